@@ -0,0 +1,29 @@
+/**
+ * @file arch/x86/pat.h
+ * @brief Таблица атрибутов страниц (PAT)
+ * @date 2026-10-19
+ * @copyright Copyright SayoriOS Team (c) 2022-2026
+ */
+
+#pragma once
+
+#include "common.h"
+
+#define IA32_PAT_MSR 0x277
+
+// Типы памяти в записях PAT
+#define PAT_UNCACHEABLE     0x00
+#define PAT_WRITE_COMBINING 0x01
+#define PAT_WRITE_THROUGH   0x04
+#define PAT_WRITE_PROTECT   0x05
+#define PAT_WRITE_BACK      0x06
+#define PAT_UNCACHED        0x07    /* UC-: уступает MTRR с объединением записи */
+
+// Бит PAT в записи таблицы страниц 4K, вместе с PCD и PWT выбирает запись PAT.
+// В записи каталога страниц этот же бит означает страницу 4M.
+#define PAGE_PAT            (1U << 7)
+
+extern bool pat_wc_available;
+
+void pat_init();
+uint32_t pat_write_combining_flags();
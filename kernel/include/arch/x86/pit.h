@@ -13,3 +13,5 @@ size_t getFrequency();
 void sleep_ticks(size_t delay);
 void sleep_ms(size_t milliseconds);
 void init_timer(size_t f);
+void timer_program_next(size_t ticks);
+uint64_t timer_tsc_per_ms();
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <common.h>
+#include "net/netbuf.h"
+
+#define E1000_VENDOR 0x8086
+#define E1000_DEVICE 0x100E     // 82540EM, `-nic model=e1000` in QEMU
+
+#define E1000_MMIO_SIZE 0x20000
+
+// Descriptors per ring: 256 * 16 bytes fill exactly one page, so a ring is physically contiguous.
+#define E1000_RX_DESCRIPTORS 256
+#define E1000_TX_DESCRIPTORS 256
+
+// Must match RCTL.BSIZE. Buffers are aligned to their size and never cross a page.
+#define E1000_RX_BUFFER_SIZE 2048
+
+// Upper bound of interrupts per second, programmed into ITR (in 256 ns units).
+#define E1000_MAX_INTERRUPT_RATE 8000
+#define E1000_ITR_INTERVAL (1000000000 / (E1000_MAX_INTERRUPT_RATE * 256))
+
+enum E1000_regs {
+    E1000_CTRL   = 0x0000,
+    E1000_STATUS = 0x0008,
+    E1000_EERD   = 0x0014,
+    E1000_ICR    = 0x00C0,
+    E1000_ITR    = 0x00C4,
+    E1000_IMS    = 0x00D0,
+    E1000_IMC    = 0x00D8,
+    E1000_RCTL   = 0x0100,
+    E1000_TCTL   = 0x0400,
+    E1000_TIPG   = 0x0410,
+    E1000_RDBAL  = 0x2800,
+    E1000_RDBAH  = 0x2804,
+    E1000_RDLEN  = 0x2808,
+    E1000_RDH    = 0x2810,
+    E1000_RDT    = 0x2818,
+    E1000_RDTR   = 0x2820,
+    E1000_TDBAL  = 0x3800,
+    E1000_TDBAH  = 0x3804,
+    E1000_TDLEN  = 0x3808,
+    E1000_TDH    = 0x3810,
+    E1000_TDT    = 0x3818,
+    E1000_MTA    = 0x5200,  // 128 dwords
+    E1000_RAL0   = 0x5400,
+    E1000_RAH0   = 0x5404,
+};
+
+#define E1000_CTRL_ASDE     (1 << 5)
+#define E1000_CTRL_SLU      (1 << 6)
+#define E1000_CTRL_RST      (1 << 26)
+
+#define E1000_STATUS_LU     (1 << 1)
+
+#define E1000_EERD_START    (1 << 0)
+#define E1000_EERD_DONE     (1 << 4)
+
+#define E1000_RCTL_EN       (1 << 1)
+#define E1000_RCTL_BAM      (1 << 15)
+#define E1000_RCTL_BSIZE_2048 (0 << 16)
+#define E1000_RCTL_SECRC    (1 << 26)
+
+#define E1000_TCTL_EN       (1 << 1)
+#define E1000_TCTL_PSP      (1 << 3)
+#define E1000_TCTL_CT       (0x10 << 4)
+#define E1000_TCTL_COLD     (0x40 << 12)
+
+#define E1000_TIPG_DEFAULT  (10 | (8 << 10) | (6 << 20))
+
+#define E1000_ICR_TXDW      (1 << 0)
+#define E1000_ICR_LSC       (1 << 2)
+#define E1000_ICR_RXDMT0    (1 << 4)
+#define E1000_ICR_RXO       (1 << 6)
+#define E1000_ICR_RXT0      (1 << 7)
+
+#define E1000_RAH_AV        (1U << 31)
+
+#define E1000_TXD_CMD_EOP   (1 << 0)
+#define E1000_TXD_CMD_IFCS  (1 << 1)
+#define E1000_TXD_CMD_RS    (1 << 3)
+#define E1000_TXD_STAT_DD   (1 << 0)
+
+#define E1000_RXD_STAT_DD   (1 << 0)
+#define E1000_RXD_STAT_EOP  (1 << 1)
+
+typedef struct {
+    uint64_t addr;
+    uint16_t length;
+    uint16_t checksum;
+    uint8_t status;
+    uint8_t errors;
+    uint16_t special;
+} __attribute__((packed)) e1000_rx_desc_t;
+
+typedef struct {
+    uint64_t addr;
+    uint16_t length;
+    uint8_t cso;
+    uint8_t cmd;
+    uint8_t status;
+    uint8_t css;
+    uint16_t special;
+} __attribute__((packed)) e1000_tx_desc_t;
+
+void e1000_init();
+void e1000_send_packet(void* data, size_t length);
+bool e1000_send_netbuf(netbuf_t* buf);
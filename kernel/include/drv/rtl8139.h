@@ -1,6 +1,7 @@
 #pragma once
 
 #include <common.h>
+#include "net/netbuf.h"
 
 #define RTL8139_VENDOR 0x10EC
 #define RTL8139_DEVICE 0x8139
@@ -22,6 +23,10 @@ enum RTL8139_regs {
 #define CAPR 0x38
 #define RX_READ_POINTER_MASK (~3)
 
+#define RTL8139_TX_DESCRIPTORS 4
+#define RTL8139_TSD_OWN (1 << 13)  // Set by the card when DMA of the descriptor is done
+#define RTL8139_CMD_BUFE (1 << 0)  // Receive buffer is empty
+
 typedef struct {
 	uint16_t Header;		/// Заголовок (?)
 	uint16_t Size;			/// Размер пакета
@@ -36,4 +41,5 @@ void rtl8139_read_mac();
 void rtl8139_setup_rcr();
 void rtl8139_enable_rx_tx();
 void rtl8139_send_packet(void* data, size_t length);
+bool rtl8139_send_netbuf(netbuf_t* buf);
 void rtl8139_end_interrupt();
\ No newline at end of file
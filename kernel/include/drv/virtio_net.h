@@ -0,0 +1,134 @@
+#pragma once
+
+#include <common.h>
+#include "net/netbuf.h"
+
+#define VIRTIO_VENDOR               0x1AF4
+#define VIRTIO_NET_DEVICE_LEGACY    0x1000  // Transitional device, `-device virtio-net-pci`
+#define VIRTIO_NET_DEVICE_MODERN    0x1041  // `disable-legacy=on`
+
+// Queue size used when the device lets us choose (modern interface). Legacy devices dictate it.
+#define VIRTIO_NET_QUEUE_SIZE       256
+
+#define VIRTIO_NET_RX_QUEUE         0
+#define VIRTIO_NET_TX_QUEUE         1
+
+// Device status bits
+#define VIRTIO_STATUS_ACKNOWLEDGE   1
+#define VIRTIO_STATUS_DRIVER        2
+#define VIRTIO_STATUS_DRIVER_OK     4
+#define VIRTIO_STATUS_FEATURES_OK   8
+#define VIRTIO_STATUS_FAILED        0x80
+
+// Feature bits
+#define VIRTIO_NET_F_CSUM           0       // Device checksums partially checksummed packets
+#define VIRTIO_NET_F_MAC            5
+#define VIRTIO_F_VERSION_1          32
+
+// Legacy interface: registers in the I/O BAR0
+enum VIRTIO_legacy_regs {
+    VIRTIO_LEGACY_DEVICE_FEATURES = 0x00,
+    VIRTIO_LEGACY_GUEST_FEATURES  = 0x04,
+    VIRTIO_LEGACY_QUEUE_PFN       = 0x08,
+    VIRTIO_LEGACY_QUEUE_SIZE      = 0x0C,
+    VIRTIO_LEGACY_QUEUE_SELECT    = 0x0E,
+    VIRTIO_LEGACY_QUEUE_NOTIFY    = 0x10,
+    VIRTIO_LEGACY_DEVICE_STATUS   = 0x12,
+    VIRTIO_LEGACY_ISR             = 0x13,
+    VIRTIO_LEGACY_DEVICE_CONFIG   = 0x14,   // Without MSI-X
+};
+
+// Modern interface: structures found through vendor PCI capabilities
+#define VIRTIO_PCI_CAP_ID           0x09
+#define VIRTIO_PCI_CAP_COMMON_CFG   1
+#define VIRTIO_PCI_CAP_NOTIFY_CFG   2
+#define VIRTIO_PCI_CAP_ISR_CFG      3
+#define VIRTIO_PCI_CAP_DEVICE_CFG   4
+
+typedef struct {
+    uint32_t device_feature_select;
+    uint32_t device_feature;
+    uint32_t driver_feature_select;
+    uint32_t driver_feature;
+    uint16_t msix_config;
+    uint16_t num_queues;
+    uint8_t device_status;
+    uint8_t config_generation;
+    uint16_t queue_select;
+    uint16_t queue_size;
+    uint16_t queue_msix_vector;
+    uint16_t queue_enable;
+    uint16_t queue_notify_off;
+    uint32_t queue_desc_low;
+    uint32_t queue_desc_high;
+    uint32_t queue_driver_low;
+    uint32_t queue_driver_high;
+    uint32_t queue_device_low;
+    uint32_t queue_device_high;
+} __attribute__((packed)) virtio_pci_common_cfg_t;
+
+// Split virtqueue (virtio 1.x, 2.7)
+#define VIRTQ_DESC_F_NEXT           1
+#define VIRTQ_DESC_F_WRITE          2
+#define VIRTQ_USED_F_NO_NOTIFY      1
+#define VIRTQ_AVAIL_F_NO_INTERRUPT  1
+
+// Legacy devices expect the used ring on the next page boundary.
+#define VIRTQ_ALIGN                 4096
+
+typedef struct {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} __attribute__((packed)) virtq_desc_t;
+
+typedef struct {
+    uint16_t flags;
+    uint16_t idx;
+    uint16_t ring[];
+} __attribute__((packed)) virtq_avail_t;
+
+typedef struct {
+    uint32_t id;
+    uint32_t len;
+} __attribute__((packed)) virtq_used_elem_t;
+
+typedef struct {
+    uint16_t flags;
+    uint16_t idx;
+    virtq_used_elem_t ring[];
+} __attribute__((packed)) virtq_used_t;
+
+typedef struct {
+    uint16_t index;
+    uint16_t size;
+    volatile virtq_desc_t* desc;
+    volatile virtq_avail_t* avail;
+    volatile virtq_used_t* used;
+    size_t phys;
+    uint16_t free_head;         /* Chain of free descriptors */
+    uint16_t num_free;
+    uint16_t avail_idx;         /* Our copy of `avail->idx`, published on kick */
+    uint16_t last_used;
+    uint16_t notify_offset;     /* Modern: queue_notify_off */
+    void** cookies;             /* Per head descriptor */
+} virtqueue_t;
+
+#define VIRTIO_NET_HDR_F_NEEDS_CSUM 1
+#define VIRTIO_NET_HDR_GSO_NONE     0
+
+typedef struct {
+    uint8_t flags;
+    uint8_t gso_type;
+    uint16_t hdr_len;
+    uint16_t gso_size;
+    uint16_t csum_start;
+    uint16_t csum_offset;
+    uint16_t num_buffers;   /* Only with VIRTIO_F_VERSION_1 */
+} __attribute__((packed)) virtio_net_hdr_t;
+
+void virtio_net_init();
+void virtio_net_send_packet(void* data, size_t length);
+bool virtio_net_send_netbuf(netbuf_t* buf);
+void virtio_net_flush();
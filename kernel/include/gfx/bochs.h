@@ -0,0 +1,64 @@
+/**
+ * @file gfx/bochs.h
+ * @brief Адаптер Bochs/QEMU VBE (интерфейс dispi)
+ * @date 2026-10-19
+ * @copyright Copyright SayoriOS Team (c) 2022-2026
+ */
+
+#pragma once
+
+#include "common.h"
+#include "io/screen.h"
+
+#define BOCHS_PCI_VENDOR                0x1234
+#define BOCHS_PCI_DEVICE                0x1111
+
+#define BOCHS_DISPI_IOPORT_INDEX        0x01CE
+#define BOCHS_DISPI_IOPORT_DATA         0x01CF
+
+#define BOCHS_DISPI_INDEX_ID            0x0
+#define BOCHS_DISPI_INDEX_XRES          0x1
+#define BOCHS_DISPI_INDEX_YRES          0x2
+#define BOCHS_DISPI_INDEX_BPP           0x3
+#define BOCHS_DISPI_INDEX_ENABLE        0x4
+#define BOCHS_DISPI_INDEX_BANK          0x5
+#define BOCHS_DISPI_INDEX_VIRT_WIDTH    0x6
+#define BOCHS_DISPI_INDEX_VIRT_HEIGHT   0x7
+#define BOCHS_DISPI_INDEX_X_OFFSET      0x8
+#define BOCHS_DISPI_INDEX_Y_OFFSET      0x9
+#define BOCHS_DISPI_INDEX_VIDEO_MEMORY  0xA     /* In 64K blocks */
+
+// The same registers, 16 bits each, in BAR2 (the only way to reach them on bochs-display).
+#define BOCHS_MMIO_DISPI                0x500
+
+#define BOCHS_DISPI_ID0                 0xB0C0
+#define BOCHS_DISPI_ID2                 0xB0C2  /* First version with virtual size and panning */
+#define BOCHS_DISPI_ID5                 0xB0C5
+
+#define BOCHS_DISPI_ENABLED             0x01
+#define BOCHS_DISPI_LFB_ENABLED         0x40
+#define BOCHS_DISPI_NOCLEARMEM          0x80
+
+// Bochs limits, QEMU accepts more. Widths must be a multiple of 8.
+#define BOCHS_DISPI_MAX_XRES            2560
+#define BOCHS_DISPI_MAX_YRES            1600
+
+#define BOCHS_MAX_MODES                 32
+
+// VGA input status #1: bit 3 is set during vertical retrace.
+#define BOCHS_VGA_INPUT_STATUS          0x03DA
+#define BOCHS_VGA_VRETRACE              0x08
+#define BOCHS_VGA_NO_PORTS              0xFF
+
+uint16_t bochs_dispi_read(uint16_t index);
+void bochs_dispi_write(uint16_t index, uint16_t value);
+bool bochs_dispi_present();
+bool bochs_dispi_drives_mode(uint32_t width, uint32_t height, uint32_t bpp, uint32_t pitch);
+uint32_t bochs_dispi_set_virtual_height(uint32_t height);
+void bochs_dispi_set_y_offset(uint32_t y);
+void bochs_wait_vsync();
+
+bool bochs_init();
+size_t bochs_mode_count();
+bool bochs_mode_get(size_t index, screen_mode_t* out);
+bool bochs_set_mode(uint32_t width, uint32_t height, uint32_t bpp);
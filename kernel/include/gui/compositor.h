@@ -0,0 +1,61 @@
+/**
+ * @file gui/compositor.h
+ * @brief Композитор: окна со своими буферами, порядок по Z и курсор мыши поверх них
+ * @date 2026-10-19
+ * @copyright Copyright SayoriOS Team (c) 2022-2026
+ */
+
+#pragma once
+
+#include "common.h"
+#include "lib/blit.h"
+
+#define COMPOSITOR_MAX_WINDOWS  16
+#define COMPOSITOR_MAX_DAMAGE   32
+#define COMPOSITOR_MAX_PIECES   64
+#define COMPOSITOR_FRAME_MS     16
+#define COMPOSITOR_MAX_SIDE     4096
+
+#define COMPOSITOR_CURSOR_WIDTH   12
+#define COMPOSITOR_CURSOR_HEIGHT  19
+
+/// Прямоугольник экрана [x0, x1) x [y0, y1)
+typedef struct {
+    int32_t x0;
+    int32_t y0;
+    int32_t x1;
+    int32_t y1;
+} compositor_box_t;
+
+/**
+ * Окно: буфер 0x00RRGGBB по 32 бита без промежутков между строками. Владелец рисует в
+ * surface.pixels и отмечает изменённое через window_damage или window_present.
+ */
+typedef struct {
+    size_t          id;
+    blit_surface_t  surface;
+    int32_t         x;          /* Положение на экране */
+    int32_t         y;
+} window_t;
+
+typedef enum {
+    COMPOSITOR_CURSOR_ARROW = 0,
+    COMPOSITOR_CURSOR_BUSY,
+    COMPOSITOR_CURSOR_SHAPES
+} compositor_cursor_t;
+
+void compositor_init();
+void compositor_compose();
+void compositor_suspend();
+void compositor_resume();
+
+window_t* window_create(int32_t x, int32_t y, uint32_t width, uint32_t height);
+void window_destroy(window_t* window);
+void window_move(window_t* window, int32_t x, int32_t y);
+void window_raise(window_t* window);
+void window_damage(window_t* window, int32_t x, int32_t y, uint32_t width, uint32_t height);
+void window_present(window_t* window);
+
+void compositor_show_cursor(bool show);
+bool compositor_cursor_shown();
+void compositor_set_cursor(compositor_cursor_t shape);
@@ -2,6 +2,7 @@
 
 #include <common.h>
 #include "multiboot.h"
+#include "lib/blit.h"
 
 extern uint8_t* framebuffer_addr;
 extern volatile size_t framebuffer_bpp;
@@ -9,12 +10,32 @@ extern volatile size_t framebuffer_pitch;
 extern uint8_t* back_framebuffer_addr;
 extern volatile size_t framebuffer_size;
 
+/// Изменённая часть строки заднего буфера: пиксели [x0, x1), строка чистая при x0 >= x1
+typedef struct {
+	uint32_t x0;
+	uint32_t x1;
+} screen_span_t;
+
+// x0 чистой строки и screen_damage_top без изменений
+#define SCREEN_DAMAGE_NONE 0xFFFFFFFF
+
+extern screen_span_t* screen_damage;
+extern uint32_t screen_damage_top;
+extern uint32_t screen_damage_bottom;
+
 typedef enum {
 	SCREEN_QUERY_WIDTH = 0,
 	SCREEN_QUERY_HEIGHT = 1,
 	SCREEN_QUERY_BITS_PER_PIXEL = 2,
 } screen_query_t;
 
+/// Режим экрана
+typedef struct {
+	uint32_t width;
+	uint32_t height;
+	uint32_t bpp;
+} screen_mode_t;
+
 #define VESA_WIDTH  (getScreenWidth())
 #define VESA_HEIGHT (getScreenHeight())
 
@@ -66,18 +87,50 @@ size_t getPixel(int32_t x, int32_t y);
 
 
 /**
- * @brief Вывод одного пикселя на экран
+ * @brief Отмечает пиксель заднего буфера изменённым, координаты уже проверены
+ *
+ * @param x - позиция по x
+ * @param y - позиция по y
+ */
+inline static __attribute__((always_inline)) void screen_damage_pixel(uint32_t x, uint32_t y) {
+	if (screen_damage == NULL) {
+		return;
+	}
+
+	screen_span_t* span = screen_damage + y;
+
+	if (x < span->x0) {
+		span->x0 = x;
+	}
+
+	if (x >= span->x1) {
+		span->x1 = x + 1;
+	}
+
+	if (y < screen_damage_top) {
+		screen_damage_top = y;
+	}
+
+	if (y >= screen_damage_bottom) {
+		screen_damage_bottom = y + 1;
+	}
+}
+
+/**
+ * @brief Запись пикселя в задний буфер без отметки изменений
+ *
+ * Для примитивов, которые сами отмечают изменённый прямоугольник целиком.
  *
  * @param x - позиция по x
  * @param y - позиция по y
  * @param color - цвет
  */
-inline static __attribute__((always_inline)) void set_pixel(uint32_t x, uint32_t y, uint32_t color) {
+inline static __attribute__((always_inline)) void screen_write_pixel(uint32_t x, uint32_t y, uint32_t color) {
 	if (x >= VESA_WIDTH ||
 		y >= VESA_HEIGHT) {
 		return;
 	}
-	
+
 	uint8_t* pixels = back_framebuffer_addr + (x * (framebuffer_bpp >> 3)) + y * framebuffer_pitch;
 
 	pixels[0] = color & 0xff;
@@ -85,6 +138,24 @@ inline static __attribute__((always_inline)) void set_pixel(uint32_t x, uint32_t
 	pixels[2] = (color >> 16) & 0xff;
 }
 
+/**
+ * @brief Вывод одного пикселя на экран
+ *
+ * @param x - позиция по x
+ * @param y - позиция по y
+ * @param color - цвет
+ */
+inline static __attribute__((always_inline)) void set_pixel(uint32_t x, uint32_t y, uint32_t color) {
+	if (x >= VESA_WIDTH ||
+		y >= VESA_HEIGHT) {
+		return;
+	}
+
+	screen_write_pixel(x, y, color);
+	screen_damage_pixel(x, y);
+}
+
+// Пишет 4 пикселя подряд без проверок и без отметки изменений.
 inline static __attribute__((always_inline)) void set_pixel4x1(uint32_t x, uint32_t y, uint32_t color) {
 	uint8_t* pixels = back_framebuffer_addr + (x * (framebuffer_bpp >> 3)) + y * framebuffer_pitch;
 
@@ -104,9 +175,25 @@ inline static __attribute__((always_inline)) uint32_t getDisplaySize(){
 
 void setPixelAlpha(uint32_t x, uint32_t y, rgba_color color);
 void rect_copy(int x, int y, int width, int height);
-void graphics_update(uint32_t new_width, uint32_t new_height, uint32_t new_pitch);
+void graphics_update(size_t new_address, uint32_t new_width, uint32_t new_height, uint32_t new_pitch, uint32_t new_bpp);
 
 void init_vbe(const multiboot_header_t *mboot);
 void screen_update();
 
 void clean_screen();
+
+void screen_back_surface(blit_surface_t* out);
+void screen_fill_rect(int x, int y, int width, int height, uint32_t color);
+void screen_copy_rect(int dst_x, int dst_y, int src_x, int src_y, int width, int height);
+void screen_blend_span(int x, int y, const uint32_t* argb, int length);
+void screen_draw_image(int x, int y, int width, int height, const uint32_t* pixels);
+
+void screen_mark_dirty(int x, int y, int width, int height);
+void screen_mark_all_dirty();
+uint64_t screen_flushed_bytes();
+bool screen_page_flipping();
+bool screen_set_page_flipping(bool enable);
+
+size_t screen_mode_count();
+bool screen_mode_get(size_t index, screen_mode_t* out);
+bool screen_set_mode(uint32_t width, uint32_t height, uint32_t bpp);
@@ -0,0 +1,49 @@
+/**
+ * @file io/surface.h
+ * @brief Поверхности программ: буферы пикселей в общей с ядром памяти
+ * @date 2026-10-19
+ * @copyright Copyright SayoriOS Team (c) 2022-2026
+ */
+
+#pragma once
+
+#include "common.h"
+#include "lib/blit.h"
+
+// ID 0 means the screen itself in the screen system calls.
+#define SURFACE_SCREEN      0
+
+#define SURFACE_TABLE_BITS  6
+#define SURFACE_MAX_SIDE    4096
+
+/// Изменённый прямоугольник поверхности, в её координатах
+typedef struct {
+    int32_t  x;
+    int32_t  y;
+    uint32_t width;
+    uint32_t height;
+} surface_rect_t;
+
+/**
+ * Пиксели 0x00RRGGBB по 32 бита без промежутков между строками. Лежат в физических страницах
+ * ядра, отображённых только в адресное пространство владельца, поэтому ядро читает их, пока
+ * активен каталог страниц владельца (в его системных вызовах).
+ */
+typedef struct {
+    size_t          id;
+    size_t          owner;      /* PID */
+    size_t          physical;
+    size_t          pages;
+    blit_surface_t  pixels;     /* pixels.pixels - адрес у владельца */
+    int32_t         x;          /* Положение на экране */
+    int32_t         y;
+} surface_t;
+
+void surfaces_init();
+ssize_t surface_create(uint32_t width, uint32_t height, size_t address);
+surface_t* surface_get(size_t id);
+void surface_put(surface_t* surface);
+bool surface_destroy(size_t id);
+void surface_destroy_process(size_t pid);
+bool surface_move(size_t id, int32_t x, int32_t y);
+bool surface_present(size_t id, const surface_rect_t* rects, size_t count);
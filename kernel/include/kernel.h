@@ -45,6 +45,8 @@
 #include "drv/disk/ata.h"
 #include <drv/atapi.h>
 #include <drv/rtl8139.h>
+#include <drv/e1000.h>
+#include <drv/virtio_net.h>
 
 #include <fs/fsm.h>
 
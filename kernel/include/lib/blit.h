@@ -0,0 +1,49 @@
+/**
+ * @file lib/blit.h
+ * @brief Заливка, копирование, смешивание и преобразование пикселей
+ * @date 2026-10-19
+ * @copyright Copyright SayoriOS Team (c) 2022-2026
+ */
+
+#pragma once
+
+#include "common.h"
+
+/// Прямоугольный буфер пикселей: задний буфер экрана или любая картинка в памяти
+typedef struct {
+    uint8_t* pixels;
+    size_t   pitch;     /* Байт на строку */
+    uint32_t width;
+    uint32_t height;
+    uint32_t bpp;       /* 24 или 32, другие форматы не поддерживаются */
+} blit_surface_t;
+
+/**
+ * Ядра одного варианта реализации. Цвета и пиксели 32 бит - 0xAARRGGBB (в памяти B, G, R, A),
+ * пиксели 24 бит - B, G, R.
+ */
+typedef struct {
+    const char* name;
+
+    void (*fill32)(uint32_t* dst, uint32_t color, size_t count);
+    void (*fill24)(uint8_t* dst, uint32_t color, size_t count);
+    // Области не пересекаются или dst лежит перед src.
+    void (*copy)(void* dst, const void* src, size_t bytes);
+    // Накладывает src с альфой из старшего байта на dst.
+    void (*blend32)(uint32_t* dst, const uint32_t* src, size_t count);
+    void (*convert_24_to_32)(uint32_t* dst, const uint8_t* src, size_t count);
+    void (*convert_32_to_24)(uint8_t* dst, const uint32_t* src, size_t count);
+} blit_ops_t;
+
+extern const blit_ops_t* blit_ops;
+
+void blit_init();
+size_t blit_variant_count();
+const blit_ops_t* blit_variant(size_t index);
+
+void blit_fill_span(const blit_surface_t* surface, int x, int y, int length, uint32_t color);
+void blit_fill_rect(const blit_surface_t* surface, int x, int y, int width, int height, uint32_t color);
+void blit_copy_rect(const blit_surface_t* dst, int dst_x, int dst_y,
+                    const blit_surface_t* src, int src_x, int src_y, int width, int height);
+void blit_blend_span(const blit_surface_t* surface, int x, int y, const uint32_t* argb, int length);
+void blit_convert(void* dst, uint32_t dst_bpp, const void* src, uint32_t src_bpp, size_t count);
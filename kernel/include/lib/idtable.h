@@ -0,0 +1,27 @@
+#pragma once
+
+#include "common.h"
+
+#define IDTABLE_INVALID_ID ((size_t)-1)
+
+/**
+ * Table that maps small numeric IDs (PID, TID, etc.) to objects in O(1).
+ *
+ * ID is `(generation << slot_bits) | slot`. When a slot is freed its generation is incremented,
+ * so stale IDs never resolve to the object that reuses the slot.
+ */
+typedef struct {
+    void**      objects;
+    size_t*     generations;
+    size_t*     free_slots;     /* Ring of free slots, so freed slots are reused as late as possible */
+    size_t      free_head;
+    size_t      free_count;
+    size_t      slot_bits;
+    size_t      capacity;
+    size_t      count;
+} idtable_t;
+
+bool idtable_init(idtable_t* table, size_t slot_bits);
+size_t idtable_alloc(idtable_t* table, void* object);
+void* idtable_get(const idtable_t* table, size_t id);
+void idtable_remove(idtable_t* table, size_t id);
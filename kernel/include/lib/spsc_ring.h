@@ -0,0 +1,92 @@
+#pragma once
+
+#include "common.h"
+
+/**
+ * Bounded lock-free FIFO for exactly one producer and one consumer
+ * (e.g. an IRQ handler and a worker thread).
+ *
+ * Slots are owned by the ring: the producer fills the slot returned by
+ * `spsc_ring_producer_slot` and publishes it with `spsc_ring_produce`; the consumer
+ * works with `spsc_ring_consumer_slot` in place and gives it back with `spsc_ring_consume`.
+ * So slots can hold preallocated buffers and nothing is allocated or copied twice.
+ */
+typedef struct {
+    size_t      head;       /* Written only by the producer */
+    size_t      tail;       /* Written only by the consumer */
+    size_t      mask;       /* Capacity - 1 (capacity is a power of two) */
+    void**      slots;
+} spsc_ring_t;
+
+bool spsc_ring_init(spsc_ring_t* ring, size_t capacity);
+void spsc_ring_destroy(spsc_ring_t* ring);
+
+SAYORI_INLINE size_t spsc_ring_capacity(const spsc_ring_t* ring) {
+    return ring->mask + 1;
+}
+
+SAYORI_INLINE size_t spsc_ring_count(const spsc_ring_t* ring) {
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
+
+/// Producer: the free slot at the head, or NULL if the ring is full.
+SAYORI_INLINE void** spsc_ring_producer_slot(spsc_ring_t* ring) {
+    size_t head = ring->head;
+
+    if(head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) > ring->mask) {
+        return NULL;
+    }
+
+    return &ring->slots[head & ring->mask];
+}
+
+/// Producer: publishes the slot returned by `spsc_ring_producer_slot`.
+SAYORI_INLINE void spsc_ring_produce(spsc_ring_t* ring) {
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+/// Consumer: the oldest published slot, or NULL if the ring is empty.
+SAYORI_INLINE void** spsc_ring_consumer_slot(spsc_ring_t* ring) {
+    size_t tail = ring->tail;
+
+    if(tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+
+    return &ring->slots[tail & ring->mask];
+}
+
+/// Consumer: gives the slot returned by `spsc_ring_consumer_slot` back to the producer.
+SAYORI_INLINE void spsc_ring_consume(spsc_ring_t* ring) {
+    __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+}
+
+/// Producer: queues a pointer. Returns false if the ring is full.
+SAYORI_INLINE bool spsc_ring_push(spsc_ring_t* ring, void* value) {
+    void** slot = spsc_ring_producer_slot(ring);
+
+    if(slot == NULL) {
+        return false;
+    }
+
+    *slot = value;
+
+    spsc_ring_produce(ring);
+
+    return true;
+}
+
+/// Consumer: takes the oldest pointer, or NULL if the ring is empty.
+SAYORI_INLINE void* spsc_ring_pop(spsc_ring_t* ring) {
+    void** slot = spsc_ring_consumer_slot(ring);
+
+    if(slot == NULL) {
+        return NULL;
+    }
+
+    void* value = *slot;
+
+    spsc_ring_consume(ring);
+
+    return value;
+}
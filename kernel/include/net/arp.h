@@ -2,12 +2,29 @@
 
 #include "common.h"
 #include "cards.h"
+#include "net/netbuf.h"
 
 #define ARP_REQUEST 1
 #define ARP_REPLY 2
 
+// Most neighbors kept at once, stale ones are evicted first.
 #define ARP_TABLE_MAX_SIZE 128
 
+// Number of buckets in the neighbor table (power of two).
+#define ARP_HASH_SIZE 64
+
+// Packets held per neighbor until its address is resolved, older ones are dropped.
+#define ARP_MAX_PENDING 16
+
+// Timings are in timer ticks (1 ms).
+#define ARP_TIMER_INTERVAL      100
+#define ARP_RETRANSMIT_TIME     1000    /* Between requests of an incomplete entry */
+#define ARP_REACHABLE_TIME      30000   /* Reachable entry becomes stale after it */
+#define ARP_STALE_TIME          600000  /* Unused stale entry is removed after it */
+
+// Requests sent before the neighbor is declared unreachable.
+#define ARP_MAX_REQUESTS        3
+
 typedef struct arp_packet {
     uint16_t hardware_type;
     uint16_t protocol;
@@ -22,13 +39,38 @@ typedef struct arp_packet {
     uint8_t dest_ip[4];
 } __attribute__((packed)) arp_packet_t;
 
+typedef enum {
+    ARP_STATE_INCOMPLETE = 0,   /* Request sent, packets wait in `pending` */
+    ARP_STATE_REACHABLE,        /* Confirmed recently */
+    ARP_STATE_STALE,            /* Still used, the next send asks the neighbor again */
+} arp_state_t;
+
 typedef struct arp_table_entry {
+    struct arp_table_entry* next;       /* Hash chain */
+    netcard_entry_t* card;
     uint32_t ip_addr;
     uint8_t mac_addr[6];
+    arp_state_t state;
+    size_t deadline;                    /* Next state change */
+    size_t requests;                    /* Sent since the last reply */
+    netbuf_t* pending_head;
+    netbuf_t* pending_tail;
+    size_t pending_count;
 } arp_table_entry_t;
 
+typedef struct {
+    size_t  entries;
+    size_t  requests_sent;
+    size_t  resolved;
+    size_t  unreachable;        /* Entries that never got a reply */
+    size_t  pending_dropped;    /* Packets dropped from full or failed queues */
+    size_t  evicted;
+} arp_stats_t;
+
 void arp_handle_packet(netcard_entry_t* card, arp_packet_t* arp_packet, size_t len);
 void arp_send_packet(netcard_entry_t* card, uint8_t* dst_hardware_addr, uint8_t* dst_protocol_addr);
+void arp_output(netcard_entry_t* card, const uint8_t ip_addr[4], netbuf_t* buf);
 bool arp_lookup(uint8_t* ret_hardware_addr, const uint8_t* ip_addr);
-void arp_lookup_add(uint8_t* ret_hardware_addr, uint8_t* ip_addr);
+void arp_lookup_add(netcard_entry_t* card, const uint8_t* hardware_addr, const uint8_t* ip_addr);
+void arp_get_stats(arp_stats_t* out);
 void arp_init();
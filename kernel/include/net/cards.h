@@ -2,15 +2,39 @@
 
 #include "common.h"
 
+struct netbuf;
+struct netstack_card;
+
+// Card computes checksums of netbufs marked with `csum_partial`.
+#define NETCARD_FEATURE_TX_CSUM (1 << 0)
+// Frames come back to the same card: there are no neighbours to resolve and no DHCP.
+#define NETCARD_FEATURE_LOOPBACK (1 << 1)
+
 typedef struct {
     char name[64];
 	uint8_t ipv4_addr[4];
     void (*get_mac_addr)(uint8_t[6]);
     void (*send_packet)(void*, size_t);
+    // Optional. Takes ownership of the buffer and may give it to DMA directly. Returns false,
+    // leaving the buffer to the caller, when the card has no free descriptor; the card then
+    // calls `netstack_tx_resume` once one frees up. Cards that can't tell drop the frame.
+    bool (*send_netbuf)(struct netbuf*);
+    // Queues of the network stack, set up by `netcard_add`.
+    struct netstack_card* stack;
+    // NETCARD_FEATURE_*
+    uint32_t features;
+    // Optional. Called by the TX worker after a batch of `send_netbuf` calls.
+    void (*flush)(void);
+    // Optional polled receive (see `netstack_schedule_poll`). `poll` moves up to `budget` frames
+    // into the stack with `netstack_transfer` and returns their number. `rx_irq_enable` unmasks
+    // RX interrupts; if frames are already waiting it keeps them masked and returns false.
+    size_t (*poll)(size_t budget);
+    bool (*rx_irq_enable)(void);
 } netcard_entry_t;
 
 
 void netcards_list_init();
 void netcard_add(netcard_entry_t *card);
 size_t netcards_get_count();
-netcard_entry_t* netcard_get(size_t index);
\ No newline at end of file
+netcard_entry_t* netcard_get(size_t index);
+netcard_entry_t* netcard_route(const uint8_t ip[4]);
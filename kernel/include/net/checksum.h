@@ -0,0 +1,63 @@
+#pragma once
+
+#include "common.h"
+
+/**
+ * Internet checksum (RFC 1071).
+ *
+ * Partial sums are 32-bit one's complement sums of 16-bit words loaded in host order
+ * straight from the packet, so `checksum_fold` gives a value that is stored into
+ * the header as is, without `htons`. Partial sums of separate blocks are combined
+ * with `checksum_block_add`, which accounts for blocks starting at odd offsets.
+ */
+
+typedef struct {
+    uint64_t    reference_tsc;  /* Plain loop over 16-bit words */
+    uint64_t    partial_tsc;    /* `checksum_partial` */
+    uint64_t    memcpy_tsc;     /* `memcpy`, then `checksum_partial` */
+    uint64_t    copy_tsc;       /* `checksum_copy` */
+    uint64_t    tsc_per_ms;
+    bool        sse2;
+} checksum_bench_t;
+
+uint32_t checksum_partial(const void* data, size_t len, uint32_t sum);
+uint32_t checksum_copy(void* dst, const void* src, size_t len, uint32_t sum);
+uint32_t checksum_pseudo_header(const uint8_t src[4], const uint8_t dst[4], uint8_t protocol, uint16_t length,
+                                uint32_t sum);
+uint16_t checksum_replace16(uint16_t check, uint16_t old_value, uint16_t new_value);
+uint16_t checksum_replace32(uint16_t check, uint32_t old_value, uint32_t new_value);
+uint16_t checksum(const void* data, size_t len);
+
+bool checksum_benchmark(size_t length, size_t rounds, checksum_bench_t* out);
+
+// One's complement addition with the end-around carry.
+SAYORI_INLINE uint32_t checksum_add(uint32_t sum, uint32_t value) {
+    sum += value;
+
+    return sum + (sum < value);
+}
+
+/**
+ * @brief Добавляет сумму блока, лежащего в пакете по смещению `offset`
+ *
+ * @param sum - Сумма предыдущих блоков
+ * @param block - Сумма блока, посчитанная с его начала
+ * @param offset - Смещение блока от начала суммируемых данных
+ * @return uint32_t - Общая сумма
+ */
+SAYORI_INLINE uint32_t checksum_block_add(uint32_t sum, uint32_t block, size_t offset) {
+    // Bytes of a block at an odd offset land in the other halves of the 16-bit words.
+    if(offset & 1) {
+        block = (block >> 8) | (block << 24);
+    }
+
+    return checksum_add(sum, block);
+}
+
+// Folds a partial sum into the value of a checksum field.
+SAYORI_INLINE uint16_t checksum_fold(uint32_t sum) {
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+
+    return (uint16_t)~sum;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+// Error codes of the network stack. Functions return them negated (`-NET_EAGAIN`),
+// numbers match Linux, so user space can treat them as ordinary errno values.
+
+#define NET_EBADF           9
+#define NET_EAGAIN          11
+#define NET_ENOMEM          12
+#define NET_EFAULT          14
+#define NET_EINVAL          22
+#define NET_EMFILE          24
+#define NET_EPIPE           32
+#define NET_ENOTSOCK        88
+#define NET_EMSGSIZE        90
+#define NET_EPROTONOSUPPORT 93
+#define NET_EOPNOTSUPP      95
+#define NET_EAFNOSUPPORT    97
+#define NET_EADDRINUSE      98
+#define NET_ENETUNREACH     101
+#define NET_ECONNRESET      104
+#define NET_EISCONN         106
+#define NET_ENOTCONN        107
+#define NET_ETIMEDOUT       110
+#define NET_ECONNREFUSED    111
+#define NET_EALREADY        114
+#define NET_EINPROGRESS     115
@@ -2,6 +2,7 @@
 
 #include "common.h"
 #include "net/cards.h"
+#include "net/netbuf.h"
 
 #define ETHERNET_TYPE_IPV4		0x0800	/// Internet Protocol v4
 #define ETHERNET_TYPE_ARP		0x0806	/// Address Resolution Protocol
@@ -72,6 +73,8 @@
 
 #define HARDWARE_TYPE_ETHERNET 0x01
 
+#define ETHERNET_MIN_FRAME_SIZE 60	/// Without FCS
+
 typedef struct ethernet_frame {
   uint8_t dest_mac[6];
   uint8_t src_mac[6];
@@ -137,4 +140,5 @@ typedef struct {
 
 
 void ethernet_send_packet(netcard_entry_t* card, uint8_t* dest_mac, uint8_t* data, size_t len, uint16_t type);
+void ethernet_send_netbuf(netcard_entry_t* card, const uint8_t* dest_mac, netbuf_t* buf, uint16_t type);
 void ethernet_handle_packet(netcard_entry_t *card, ethernet_frame_t *packet, size_t len);
\ No newline at end of file
@@ -1,5 +1,15 @@
 #pragma once
 
 #include "net/cards.h"
+#include "net/ethernet.h"
 
-void icmp_handle_packet(netcard_entry_t* card, char* packet_data);
\ No newline at end of file
+#define ICMP_ECHO_REPLY     0
+#define ICMP_ECHO_REQUEST   8
+
+typedef struct {
+	uint8_t type;
+	uint8_t code;
+	uint16_t checksum;
+} __attribute__((packed)) icmp_header_t;
+
+void icmp_handle_packet(netcard_entry_t* card, ipv4_packet_t* ip, char* packet_data, size_t length);
@@ -6,8 +6,10 @@
 
 #include <common.h>
 #include "net/cards.h"
+#include "net/netbuf.h"
 
 #define IP_PROTOCOL_UDP 17
 
 void ipv4_handle_packet(netcard_entry_t *card, char *packet, size_t packet_size);
-void ipv4_send_packet(netcard_entry_t *card, uint8_t dest_ip[4], const void *data, size_t size, uint8_t protocol);
\ No newline at end of file
+void ipv4_send_packet(netcard_entry_t *card, uint8_t dest_ip[4], const void *data, size_t size, uint8_t protocol);
+void ipv4_send_netbuf(netcard_entry_t *card, const uint8_t dest_ip[4], netbuf_t* buf, uint8_t protocol);
\ No newline at end of file
@@ -0,0 +1,5 @@
+#pragma once
+
+#include "net/cards.h"
+
+void loopback_init();
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "common.h"
+#include "net/stack.h"
+
+// Port of both tests on 127.0.0.1 (the one iperf3 uses).
+#define NETBENCH_PORT           5201
+
+// Datagrams sent before waiting for them: below the ring sizes and SOCKET_UDP_QUEUE_LENGTH.
+#define NETBENCH_UDP_BURST      32
+
+// Longest wait for the other side before the rest of a burst is counted as lost
+// or the TCP test is aborted.
+#define NETBENCH_TIMEOUT_MS     1000
+
+// Bytes given to one send/recv call of the TCP test.
+#define NETBENCH_TCP_CHUNK      16384
+
+typedef struct {
+    size_t              datagrams;  /* UDP: datagrams received */
+    size_t              lost;       /* UDP: datagrams that never arrived */
+    size_t              bytes;      /* Payload received */
+    size_t              frames;     /* Frames that went through the loopback card */
+    uint64_t            elapsed_us;
+    netstack_counters_t counters;   /* Work of the stack during the test */
+} netbench_result_t;
+
+ssize_t netbench_udp(size_t count, size_t payload, netbench_result_t* out);
+ssize_t netbench_tcp(size_t bytes, netbench_result_t* out);
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "common.h"
+#include "net/cards.h"
+
+// Ethernet (14) + IPv4 (20) + TCP with options (60), rounded up. The extra 2 bytes offset
+// the 14-byte Ethernet header, so frames of whole headers start on a dword boundary
+// (RTL8139 needs that for transmit buffers).
+#define NETBUF_HEADROOM     130
+
+// Enough for the headroom and a full Ethernet frame. Buffers are aligned to their size,
+// so they never cross a page and are physically contiguous (can be given to DMA as is).
+#define NETBUF_SIZE         2048
+
+#define NETBUF_MAX_PAYLOAD  (NETBUF_SIZE - NETBUF_HEADROOM)
+
+// Free buffers kept for reuse instead of going back to the heap.
+#define NETBUF_CACHE_SIZE   64
+
+/**
+ * Packet buffer. Payload is written once, then every layer prepends its header in place
+ * with `netbuf_push`, so the same buffer travels from the protocol down to the card.
+ */
+typedef struct netbuf {
+    struct netbuf*      next;       /* For queues */
+    netcard_entry_t*    card;
+    uint8_t*            head;       /* Start of the buffer */
+    uint8_t*            data;       /* Start of the packet */
+    size_t              len;        /* Length of the packet */
+    size_t              capacity;   /* Size of the buffer */
+    size_t              phys;       /* Physical address of `head` */
+    /* Checksum offload (NETCARD_FEATURE_TX_CSUM): the field at `csum_offset` holds
+       the pseudo-header sum, the card sums everything from `csum_start` into it. */
+    bool                csum_partial;
+    uint16_t            csum_start;     /* From `head` */
+    uint16_t            csum_offset;    /* From `csum_start` */
+    /* Partial checksum of the payload, taken while copying it in (`netbuf_put_copy`). */
+    bool                csum_valid;
+    uint32_t            csum;
+} netbuf_t;
+
+netbuf_t* netbuf_alloc(size_t headroom, size_t length);
+void netbuf_free(netbuf_t* buf);
+
+void* netbuf_put(netbuf_t* buf, size_t length);
+void* netbuf_push(netbuf_t* buf, size_t length);
+void* netbuf_pull(netbuf_t* buf, size_t length);
+void netbuf_put_copy(netbuf_t* buf, const void* data, size_t length);
+
+SAYORI_INLINE size_t netbuf_headroom(const netbuf_t* buf) {
+    return buf->data - buf->head;
+}
+
+SAYORI_INLINE size_t netbuf_tailroom(const netbuf_t* buf) {
+    return buf->capacity - netbuf_headroom(buf) - buf->len;
+}
+
+SAYORI_INLINE size_t netbuf_phys(const netbuf_t* buf) {
+    return buf->phys + netbuf_headroom(buf);
+}
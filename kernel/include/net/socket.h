@@ -1,18 +1,93 @@
 #pragma once
 
-#define SOCKET_TCP 1
+#include "common.h"
+#include "net/tcp.h"
+#include "sys/scheduler/scheduler.h"
 
+// Values follow BSD, so user programs can use the usual names.
+#define SOCKET_AF_INET          2
+
+#define SOCKET_STREAM           1
+#define SOCKET_DGRAM            2
+#define SOCKET_TYPE_MASK        0xF
+#define SOCKET_NONBLOCK         0x800   /* Or-ed into `type` */
+
+#define SOCKET_MSG_DONTWAIT     0x40    /* `flags` of send/recv */
+
+#define SOCKET_SHUT_WR          1
+
+// Readiness bits of `socket_poll` (same as poll(2)).
+#define SOCKET_POLL_IN          0x01
+#define SOCKET_POLL_OUT         0x04
+#define SOCKET_POLL_ERR         0x08
+#define SOCKET_POLL_HUP         0x10
+#define SOCKET_POLL_NVAL        0x20
+
+// Most descriptors one `socket_poll` call can wait on.
+#define SOCKET_POLL_MAX         256
+
+// Ethernet MTU minus IPv4 and UDP headers: datagrams are not fragmented.
+#define SOCKET_UDP_MAX_PAYLOAD  1472
+
+// Datagrams queued on a UDP socket before new ones are dropped.
+#define SOCKET_UDP_QUEUE_LENGTH 64
+
+#define SOCKET_TABLE_BITS       10
+
+// Address in host byte order.
 typedef struct {
     uint8_t address[4];
     uint16_t port;
 } socket_address_t;
 
 typedef struct {
-    socket_address_t* bond_address;
-    // ...
+    int32_t     fd;
+    uint16_t    events;
+    uint16_t    revents;
+} socket_poll_t;
+
+typedef struct socket_datagram {
+    struct socket_datagram* next;
+    socket_address_t        from;
+    size_t                  len;
+    uint8_t                 data[];
+} socket_datagram_t;
+
+typedef struct {
+    size_t              owner;      /* PID */
+    size_t              fd;
+    size_t              refs;       /* Table entry and calls in progress */
+    bool                closed;     /* Removed from the table */
+    uint32_t            type;
+    bool                nonblock;
+    bool                bound;
+    bool                connected;
+    socket_address_t    local;
+    socket_address_t    remote;
+
+    /* SOCKET_STREAM: listener or connection */
+    tcp_connection_t*   tcp;
+
+    /* SOCKET_DGRAM */
+    socket_datagram_t*  rx_head;
+    socket_datagram_t*  rx_tail;
+    size_t              rx_count;
+    size_t              rx_dropped;
+    wait_queue_t        waiters;
 } socket_t;
 
-socket_t* socket_new(socket_address_t* address, uint32_t flags);
-socket_t* socket_listen(socket_t* server_socket);
-void socket_read_until_newline(socket_t* socket, uint8_t* data);
-void socket_close(socket_t* socket);
\ No newline at end of file
+void sockets_init();
+
+ssize_t socket_create(uint32_t domain, uint32_t type, uint32_t protocol);
+ssize_t socket_bind(int32_t fd, const socket_address_t* address);
+ssize_t socket_listen(int32_t fd, size_t backlog);
+ssize_t socket_accept(int32_t fd, socket_address_t* address);
+ssize_t socket_connect(int32_t fd, const socket_address_t* address);
+ssize_t socket_send(int32_t fd, const void* data, size_t len, uint32_t flags);
+ssize_t socket_recv(int32_t fd, void* data, size_t len, uint32_t flags);
+ssize_t socket_sendto(int32_t fd, const void* data, size_t len, uint32_t flags, const socket_address_t* address);
+ssize_t socket_recvfrom(int32_t fd, void* data, size_t len, uint32_t flags, socket_address_t* address);
+ssize_t socket_shutdown(int32_t fd, uint32_t how);
+ssize_t socket_close(int32_t fd);
+void socket_close_process(size_t pid);
+ssize_t socket_poll(socket_poll_t* fds, size_t count, int32_t timeout_ms);
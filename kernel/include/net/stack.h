@@ -6,18 +6,78 @@
 
 #include "common.h"
 #include "net/cards.h"
+#include "net/netbuf.h"
+#include "lib/spsc_ring.h"
+
+// Slots per card and direction (powers of two).
+#define NETSTACK_RX_RING_SIZE 64
+#define NETSTACK_TX_RING_SIZE 64
+
+// Most frames one `poll` call of a card may deliver before others get their turn.
+#define NETSTACK_POLL_BUDGET 32
 
 typedef struct {
+	size_t rx_packets;
+	size_t rx_dropped;	/* RX ring was full or the frame did not fit into a slot */
+	size_t tx_packets;
+	size_t tx_dropped;	/* TX ring was full */
+	size_t interrupts;	/* RX interrupts that started polling */
+	size_t polls;		/* Calls of the card's `poll` */
+} netstack_stats_t;
+
+// Work of the whole stack on the packet path, for benchmarks.
+typedef struct {
+	size_t allocations;		/* `netbuf_alloc` calls, queued datagrams and out-of-order segments */
+	size_t heap_allocations;	/* Those of them that went to the heap */
+	size_t copies;			/* Copies of packet data */
+	size_t copied_bytes;
+} netstack_counters_t;
+
+/**
+ * Per-card queues.
+ *
+ * RX: the card's IRQ handler is the only producer and copies frames into preallocated buffers
+ * of the ring; the RX work item is the only consumer and handles them in place.
+ * Cards with `poll` fill the RX ring from the RX work item instead, see `netstack_schedule_poll`.
+ * TX: producers are serialized with disabled interrupts; the TX work item is the only consumer.
+ */
+typedef struct netstack_card {
 	netcard_entry_t* card;
-	void* data;
-	size_t length;
-} netqueue_item_t;
+	spsc_ring_t rx;		/* Slots hold preallocated `netbuf_t*` */
+	spsc_ring_t tx;		/* Slots hold queued `netbuf_t*` */
+	netstack_stats_t stats;
+	volatile bool polling;	/* RX interrupts are masked, the RX work item polls the card */
+	netbuf_t* tx_stalled;	/* Refused by the card's full ring, goes out first */
+} netstack_card_t;
+
+// Called from the RX work item for every received frame, before the protocol handlers.
+// A removed listener may still be running, so free its `ctx` from a WORK_PRIORITY_NORMAL
+// work item: it runs on the same worker, after the current call returns.
+typedef void (*netstack_rx_listener_t)(netcard_entry_t* card, void* data, size_t length, void* ctx);
+
+#define NETSTACK_MAX_RX_LISTENERS 8
 
 void netstack_init();
-// Pushes to out
+bool netstack_attach_card(netcard_entry_t* card);
+// Pushes to out (copies the data)
 void netstack_push(netcard_entry_t* card, void* packet_data, size_t length);
-// Pushes to in
+// Pushes to out, the stack takes ownership of the buffer
+void netstack_push_netbuf(netcard_entry_t* card, netbuf_t* buf);
+// Pushes to in. Safe to call from the card's IRQ handler, never allocates.
 void netstack_transfer(netcard_entry_t* card, void* packet_data, size_t length);
+// Pushes to in without copying, the stack takes ownership of the buffer. Not for IRQ handlers.
+void netstack_receive_netbuf(netcard_entry_t* card, netbuf_t* buf);
+// Called from the IRQ handler of a card with `poll` after it masked its RX interrupts.
+void netstack_schedule_poll(netcard_entry_t* card);
+// Called by a card (IRQ handlers too) when it has free TX descriptors again after `send_netbuf`
+// refused a frame.
+void netstack_tx_resume(netcard_entry_t* card);
+
+bool netstack_get_stats(netcard_entry_t* card, netstack_stats_t* out);
+
+void netstack_count_allocation(bool heap);
+void netstack_count_copy(size_t length);
+void netstack_get_counters(netstack_counters_t* out);
 
-netqueue_item_t* netstack_pop();
-netqueue_item_t* netstack_poll();
+bool netstack_add_rx_listener(netstack_rx_listener_t listener, void* ctx);
+void netstack_remove_rx_listener(netstack_rx_listener_t listener, void* ctx);
@@ -6,42 +6,200 @@
 
 #include "common.h"
 #include "cards.h"
+#include "net/ethernet.h"
+#include "sys/scheduler/scheduler.h"
 
 typedef struct {
     uint16_t source;
     uint16_t destination;
     uint32_t seq;
     uint32_t ack_seq;
-    uint16_t res1:4;
-    uint16_t doff:4;
-    uint16_t fin:1;
-    uint16_t syn:1;
-    uint16_t rst:1;
-    uint16_t psh:1;
-    uint16_t ack:1;
-    uint16_t urg:1;
-    uint16_t res2:2;
+    uint8_t  data_offset;   /* Header length in 32-bit words, upper 4 bits */
+    uint8_t  flags;         /* TCP_FLAG_* */
     uint16_t window;
     uint16_t check;
     uint16_t urg_ptr;
 } __attribute__((packed)) tcp_packet_t;
 
+#define TCP_FLAG_FIN    0x01
+#define TCP_FLAG_SYN    0x02
+#define TCP_FLAG_RST    0x04
+#define TCP_FLAG_PSH    0x08
+#define TCP_FLAG_ACK    0x10
+#define TCP_FLAG_URG    0x20
+
+#define TCP_OPTION_END  0
+#define TCP_OPTION_NOP  1
+#define TCP_OPTION_MSS  2
+
+// Number of buckets in the connection table (power of two).
+#define TCP_HASH_SIZE           256
+
+// Per-connection buffers.
+#define TCP_SEND_BUFFER_SIZE    (32 << 10)
+#define TCP_RECV_BUFFER_SIZE    (32 << 10)
+
+// Out-of-order segments kept per connection, the rest are dropped.
+#define TCP_MAX_OOO_SEGMENTS    32
+
+// Ethernet MTU minus IPv4 and TCP headers.
+#define TCP_MSS                 1460
+// MSS assumed when peer did not send the option (RFC 1122).
+#define TCP_DEFAULT_MSS         536
+
+// Timings are in timer ticks (1 ms).
+#define TCP_TIMER_INTERVAL      10
+#define TCP_RTO_INITIAL         1000
+#define TCP_RTO_MIN             200
+#define TCP_RTO_MAX             60000
+#define TCP_DELAYED_ACK         40
+#define TCP_MSL                 30000
+#define TCP_FIN_WAIT2_TIMEOUT   60000
+
+#define TCP_SYN_RETRIES         5
+#define TCP_DATA_RETRIES        12
+
+#define TCP_DUPACK_THRESHOLD    3
+
+// First port given to `tcp_connect`.
+#define TCP_EPHEMERAL_PORT_MIN  49152
+
+// Readiness bits of `tcp_poll`.
+#define TCP_POLL_IN     0x01    /* Data, EOF or a connection to accept */
+#define TCP_POLL_OUT    0x04    /* Send buffer has room */
+#define TCP_POLL_ERR    0x08
+#define TCP_POLL_HUP    0x10
+
 typedef enum {
-	TCP_NONE = 0,
-	TCP_CREATED = 1,
-	TCP_LISTENING = 2,
-	TCP_ESTABLISHED = 3
-} tcp_connection_status_t;
+    TCP_CLOSED = 0,
+    TCP_LISTEN,
+    TCP_SYN_SENT,
+    TCP_SYN_RECEIVED,
+    TCP_ESTABLISHED,
+    TCP_FIN_WAIT_1,
+    TCP_FIN_WAIT_2,
+    TCP_CLOSE_WAIT,
+    TCP_CLOSING,
+    TCP_LAST_ACK,
+    TCP_TIME_WAIT,
+    TCP_STATE_COUNT
+} tcp_state_t;
 
 typedef struct {
-	netcard_entry_t* card;
-	uint32_t dest_ip_addr;
-	uint16_t source_port;
-	uint16_t dest_port;
-	uint32_t seq;
-	uint32_t ack;
-	tcp_connection_status_t status;
+    uint8_t*    data;
+    size_t      size;
+    size_t      head;       /* Oldest byte */
+    size_t      len;
+} tcp_buffer_t;
+
+typedef struct tcp_segment {
+    struct tcp_segment* next;
+    uint32_t            seq;
+    size_t              len;
+    uint8_t             data[];
+} tcp_segment_t;
+
+typedef struct tcp_connection {
+    struct tcp_connection*  hash_next;
+    struct tcp_connection*  parent;         /* Listener that accepted us */
+    struct tcp_connection*  accept_next;    /* Accept queue of the listener */
+    bool                    queued;         /* Waits in the accept queue */
+
+    netcard_entry_t*        card;
+    uint8_t                 local_ip[4];
+    uint8_t                 remote_ip[4];
+    uint16_t                local_port;
+    uint16_t                remote_port;
+
+    tcp_state_t             state;
+    int                     error;          /* NET_E* that closed the connection */
+    bool                    user_closed;    /* Nobody holds it, free when CLOSED */
+
+    /* Send sequence space (RFC 793 3.2) */
+    uint32_t                iss;
+    uint32_t                snd_una;
+    uint32_t                snd_nxt;
+    uint32_t                snd_max;        /* Highest sequence number sent */
+    uint32_t                snd_wnd;
+    uint32_t                snd_wl1;
+    uint32_t                snd_wl2;
+    uint32_t                mss;
+
+    /* Receive sequence space */
+    uint32_t                irs;
+    uint32_t                rcv_nxt;
+    uint32_t                rcv_wnd_advertised;
+
+    tcp_buffer_t            send_buffer;    /* Starts at `snd_una`, FIN follows the data */
+    tcp_buffer_t            recv_buffer;
+    tcp_segment_t*          ooo;            /* Sorted by sequence number */
+    size_t                  ooo_count;
+
+    bool                    fin_queued;     /* Close requested, FIN goes after the data */
+    bool                    fin_received;
+
+    /* Retransmission (RFC 6298) */
+    uint32_t                srtt;           /* Scaled by 8 */
+    uint32_t                rttvar;         /* Scaled by 4 */
+    uint32_t                rto;
+    size_t                  rtx_deadline;   /* 0 - timer is stopped */
+    uint32_t                rtx_count;
+    bool                    rtt_pending;
+    uint32_t                rtt_seq;
+    size_t                  rtt_start;
+
+    /* Congestion control (RFC 5681, NewReno from RFC 6582) */
+    uint32_t                cwnd;
+    uint32_t                ssthresh;
+    uint32_t                dupacks;
+    uint32_t                recover;
+    bool                    in_recovery;
+
+    size_t                  ack_deadline;   /* Delayed ACK, 0 - none pending */
+    uint32_t                unacked_segments;
+    size_t                  state_deadline; /* TIME_WAIT and FIN_WAIT_2 timeouts */
+
+    /* Listener */
+    struct tcp_connection*  accept_head;
+    struct tcp_connection*  accept_tail;
+    size_t                  accept_count;
+    size_t                  pending_count;  /* Children in SYN_RECEIVED */
+    size_t                  backlog;
+
+    wait_queue_t            waiters;
+    size_t                  sleepers;       /* Threads inside tcp_wait */
 } tcp_connection_t;
 
-void tcp_handle_packet(netcard_entry_t *card, tcp_packet_t *packet);
-void tcp_send_packet(tcp_connection_t* connection, void* data, size_t len);
\ No newline at end of file
+typedef struct {
+    size_t  active_connections;
+    size_t  segments_received;
+    size_t  segments_sent;
+    size_t  retransmits;
+    size_t  fast_retransmits;
+    size_t  timeouts;
+    size_t  resets_sent;
+    size_t  checksum_errors;
+    size_t  ooo_dropped;
+} tcp_stats_t;
+
+void tcp_init();
+
+void tcp_handle_packet(netcard_entry_t *card, ipv4_packet_t* ip, tcp_packet_t *packet, size_t length);
+
+tcp_connection_t* tcp_listen(netcard_entry_t* card, uint16_t port, size_t backlog, int* error);
+tcp_connection_t* tcp_accept(tcp_connection_t* listener, bool nonblock, int* error);
+tcp_connection_t* tcp_connect(netcard_entry_t* card, const uint8_t ip[4], uint16_t port, uint16_t local_port, bool nonblock, int* error);
+
+ssize_t tcp_send(tcp_connection_t* connection, const void* data, size_t len, bool nonblock);
+ssize_t tcp_recv(tcp_connection_t* connection, void* data, size_t len, bool nonblock);
+
+void tcp_shutdown(tcp_connection_t* connection);
+void tcp_close(tcp_connection_t* connection);
+
+uint32_t tcp_poll(tcp_connection_t* connection);
+wait_queue_t* tcp_wait_queue(tcp_connection_t* connection);
+
+const char* tcp_state_name(tcp_state_t state);
+void tcp_get_stats(tcp_stats_t* out);
+
+uint16_t tcp_calculate_checksum(uint32_t src_addr, uint32_t dst_addr, tcp_packet_t *tcp_packet, uint16_t tcp_length);
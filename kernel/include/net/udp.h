@@ -2,6 +2,8 @@
 
 #include "common.h"
 #include "net/cards.h"
+#include "net/netbuf.h"
+#include "net/ethernet.h"
 
 typedef struct udp_packet {
 	uint16_t src_port;
@@ -10,5 +12,19 @@ typedef struct udp_packet {
 	uint16_t checksum;
 } __attribute__((packed)) udp_packet_t;
 
+// Ports that can be bound with `udp_bind` at once.
+#define UDP_MAX_BINDINGS        64
+
+// First port given by `udp_bind(0, ...)`.
+#define UDP_EPHEMERAL_PORT_MIN  49152
+
+// Called on the RX worker for every datagram to the bound port.
+typedef void (*udp_handler_t)(void* ctx, netcard_entry_t* card, const uint8_t src_ip[4], uint16_t src_port,
+                              const void* data, size_t len);
+
 void udp_send_packet(netcard_entry_t* card, uint8_t * dst_ip, uint16_t src_port, uint16_t dst_port, void * data, int len);
-void udp_handle_packet(netcard_entry_t *card, udp_packet_t *packet);
\ No newline at end of file
+void udp_send_netbuf(netcard_entry_t* card, const uint8_t* dst_ip, uint16_t src_port, uint16_t dst_port, netbuf_t* buf);
+void udp_handle_packet(netcard_entry_t *card, ipv4_packet_t* ip, udp_packet_t *packet);
+
+uint16_t udp_bind(uint16_t port, udp_handler_t handler, void* ctx);
+void udp_unbind(uint16_t port);
@@ -23,6 +23,10 @@
 #define APIC_REG_TMRDIV         0x3E0
 #define APIC_REG_LAST           0x38F
 
+#define APIC_LVT_MASKED             (1 << 16)
+#define APIC_LVT_TIMER_ONESHOT      (0b00 << 17)
+#define APIC_LVT_TIMER_PERIODIC     (0b01 << 17)
+
 extern volatile bool __using_apic;
 extern volatile size_t lapic_addr;
 
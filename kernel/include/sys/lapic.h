@@ -1,3 +1,11 @@
 #pragma once
 
+#include <common.h>
+
+extern size_t lapic_ticks_per_ms;
+
 void lapic_init();
+
+bool lapic_timer_is_active();
+void lapic_timer_arm(size_t ticks);
+size_t lapic_timer_elapsed();
@@ -3,6 +3,7 @@
 #include "arch/x86/mem/paging_common.h"
 #include "elf/elf.h"
 #include "lib/list.h"
+#include "lib/idtable.h"
 
 typedef	struct {
     // 0
@@ -25,5 +26,11 @@ typedef	struct {
     elf_t*          program;
 } process_t;
 
+// Up to 256 processes alive at the same time.
+#define PROCESS_TABLE_BITS 8
+
 /* Get current process */
-process_t* get_current_proc(void);
\ No newline at end of file
+process_t* get_current_proc(void);
+
+/* Find process by PID */
+process_t* process_get(size_t pid);
\ No newline at end of file
@@ -14,10 +14,30 @@
 // 128 KB stack for each user thread
 #define DEFAULT_STACK_SIZE (128 << 10)
 
+// Runnable thread which did not get CPU for this long (in ticks) is picked first.
+#define SCHED_STARVATION_TICKS 30
+
+// Longest period idle CPU stays halted if nobody sleeps (in ticks).
+#define SCHED_MAX_IDLE_TICKS 1000
+
 /* Initialization */
 void init_task_manager(void);
 
+typedef struct {
+    size_t          id;
+    size_t          pid;
+    char            name[32];       /* Process name */
+    uint32_t        sched_class;
+    uint32_t        priority;
+    thread_state_t  state;
+    bool            sleeping;
+    bool            idle;
+    size_t          runtime_ticks;
+    uint64_t        runtime_tsc;
+} thread_info_t;
+
 void task_switch_v2_wrapper(registers_t* regs);
+void sched_tick(registers_t* regs);
 extern void task_switch_v2(thread_t*, thread_t*);
 
 size_t create_process(void* entry_point, char* name, bool is_kernel);
@@ -35,6 +55,32 @@ void scheduler_mode(bool on);
 
 void yield();
 
+void sched_sleep_ticks(size_t ticks);
+void sched_wait(size_t max_ticks);
+void thread_wake(thread_t* thread);
+
+/**
+ * Entry of a wait queue. Lives on the waiter's stack: register it, check the condition
+ * with interrupts disabled, call `sched_wait`, then remove it.
+ * One thread may wait on several queues at once (one entry per queue).
+ */
+typedef struct wait_queue_entry {
+    struct wait_queue_entry*    next;
+    struct wait_queue_entry*    prev;
+    thread_t*                   thread;
+    volatile bool               woken;      /* Set by `wait_queue_wake_all` */
+} wait_queue_entry_t;
+
+typedef struct {
+    wait_queue_entry_t* head;
+} wait_queue_t;
+
+void wait_queue_add(wait_queue_t* queue, wait_queue_entry_t* entry);
+void wait_queue_remove(wait_queue_t* queue, wait_queue_entry_t* entry);
+void wait_queue_wake_all(wait_queue_t* queue);
+
+size_t sched_get_thread_info(thread_info_t* out, size_t capacity);
+
 bool process_exists(size_t pid);
 void process_wait(size_t pid);
 
@@ -39,10 +39,33 @@ typedef struct {
     size_t          kernel_stack_bottom;
     // 60: Indicates the last system error happened in this thread (i/o error, memory allocation fail, etc.).
     size_t          last_error;
+    // 64: Tick when sleeping thread should be woken up (0 if thread is not sleeping).
+    size_t          wakeup_tick;
+    // 68: Scheduling class (SCHED_CLASS_*) and priority inside the class (higher runs first).
+    uint32_t        sched_class;
+    // 72
+    uint32_t        priority;
+    // 76: Thread gave up CPU by itself, so it goes after threads that want to run.
+    bool            sched_yielded;
+    // 80: Tick when current timeslice of the thread ends.
+    size_t          slice_end_tick;
+    // 84: Tick when thread was scheduled last time.
+    size_t          last_run_tick;
+    // 88: Total ticks thread spent on CPU.
+    size_t          runtime_ticks;
+    // 92: Total TSC cycles thread spent on CPU.
+    uint64_t        runtime_tsc;
+    // 100: TSC value when thread was switched in.
+    uint64_t        switched_in_tsc;
 } thread_t;
 
 #define THREAD_KERNEL (1 << 0)
 
+#define SCHED_CLASS_REALTIME    0   /* Runs before anything else (audio feeding, etc.) */
+#define SCHED_CLASS_INTERACTIVE 1   /* Default for kernel threads */
+#define SCHED_CLASS_BATCH       2   /* Default for user programs, longer timeslices */
+#define SCHED_CLASS_COUNT       3
+
 void initialize_thread_list();
 thread_t* get_kernel_thread();
 thread_t* get_current_thread();
@@ -58,3 +81,5 @@ void thread_exit(thread_t* thread);
 
 __attribute__((noreturn)) void thread_exit_entrypoint();
 void initialize_idle_thread();
+
+void thread_set_sched_class(thread_t* thread, uint32_t sched_class, uint32_t priority);
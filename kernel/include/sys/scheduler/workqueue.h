@@ -0,0 +1,55 @@
+#pragma once
+
+#include "common.h"
+
+#define WORK_PRIORITY_HIGH      0   /* Served by realtime worker */
+#define WORK_PRIORITY_NORMAL    1   /* Served by interactive worker */
+#define WORK_PRIORITY_LOW       2   /* Served by batch worker */
+#define WORK_PRIORITY_COUNT     3
+
+// Number of work items `workqueue_submit` can have in flight.
+#define WORKQUEUE_POOL_SIZE     128
+
+typedef void (*work_fn_t)(void* arg);
+
+/**
+ * Deferred work item.
+ *
+ * Subsystems embed it into their structures and resubmit with `workqueue_queue_work`.
+ * Item that is already pending is not queued twice, and every priority has one worker,
+ * so the same item never runs in parallel with itself.
+ */
+typedef struct work {
+    struct work*    next;
+    work_fn_t       fn;
+    void*           arg;
+    uint32_t        priority;
+    volatile bool   pending;
+    bool            pooled;     /* Taken from the pool by `workqueue_submit` */
+    uint64_t        submit_tsc;
+} work_t;
+
+#define WORK_INITIALIZER(_fn, _arg, _priority) { .fn = (_fn), .arg = (_arg), .priority = (_priority) }
+
+typedef struct {
+    size_t      depth;              /* Items waiting right now */
+    size_t      max_depth;
+    size_t      submitted;
+    size_t      completed;
+    size_t      dropped;            /* Pool was exhausted */
+    uint64_t    total_latency_tsc;  /* Sum of (start - submit) of completed items */
+    uint64_t    max_latency_tsc;
+    uint64_t    total_run_tsc;      /* Time spent in work functions */
+} workqueue_queue_stats_t;
+
+typedef struct {
+    workqueue_queue_stats_t queues[WORK_PRIORITY_COUNT];
+    uint64_t                tsc_per_ms;
+} workqueue_stats_t;
+
+void workqueue_init();
+
+bool workqueue_queue_work(work_t* work);
+bool workqueue_submit(work_fn_t fn, void* arg, uint32_t priority);
+
+void workqueue_get_stats(workqueue_stats_t* out);
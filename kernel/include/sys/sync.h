@@ -11,3 +11,22 @@ void mutex_get(mutex_t* mutex);
 
 /* Release mutex */
 void mutex_release(mutex_t* mutex);
+
+#if defined(NOCTURNE_X86) || defined(NOCTURNE_X86_64)
+/* Disable interrupts and return previous flags (safe to use inside IRQ handlers) */
+SAYORI_INLINE size_t irq_save() {
+    size_t flags;
+
+    __asm__ volatile("pushf\n"
+                     "pop %0\n"
+                     "cli" : "=r"(flags) :: "memory");
+
+    return flags;
+}
+
+/* Restore interrupt flag saved by `irq_save` */
+SAYORI_INLINE void irq_restore(size_t flags) {
+    __asm__ volatile("push %0\n"
+                     "popf" :: "r"(flags) : "memory", "cc");
+}
+#endif
@@ -0,0 +1,57 @@
+/**
+ * @file arch/x86/pat.c
+ * @brief Настройка PAT: объединение записи для видеопамяти
+ * @date 2026-10-19
+ * @copyright Copyright SayoriOS Team (c) 2022-2026
+ */
+
+#include "common.h"
+#include "arch/x86/cpufeature.h"
+#include "arch/x86/msr.h"
+#include "arch/x86/pat.h"
+#include "arch/x86/mem/paging_common.h"
+#include "io/logging.h"
+#include "sys/cpuid.h"
+
+bool pat_wc_available = false;
+
+/**
+ * @brief Делает запись 4 таблицы PAT (бит PAT, без PCD и PWT) записью с объединением
+ *
+ * После сброса запись 4 повторяет запись 0 (write-back), а бит PAT в ядре до этого
+ * не используется, так что существующие отображения не меняются.
+ */
+void pat_init() {
+    if(!boot_cpu_has(X86_FEATURE_PAT)) {
+        qemu_warn("PAT is not supported, video memory will use MTRRs");
+        return;
+    }
+
+    uint32_t low, high;
+
+    rdmsr(IA32_PAT_MSR, low, high);
+
+    high = (high & ~0xFFU) | PAT_WRITE_COMBINING;
+
+    // Lines cached under the old type must not survive the change.
+    __asm__ volatile("wbinvd" ::: "memory");
+    wrmsr(IA32_PAT_MSR, low, high);
+    __asm__ volatile("wbinvd" ::: "memory");
+
+    reload_cr3();
+
+    pat_wc_available = true;
+
+    qemu_ok("PAT: %x%x", high, low);
+}
+
+/**
+ * @brief Флаги страницы для памяти с объединением записи (видеопамять)
+ *
+ * Без PAT страница будет UC-, её делает WC регистр MTRR, если он на неё поставлен.
+ *
+ * @return uint32_t - PAGE_PAT или PAGE_CACHE_DISABLE
+ */
+uint32_t pat_write_combining_flags() {
+    return pat_wc_available ? PAGE_PAT : PAGE_CACHE_DISABLE;
+}
@@ -11,6 +11,8 @@
 #include  "arch/x86/ports.h"
 #include "io/logging.h"
 #include "sys/scheduler/scheduler.h"
+#include "sys/lapic.h"
+#include "arch/x86/cpuinfo.h"
 
 #ifdef NOCTURNE_SUPPORT_TIER1
 extern volatile bool scheduler_working;
@@ -19,13 +21,53 @@ extern volatile bool scheduler_working;
 volatile size_t timer_tick = 0;                /* Количество тиков */
 volatile size_t timer_frequency = CLOCK_FREQ;  /* Частота */
 
+static volatile size_t timer_subtick_counts = 0;  /* Остаток счётчика LAPIC, не набравший целый тик */
+static volatile size_t timer_epoch = 0;           /* Меняется при каждом переносе счётчика LAPIC в `timer_tick` */
+static uint64_t timer_boot_tsc = 0;               /* Значение TSC при инициализации таймера */
+
 /**
  * @brief Получить количество тиков
  *
  * @return size_t - Количество тиков с момента старта
  */
 size_t getTicks() {
-    return (size_t)timer_tick;
+    if(!lapic_timer_is_active()) {
+        return (size_t)timer_tick;
+    }
+
+    // In one-shot mode `timer_tick` is updated only when timer is reprogrammed,
+    // so add time passed since last arming. Retry if we were interrupted in the middle.
+    size_t epoch, ticks;
+
+    do {
+        epoch = timer_epoch;
+        ticks = timer_tick + (timer_subtick_counts + lapic_timer_elapsed()) / lapic_ticks_per_ms;
+    } while(epoch != timer_epoch);
+
+    return ticks;
+}
+
+/**
+ * @brief Запрограммировать следующее прерывание таймера
+ *
+ * В режиме one-shot (LAPIC) переносит прошедшее время в `timer_tick` и взводит таймер заново.
+ * При работе от PIT ничего не делает - PIT и так тикает периодически.
+ * Вызывать только с выключенными прерываниями.
+ *
+ * @param ticks - Через сколько тиков нужно прерывание
+ */
+void timer_program_next(size_t ticks) {
+    if(!lapic_timer_is_active()) {
+        return;
+    }
+
+    size_t counts = timer_subtick_counts + lapic_timer_elapsed();
+
+    timer_tick += counts / lapic_ticks_per_ms;
+    timer_subtick_counts = counts % lapic_ticks_per_ms;
+    timer_epoch++;
+
+    lapic_timer_arm(ticks);
 }
 
 /**
@@ -43,6 +85,13 @@ size_t getFrequency() {
  * @param delay - Тики
  */
 void sleep_ticks(size_t delay) {
+    #ifdef NOCTURNE_FEATURE_MULTITASKING
+    if(is_multitask()) {
+        sched_sleep_ticks(delay);
+        return;
+    }
+    #endif
+
     size_t current_ticks = getTicks();
 
     while (1) {
@@ -50,10 +99,6 @@ void sleep_ticks(size_t delay) {
             break;
         } else {
         	__asm__ volatile("hlt");
-
-            #ifdef NOCTURNE_FEATURE_MULTITASKING
-            yield();
-            #endif
         }
     }
 }
@@ -75,7 +120,10 @@ void sleep_ms(size_t milliseconds) {
  * @param regs - Регистры процессора
  */
 void timer_callback(SAYORI_UNUSED registers_t* regs){
-    timer_tick++;
+    // In one-shot mode ticks are accounted in `timer_program_next`.
+    if(!lapic_timer_is_active()) {
+        timer_tick++;
+    }
 
     // if(timer_tick % 256 == 0) {
     //     qemu_log("Tick!");
@@ -83,9 +131,28 @@ void timer_callback(SAYORI_UNUSED registers_t* regs){
 
     #ifdef NOCTURNE_SUPPORT_TIER1
     if (is_multitask() && scheduler_working) {
-        task_switch_v2_wrapper(regs);
+        // Scheduler programs the next interrupt by itself.
+        sched_tick(regs);
+        return;
     }
     #endif
+
+    timer_program_next(1);
+}
+
+/**
+ * @brief Оценивает частоту TSC по ходу системного таймера
+ *
+ * @return uint64_t - Количество тактов TSC за миллисекунду (0, если таймер ещё не отсчитал ни одного тика)
+ */
+uint64_t timer_tsc_per_ms() {
+    size_t ticks = getTicks();
+
+    if(ticks == 0) {
+        return 0;
+    }
+
+    return ((rdtsc() - timer_boot_tsc) * timer_frequency) / ((uint64_t)ticks * 1000);
 }
 
 /**
@@ -95,6 +162,7 @@ void timer_callback(SAYORI_UNUSED registers_t* regs){
  */
 void init_timer(size_t f) {
     timer_frequency = f;
+    timer_boot_tsc = rdtsc();
 
     size_t divisor = BASE_FREQ / f;
 
@@ -12,6 +12,7 @@
 #include "io/screen.h"
 #include "arch/x86/isr.h"
 #include "drv/ps2.h"
+#include "gui/compositor.h"
 
 uint8_t mouse_ready = 0;        /// Готова ли мышь к работе
 
@@ -218,6 +219,39 @@ void ps2_mouse_install_irq() {
     mouse_ready = 1;
 }
 
+/**
+ * @brief Показывает или прячет системный курсор
+ *
+ * @param set - Показать
+ */
+void mouse_set_show_system_cursor(bool set) {
+    compositor_show_cursor(set);
+}
+
+/**
+ * @brief Показан ли системный курсор?
+ *
+ * @return bool - Да/Нет
+ */
+bool mouse_get_show_system_cursor() {
+    return compositor_cursor_shown();
+}
+
+/**
+ * @brief Задаёт вид системного курсора
+ *
+ * @param state - Вид курсора, CURSOR_HIDDEN прячет его
+ */
+void mouse_set_state(MouseDrawState_t state) {
+    if (state == CURSOR_HIDDEN) {
+        compositor_show_cursor(false);
+        return;
+    }
+
+    compositor_set_cursor(state == CURSOR_LOADING ? COMPOSITOR_CURSOR_BUSY : COMPOSITOR_CURSOR_ARROW);
+    compositor_show_cursor(true);
+}
+
 uint32_t mouse_get_x() {return (uint32_t)mouse_x;}
 uint32_t mouse_get_y() {return (uint32_t)mouse_y;}
 uint8_t  mouse_get_b1() {return mouse_b1;}
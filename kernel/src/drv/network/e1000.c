@@ -0,0 +1,384 @@
+/**
+ * @brief Драйвер сетевой карты Intel 8254x (e1000)
+ * @date 2026-10-19
+ * @copyright Copyright SayoriOS Team (c) 2022-2026
+ */
+
+#include <drv/e1000.h>
+#include <net/cards.h>
+#include <generated/pci.h>
+#include <arch/x86/isr.h>
+#include <arch/x86/mem/paging_common.h>
+#include "lib/string.h"
+#include "mem/vmm.h"
+#include "net/stack.h"
+#include <net/ethernet.h>
+#include <io/logging.h>
+#include "sys/sync.h"
+
+#define NETCARD_NAME ("E1000")
+
+static uint8_t e1000_busnum, e1000_slot, e1000_func;
+static volatile uint8_t* e1000_mmio = NULL;
+static uint8_t e1000_irq;
+
+static uint8_t e1000_mac[6];
+
+static volatile e1000_rx_desc_t* e1000_rx_ring = NULL;
+static volatile e1000_tx_desc_t* e1000_tx_ring = NULL;
+
+static uint8_t* e1000_rx_buffers[E1000_RX_DESCRIPTORS] = {0};
+static size_t e1000_rx_next = 0;
+
+// The TX worker sends and the RX worker reclaims in `e1000_poll`, both with interrupts off.
+// `e1000_tx_netbufs[i]` is owned by the card until descriptor `i` reports DD.
+static netbuf_t* e1000_tx_netbufs[E1000_TX_DESCRIPTORS] = {0};
+static size_t e1000_tx_tail = 0;
+static size_t e1000_tx_clean = 0;
+
+static void e1000_netcard_get_mac(uint8_t mac[6]) {
+	memcpy(mac, e1000_mac, 6);
+}
+
+static size_t e1000_poll(size_t budget);
+static bool e1000_rx_irq_enable();
+
+netcard_entry_t e1000_netcard = {
+	.name = NETCARD_NAME,
+	.get_mac_addr = e1000_netcard_get_mac,
+	.send_packet = e1000_send_packet,
+	.send_netbuf = e1000_send_netbuf,
+	.poll = e1000_poll,
+	.rx_irq_enable = e1000_rx_irq_enable,
+};
+
+SAYORI_INLINE uint32_t e1000_read(uint32_t reg) {
+	return *(volatile uint32_t*)(e1000_mmio + reg);
+}
+
+SAYORI_INLINE void e1000_write(uint32_t reg, uint32_t value) {
+	*(volatile uint32_t*)(e1000_mmio + reg) = value;
+}
+
+static uint16_t e1000_eeprom_read(uint8_t address) {
+	e1000_write(E1000_EERD, E1000_EERD_START | ((uint32_t)address << 8));
+
+	uint32_t value;
+	size_t spin = 100000;
+
+	while(!((value = e1000_read(E1000_EERD)) & E1000_EERD_DONE) && --spin)
+		;
+
+	return value >> 16;
+}
+
+static void e1000_read_mac() {
+	uint32_t low = e1000_read(E1000_RAL0);
+	uint32_t high = e1000_read(E1000_RAH0);
+
+	// Receive address 0 is loaded from the EEPROM on reset, but not on every model.
+	if(!(high & E1000_RAH_AV)) {
+		for(uint8_t i = 0; i < 3; i++) {
+			uint16_t word = e1000_eeprom_read(i);
+
+			e1000_mac[i * 2] = word & 0xFF;
+			e1000_mac[i * 2 + 1] = word >> 8;
+		}
+
+		return;
+	}
+
+	e1000_mac[0] = low;
+	e1000_mac[1] = low >> 8;
+	e1000_mac[2] = low >> 16;
+	e1000_mac[3] = low >> 24;
+	e1000_mac[4] = high;
+	e1000_mac[5] = high >> 8;
+}
+
+static bool e1000_reset() {
+	e1000_write(E1000_IMC, 0xFFFFFFFF);
+
+	e1000_write(E1000_CTRL, e1000_read(E1000_CTRL) | E1000_CTRL_RST);
+
+	size_t spin = 100000;
+
+	while((e1000_read(E1000_CTRL) & E1000_CTRL_RST) && --spin)
+		;
+
+	if(spin == 0) {
+		return false;
+	}
+
+	// Reset unmasks nothing, but clear it again along with anything pending.
+	e1000_write(E1000_IMC, 0xFFFFFFFF);
+	e1000_read(E1000_ICR);
+
+	e1000_write(E1000_CTRL, e1000_read(E1000_CTRL) | E1000_CTRL_SLU | E1000_CTRL_ASDE);
+
+	for(size_t i = 0; i < 128; i++) {
+		e1000_write(E1000_MTA + i * 4, 0);
+	}
+
+	return true;
+}
+
+// Frees whatever `e1000_init_rx` and `e1000_init_tx` managed to allocate.
+static void e1000_free_rings() {
+	for(size_t i = 0; i < E1000_RX_DESCRIPTORS; i++) {
+		kfree(e1000_rx_buffers[i]);
+		e1000_rx_buffers[i] = NULL;
+	}
+
+	kfree((void*)e1000_rx_ring);
+	kfree((void*)e1000_tx_ring);
+
+	e1000_rx_ring = NULL;
+	e1000_tx_ring = NULL;
+}
+
+static bool e1000_init_rx() {
+	e1000_rx_ring = kmalloc_common(E1000_RX_DESCRIPTORS * sizeof(e1000_rx_desc_t), PAGE_SIZE);
+
+	if(e1000_rx_ring == NULL) {
+		return false;
+	}
+
+	for(size_t i = 0; i < E1000_RX_DESCRIPTORS; i++) {
+		e1000_rx_buffers[i] = kmalloc_common(E1000_RX_BUFFER_SIZE, E1000_RX_BUFFER_SIZE);
+
+		if(e1000_rx_buffers[i] == NULL) {
+			return false;
+		}
+
+		e1000_rx_ring[i].addr = virt2phys_precise(get_kernel_page_directory(), (virtual_addr_t)e1000_rx_buffers[i]);
+		e1000_rx_ring[i].status = 0;
+	}
+
+	size_t ring_phys = virt2phys(get_kernel_page_directory(), (virtual_addr_t)e1000_rx_ring);
+
+	e1000_write(E1000_RDBAL, ring_phys);
+	e1000_write(E1000_RDBAH, 0);
+	e1000_write(E1000_RDLEN, E1000_RX_DESCRIPTORS * sizeof(e1000_rx_desc_t));
+	e1000_write(E1000_RDH, 0);
+	e1000_write(E1000_RDT, E1000_RX_DESCRIPTORS - 1);
+
+	// ITR already limits the rate, a per-packet delay timer would only add latency.
+	e1000_write(E1000_RDTR, 0);
+
+	e1000_write(E1000_RCTL, E1000_RCTL_EN | E1000_RCTL_BAM | E1000_RCTL_BSIZE_2048 | E1000_RCTL_SECRC);
+
+	return true;
+}
+
+static bool e1000_init_tx() {
+	e1000_tx_ring = kmalloc_common(E1000_TX_DESCRIPTORS * sizeof(e1000_tx_desc_t), PAGE_SIZE);
+
+	if(e1000_tx_ring == NULL) {
+		return false;
+	}
+
+	memset((void*)e1000_tx_ring, 0, E1000_TX_DESCRIPTORS * sizeof(e1000_tx_desc_t));
+
+	size_t ring_phys = virt2phys(get_kernel_page_directory(), (virtual_addr_t)e1000_tx_ring);
+
+	e1000_write(E1000_TDBAL, ring_phys);
+	e1000_write(E1000_TDBAH, 0);
+	e1000_write(E1000_TDLEN, E1000_TX_DESCRIPTORS * sizeof(e1000_tx_desc_t));
+	e1000_write(E1000_TDH, 0);
+	e1000_write(E1000_TDT, 0);
+
+	e1000_write(E1000_TIPG, E1000_TIPG_DEFAULT);
+	e1000_write(E1000_TCTL, E1000_TCTL_EN | E1000_TCTL_PSP | E1000_TCTL_CT | E1000_TCTL_COLD);
+
+	return true;
+}
+
+#define E1000_RX_INTERRUPTS (E1000_ICR_RXT0 | E1000_ICR_RXDMT0 | E1000_ICR_RXO)
+
+// Frees buffers of the descriptors the card is done with. Called with interrupts off.
+static void e1000_reclaim_tx() {
+	while(e1000_tx_clean != e1000_tx_tail
+		  && (e1000_tx_ring[e1000_tx_clean].status & E1000_TXD_STAT_DD)) {
+		netbuf_free(e1000_tx_netbufs[e1000_tx_clean]);
+
+		e1000_tx_netbufs[e1000_tx_clean] = NULL;
+		e1000_tx_clean = (e1000_tx_clean + 1) % E1000_TX_DESCRIPTORS;
+	}
+}
+
+// Runs on the RX worker: hands up to `budget` frames to the stack and gives descriptors back.
+// Sent buffers are freed here too, since TXDW is masked and the TX side may stay idle.
+static size_t e1000_poll(size_t budget) {
+	size_t processed = 0;
+
+	size_t flags = irq_save();
+	e1000_reclaim_tx();
+	irq_restore(flags);
+
+	while(processed < budget && (e1000_rx_ring[e1000_rx_next].status & E1000_RXD_STAT_DD)) {
+		volatile e1000_rx_desc_t* desc = &e1000_rx_ring[e1000_rx_next];
+
+		// Frames never span buffers: the largest one fits into 2048 bytes.
+		if((desc->status & E1000_RXD_STAT_EOP) && desc->errors == 0) {
+			netstack_transfer(&e1000_netcard, e1000_rx_buffers[e1000_rx_next], desc->length);
+		}
+
+		desc->status = 0;
+
+		e1000_rx_next = (e1000_rx_next + 1) % E1000_RX_DESCRIPTORS;
+		processed++;
+	}
+
+	if(processed) {
+		e1000_write(E1000_RDT, (e1000_rx_next + E1000_RX_DESCRIPTORS - 1) % E1000_RX_DESCRIPTORS);
+	}
+
+	return processed;
+}
+
+static bool e1000_rx_irq_enable() {
+	e1000_write(E1000_IMS, E1000_RX_INTERRUPTS);
+
+	// A frame that came after the last poll may have been acknowledged with the ICR read already.
+	if(e1000_rx_ring[e1000_rx_next].status & E1000_RXD_STAT_DD) {
+		e1000_write(E1000_IMC, E1000_RX_INTERRUPTS);
+		return false;
+	}
+
+	return true;
+}
+
+static void e1000_handler(SAYORI_UNUSED registers_t* regs) {
+	// Reading clears it. The line may be shared, so zero means "not ours".
+	uint32_t cause = e1000_read(E1000_ICR);
+
+	if(cause & E1000_RX_INTERRUPTS) {
+		// Frames are taken by the poll, interrupts stay masked until it runs dry.
+		e1000_write(E1000_IMC, E1000_RX_INTERRUPTS);
+
+		netstack_schedule_poll(&e1000_netcard);
+	}
+
+	if(cause & E1000_ICR_LSC) {
+		qemu_note("E1000: link is %s", (e1000_read(E1000_STATUS) & E1000_STATUS_LU) ? "up" : "down");
+	}
+}
+
+/**
+ * @brief Отправляет пакет без копирования: карта читает его прямо из буфера
+ *
+ * В кольце может быть до E1000_TX_DESCRIPTORS - 1 пакетов одновременно.
+ *
+ * @param buf - Буфер пакета (драйвер забирает его себе)
+ * @return true - всегда: при полном кольце пакет теряется
+ */
+bool e1000_send_netbuf(netbuf_t* buf) {
+	size_t flags = irq_save();
+
+	e1000_reclaim_tx();
+
+	size_t next = (e1000_tx_tail + 1) % E1000_TX_DESCRIPTORS;
+
+	if(next == e1000_tx_clean) {
+		irq_restore(flags);
+
+		qemu_warn("E1000: TX ring is full, dropping a packet");
+
+		netbuf_free(buf);
+		return true;
+	}
+
+	volatile e1000_tx_desc_t* desc = &e1000_tx_ring[e1000_tx_tail];
+
+	e1000_tx_netbufs[e1000_tx_tail] = buf;
+
+	desc->addr = netbuf_phys(buf);
+	desc->length = buf->len;
+	desc->cmd = E1000_TXD_CMD_EOP | E1000_TXD_CMD_IFCS | E1000_TXD_CMD_RS;
+	desc->status = 0;
+
+	e1000_tx_tail = next;
+
+	e1000_write(E1000_TDT, e1000_tx_tail);
+
+	irq_restore(flags);
+
+	return true;
+}
+
+void e1000_send_packet(void* data, size_t length) {
+	netbuf_t* buf = netbuf_alloc(0, length);
+
+	if(buf == NULL) {
+		return;
+	}
+
+	memcpy(netbuf_put(buf, length), data, length);
+
+	e1000_send_netbuf(buf);
+}
+
+void e1000_init() {
+	qemu_log("Initializing E1000...");
+
+	uint8_t result = pci_find_device(E1000_VENDOR, E1000_DEVICE, &e1000_busnum, &e1000_slot, &e1000_func);
+
+	if(!result) {
+		qemu_log("E1000 is not connected!");
+		return;
+	}
+
+	pci_enable_bus_mastering(e1000_busnum, e1000_slot, e1000_func);
+
+	size_t mmio_phys = pci_read32(e1000_busnum, e1000_slot, e1000_func, 0x10) & ~0xFU;  // BAR0
+
+	map_pages(
+		get_kernel_page_directory(),
+		(physical_addr_t)mmio_phys,
+		(virtual_addr_t)mmio_phys,
+		E1000_MMIO_SIZE,
+		PAGE_WRITEABLE | PAGE_CACHE_DISABLE
+	);
+
+	e1000_mmio = (volatile uint8_t*)mmio_phys;
+
+	qemu_log("E1000 MMIO at: %x", mmio_phys);
+
+	if(!e1000_reset()) {
+		qemu_err("E1000: the card did not come out of reset");
+
+		unmap_pages_overlapping(get_kernel_page_directory(), mmio_phys, E1000_MMIO_SIZE);
+		return;
+	}
+
+	e1000_read_mac();
+
+	qemu_log("Mac is: %02x:%02x:%02x:%02x:%02x:%02x", e1000_mac[0], e1000_mac[1], e1000_mac[2], e1000_mac[3], e1000_mac[4], e1000_mac[5]);
+
+	if(!e1000_init_rx() || !e1000_init_tx()) {
+		qemu_err("E1000: not enough memory for the rings");
+
+		// The card may already know the RX ring: stop it before the memory goes away.
+		e1000_write(E1000_RCTL, 0);
+		e1000_write(E1000_TCTL, 0);
+
+		e1000_free_rings();
+		unmap_pages_overlapping(get_kernel_page_directory(), mmio_phys, E1000_MMIO_SIZE);
+		return;
+	}
+
+	e1000_irq = pci_read32(e1000_busnum, e1000_slot, e1000_func, 0x3C) & 0xFF;
+
+	register_interrupt_handler(32 + e1000_irq, e1000_handler);
+
+	e1000_write(E1000_ITR, E1000_ITR_INTERVAL);
+
+	// TX completions are collected lazily by sends and polls, so TXDW stays masked.
+	e1000_write(E1000_IMS, E1000_RX_INTERRUPTS | E1000_ICR_LSC);
+
+	qemu_ok("E1000: IRQ %d, %d RX / %d TX descriptors, up to %d interrupts/s", e1000_irq,
+			E1000_RX_DESCRIPTORS, E1000_TX_DESCRIPTORS, E1000_MAX_INTERRUPT_RATE);
+
+	netcard_add(&e1000_netcard);
+}
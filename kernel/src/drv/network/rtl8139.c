@@ -14,11 +14,13 @@
 #include <debug/hexview.h>
 #include <arch/x86/isr.h>
 #include "lib/string.h"
+#include "lib/math.h"
 #include "mem/vmm.h"
 #include "mem/pmm.h"
 #include "net/stack.h"
 #include <net/ethernet.h>
 #include <io/logging.h>
+#include "sys/sync.h"
 
 uint8_t rtl8139_busnum, rtl8139_slot, rtl8139_func;
 uint32_t rtl8139_io_base, rtl8139_mem_base, rtl8139_bar_type;
@@ -34,8 +36,10 @@ uint8_t TSD_array[4] = {0x10, 0x14, 0x18, 0x1C};
 
 volatile size_t rtl8139_current_tx_index = 0;
 
-volatile void* rtl8139_transfer_buffer;
-volatile size_t rtl8139_transfer_buffer_phys;
+// Buffers given to the card by `rtl8139_send_netbuf`, freed once the card is done with them.
+netbuf_t* rtl8139_tx_netbufs[RTL8139_TX_DESCRIPTORS] = {0};
+static size_t rtl8139_tx_clean = 0;        // Oldest descriptor that may still hold a buffer
+static volatile bool rtl8139_tx_full = false;  // A frame was refused, TOK resumes the stack
 
 void rtl8139_send_packet(void* data, size_t length);
 void rtl8139_receive_packet();
@@ -50,11 +54,16 @@ void rtl8139_netcard_get_mac(uint8_t mac[6]) {
 	memcpy(mac, rtl8139_mac, 6);
 }
 
+size_t rtl8139_poll(size_t budget);
+bool rtl8139_rx_irq_enable();
+
 netcard_entry_t rtl8139_netcard = {
-	NETCARD_NAME,
-	{0, 0, 0, 0},
-	rtl8139_netcard_get_mac,
-	rtl8139_send_packet,
+	.name = NETCARD_NAME,
+	.get_mac_addr = rtl8139_netcard_get_mac,
+	.send_packet = rtl8139_send_packet,
+	.send_netbuf = rtl8139_send_netbuf,
+	.poll = rtl8139_poll,
+	.rx_irq_enable = rtl8139_rx_irq_enable,
 };
 
 void rtl8139_init() {
@@ -94,9 +103,6 @@ void rtl8139_init() {
 	rtl8139_virt_buffer = kmalloc_common(RTL8139_BUFFER_SIZE, PAGE_SIZE);
 	rtl8139_phys_buffer = virt2phys(get_kernel_page_directory(), (virtual_addr_t) rtl8139_virt_buffer);
 
-	rtl8139_transfer_buffer = kmalloc_common(RTL8139_BUFFER_SIZE, PAGE_SIZE);
-	rtl8139_transfer_buffer_phys = virt2phys(get_kernel_page_directory(), (virtual_addr_t)rtl8139_transfer_buffer);
-
 	rtl8139_init_buffer();
 
 	qemu_log("RTL8139 Buffer at: [V%p, P%x]", rtl8139_virt_buffer, rtl8139_phys_buffer);
@@ -165,53 +171,138 @@ void rtl8139_handler(SAYORI_UNUSED registers_t* regs) {
 
 	if(status & TOK) {
 		qemu_log("Packet sent");
-	}
 
-	if (status & ROK) {
-		qemu_log("Packet received!\n");
+		// Buffers are freed later, outside of the interrupt.
+		if(rtl8139_tx_full) {
+			rtl8139_tx_full = false;
 
-		rtl8139_receive_packet();
+			netstack_tx_resume(&rtl8139_netcard);
+		}
 	}
 
 	outw(rtl8139_io_base + 0x3E, 0x05);
 
+	if (status & ROK) {
+		// Frames are taken by the poll, RX interrupts stay masked until it runs dry.
+		outw(rtl8139_io_base + IMR, TOK);
+
+		netstack_schedule_poll(&rtl8139_netcard);
+	}
+
 	rtl8139_in_irq = false;
 }
 
-void rtl8139_send_packet(void *data, size_t length) {
-	// First, copy the data to a physically contiguous chunk of memory
+// Frees the buffers of descriptors the card has sent. Called with interrupts off.
+static void rtl8139_reclaim_tx() {
+	while(rtl8139_tx_netbufs[rtl8139_tx_clean] != NULL
+		  && (inl(rtl8139_io_base + TSD_array[rtl8139_tx_clean]) & RTL8139_TSD_OWN)) {
+		netbuf_free(rtl8139_tx_netbufs[rtl8139_tx_clean]);
 
-	//qemu_log("Waiting lock...");
-	//while(rtl8139_in_irq)
-	//	;
+		rtl8139_tx_netbufs[rtl8139_tx_clean] = NULL;
+		rtl8139_tx_clean = (rtl8139_tx_clean + 1) % RTL8139_TX_DESCRIPTORS;
+	}
+}
 
-	qemu_log("Sending packet");
+/**
+ * @brief Отправляет пакет без копирования: карта читает его прямо из буфера
+ *
+ * @param buf - Буфер пакета (драйвер забирает его себе, если принял)
+ * @return true - если принят; false - все дескрипторы заняты, буфер остаётся у вызывающего
+ */
+bool rtl8139_send_netbuf(netbuf_t* buf) {
+	// `rtl8139_poll` reclaims from another worker, and both send paths end up here.
+	size_t flags = irq_save();
+
+	rtl8139_reclaim_tx();
 
-	memset((void*)rtl8139_transfer_buffer, 0, 65535);
+	size_t index = rtl8139_current_tx_index;
 
-	memcpy((void*)rtl8139_transfer_buffer, data, length);
+	if(rtl8139_tx_netbufs[index] != NULL) {
+		rtl8139_tx_full = true;
 
-	//qemu_log("Send packet: Virtual memory at %x", (size_t)rtl8139_transfer_buffer);
-	//qemu_log("Send packet: Physical memory at %x", rtl8139_transfer_buffer_phys);
+		irq_restore(flags);
+		return false;
+	}
+
+	// The card only takes transmit buffers on a dword boundary. The buffer itself is aligned,
+	// so the misalignment is never more than the headroom.
+	size_t misalign = netbuf_phys(buf) & 3;
 
-	// Second, fill in physical address of data, and length
+	if(misalign != 0) {
+		memmove(buf->data - misalign, buf->data, buf->len);
+		buf->data -= misalign;
+	}
 
-	//qemu_log("Before: %d",  rtl8139_current_tx_index);
+	rtl8139_tx_netbufs[index] = buf;
 
-	outl(rtl8139_io_base + TSAD_array[rtl8139_current_tx_index], (uint32_t)rtl8139_transfer_buffer_phys);
-	outl(rtl8139_io_base + TSD_array[rtl8139_current_tx_index++], length);
+	outl(rtl8139_io_base + TSAD_array[index], (uint32_t)netbuf_phys(buf));
+	outl(rtl8139_io_base + TSD_array[index], buf->len);
 
-	//qemu_log("After: %d",  rtl8139_current_tx_index);
+	rtl8139_current_tx_index = (index + 1) % RTL8139_TX_DESCRIPTORS;
 
-	if(rtl8139_current_tx_index > 3)
-		rtl8139_current_tx_index = 0;
+	irq_restore(flags);
 
-	qemu_log("Send packet end");
+	return true;
+}
+
+void rtl8139_send_packet(void *data, size_t length) {
+	size_t frame_length = MAX(length, (size_t)ETHERNET_MIN_FRAME_SIZE);
+	netbuf_t* buf = netbuf_alloc(0, frame_length);
+
+	if(buf == NULL) {
+		return;
+	}
+
+	uint8_t* frame = netbuf_put(buf, frame_length);
+
+	memcpy(frame, data, length);
+
+	// Pad short frames (only the tail, not the whole buffer).
+	memset(frame + length, 0, frame_length - length);
+
+	if(!rtl8139_send_netbuf(buf)) {
+		qemu_warn("RTL8139: TX ring is full, dropping a packet");
+
+		netbuf_free(buf);
+	}
 }
 
 size_t rtl8139_current_packet_ptr = 0;
 
-// This function is a part of IRQ
+/**
+ * @brief Забирает из кольца приёма до `budget` кадров (вызывается стеком вне прерывания)
+ *
+ * @param budget - Сколько кадров можно отдать стеку
+ * @return size_t - Сколько отдано
+ */
+size_t rtl8139_poll(size_t budget) {
+	size_t processed = 0;
+
+	size_t flags = irq_save();
+	rtl8139_reclaim_tx();
+	irq_restore(flags);
+
+	while(processed < budget && !(inb(rtl8139_io_base + CMD) & RTL8139_CMD_BUFE)) {
+		rtl8139_receive_packet();
+
+		processed++;
+	}
+
+	return processed;
+}
+
+bool rtl8139_rx_irq_enable() {
+	outw(rtl8139_io_base + IMR, ROK | TOK);
+
+	// ROK of a frame that came after the last poll was acknowledged along with the previous one.
+	if(!(inb(rtl8139_io_base + CMD) & RTL8139_CMD_BUFE)) {
+		outw(rtl8139_io_base + IMR, TOK);
+		return false;
+	}
+
+	return true;
+}
+
 void rtl8139_receive_packet() {
 	uint16_t* packet = (uint16_t*)(rtl8139_virt_buffer + rtl8139_current_packet_ptr);
 
@@ -241,7 +332,7 @@ void rtl8139_receive_packet() {
 }
 
 void rtl8139_init_interrupts() {
-	outw(rtl8139_io_base + IMR, 0x0005);
+	outw(rtl8139_io_base + IMR, ROK | TOK);
 
     uint32_t word = pci_read32(rtl8139_busnum, rtl8139_slot, rtl8139_func, 0x3C);  // All 0xF PCI register
 	// uint32_t word = pci_read_confspc_word(rtl8139_busnum, rtl8139_slot, rtl8139_func, 0x3C);  // All 0xF PCI register
@@ -0,0 +1,577 @@
+/**
+ * @brief Драйвер сетевой карты virtio-net (legacy и modern PCI)
+ * @date 2026-10-19
+ * @copyright Copyright SayoriOS Team (c) 2022-2026
+ */
+
+#include <drv/virtio_net.h>
+#include <net/cards.h>
+#include <generated/pci.h>
+#include <arch/x86/ports.h>
+#include <arch/x86/isr.h>
+#include <arch/x86/mem/paging_common.h>
+#include "lib/string.h"
+#include "lib/math.h"
+#include "mem/vmm.h"
+#include "net/stack.h"
+#include <net/ethernet.h>
+#include <io/logging.h>
+
+#define NETCARD_NAME ("VIRTIO-NET")
+
+static uint8_t virtio_busnum, virtio_slot, virtio_func;
+static uint8_t virtio_irq;
+
+// Legacy devices are driven through `virtio_io_base`, modern ones through the mapped structures.
+static bool virtio_modern = false;
+static uint16_t virtio_io_base = 0;
+static volatile virtio_pci_common_cfg_t* virtio_common = NULL;
+static volatile uint8_t* virtio_isr = NULL;
+static volatile uint8_t* virtio_device_cfg = NULL;
+static volatile uint8_t* virtio_notify_base = NULL;
+static uint32_t virtio_notify_multiplier = 0;
+
+static uint64_t virtio_features = 0;
+static size_t virtio_hdr_len = 0;
+
+static uint8_t virtio_mac[6];
+
+static virtqueue_t virtio_rx_queue = {0};
+static virtqueue_t virtio_tx_queue = {0};
+
+// One header per descriptor chain. The RX queue is only touched by the poll on the RX worker,
+// the TX queue only by the stack's TX worker, so neither needs a lock.
+static virtio_net_hdr_t* virtio_rx_headers = NULL;
+static virtio_net_hdr_t* virtio_tx_headers = NULL;
+static size_t virtio_rx_headers_phys = 0;
+static size_t virtio_tx_headers_phys = 0;
+
+static void virtio_net_get_mac(uint8_t mac[6]) {
+	memcpy(mac, virtio_mac, 6);
+}
+
+static size_t virtio_net_poll(size_t budget);
+static bool virtio_net_rx_irq_enable();
+
+netcard_entry_t virtio_net_netcard = {
+	.name = NETCARD_NAME,
+	.get_mac_addr = virtio_net_get_mac,
+	.send_packet = virtio_net_send_packet,
+	.send_netbuf = virtio_net_send_netbuf,
+	.flush = virtio_net_flush,
+	.poll = virtio_net_poll,
+	.rx_irq_enable = virtio_net_rx_irq_enable,
+};
+
+/* Transport */
+
+static uint8_t virtio_get_status() {
+	return virtio_modern ? virtio_common->device_status : inb(virtio_io_base + VIRTIO_LEGACY_DEVICE_STATUS);
+}
+
+static void virtio_set_status(uint8_t status) {
+	if(virtio_modern) {
+		virtio_common->device_status = status;
+	} else {
+		outb(virtio_io_base + VIRTIO_LEGACY_DEVICE_STATUS, status);
+	}
+}
+
+static uint64_t virtio_get_device_features() {
+	if(!virtio_modern) {
+		return inl(virtio_io_base + VIRTIO_LEGACY_DEVICE_FEATURES);
+	}
+
+	virtio_common->device_feature_select = 0;
+	uint64_t low = virtio_common->device_feature;
+
+	virtio_common->device_feature_select = 1;
+	uint64_t high = virtio_common->device_feature;
+
+	return low | (high << 32);
+}
+
+static void virtio_set_driver_features(uint64_t features) {
+	if(!virtio_modern) {
+		outl(virtio_io_base + VIRTIO_LEGACY_GUEST_FEATURES, (uint32_t)features);
+		return;
+	}
+
+	virtio_common->driver_feature_select = 0;
+	virtio_common->driver_feature = (uint32_t)features;
+
+	virtio_common->driver_feature_select = 1;
+	virtio_common->driver_feature = (uint32_t)(features >> 32);
+}
+
+static uint8_t virtio_read_device_config(size_t offset) {
+	return virtio_modern ? virtio_device_cfg[offset] : inb(virtio_io_base + VIRTIO_LEGACY_DEVICE_CONFIG + offset);
+}
+
+// Reading acknowledges the interrupt.
+static uint8_t virtio_read_isr() {
+	return virtio_modern ? *virtio_isr : inb(virtio_io_base + VIRTIO_LEGACY_ISR);
+}
+
+static void virtio_notify(virtqueue_t* queue) {
+	if(virtio_modern) {
+		*(volatile uint16_t*)(virtio_notify_base + queue->notify_offset * virtio_notify_multiplier) = queue->index;
+	} else {
+		outw(virtio_io_base + VIRTIO_LEGACY_QUEUE_NOTIFY, queue->index);
+	}
+}
+
+static void* virtio_map_bar(uint8_t bar, size_t offset, size_t length) {
+	uint8_t type = 0;
+	size_t address = 0;
+	size_t bar_length = 0;
+
+	pci_get_bar(virtio_busnum, virtio_slot, virtio_func, bar, &type, &address, &bar_length);
+
+	if(type != 0 || address == 0 || offset + length > bar_length) {
+		return NULL;
+	}
+
+	size_t start = (address + offset) & ~(PAGE_SIZE - 1);
+	size_t end = ALIGN(address + offset + length, PAGE_SIZE);
+
+	map_pages(get_kernel_page_directory(), start, start, end - start, PAGE_WRITEABLE | PAGE_CACHE_DISABLE);
+
+	return (void*)(address + offset);
+}
+
+// Looks for the vendor capabilities of the modern interface (virtio 1.x, 4.1.4).
+static bool virtio_find_modern() {
+	if(!(pci_read16(virtio_busnum, virtio_slot, virtio_func, 0x06) & (1 << 4))) {
+		return false;
+	}
+
+	uint8_t pointer = pci_read32(virtio_busnum, virtio_slot, virtio_func, 0x34) & 0xFC;
+
+	while(pointer) {
+		uint32_t header = pci_read32(virtio_busnum, virtio_slot, virtio_func, pointer);
+		uint8_t next = (header >> 8) & 0xFC;
+
+		if((header & 0xFF) == VIRTIO_PCI_CAP_ID) {
+			uint8_t cfg_type = header >> 24;
+			uint8_t bar = pci_read32(virtio_busnum, virtio_slot, virtio_func, pointer + 4) & 0xFF;
+			uint32_t offset = pci_read32(virtio_busnum, virtio_slot, virtio_func, pointer + 8);
+			uint32_t length = pci_read32(virtio_busnum, virtio_slot, virtio_func, pointer + 12);
+
+			switch(cfg_type) {
+				case VIRTIO_PCI_CAP_COMMON_CFG:
+					virtio_common = virtio_map_bar(bar, offset, length);
+					break;
+				case VIRTIO_PCI_CAP_NOTIFY_CFG:
+					virtio_notify_base = virtio_map_bar(bar, offset, length);
+					virtio_notify_multiplier = pci_read32(virtio_busnum, virtio_slot, virtio_func, pointer + 16);
+					break;
+				case VIRTIO_PCI_CAP_ISR_CFG:
+					virtio_isr = virtio_map_bar(bar, offset, length);
+					break;
+				case VIRTIO_PCI_CAP_DEVICE_CFG:
+					virtio_device_cfg = virtio_map_bar(bar, offset, length);
+					break;
+			}
+		}
+
+		pointer = next;
+	}
+
+	return virtio_common && virtio_notify_base && virtio_isr && virtio_device_cfg;
+}
+
+/* Virtqueues */
+
+static bool virtqueue_setup(virtqueue_t* queue, uint16_t index) {
+	uint16_t size;
+
+	if(virtio_modern) {
+		virtio_common->queue_select = index;
+
+		size = MIN(virtio_common->queue_size, (uint16_t)VIRTIO_NET_QUEUE_SIZE);
+	} else {
+		outw(virtio_io_base + VIRTIO_LEGACY_QUEUE_SELECT, index);
+
+		size = inw(virtio_io_base + VIRTIO_LEGACY_QUEUE_SIZE);
+	}
+
+	if(size == 0) {
+		return false;
+	}
+
+	size_t avail_offset = size * sizeof(virtq_desc_t);
+	size_t used_offset = ALIGN(avail_offset + sizeof(virtq_avail_t) + (size + 1) * sizeof(uint16_t), VIRTQ_ALIGN);
+	size_t total = used_offset + ALIGN(sizeof(virtq_used_t) + size * sizeof(virtq_used_elem_t) + sizeof(uint16_t), VIRTQ_ALIGN);
+
+	// The device sees the ring as one physical block.
+	uint8_t* memory = kmalloc_common_contiguous(get_kernel_page_directory(), total / PAGE_SIZE);
+
+	if(memory == NULL) {
+		return false;
+	}
+
+	memset(memory, 0, total);
+
+	queue->index = index;
+	queue->size = size;
+	queue->desc = (volatile virtq_desc_t*)memory;
+	queue->avail = (volatile virtq_avail_t*)(memory + avail_offset);
+	queue->used = (volatile virtq_used_t*)(memory + used_offset);
+	queue->phys = virt2phys(get_kernel_page_directory(), (virtual_addr_t)memory);
+	queue->cookies = kcalloc(sizeof(void*), size);
+
+	for(uint16_t i = 0; i < size; i++) {
+		queue->desc[i].next = (i + 1) % size;
+	}
+
+	queue->free_head = 0;
+	queue->num_free = size;
+
+	if(virtio_modern) {
+		virtio_common->queue_size = size;
+		virtio_common->queue_desc_low = queue->phys;
+		virtio_common->queue_desc_high = 0;
+		virtio_common->queue_driver_low = queue->phys + avail_offset;
+		virtio_common->queue_driver_high = 0;
+		virtio_common->queue_device_low = queue->phys + used_offset;
+		virtio_common->queue_device_high = 0;
+
+		queue->notify_offset = virtio_common->queue_notify_off;
+
+		virtio_common->queue_enable = 1;
+	} else {
+		outl(virtio_io_base + VIRTIO_LEGACY_QUEUE_PFN, queue->phys / VIRTQ_ALIGN);
+	}
+
+	return true;
+}
+
+// Takes two free descriptors and links them: the header, then the packet.
+static uint16_t virtqueue_add_pair(virtqueue_t* queue, size_t header_phys, size_t data_phys, size_t data_len,
+								   uint16_t flags, void* cookie) {
+	uint16_t head = queue->free_head;
+	uint16_t second = queue->desc[head].next;
+
+	queue->free_head = queue->desc[second].next;
+	queue->num_free -= 2;
+
+	queue->desc[head].addr = header_phys;
+	queue->desc[head].len = virtio_hdr_len;
+	queue->desc[head].flags = flags | VIRTQ_DESC_F_NEXT;
+	queue->desc[head].next = second;
+
+	queue->desc[second].addr = data_phys;
+	queue->desc[second].len = data_len;
+	queue->desc[second].flags = flags;
+
+	queue->cookies[head] = cookie;
+
+	queue->avail->ring[queue->avail_idx % queue->size] = head;
+	queue->avail_idx++;
+
+	return head;
+}
+
+static void virtqueue_free_pair(virtqueue_t* queue, uint16_t head) {
+	uint16_t second = queue->desc[head].next;
+
+	queue->desc[second].next = queue->free_head;
+	queue->free_head = head;
+	queue->num_free += 2;
+}
+
+// Publishes everything added since the last call with one index update and at most one doorbell.
+static void virtqueue_kick(virtqueue_t* queue) {
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	queue->avail->idx = queue->avail_idx;
+
+	// The device may clear NO_NOTIFY right after we publish, so the check must follow the store.
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if(!(queue->used->flags & VIRTQ_USED_F_NO_NOTIFY)) {
+		virtio_notify(queue);
+	}
+}
+
+/* RX */
+
+static bool virtio_net_fill_rx() {
+	virtqueue_t* queue = &virtio_rx_queue;
+	size_t chains = queue->size / 2;
+
+	virtio_rx_headers = kmalloc_common_contiguous(get_kernel_page_directory(),
+												  ALIGN(chains * sizeof(virtio_net_hdr_t), PAGE_SIZE) / PAGE_SIZE);
+
+	if(virtio_rx_headers == NULL) {
+		return false;
+	}
+
+	virtio_rx_headers_phys = virt2phys(get_kernel_page_directory(), (virtual_addr_t)virtio_rx_headers);
+
+	for(size_t i = 0; i < chains; i++) {
+		// Aligned to its size, so the buffer never crosses a page.
+		uint8_t* buffer = kmalloc_common(NETBUF_SIZE, NETBUF_SIZE);
+
+		if(buffer == NULL) {
+			return false;
+		}
+
+		size_t phys = virt2phys_precise(get_kernel_page_directory(), (virtual_addr_t)buffer);
+
+		virtqueue_add_pair(queue, virtio_rx_headers_phys + i * sizeof(virtio_net_hdr_t),
+						   phys, NETBUF_SIZE, VIRTQ_DESC_F_WRITE, buffer);
+	}
+
+	// Published with the first kick, the device must not be notified before DRIVER_OK.
+	return true;
+}
+
+// Runs on the RX worker: gives up to `budget` frames to the stack and puts the same buffers back.
+static size_t virtio_net_poll(size_t budget) {
+	virtqueue_t* queue = &virtio_rx_queue;
+	size_t processed = 0;
+
+	while(processed < budget && queue->last_used != queue->used->idx) {
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+		volatile virtq_used_elem_t* elem = &queue->used->ring[queue->last_used % queue->size];
+		uint16_t head = elem->id;
+		size_t length = elem->len;
+
+		queue->last_used++;
+
+		if(length > virtio_hdr_len) {
+			netstack_transfer(&virtio_net_netcard, queue->cookies[head], length - virtio_hdr_len);
+		}
+
+		// The chain is reused as is: only its slot in the available ring is new.
+		queue->avail->ring[queue->avail_idx % queue->size] = head;
+		queue->avail_idx++;
+
+		processed++;
+	}
+
+	if(processed) {
+		virtqueue_kick(queue);
+	}
+
+	return processed;
+}
+
+static bool virtio_net_rx_irq_enable() {
+	virtqueue_t* queue = &virtio_rx_queue;
+
+	queue->avail->flags = 0;
+
+	// The device may have used a buffer before it saw the flag cleared.
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if(queue->last_used != queue->used->idx) {
+		queue->avail->flags = VIRTQ_AVAIL_F_NO_INTERRUPT;
+		return false;
+	}
+
+	return true;
+}
+
+static void virtio_net_handler(SAYORI_UNUSED registers_t* regs) {
+	// The line may be shared: zero means the interrupt is not ours.
+	if(virtio_read_isr() & 1) {
+		// Only a hint to the device, the poll copes with interrupts that still arrive.
+		virtio_rx_queue.avail->flags = VIRTQ_AVAIL_F_NO_INTERRUPT;
+
+		netstack_schedule_poll(&virtio_net_netcard);
+	}
+}
+
+/* TX */
+
+static void virtio_net_reclaim_tx() {
+	virtqueue_t* queue = &virtio_tx_queue;
+
+	while(queue->last_used != queue->used->idx) {
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+		uint16_t head = queue->used->ring[queue->last_used % queue->size].id;
+
+		queue->last_used++;
+
+		netbuf_free(queue->cookies[head]);
+		queue->cookies[head] = NULL;
+
+		virtqueue_free_pair(queue, head);
+	}
+}
+
+/**
+ * @brief Ставит пакет в очередь отправки без копирования
+ *
+ * Устройство узнаёт о пакетах только в `virtio_net_flush`, который стек
+ * вызывает после пачки отправок.
+ *
+ * @param buf - Буфер пакета (драйвер забирает его себе)
+ * @return true - всегда: при полном кольце пакет теряется
+ */
+bool virtio_net_send_netbuf(netbuf_t* buf) {
+	virtqueue_t* queue = &virtio_tx_queue;
+
+	virtio_net_reclaim_tx();
+
+	if(queue->num_free < 2) {
+		// Let the device drain what is already queued.
+		virtqueue_kick(queue);
+
+		qemu_warn("VIRTIO-NET: TX queue is full, dropping a packet");
+
+		netbuf_free(buf);
+		return true;
+	}
+
+	uint16_t head = queue->free_head;
+	virtio_net_hdr_t* header = &virtio_tx_headers[head];
+
+	memset(header, 0, sizeof(virtio_net_hdr_t));
+
+	header->gso_type = VIRTIO_NET_HDR_GSO_NONE;
+
+	if(buf->csum_partial) {
+		header->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+		header->csum_start = (buf->head + buf->csum_start) - buf->data;
+		header->csum_offset = buf->csum_offset;
+	}
+
+	virtqueue_add_pair(queue, virtio_tx_headers_phys + head * sizeof(virtio_net_hdr_t),
+					   netbuf_phys(buf), buf->len, 0, buf);
+
+	return true;
+}
+
+void virtio_net_flush() {
+	virtqueue_kick(&virtio_tx_queue);
+}
+
+void virtio_net_send_packet(void* data, size_t length) {
+	netbuf_t* buf = netbuf_alloc(0, length);
+
+	if(buf == NULL) {
+		return;
+	}
+
+	memcpy(netbuf_put(buf, length), data, length);
+
+	virtio_net_send_netbuf(buf);
+	virtio_net_flush();
+}
+
+/* Initialization */
+
+static bool virtio_net_find() {
+	if(pci_find_device(VIRTIO_VENDOR, VIRTIO_NET_DEVICE_MODERN, &virtio_busnum, &virtio_slot, &virtio_func)) {
+		return true;
+	}
+
+	return pci_find_device(VIRTIO_VENDOR, VIRTIO_NET_DEVICE_LEGACY, &virtio_busnum, &virtio_slot, &virtio_func);
+}
+
+void virtio_net_init() {
+	qemu_log("Initializing VIRTIO-NET...");
+
+	if(!virtio_net_find()) {
+		qemu_log("VIRTIO-NET is not connected!");
+		return;
+	}
+
+	pci_enable_bus_mastering(virtio_busnum, virtio_slot, virtio_func);
+
+	// Transitional devices have both interfaces, the modern one is preferred.
+	virtio_modern = virtio_find_modern();
+
+	if(!virtio_modern) {
+		virtio_io_base = pci_read32(virtio_busnum, virtio_slot, virtio_func, 0x10) & ~0x3U;  // BAR0
+	}
+
+	virtio_set_status(0);
+	virtio_set_status(VIRTIO_STATUS_ACKNOWLEDGE);
+	virtio_set_status(VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+
+	uint64_t offered = virtio_get_device_features();
+	uint64_t wanted = (1ULL << VIRTIO_NET_F_MAC) | (1ULL << VIRTIO_NET_F_CSUM);
+
+	if(virtio_modern) {
+		wanted |= 1ULL << VIRTIO_F_VERSION_1;
+	}
+
+	virtio_features = offered & wanted;
+
+	virtio_set_driver_features(virtio_features);
+
+	if(virtio_modern) {
+		virtio_set_status(VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_FEATURES_OK);
+
+		if(!(virtio_get_status() & VIRTIO_STATUS_FEATURES_OK)) {
+			qemu_err("VIRTIO-NET: device rejected features %x:%x", (uint32_t)(virtio_features >> 32), (uint32_t)virtio_features);
+
+			virtio_set_status(VIRTIO_STATUS_FAILED);
+			return;
+		}
+	}
+
+	// `num_buffers` is only part of the header in the modern format.
+	virtio_hdr_len = (virtio_features & (1ULL << VIRTIO_F_VERSION_1))
+		? sizeof(virtio_net_hdr_t)
+		: sizeof(virtio_net_hdr_t) - sizeof(uint16_t);
+
+	if(virtio_features & (1ULL << VIRTIO_NET_F_MAC)) {
+		for(size_t i = 0; i < 6; i++) {
+			virtio_mac[i] = virtio_read_device_config(i);
+		}
+	} else {
+		// Locally administered address, the device has none of its own.
+		uint8_t fallback[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+
+		memcpy(virtio_mac, fallback, 6);
+	}
+
+	if(!virtqueue_setup(&virtio_rx_queue, VIRTIO_NET_RX_QUEUE)
+	   || !virtqueue_setup(&virtio_tx_queue, VIRTIO_NET_TX_QUEUE)) {
+		qemu_err("VIRTIO-NET: failed to set up the queues");
+
+		virtio_set_status(VIRTIO_STATUS_FAILED);
+		return;
+	}
+
+	// TX headers are indexed by the head descriptor of their chain.
+	virtio_tx_headers = kmalloc_common_contiguous(get_kernel_page_directory(),
+												  ALIGN(virtio_tx_queue.size * sizeof(virtio_net_hdr_t), PAGE_SIZE) / PAGE_SIZE);
+
+	if(virtio_tx_headers == NULL || !virtio_net_fill_rx()) {
+		qemu_err("VIRTIO-NET: not enough memory for the buffers");
+
+		virtio_set_status(VIRTIO_STATUS_FAILED);
+		return;
+	}
+
+	virtio_tx_headers_phys = virt2phys(get_kernel_page_directory(), (virtual_addr_t)virtio_tx_headers);
+
+	if(virtio_features & (1ULL << VIRTIO_NET_F_CSUM)) {
+		virtio_net_netcard.features |= NETCARD_FEATURE_TX_CSUM;
+	}
+
+	virtio_irq = pci_read32(virtio_busnum, virtio_slot, virtio_func, 0x3C) & 0xFF;
+
+	register_interrupt_handler(32 + virtio_irq, virtio_net_handler);
+
+	virtio_set_status(virtio_get_status() | VIRTIO_STATUS_DRIVER_OK);
+
+	virtqueue_kick(&virtio_rx_queue);
+
+	qemu_ok("VIRTIO-NET: %s interface, IRQ %d, queues %d/%d, checksum offload: %s",
+			virtio_modern ? "modern" : "legacy", virtio_irq, virtio_rx_queue.size, virtio_tx_queue.size,
+			(virtio_net_netcard.features & NETCARD_FEATURE_TX_CSUM) ? "yes" : "no");
+
+	qemu_log("Mac is: %02x:%02x:%02x:%02x:%02x:%02x", virtio_mac[0], virtio_mac[1], virtio_mac[2], virtio_mac[3], virtio_mac[4], virtio_mac[5]);
+
+	netcard_add(&virtio_net_netcard);
+}
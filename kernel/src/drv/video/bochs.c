@@ -0,0 +1,304 @@
+/**
+ * @file drv/video/bochs.c
+ * @brief Адаптер Bochs/QEMU VBE (интерфейс dispi): режимы экрана, виртуальный экран и прокрутка
+ * @date 2026-10-19
+ * @copyright Copyright SayoriOS Team (c) 2022-2026
+ */
+
+#include "gfx/bochs.h"
+#include "arch/x86/ports.h"
+#include "generated/pci.h"
+#include "io/logging.h"
+#include "mem/vmm.h"
+
+// Polls of the retrace bit before giving up on an adapter that doesn't emulate it.
+#define BOCHS_VSYNC_POLLS   1000000
+
+// The adapter has no list of modes, these are offered where the video memory fits them.
+static const uint16_t bochs_resolutions[][2] = {
+    {640, 480},   {800, 600},   {1024, 768},  {1152, 864},
+    {1280, 720},  {1280, 800},  {1280, 1024}, {1360, 768},
+    {1440, 900},  {1600, 900},  {1600, 1200}, {1680, 1050},
+    {1920, 1080}, {1920, 1200}, {2560, 1440}, {2560, 1600},
+};
+
+static bool bochs_found = false;
+static size_t bochs_lfb = 0;                 /// Видеопамять из BAR0
+static size_t bochs_vram_size = 0;
+static volatile uint16_t* bochs_mmio = NULL; /// Регистры dispi в BAR2, если есть
+
+static screen_mode_t bochs_modes[BOCHS_MAX_MODES];
+static size_t bochs_modes_count = 0;
+
+uint16_t bochs_dispi_read(uint16_t index) {
+    if(bochs_mmio != NULL) {
+        return bochs_mmio[index];
+    }
+
+    outw(BOCHS_DISPI_IOPORT_INDEX, index);
+
+    return inw(BOCHS_DISPI_IOPORT_DATA);
+}
+
+void bochs_dispi_write(uint16_t index, uint16_t value) {
+    if(bochs_mmio != NULL) {
+        bochs_mmio[index] = value;
+        return;
+    }
+
+    outw(BOCHS_DISPI_IOPORT_INDEX, index);
+    outw(BOCHS_DISPI_IOPORT_DATA, value);
+}
+
+/**
+ * @brief Проверяет, что адаптер поддерживает виртуальный экран и прокрутку
+ *
+ * @return true - если ID не ниже BOCHS_DISPI_ID2
+ */
+bool bochs_dispi_present() {
+    uint16_t id = bochs_dispi_read(BOCHS_DISPI_INDEX_ID);
+
+    return id >= BOCHS_DISPI_ID2 && id <= BOCHS_DISPI_ID5;
+}
+
+/**
+ * @brief Проверяет, что текущий режим экрана выставлен через dispi
+ *
+ * Загрузчик мог включить режим через другой адаптер, тогда регистры dispi к экрану не относятся.
+ *
+ * @param width - Ширина экрана
+ * @param height - Высота экрана
+ * @param bpp - Бит на пиксель
+ * @param pitch - Байт на строку
+ * @return true - если режим совпадает и строки не длиннее видимой части
+ */
+bool bochs_dispi_drives_mode(uint32_t width, uint32_t height, uint32_t bpp, uint32_t pitch) {
+    if(!bochs_dispi_present()) {
+        return false;
+    }
+
+    uint16_t enable = bochs_dispi_read(BOCHS_DISPI_INDEX_ENABLE);
+
+    if(!(enable & BOCHS_DISPI_ENABLED) || !(enable & BOCHS_DISPI_LFB_ENABLED)) {
+        return false;
+    }
+
+    return bochs_dispi_read(BOCHS_DISPI_INDEX_XRES) == width
+        && bochs_dispi_read(BOCHS_DISPI_INDEX_YRES) == height
+        && bochs_dispi_read(BOCHS_DISPI_INDEX_BPP) == bpp
+        && bochs_dispi_read(BOCHS_DISPI_INDEX_VIRT_WIDTH) * (bpp >> 3) == pitch;
+}
+
+/**
+ * @brief Задаёт высоту виртуального экрана
+ *
+ * QEMU сам выставляет её по объёму видеопамяти, Bochs принимает запись. Ответ - то, что
+ * адаптер выставил на самом деле.
+ *
+ * @param height - Нужная высота в строках
+ * @return uint32_t - Высота виртуального экрана
+ */
+uint32_t bochs_dispi_set_virtual_height(uint32_t height) {
+    bochs_dispi_write(BOCHS_DISPI_INDEX_VIRT_HEIGHT, height);
+
+    return bochs_dispi_read(BOCHS_DISPI_INDEX_VIRT_HEIGHT);
+}
+
+/**
+ * @brief Показывает виртуальный экран начиная со строки y
+ *
+ * @param y - Первая видимая строка
+ */
+void bochs_dispi_set_y_offset(uint32_t y) {
+    bochs_dispi_write(BOCHS_DISPI_INDEX_Y_OFFSET, y);
+}
+
+/**
+ * @brief Ждёт начала обратного хода луча по вертикали
+ *
+ * Сначала дожидается конца текущего, чтобы не попасть в его хвост. Без портов VGA
+ * (bochs-display) не ждёт ничего.
+ */
+void bochs_wait_vsync() {
+    // Nobody answers the port: all bits read as ones and the retrace never ends.
+    if(inb(BOCHS_VGA_INPUT_STATUS) == BOCHS_VGA_NO_PORTS) {
+        return;
+    }
+
+    size_t polls = BOCHS_VSYNC_POLLS;
+
+    while((inb(BOCHS_VGA_INPUT_STATUS) & BOCHS_VGA_VRETRACE) && --polls)
+        ;
+
+    polls = BOCHS_VSYNC_POLLS;
+
+    while(!(inb(BOCHS_VGA_INPUT_STATUS) & BOCHS_VGA_VRETRACE) && --polls)
+        ;
+}
+
+static bool bochs_mode_fits(uint32_t width, uint32_t height, uint32_t bpp) {
+    if(bpp != 32 && bpp != 24) {
+        return false;
+    }
+
+    if(width == 0 || height == 0 || (width & 7) != 0
+       || width > BOCHS_DISPI_MAX_XRES || height > BOCHS_DISPI_MAX_YRES) {
+        return false;
+    }
+
+    return (size_t)width * (bpp >> 3) * height <= bochs_vram_size;
+}
+
+/**
+ * @brief Находит адаптер Bochs/QEMU на PCI и составляет список режимов
+ *
+ * Подходит и QEMU -vga std, и bochs-display: у второго нет портов VGA, поэтому регистры
+ * dispi берутся из BAR2, когда он есть.
+ *
+ * @return true - если адаптер найден
+ */
+bool bochs_init() {
+    uint8_t bus = 0, slot = 0, func = 0;
+
+    if(!pci_find_device(BOCHS_PCI_VENDOR, BOCHS_PCI_DEVICE, &bus, &slot, &func)) {
+        return false;
+    }
+
+    uint8_t type = 0;
+    size_t address = 0;
+    size_t length = 0;
+
+    pci_get_bar(bus, slot, func, 0, &type, &address, &length);
+
+    if(type != 0 || address == 0) {
+        qemu_err("Bochs VBE: no linear framebuffer in BAR0");
+        return false;
+    }
+
+    uint8_t mmio_type = 1;
+    size_t mmio = 0;
+    size_t mmio_length = 0;
+
+    pci_get_bar(bus, slot, func, 2, &mmio_type, &mmio, &mmio_length);
+
+    if(mmio_type == 0 && mmio != 0 && mmio_length >= PAGE_SIZE) {
+        map_pages(get_kernel_page_directory(), mmio, mmio, PAGE_SIZE, PAGE_WRITEABLE | PAGE_CACHE_DISABLE);
+
+        bochs_mmio = (volatile uint16_t*)(mmio + BOCHS_MMIO_DISPI);
+    }
+
+    if(!bochs_dispi_present()) {
+        qemu_err("Bochs VBE: unsupported dispi ID %x", bochs_dispi_read(BOCHS_DISPI_INDEX_ID));
+
+        bochs_mmio = NULL;
+        return false;
+    }
+
+    bochs_lfb = address;
+    bochs_vram_size = (size_t)bochs_dispi_read(BOCHS_DISPI_INDEX_VIDEO_MEMORY) << 16;
+
+    // Older adapters don't report it, the BAR covers all of it then.
+    if(bochs_vram_size == 0) {
+        bochs_vram_size = length;
+    }
+
+    bochs_modes_count = 0;
+
+    for(size_t depth = 0; depth < 2; depth++) {
+        uint32_t bpp = depth == 0 ? 32 : 24;
+
+        for(size_t i = 0; i < sizeof(bochs_resolutions) / sizeof(bochs_resolutions[0]); i++) {
+            uint32_t width = bochs_resolutions[i][0];
+            uint32_t height = bochs_resolutions[i][1];
+
+            if(bochs_modes_count < BOCHS_MAX_MODES && bochs_mode_fits(width, height, bpp)) {
+                bochs_modes[bochs_modes_count++] = (screen_mode_t){width, height, bpp};
+            }
+        }
+    }
+
+    bochs_found = true;
+
+    qemu_ok("Bochs VBE: %d.%d.%d, LFB at %x, %dK of video memory, %d modes, registers in %s",
+            bus, slot, func, bochs_lfb, bochs_vram_size >> 10, bochs_modes_count,
+            bochs_mmio != NULL ? "MMIO" : "I/O ports");
+
+    return true;
+}
+
+/**
+ * @brief Количество режимов из списка bochs_init
+ *
+ * @return size_t - Количество, 0 без адаптера
+ */
+size_t bochs_mode_count() {
+    return bochs_modes_count;
+}
+
+/**
+ * @brief Режим из списка: сначала 32 бита на пиксель, потом 24, по возрастанию размера
+ *
+ * @param index - Номер режима
+ * @param out - Куда записать режим
+ * @return true - если такой номер есть
+ */
+bool bochs_mode_get(size_t index, screen_mode_t* out) {
+    if(index >= bochs_modes_count) {
+        return false;
+    }
+
+    *out = bochs_modes[index];
+
+    return true;
+}
+
+static void bochs_dispi_program(uint32_t width, uint32_t height, uint32_t bpp) {
+    bochs_dispi_write(BOCHS_DISPI_INDEX_ENABLE, 0);
+
+    bochs_dispi_write(BOCHS_DISPI_INDEX_XRES, width);
+    bochs_dispi_write(BOCHS_DISPI_INDEX_YRES, height);
+    bochs_dispi_write(BOCHS_DISPI_INDEX_BPP, bpp);
+    bochs_dispi_write(BOCHS_DISPI_INDEX_VIRT_WIDTH, width);
+    bochs_dispi_write(BOCHS_DISPI_INDEX_X_OFFSET, 0);
+    bochs_dispi_write(BOCHS_DISPI_INDEX_Y_OFFSET, 0);
+
+    bochs_dispi_write(BOCHS_DISPI_INDEX_ENABLE, BOCHS_DISPI_ENABLED | BOCHS_DISPI_LFB_ENABLED);
+}
+
+/**
+ * @brief Переключает экран в режим и перестраивает под него буферы через graphics_update
+ *
+ * Подходит любой режим, который помещается в видеопамять, не только из списка. Если адаптер
+ * его не принял, возвращается прежний режим.
+ *
+ * @param width - Ширина, кратная 8
+ * @param height - Высота
+ * @param bpp - 32 или 24 бита на пиксель
+ * @return true - если режим включён
+ */
+bool bochs_set_mode(uint32_t width, uint32_t height, uint32_t bpp) {
+    if(!bochs_found || !bochs_mode_fits(width, height, bpp)) {
+        return false;
+    }
+
+    bochs_dispi_program(width, height, bpp);
+
+    if(bochs_dispi_read(BOCHS_DISPI_INDEX_XRES) != width
+       || bochs_dispi_read(BOCHS_DISPI_INDEX_YRES) != height
+       || bochs_dispi_read(BOCHS_DISPI_INDEX_BPP) != bpp) {
+        qemu_err("Bochs VBE: %dx%dx%d was not accepted", width, height, bpp);
+
+        // The screen state still describes the old mode.
+        bochs_dispi_program(getScreenWidth(), getScreenHeight(), getDisplayBpp());
+
+        return false;
+    }
+
+    uint32_t pitch = bochs_dispi_read(BOCHS_DISPI_INDEX_VIRT_WIDTH) * (bpp >> 3);
+
+    graphics_update(bochs_lfb, width, height, pitch, bpp);
+
+    qemu_ok("Bochs VBE: now %dx%dx%d, pitch %d", width, height, bpp, pitch);
+
+    return true;
+}
@@ -171,8 +171,9 @@ void igfx_init() {
 	IGFX_WRITE(xaddr + 0x10008, IGFX_READ(xaddr + 0x10008) | (1 << 31)); // enable pipe
 	IGFX_WRITE(xaddr + 0x10180, IGFX_READ(xaddr + 0x10180) | (1 << 31)); // enable Display Plane A
 
-    graphics_update(igfx_width, igfx_height, scanline_w);
+    graphics_update((size_t)framebuffer_addr, igfx_width, igfx_height, scanline_w, 32);
 
+    tty_fit_screen();
     tty_clear();
 
 	tty_printf("Screen now tuned to: %dx%d; Size: %d; BackFB: %x\n", igfx_width, igfx_height, framebuffer_size, back_framebuffer_addr);
@@ -0,0 +1,756 @@
+/**
+ * @file gui/compositor.c
+ * @brief Композитор: окна со своими буферами, порядок по Z и курсор мыши поверх них
+ * @date 2026-10-19
+ * @copyright Copyright SayoriOS Team (c) 2022-2026
+ */
+
+#include "gui/compositor.h"
+#include "drv/input/mouse.h"
+#include "io/screen.h"
+#include "io/logging.h"
+#include "lib/math.h"
+#include "lib/string.h"
+#include "mem/vmm.h"
+#include "sys/sync.h"
+#include "sys/timer.h"
+#include "sys/scheduler/process.h"
+#include "sys/scheduler/thread.h"
+
+typedef struct {
+    window_t public;
+    bool     visible;   /* Не показывается до первого window_damage или window_present */
+} compositor_window_t;
+
+static mutex_t compositor_lock = {false};
+
+// Bottom to top.
+static compositor_window_t* compositor_windows[COMPOSITOR_MAX_WINDOWS];
+static size_t compositor_window_count = 0;
+static size_t compositor_next_id = 1;
+
+// The back buffer as it was before the first window, shown where no window covers it.
+static blit_surface_t compositor_desktop = {0};
+
+static compositor_box_t compositor_damage[COMPOSITOR_MAX_DAMAGE];
+static size_t compositor_damage_count = 0;
+
+static const char* const compositor_cursor_art[COMPOSITOR_CURSOR_SHAPES][COMPOSITOR_CURSOR_HEIGHT] = {
+    [COMPOSITOR_CURSOR_ARROW] = {
+        "X           ",
+        "XX          ",
+        "X.X         ",
+        "X..X        ",
+        "X...X       ",
+        "X....X      ",
+        "X.....X     ",
+        "X......X    ",
+        "X.......X   ",
+        "X........X  ",
+        "X.........X ",
+        "X..........X",
+        "X......XXXXX",
+        "X...X..X    ",
+        "X..XX..X    ",
+        "X.X  X..X   ",
+        "XX   X..X   ",
+        "X     X..X  ",
+        "      XXXX  ",
+    },
+    [COMPOSITOR_CURSOR_BUSY] = {
+        "XXXXXXXXXXXX",
+        "X..........X",
+        "XXXXXXXXXXXX",
+        " X........X ",
+        " X........X ",
+        " X.XXXXXX.X ",
+        "  X.XXXX.X  ",
+        "   X.XX.X   ",
+        "    X..X    ",
+        "     XX     ",
+        "    X..X    ",
+        "   X....X   ",
+        "  X..XX..X  ",
+        " X..XXXX..X ",
+        " X.XXXXXX.X ",
+        " X........X ",
+        "XXXXXXXXXXXX",
+        "X..........X",
+        "XXXXXXXXXXXX",
+    },
+};
+
+static const int32_t compositor_cursor_hotspot[COMPOSITOR_CURSOR_SHAPES][2] = {
+    [COMPOSITOR_CURSOR_ARROW] = {0, 0},
+    [COMPOSITOR_CURSOR_BUSY] = {5, 9},
+};
+
+static uint32_t compositor_cursor_pixels[COMPOSITOR_CURSOR_SHAPES][COMPOSITOR_CURSOR_HEIGHT][COMPOSITOR_CURSOR_WIDTH];
+
+static bool compositor_cursor_visible = false;
+static compositor_cursor_t compositor_cursor_shape = COMPOSITOR_CURSOR_ARROW;
+
+// The cursor is drawn straight into the back buffer, with the pixels it hides saved aside.
+static bool cursor_drawn = false;
+static compositor_cursor_t cursor_drawn_shape;
+static compositor_box_t cursor_drawn_at;     /* Целиком, без обрезки по экрану */
+static compositor_box_t cursor_box;          /* Часть на экране, её пиксели в cursor_under */
+static uint8_t cursor_under_pixels[COMPOSITOR_CURSOR_WIDTH * COMPOSITOR_CURSOR_HEIGHT * 4];
+static blit_surface_t cursor_under = {0};
+
+static inline bool box_empty(compositor_box_t box) {
+    return box.x0 >= box.x1 || box.y0 >= box.y1;
+}
+
+static inline bool box_equal(compositor_box_t a, compositor_box_t b) {
+    return a.x0 == b.x0 && a.y0 == b.y0 && a.x1 == b.x1 && a.y1 == b.y1;
+}
+
+static inline compositor_box_t box_intersect(compositor_box_t a, compositor_box_t b) {
+    return (compositor_box_t){MAX(a.x0, b.x0), MAX(a.y0, b.y0), MIN(a.x1, b.x1), MIN(a.y1, b.y1)};
+}
+
+static inline bool box_contains(compositor_box_t outer, compositor_box_t inner) {
+    return outer.x0 <= inner.x0 && outer.y0 <= inner.y0 && outer.x1 >= inner.x1 && outer.y1 >= inner.y1;
+}
+
+/**
+ * @brief Вычитает один прямоугольник из другого
+ *
+ * @param from - Из чего
+ * @param cut - Что вычесть
+ * @param out - До 4 прямоугольников остатка
+ * @return size_t - Сколько их
+ */
+static size_t box_subtract(compositor_box_t from, compositor_box_t cut, compositor_box_t out[4]) {
+    compositor_box_t hit = box_intersect(from, cut);
+
+    if(box_empty(hit)) {
+        out[0] = from;
+        return 1;
+    }
+
+    size_t count = 0;
+
+    if(from.y0 < hit.y0) {
+        out[count++] = (compositor_box_t){from.x0, from.y0, from.x1, hit.y0};
+    }
+
+    if(hit.y1 < from.y1) {
+        out[count++] = (compositor_box_t){from.x0, hit.y1, from.x1, from.y1};
+    }
+
+    if(from.x0 < hit.x0) {
+        out[count++] = (compositor_box_t){from.x0, hit.y0, hit.x0, hit.y1};
+    }
+
+    if(hit.x1 < from.x1) {
+        out[count++] = (compositor_box_t){hit.x1, hit.y0, from.x1, hit.y1};
+    }
+
+    return count;
+}
+
+static inline compositor_box_t surface_box(const blit_surface_t* surface) {
+    return (compositor_box_t){0, 0, (int32_t)surface->width, (int32_t)surface->height};
+}
+
+static inline compositor_box_t window_box(const window_t* window) {
+    return (compositor_box_t){
+        window->x,
+        window->y,
+        window->x + (int32_t)window->surface.width,
+        window->y + (int32_t)window->surface.height
+    };
+}
+
+static void compositor_add_damage(compositor_box_t box) {
+    blit_surface_t screen;
+
+    screen_back_surface(&screen);
+
+    box = box_intersect(box, surface_box(&screen));
+
+    if(box_empty(box)) {
+        return;
+    }
+
+    for(size_t i = 0; i < compositor_damage_count; i++) {
+        if(box_contains(compositor_damage[i], box)) {
+            return;
+        }
+
+        if(box_contains(box, compositor_damage[i])) {
+            compositor_damage[i] = box;
+            return;
+        }
+    }
+
+    if(compositor_damage_count == COMPOSITOR_MAX_DAMAGE) {
+        // Too many pieces: their bounding box is recomposed instead.
+        for(size_t i = 0; i < compositor_damage_count; i++) {
+            box.x0 = MIN(box.x0, compositor_damage[i].x0);
+            box.y0 = MIN(box.y0, compositor_damage[i].y0);
+            box.x1 = MAX(box.x1, compositor_damage[i].x1);
+            box.y1 = MAX(box.y1, compositor_damage[i].y1);
+        }
+
+        compositor_damage_count = 0;
+    }
+
+    compositor_damage[compositor_damage_count++] = box;
+}
+
+static void compositor_paint_layer(const blit_surface_t* screen, compositor_box_t box,
+                                   const blit_surface_t* layer, int32_t x, int32_t y) {
+    blit_copy_rect(screen, box.x0, box.y0, layer, box.x0 - x, box.y0 - y, box.x1 - box.x0, box.y1 - box.y0);
+}
+
+static void compositor_paint_desktop(const blit_surface_t* screen, compositor_box_t box) {
+    if(compositor_desktop.pixels == NULL) {
+        blit_fill_rect(screen, box.x0, box.y0, box.x1 - box.x0, box.y1 - box.y0, 0);
+        return;
+    }
+
+    compositor_paint_layer(screen, box, &compositor_desktop, 0, 0);
+}
+
+// Paints the box from the desktop and windows [0, top) bottom to top, overdrawing.
+static void compositor_paint_overdraw(const blit_surface_t* screen, compositor_box_t box, size_t top) {
+    compositor_paint_desktop(screen, box);
+
+    for(size_t i = 0; i < top; i++) {
+        window_t* window = &compositor_windows[i]->public;
+        compositor_box_t hit = box_intersect(box, window_box(window));
+
+        if(compositor_windows[i]->visible && !box_empty(hit)) {
+            compositor_paint_layer(screen, hit, &window->surface, window->x, window->y);
+        }
+    }
+}
+
+/**
+ * @brief Собирает прямоугольник экрана из окон и рабочего стола
+ *
+ * Окна обходятся сверху вниз: каждое рисует свою часть оставшихся кусков и вырезает её,
+ * так что каждый пиксель пишется один раз, а закрытые части окон не читаются вовсе.
+ *
+ * @param screen - Задний буфер
+ * @param box - Прямоугольник
+ */
+static void compositor_paint(const blit_surface_t* screen, compositor_box_t box) {
+    compositor_box_t pieces[2][COMPOSITOR_MAX_PIECES];
+    size_t current = 0;
+    size_t count = 1;
+
+    pieces[0][0] = box;
+
+    for(size_t i = compositor_window_count; i > 0 && count > 0; i--) {
+        compositor_window_t* entry = compositor_windows[i - 1];
+
+        if(!entry->visible) {
+            continue;
+        }
+
+        window_t* window = &entry->public;
+        compositor_box_t bounds = window_box(window);
+        compositor_box_t* from = pieces[current];
+        compositor_box_t* to = pieces[current ^ 1];
+        size_t kept = 0;
+
+        for(size_t j = 0; j < count; j++) {
+            if(kept + 4 > COMPOSITOR_MAX_PIECES) {
+                // Out of room: this piece is painted bottom to top instead.
+                compositor_paint_overdraw(screen, from[j], i);
+                continue;
+            }
+
+            compositor_box_t hit = box_intersect(from[j], bounds);
+
+            if(box_empty(hit)) {
+                to[kept++] = from[j];
+                continue;
+            }
+
+            compositor_paint_layer(screen, hit, &window->surface, window->x, window->y);
+
+            kept += box_subtract(from[j], bounds, to + kept);
+        }
+
+        current ^= 1;
+        count = kept;
+    }
+
+    for(size_t i = 0; i < count; i++) {
+        compositor_paint_desktop(screen, pieces[current][i]);
+    }
+}
+
+static void compositor_capture_desktop(const blit_surface_t* screen) {
+    kfree(compositor_desktop.pixels);
+
+    compositor_desktop = *screen;
+    compositor_desktop.pixels = kmalloc_common(screen->pitch * screen->height, 16);
+
+    if(compositor_desktop.pixels == NULL) {
+        qemu_err("No memory for the desktop, it is shown black");
+        compositor_desktop = (blit_surface_t){0};
+        return;
+    }
+
+    memcpy(compositor_desktop.pixels, screen->pixels, screen->pitch * screen->height);
+}
+
+static compositor_box_t compositor_cursor_at(compositor_cursor_t shape) {
+    int32_t x = (int32_t)mouse_get_x() - compositor_cursor_hotspot[shape][0];
+    int32_t y = (int32_t)mouse_get_y() - compositor_cursor_hotspot[shape][1];
+
+    return (compositor_box_t){x, y, x + COMPOSITOR_CURSOR_WIDTH, y + COMPOSITOR_CURSOR_HEIGHT};
+}
+
+// Puts back the pixels under the cursor.
+static void compositor_cursor_restore(const blit_surface_t* screen) {
+    if(!cursor_drawn) {
+        return;
+    }
+
+    cursor_drawn = false;
+
+    // After a mode switch there is nothing to put back.
+    if(cursor_under.bpp != screen->bpp || !box_contains(surface_box(screen), cursor_box)) {
+        return;
+    }
+
+    compositor_paint_layer(screen, cursor_box, &cursor_under, cursor_box.x0, cursor_box.y0);
+
+    screen_mark_dirty(cursor_box.x0, cursor_box.y0, cursor_box.x1 - cursor_box.x0, cursor_box.y1 - cursor_box.y0);
+}
+
+static void compositor_cursor_draw(const blit_surface_t* screen, compositor_box_t at, compositor_cursor_t shape) {
+    cursor_drawn = true;
+    cursor_drawn_at = at;
+    cursor_drawn_shape = shape;
+    cursor_box = box_intersect(at, surface_box(screen));
+
+    if(box_empty(cursor_box)) {
+        return;
+    }
+
+    cursor_under = (blit_surface_t){
+        .pixels = cursor_under_pixels,
+        .pitch = COMPOSITOR_CURSOR_WIDTH * (screen->bpp >> 3),
+        .width = COMPOSITOR_CURSOR_WIDTH,
+        .height = COMPOSITOR_CURSOR_HEIGHT,
+        .bpp = screen->bpp,
+    };
+
+    blit_copy_rect(&cursor_under, 0, 0, screen, cursor_box.x0, cursor_box.y0,
+                   cursor_box.x1 - cursor_box.x0, cursor_box.y1 - cursor_box.y0);
+
+    for(int32_t y = cursor_box.y0; y < cursor_box.y1; y++) {
+        blit_blend_span(screen, at.x0, y, compositor_cursor_pixels[shape][y - at.y0], COMPOSITOR_CURSOR_WIDTH);
+    }
+
+    screen_mark_dirty(cursor_box.x0, cursor_box.y0, cursor_box.x1 - cursor_box.x0, cursor_box.y1 - cursor_box.y0);
+}
+
+static void compositor_compose_locked() {
+    blit_surface_t screen;
+
+    screen_back_surface(&screen);
+
+    if(compositor_desktop.pixels != NULL && (compositor_desktop.width != screen.width ||
+                                             compositor_desktop.height != screen.height ||
+                                             compositor_desktop.bpp != screen.bpp)) {
+        // The mode changed, the old desktop no longer fits.
+        cursor_drawn = false;
+        compositor_capture_desktop(&screen);
+        compositor_add_damage(surface_box(&screen));
+    }
+
+    compositor_cursor_t shape = compositor_cursor_shape;
+    compositor_box_t at = compositor_cursor_at(shape);
+
+    // The cursor is redrawn when it moves, or when the damage under it is recomposed.
+    bool cursor_redraw = compositor_cursor_visible
+        ? !cursor_drawn || !box_equal(at, cursor_drawn_at) || shape != cursor_drawn_shape
+        : cursor_drawn;
+
+    for(size_t i = 0; i < compositor_damage_count && !cursor_redraw; i++) {
+        cursor_redraw = cursor_drawn && !box_empty(box_intersect(compositor_damage[i], cursor_box));
+    }
+
+    if(compositor_damage_count == 0 && !cursor_redraw) {
+        return;
+    }
+
+    // The layers under the cursor are composed without it, then it goes on top.
+    if(cursor_redraw) {
+        compositor_cursor_restore(&screen);
+    }
+
+    for(size_t i = 0; i < compositor_damage_count; i++) {
+        compositor_box_t box = compositor_damage[i];
+
+        compositor_paint(&screen, box);
+
+        screen_mark_dirty(box.x0, box.y0, box.x1 - box.x0, box.y1 - box.y0);
+    }
+
+    compositor_damage_count = 0;
+
+    if(cursor_redraw && compositor_cursor_visible) {
+        compositor_cursor_draw(&screen, at, shape);
+    }
+
+    screen_update();
+}
+
+/**
+ * @brief Выводит на экран всё, что изменилось с прошлого раза
+ *
+ * Вызывается потоком композитора каждые COMPOSITOR_FRAME_MS, так что курсор следует за мышью.
+ */
+void compositor_compose() {
+    mutex_get(&compositor_lock);
+    compositor_compose_locked();
+    mutex_release(&compositor_lock);
+}
+
+/**
+ * @brief Останавливает композитор перед сменой режима экрана
+ *
+ * До compositor_resume он не трогает задний буфер, который в это время выделяется заново.
+ */
+void compositor_suspend() {
+    mutex_get(&compositor_lock);
+}
+
+/**
+ * @brief Запускает композитор после смены режима и пересобирает окна в новом буфере
+ */
+void compositor_resume() {
+    blit_surface_t screen;
+
+    screen_back_surface(&screen);
+
+    // The pixels saved under the cursor were in the old buffer, which is gone.
+    cursor_drawn = false;
+
+    if(compositor_window_count > 0) {
+        compositor_add_damage(surface_box(&screen));
+    }
+
+    compositor_compose_locked();
+
+    mutex_release(&compositor_lock);
+}
+
+static void compositor_thread() {
+    while(true) {
+        compositor_compose();
+
+        sleep_ms(COMPOSITOR_FRAME_MS);
+    }
+}
+
+/**
+ * @brief Запускает композитор
+ */
+void compositor_init() {
+    for(size_t shape = 0; shape < COMPOSITOR_CURSOR_SHAPES; shape++) {
+        for(size_t y = 0; y < COMPOSITOR_CURSOR_HEIGHT; y++) {
+            for(size_t x = 0; x < COMPOSITOR_CURSOR_WIDTH; x++) {
+                char c = compositor_cursor_art[shape][y][x];
+
+                compositor_cursor_pixels[shape][y][x] = c == 'X' ? 0xFF000000 : (c == '.' ? 0xFFFFFFFF : 0);
+            }
+        }
+    }
+
+    thread_create(get_current_proc(), compositor_thread, 0x4000, THREAD_KERNEL, NULL, 0);
+}
+
+static ssize_t compositor_find(const window_t* window) {
+    for(size_t i = 0; i < compositor_window_count; i++) {
+        if(&compositor_windows[i]->public == window) {
+            return (ssize_t)i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Создаёт окно поверх остальных
+ *
+ * Окно появляется на экране при первом window_damage или window_present, до этого владелец
+ * успевает нарисовать его содержимое.
+ *
+ * @param x - Левый край
+ * @param y - Верхний край
+ * @param width - Ширина (до COMPOSITOR_MAX_SIDE)
+ * @param height - Высота (до COMPOSITOR_MAX_SIDE)
+ * @return window_t* - Окно, заполненное чёрным, или NULL
+ */
+window_t* window_create(int32_t x, int32_t y, uint32_t width, uint32_t height) {
+    if(width == 0 || height == 0 || width > COMPOSITOR_MAX_SIDE || height > COMPOSITOR_MAX_SIDE) {
+        return NULL;
+    }
+
+    compositor_window_t* entry = kcalloc(1, sizeof(compositor_window_t));
+    uint8_t* pixels = kmalloc_common(width * height * 4, 16);
+
+    if(entry == NULL || pixels == NULL) {
+        kfree(entry);
+        kfree(pixels);
+        return NULL;
+    }
+
+    memset(pixels, 0, width * height * 4);
+
+    entry->public.surface = (blit_surface_t){
+        .pixels = pixels,
+        .pitch = width * 4,
+        .width = width,
+        .height = height,
+        .bpp = 32,
+    };
+    entry->public.x = x;
+    entry->public.y = y;
+
+    mutex_get(&compositor_lock);
+
+    if(compositor_window_count == COMPOSITOR_MAX_WINDOWS) {
+        mutex_release(&compositor_lock);
+
+        kfree(pixels);
+        kfree(entry);
+
+        return NULL;
+    }
+
+    if(compositor_window_count == 0) {
+        blit_surface_t screen;
+
+        screen_back_surface(&screen);
+
+        // Without the cursor, or it would stay in the desktop.
+        compositor_cursor_restore(&screen);
+        compositor_capture_desktop(&screen);
+        compositor_compose_locked();
+    }
+
+    entry->public.id = compositor_next_id++;
+    compositor_windows[compositor_window_count++] = entry;
+
+    mutex_release(&compositor_lock);
+
+    return &entry->public;
+}
+
+/**
+ * @brief Убирает окно с экрана и удаляет его
+ *
+ * @param window - Окно
+ */
+void window_destroy(window_t* window) {
+    mutex_get(&compositor_lock);
+
+    ssize_t index = compositor_find(window);
+
+    if(index < 0) {
+        mutex_release(&compositor_lock);
+        return;
+    }
+
+    compositor_window_t* entry = compositor_windows[index];
+
+    memmove(compositor_windows + index, compositor_windows + index + 1,
+            (compositor_window_count - index - 1) * sizeof(compositor_window_t*));
+    compositor_window_count--;
+
+    if(entry->visible) {
+        compositor_add_damage(window_box(window));
+    }
+
+    compositor_compose_locked();
+
+    // The screen is back to the desktop, further drawing goes straight to it.
+    if(compositor_window_count == 0) {
+        kfree(compositor_desktop.pixels);
+        compositor_desktop = (blit_surface_t){0};
+    }
+
+    mutex_release(&compositor_lock);
+
+    kfree(window->surface.pixels);
+    kfree(entry);
+}
+
+/**
+ * @brief Перемещает окно, пересобирая только открывшиеся места и само окно
+ *
+ * @param window - Окно
+ * @param x - Левый край
+ * @param y - Верхний край
+ */
+void window_move(window_t* window, int32_t x, int32_t y) {
+    mutex_get(&compositor_lock);
+
+    ssize_t index = compositor_find(window);
+
+    if(index < 0 || (window->x == x && window->y == y)) {
+        mutex_release(&compositor_lock);
+        return;
+    }
+
+    compositor_box_t old = window_box(window);
+
+    window->x = x;
+    window->y = y;
+
+    if(compositor_windows[index]->visible) {
+        compositor_box_t exposed[4];
+        size_t count = box_subtract(old, window_box(window), exposed);
+
+        for(size_t i = 0; i < count; i++) {
+            compositor_add_damage(exposed[i]);
+        }
+
+        compositor_add_damage(window_box(window));
+        compositor_compose_locked();
+    }
+
+    mutex_release(&compositor_lock);
+}
+
+/**
+ * @brief Поднимает окно над остальными
+ *
+ * @param window - Окно
+ */
+void window_raise(window_t* window) {
+    mutex_get(&compositor_lock);
+
+    ssize_t index = compositor_find(window);
+
+    if(index < 0 || (size_t)index == compositor_window_count - 1) {
+        mutex_release(&compositor_lock);
+        return;
+    }
+
+    compositor_window_t* entry = compositor_windows[index];
+    compositor_box_t box = window_box(window);
+
+    // Only the parts the windows above it covered change.
+    if(entry->visible) {
+        for(size_t i = index + 1; i < compositor_window_count; i++) {
+            if(compositor_windows[i]->visible) {
+                compositor_add_damage(box_intersect(box, window_box(&compositor_windows[i]->public)));
+            }
+        }
+    }
+
+    memmove(compositor_windows + index, compositor_windows + index + 1,
+            (compositor_window_count - index - 1) * sizeof(compositor_window_t*));
+    compositor_windows[compositor_window_count - 1] = entry;
+
+    compositor_compose_locked();
+
+    mutex_release(&compositor_lock);
+}
+
+/**
+ * @brief Отмечает часть окна изменённой, на экран она попадёт со следующим кадром композитора
+ *
+ * @param window - Окно
+ * @param x - Левый край в окне
+ * @param y - Верхний край в окне
+ * @param width - Ширина
+ * @param height - Высота
+ */
+void window_damage(window_t* window, int32_t x, int32_t y, uint32_t width, uint32_t height) {
+    mutex_get(&compositor_lock);
+
+    ssize_t index = compositor_find(window);
+
+    if(index < 0) {
+        mutex_release(&compositor_lock);
+        return;
+    }
+
+    compositor_box_t bounds = window_box(window);
+
+    if(!compositor_windows[index]->visible) {
+        compositor_windows[index]->visible = true;
+        compositor_add_damage(bounds);
+    } else {
+        int32_t x0 = window->x + x;
+        int32_t y0 = window->y + y;
+
+        compositor_box_t box = {
+            x0,
+            y0,
+            x0 + (int32_t)MIN(width, window->surface.width),
+            y0 + (int32_t)MIN(height, window->surface.height)
+        };
+
+        compositor_add_damage(box_intersect(box, bounds));
+    }
+
+    mutex_release(&compositor_lock);
+}
+
+/**
+ * @brief Сразу выводит окно на экран целиком
+ *
+ * @param window - Окно
+ */
+void window_present(window_t* window) {
+    mutex_get(&compositor_lock);
+
+    ssize_t index = compositor_find(window);
+
+    if(index >= 0) {
+        compositor_windows[index]->visible = true;
+        compositor_add_damage(window_box(window));
+        compositor_compose_locked();
+    }
+
+    mutex_release(&compositor_lock);
+}
+
+/**
+ * @brief Показывает или прячет курсор мыши
+ *
+ * Курсор рисуется поверх всего, и под ним сохраняется то, что он закрыл. Рисование прямо в
+ * задний буфер под курсором (TTY) при его перемещении затрётся.
+ *
+ * @param show - Показать
+ */
+void compositor_show_cursor(bool show) {
+    mutex_get(&compositor_lock);
+
+    compositor_cursor_visible = show;
+    compositor_compose_locked();
+
+    mutex_release(&compositor_lock);
+}
+
+bool compositor_cursor_shown() {
+    return compositor_cursor_visible;
+}
+
+/**
+ * @brief Меняет вид курсора мыши
+ *
+ * @param shape - Вид курсора
+ */
+void compositor_set_cursor(compositor_cursor_t shape) {
+    if(shape >= COMPOSITOR_CURSOR_SHAPES) {
+        return;
+    }
+
+    compositor_cursor_shape = shape;
+}
@@ -5,12 +5,16 @@
 #include <common.h>
 #include "mem/pmm.h"
 #include "mem/vmm.h"
+#include "lib/math.h"
 
 #ifdef NOCTURNE_X86
 #include "arch/x86/mtrr.h"
+#include "arch/x86/pat.h"
+#include "gfx/bochs.h"
 #endif
 
 #include "sys/sync.h"
+#include "gui/compositor.h"
 
 uint8_t *framebuffer_addr = 0;			/// Указатель на кадровый буфер экрана
 volatile size_t framebuffer_pitch;				/// Частота обновления экрана
@@ -20,8 +24,22 @@ volatile size_t framebuffer_height;			/// Высота экрана
 volatile size_t framebuffer_size;				/// Кол-во пикселей
 uint8_t *back_framebuffer_addr = 0;		/// Позиция буфера экрана
 
-size_t fb_mtrr_idx = 0;
-size_t bfb_mtrr_idx = 0;
+size_t fb_mtrr_idx = 0xffffffff;
+
+screen_span_t* screen_damage = 0;       /// Изменённые части строк заднего буфера, по одной на строку
+uint32_t screen_damage_top = SCREEN_DAMAGE_NONE; /// Первая изменённая строка
+uint32_t screen_damage_bottom = 0;      /// Строка после последней изменённой
+
+static uint64_t screen_flushed = 0;     /// Сколько байт скопировано на экран за всё время
+
+static bool screen_flipping = false;    /// Кадры показываются сменой страниц видеопамяти
+static uint8_t* screen_pages[2];        /// Две страницы видеопамяти друг под другом
+static size_t screen_front_page = 0;    /// Видимая страница
+static screen_span_t* screen_flip_stale = 0;    /// Изменения прошлого кадра, которых нет в скрытой странице
+static uint32_t screen_flip_stale_top = SCREEN_DAMAGE_NONE;
+static uint32_t screen_flip_stale_bottom = 0;
+
+mutex_t graphics_flush_mutex = { .lock = false };
 
 /**
  * @brief Получение адреса расположения драйвера экрана
@@ -54,6 +72,64 @@ uint32_t getDisplayBpp(){
     return framebuffer_bpp;
 }
 
+/**
+ * @brief Выделяет учёт изменений под текущую высоту экрана и отмечает весь экран изменённым
+ */
+static void screen_damage_alloc() {
+    screen_span_t* old = screen_damage;
+
+    // Drawing in between must not touch the old array sized for another height.
+    screen_damage = NULL;
+    kfree(old);
+
+    screen_span_t* spans = kcalloc(framebuffer_height, sizeof(screen_span_t));
+
+    if(spans == NULL) {
+        qemu_warn("No memory for screen damage tracking, flushing whole frames");
+        return;
+    }
+
+    screen_damage = spans;
+    screen_mark_all_dirty();
+}
+
+/**
+ * @brief Флаги отображения видеопамяти: объединение записи через PAT, если он есть
+ *
+ * @return uint32_t - Флаги страниц
+ */
+static uint32_t screen_vram_flags() {
+#ifdef NOCTURNE_X86
+    return PAGE_WRITEABLE | pat_write_combining_flags();
+#else
+    return PAGE_WRITEABLE | PAGE_CACHE_DISABLE;
+#endif
+}
+
+/**
+ * @brief Ставит MTRR с объединением записи на видеопамять, когда PAT недоступен
+ */
+static void screen_vram_mtrr() {
+#ifdef NOCTURNE_X86
+    if(pat_wc_available) {
+        return;
+    }
+
+    if(fb_mtrr_idx == 0xffffffff) {
+        fb_mtrr_idx = find_free_mtrr();
+    }
+
+    // Variable MTRRs only cover power of two sizes.
+    size_t size = PAGE_SIZE;
+
+    while(size < framebuffer_size) {
+        size <<= 1;
+    }
+
+    write_mtrr_size(fb_mtrr_idx, (uint32_t)(size_t)framebuffer_addr, size, 1);
+#endif
+}
+
 void create_back_framebuffer() {
     // back_framebuffer_addr = framebuffer_addr;
 
@@ -66,19 +142,12 @@ void create_back_framebuffer() {
 
     qemu_ok("^---- Ready!");
 
-    size_t phys_bfb = virt2phys(get_kernel_page_directory(), (virtual_addr_t) back_framebuffer_addr);
-
-    qemu_log("Physical is: %x", phys_bfb);
-
-    #ifdef NOCTURNE_ARCH_X86
-	bfb_mtrr_idx = find_free_mtrr();
-    write_mtrr_size(bfb_mtrr_idx, phys_bfb, framebuffer_size, 1);
-
-	phys_set_flags(get_kernel_page_directory(), (virtual_addr_t)back_framebuffer_addr, PAGE_WRITEABLE | PAGE_CACHE_DISABLE);
-    #endif
-	
+    // The back buffer is ordinary write-back RAM: drawing reads it back (getPixel, blending),
+    // and only the flush to video memory needs write combining.
     qemu_log("framebuffer_size = %d (%dK) (%dM)", framebuffer_size, framebuffer_size/1024, framebuffer_size/(1024*1024));
     qemu_log("back_framebuffer_addr = %p", back_framebuffer_addr);
+
+    screen_damage_alloc();
 }
 
 /**
@@ -111,7 +180,7 @@ void init_vbe(const multiboot_header_t *mboot) {
 			  frame,
 			  virt,
 			  framebuffer_size,
-			  PAGE_WRITEABLE | PAGE_CACHE_DISABLE);
+			  screen_vram_flags());
 
     qemu_log("Okay mapping!");
 
@@ -119,11 +188,7 @@ void init_vbe(const multiboot_header_t *mboot) {
 
     qemu_log("Created back framebuffer");
 
-    #ifdef NOCTURNE_ARCH_X86
-	fb_mtrr_idx = find_free_mtrr();
-
-    write_mtrr_size(fb_mtrr_idx, frame, framebuffer_size, 1);
-    #endif
+    screen_vram_mtrr();
 }
 
 /**
@@ -176,89 +241,559 @@ uint32_t getScreenHeight(){
     return framebuffer_height;
 }
 
-void graphics_update(uint32_t new_width, uint32_t new_height, uint32_t new_pitch) {
+/**
+ * @brief Перестраивает буферы экрана после смены режима
+ *
+ * @param new_address - Физический адрес видеопамяти (отображается по тому же адресу)
+ * @param new_width - Ширина
+ * @param new_height - Высота
+ * @param new_pitch - Байт на строку
+ * @param new_bpp - Бит на пиксель
+ */
+void graphics_update(size_t new_address, uint32_t new_width, uint32_t new_height, uint32_t new_pitch, uint32_t new_bpp) {
+    mutex_get(&graphics_flush_mutex);
+
+#ifdef NOCTURNE_X86
+    // The new mode starts out copying frames, from the first page.
+    if(screen_flipping) {
+        unmap_pages_overlapping(get_kernel_page_directory(), (virtual_addr_t)screen_pages[1], framebuffer_size);
+
+        screen_flipping = false;
+        framebuffer_addr = screen_pages[0];
+
+        kfree(screen_flip_stale);
+        screen_flip_stale = NULL;
+
+        bochs_dispi_set_y_offset(0);
+    }
+#endif
+
     unmap_pages_overlapping(get_kernel_page_directory(), (virtual_addr_t)framebuffer_addr, framebuffer_size);
 
+    framebuffer_addr = (uint8_t*)new_address;
     framebuffer_width = new_width;
     framebuffer_height = new_height;
     framebuffer_pitch = new_pitch;
-    framebuffer_bpp = (new_pitch / new_width) << 3;
+    framebuffer_bpp = new_bpp;
 
-    framebuffer_size = ALIGN((new_width + 32) * new_height * 4, PAGE_SIZE);
+    framebuffer_size = new_height * new_pitch;
 
     map_pages(get_kernel_page_directory(),
               (physical_addr_t)framebuffer_addr,
               (virtual_addr_t)framebuffer_addr,
               framebuffer_size,
-              PAGE_WRITEABLE | PAGE_CACHE_DISABLE
+              screen_vram_flags()
     );
 
+    kfree(back_framebuffer_addr);
+    back_framebuffer_addr = kmalloc_common(framebuffer_size, PAGE_SIZE);
+    memset(back_framebuffer_addr, 0, framebuffer_size);
 
-    //back_framebuffer_addr = krealloc(back_framebuffer_addr, framebuffer_size);
-    //memset(back_framebuffer_addr, 0x00, framebuffer_size);
-   kfree(back_framebuffer_addr);
-  back_framebuffer_addr = kmalloc_common(framebuffer_size, PAGE_SIZE);
-  memset(back_framebuffer_addr, 0, framebuffer_size);
+    screen_vram_mtrr();
 
-  #ifdef NOCTURNE_ARCH_X86
-	phys_set_flags(get_kernel_page_directory(), (virtual_addr_t)back_framebuffer_addr, PAGE_WRITEABLE | PAGE_CACHE_DISABLE);
+    screen_damage_alloc();
 
-    uint32_t bfb_new_phys = virt2phys(get_kernel_page_directory(), (virtual_addr_t)back_framebuffer_addr);
+    mutex_release(&graphics_flush_mutex);
+}
 
-    write_mtrr_size(fb_mtrr_idx, (uint32_t)framebuffer_addr, framebuffer_size, 1);
-    write_mtrr_size(bfb_mtrr_idx, (uint32_t)bfb_new_phys, framebuffer_size, 1);
-    #endif
+/**
+ * @brief Количество режимов, в которые можно переключить экран
+ *
+ * @return size_t - Количество, 0 без драйвера, умеющего менять режим
+ */
+size_t screen_mode_count() {
+#ifdef NOCTURNE_X86
+    return bochs_mode_count();
+#else
+    return 0;
+#endif
 }
 
+/**
+ * @brief Режим из списка доступных
+ *
+ * @param index - Номер режима
+ * @param out - Куда записать режим
+ * @return true - если такой номер есть
+ */
+bool screen_mode_get(size_t index, screen_mode_t* out) {
 #ifdef NOCTURNE_X86
-    #ifdef __SSE2__
-        #include <emmintrin.h>
-    #endif
+    return bochs_mode_get(index, out);
+#else
+    (void)index;
+    (void)out;
+    return false;
 #endif
+}
 
 /**
- * @brief Очистка экрана
+ * @brief Переключает режим экрана
+ *
+ * Задний буфер выделяется заново и очищается, так что всё на экране нужно перерисовать.
+ * Композитор на это время останавливается и потом пересобирает окна сам.
  *
+ * @param width - Ширина
+ * @param height - Высота
+ * @param bpp - Бит на пиксель
+ * @return true - если режим включён
  */
-__attribute__((force_align_arg_pointer)) void clean_screen() {
-// #ifdef __SSE2__
-#if 0
-  if((size_t)back_framebuffer_addr % 16 == 0) {
-    __m128i* buffer = (__m128i*)back_framebuffer_addr;
+bool screen_set_mode(uint32_t width, uint32_t height, uint32_t bpp) {
+#ifdef NOCTURNE_X86
+    compositor_suspend();
 
-    for(size_t index = 0, chunks = framebuffer_size / sizeof(__m128i); index < chunks; index ++) {
-        _mm_store_si128(buffer, _mm_setzero_si128());
+    bool ok = bochs_set_mode(width, height, bpp);
 
-        buffer++;
-    }
-  } else {
-    memset(back_framebuffer_addr, 0, framebuffer_size);
-  }
+    compositor_resume();
+
+    return ok;
 #else
-    //memset(back_framebuffer_addr, 0, framebuffer_size);
-    __builtin_memset(back_framebuffer_addr, 0, framebuffer_size);
+    (void)width;
+    (void)height;
+    (void)bpp;
+    return false;
 #endif
 }
 
-mutex_t graphics_flush_mutex = { .lock = false };
+/**
+ * @brief Отмечает прямоугольник заднего буфера изменённым
+ *
+ * @param x - Левый край
+ * @param y - Верхний край
+ * @param width - Ширина
+ * @param height - Высота
+ */
+void screen_mark_dirty(int x, int y, int width, int height) {
+    if(screen_damage == NULL || width <= 0 || height <= 0) {
+        return;
+    }
+
+    int32_t x0 = MAX(x, 0);
+    int32_t y0 = MAX(y, 0);
+    int32_t x1 = MIN(x + width, (int32_t)framebuffer_width);
+    int32_t y1 = MIN(y + height, (int32_t)framebuffer_height);
+
+    if(x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    for(int32_t row = y0; row < y1; row++) {
+        screen_span_t* span = screen_damage + row;
+
+        if((uint32_t)x0 < span->x0) {
+            span->x0 = x0;
+        }
+
+        if((uint32_t)x1 > span->x1) {
+            span->x1 = x1;
+        }
+    }
+
+    if((uint32_t)y0 < screen_damage_top) {
+        screen_damage_top = y0;
+    }
+
+    if((uint32_t)y1 > screen_damage_bottom) {
+        screen_damage_bottom = y1;
+    }
+}
+
+/**
+ * @brief Отмечает весь задний буфер изменённым (после записи в него в обход примитивов)
+ */
+void screen_mark_all_dirty() {
+    screen_mark_dirty(0, 0, framebuffer_width, framebuffer_height);
+}
+
+/**
+ * @brief Сколько байт скопировано из заднего буфера на экран с загрузки
+ *
+ * @return uint64_t - Количество байт
+ */
+uint64_t screen_flushed_bytes() {
+    return screen_flushed;
+}
+
+/**
+ * @brief Описание заднего буфера для функций lib/blit
+ *
+ * @param out - Куда записать описание
+ */
+void screen_back_surface(blit_surface_t* out) {
+    out->pixels = back_framebuffer_addr;
+    out->pitch = framebuffer_pitch;
+    out->width = framebuffer_width;
+    out->height = framebuffer_height;
+    out->bpp = framebuffer_bpp;
+}
+
+/**
+ * @brief Заливает прямоугольник заднего буфера
+ *
+ * @param x - Левый край
+ * @param y - Верхний край
+ * @param width - Ширина
+ * @param height - Высота
+ * @param color - Цвет
+ */
+void screen_fill_rect(int x, int y, int width, int height, uint32_t color) {
+    blit_surface_t surface;
+
+    screen_back_surface(&surface);
+    blit_fill_rect(&surface, x, y, width, height, color);
+
+    screen_mark_dirty(x, y, width, height);
+}
+
+/**
+ * @brief Переносит прямоугольник внутри заднего буфера (прокрутка)
+ *
+ * @param dst_x - Новый левый край
+ * @param dst_y - Новый верхний край
+ * @param src_x - Старый левый край
+ * @param src_y - Старый верхний край
+ * @param width - Ширина
+ * @param height - Высота
+ */
+void screen_copy_rect(int dst_x, int dst_y, int src_x, int src_y, int width, int height) {
+    blit_surface_t surface;
+
+    screen_back_surface(&surface);
+    blit_copy_rect(&surface, dst_x, dst_y, &surface, src_x, src_y, width, height);
+
+    screen_mark_dirty(dst_x, dst_y, width, height);
+}
+
+/**
+ * @brief Накладывает отрезок пикселей с альфой на задний буфер
+ *
+ * @param x - Начало
+ * @param y - Строка
+ * @param argb - Пиксели 0xAARRGGBB
+ * @param length - Количество пикселей
+ */
+void screen_blend_span(int x, int y, const uint32_t* argb, int length) {
+    blit_surface_t surface;
 
-__attribute__((force_align_arg_pointer)) void screen_update() {
-// #ifdef __SSE2__
+    screen_back_surface(&surface);
+    blit_blend_span(&surface, x, y, argb, length);
+
+    screen_mark_dirty(x, y, length, 1);
+}
+
+/**
+ * @brief Рисует картинку 0x00RRGGBB в задний буфер, преобразуя её в формат экрана
+ *
+ * @param x - Левый край
+ * @param y - Верхний край
+ * @param width - Ширина картинки
+ * @param height - Высота картинки
+ * @param pixels - Пиксели построчно, без промежутков между строками
+ */
+void screen_draw_image(int x, int y, int width, int height, const uint32_t* pixels) {
+    if(width <= 0 || height <= 0) {
+        return;
+    }
+
+    blit_surface_t surface;
+    blit_surface_t image = {
+        .pixels = (uint8_t*)pixels,
+        .pitch = width * 4,
+        .width = width,
+        .height = height,
+        .bpp = 32,
+    };
+
+    screen_back_surface(&surface);
+    blit_copy_rect(&surface, x, y, &image, 0, 0, width, height);
+
+    screen_mark_dirty(x, y, width, height);
+}
+
+/**
+ * @brief Очистка экрана
+ *
+ */
+void clean_screen() {
+    // Padding at the end of rows is cleared too, so the whole buffer is one span.
+    blit_ops->fill32((uint32_t*)back_framebuffer_addr, 0, framebuffer_size / 4);
+
+    screen_mark_all_dirty();
+}
+
+/**
+ * Copies the damaged span of every dirty row from `from` to `to`. Runs of whole rows go out as
+ * one copy together with the pitch padding between them. Each row is marked clean before it is
+ * copied, so drawing that happens meanwhile lands in the next flush instead of being lost.
+ */
+static void screen_flush_damage(uint8_t* to, const uint8_t* from) {
+    uint32_t top = screen_damage_top;
+    uint32_t bottom = MIN(screen_damage_bottom, (uint32_t)framebuffer_height);
+    size_t bytes_pp = framebuffer_bpp >> 3;
+
+    screen_damage_top = SCREEN_DAMAGE_NONE;
+    screen_damage_bottom = 0;
+
+    for(uint32_t row = top; row < bottom;) {
+        screen_span_t* span = screen_damage + row;
+        uint32_t x0 = span->x0;
+        uint32_t x1 = MIN(span->x1, (uint32_t)framebuffer_width);
+
+        span->x0 = SCREEN_DAMAGE_NONE;
+        span->x1 = 0;
+
+        if(x0 >= x1) {
+            row++;
+            continue;
+        }
+
+        size_t offset = row * framebuffer_pitch + x0 * bytes_pp;
+        size_t length = (x1 - x0) * bytes_pp;
+
+        row++;
+
+        if(x0 == 0 && x1 == framebuffer_width) {
+            while(row < bottom && screen_damage[row].x0 == 0 && screen_damage[row].x1 >= framebuffer_width) {
+                screen_damage[row].x0 = SCREEN_DAMAGE_NONE;
+                screen_damage[row].x1 = 0;
+
+                length += framebuffer_pitch;
+                row++;
+            }
+        }
+
+        blit_ops->copy(to + offset, from + offset, length);
+        screen_flushed += length;
+    }
+}
+
+#ifdef NOCTURNE_X86
+/**
+ * Copies the frame from the back buffer in RAM to the hidden page. The hidden page was last
+ * written two frames ago, so it gets the previous frame's damage as well as the current one,
+ * and the current damage becomes the previous one. VRAM is only written, never read.
+ */
+static void screen_flush_flip(uint8_t* to) {
+    uint32_t damage_top = screen_damage_top;
+    uint32_t damage_bottom = MIN(screen_damage_bottom, (uint32_t)framebuffer_height);
+    uint32_t top = MIN(damage_top, screen_flip_stale_top);
+    uint32_t bottom = MAX(damage_bottom, screen_flip_stale_bottom);
+    size_t bytes_pp = framebuffer_bpp >> 3;
+
+    screen_damage_top = SCREEN_DAMAGE_NONE;
+    screen_damage_bottom = 0;
+    screen_flip_stale_top = damage_top;
+    screen_flip_stale_bottom = damage_bottom;
+
+    for(uint32_t row = top; row < bottom; row++) {
+        screen_span_t* span = screen_damage + row;
+        screen_span_t* stale = screen_flip_stale + row;
+        uint32_t x0 = MIN(span->x0, stale->x0);
+        uint32_t x1 = MIN(MAX(span->x1, stale->x1), (uint32_t)framebuffer_width);
+
+        *stale = *span;
+
+        span->x0 = SCREEN_DAMAGE_NONE;
+        span->x1 = 0;
+
+        if(x0 >= x1) {
+            continue;
+        }
+
+        size_t offset = row * framebuffer_pitch + x0 * bytes_pp;
+        size_t length = (x1 - x0) * bytes_pp;
+
+        blit_ops->copy(to + offset, back_framebuffer_addr + offset, length);
+        screen_flushed += length;
+    }
+}
+
+/**
+ * Fills the hidden page from the back buffer and shows it at the next vertical retrace.
+ * Only switching the pages runs with interrupts off.
+ */
+static void screen_flip() {
+    uint8_t* hidden = screen_pages[screen_front_page ^ 1];
+
+    if(screen_damage == NULL) {
+        blit_ops->copy(hidden, back_framebuffer_addr, framebuffer_size);
+        screen_flushed += framebuffer_size;
+    } else {
+        screen_flush_flip(hidden);
+    }
+
+    bochs_wait_vsync();
+
+    size_t flags = irq_save();
+
+    screen_front_page ^= 1;
+    framebuffer_addr = screen_pages[screen_front_page];
+
+    bochs_dispi_set_y_offset(screen_front_page * framebuffer_height);
+
+    irq_restore(flags);
+}
+#endif
+
+void screen_update() {
     mutex_get(&graphics_flush_mutex);
-#if 0
-    if((size_t)back_framebuffer_addr % 16 == 0) {
-        __m128i* src_buffer = (__m128i*)back_framebuffer_addr;
-        __m128i* dest_buffer = (__m128i*)framebuffer_addr;
 
-        for(size_t index = 0, chunks = framebuffer_size / sizeof(__m128i); index < chunks; index ++) {
-            _mm_store_si128(dest_buffer++, _mm_load_si128(src_buffer++));
+#ifdef NOCTURNE_X86
+    if(screen_flipping) {
+        // Nothing changed, nothing to show.
+        if(screen_damage == NULL || screen_damage_top != SCREEN_DAMAGE_NONE) {
+            screen_flip();
         }
+
+        mutex_release(&graphics_flush_mutex);
+        return;
+    }
+#endif
+
+    if(screen_damage == NULL) {
+        blit_ops->copy(framebuffer_addr, back_framebuffer_addr, framebuffer_size);
+        screen_flushed += framebuffer_size;
     } else {
-        memcpy(framebuffer_addr, back_framebuffer_addr, framebuffer_size);
+        screen_flush_damage(framebuffer_addr, back_framebuffer_addr);
     }
+
+    mutex_release(&graphics_flush_mutex);
+}
+
+/**
+ * @brief Включена ли смена страниц вместо копирования на экран
+ *
+ * @return true - если кадры показываются сменой страниц
+ */
+bool screen_page_flipping() {
+    return screen_flipping;
+}
+
+/**
+ * @brief Переключает вывод на экран между сменой страниц видеопамяти и копированием
+ *
+ * Смена страниц работает на адаптере Bochs/QEMU (dispi), когда режим выставлен через него и
+ * видеопамяти хватает на две страницы. Рисование по-прежнему идёт в задний буфер в ОЗУ, а
+ * screen_update копирует изменения в скрытую страницу под видимой и показывает её во время
+ * обратного хода луча.
+ *
+ * @param enable - true, чтобы включить
+ * @return true - если режим теперь такой, как просили
+ */
+bool screen_set_page_flipping(bool enable) {
+#ifdef NOCTURNE_X86
+    if(enable == screen_flipping) {
+        return true;
+    }
+
+    size_t page_size = framebuffer_height * framebuffer_pitch;
+
+    mutex_get(&graphics_flush_mutex);
+
+    if(!enable) {
+        screen_flipping = false;
+        framebuffer_addr = screen_pages[0];
+
+        kfree(screen_flip_stale);
+        screen_flip_stale = NULL;
+
+        bochs_dispi_set_y_offset(0);
+
+        mutex_release(&graphics_flush_mutex);
+
+        screen_mark_all_dirty();
+        screen_update();
+
+        return true;
+    }
+
+    if(!bochs_dispi_drives_mode(framebuffer_width, framebuffer_height, framebuffer_bpp, framebuffer_pitch)
+       || bochs_dispi_set_virtual_height(framebuffer_height * 2) < framebuffer_height * 2) {
+        mutex_release(&graphics_flush_mutex);
+
+        qemu_warn("Page flipping is not available, copying frames to the screen");
+        return false;
+    }
+
+    screen_flip_stale = kcalloc(framebuffer_height, sizeof(screen_span_t));
+
+    if(screen_flip_stale == NULL) {
+        mutex_release(&graphics_flush_mutex);
+        return false;
+    }
+
+    for(size_t row = 0; row < framebuffer_height; row++) {
+        screen_flip_stale[row].x0 = SCREEN_DAMAGE_NONE;
+    }
+
+    screen_flip_stale_top = SCREEN_DAMAGE_NONE;
+    screen_flip_stale_bottom = 0;
+
+    screen_pages[0] = framebuffer_addr;
+    screen_pages[1] = framebuffer_addr + page_size;
+
+    map_pages(get_kernel_page_directory(),
+              (physical_addr_t)screen_pages[1],
+              (virtual_addr_t)screen_pages[1],
+              page_size,
+              screen_vram_flags());
+
+    // Both pages start with the current picture.
+    memcpy(screen_pages[0], back_framebuffer_addr, page_size);
+    memcpy(screen_pages[1], back_framebuffer_addr, page_size);
+
+    screen_front_page = 0;
+    screen_flipping = true;
+
+    bochs_dispi_set_y_offset(0);
+
+    mutex_release(&graphics_flush_mutex);
+
+    qemu_ok("Page flipping enabled: pages at %p and %p", screen_pages[0], screen_pages[1]);
+
+    return true;
 #else
-    memcpy(framebuffer_addr, back_framebuffer_addr, framebuffer_size);
-    // __builtin_memcpy(framebuffer_addr, back_framebuffer_addr, framebuffer_size);
+    return !enable;
 #endif
+}
+
+/**
+ * @brief Немедленно копирует прямоугольник заднего буфера на экран
+ *
+ * Отметки изменений не трогает: прямоугольник скопируется ещё раз при следующем screen_update, если был отмечен.
+ *
+ * @param x - Левый край
+ * @param y - Верхний край
+ * @param width - Ширина
+ * @param height - Высота
+ */
+void rect_copy(int x, int y, int width, int height) {
+    int32_t x0 = MAX(x, 0);
+    int32_t y0 = MAX(y, 0);
+    int32_t x1 = MIN(x + width, (int32_t)framebuffer_width);
+    int32_t y1 = MIN(y + height, (int32_t)framebuffer_height);
+
+    if(x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    if(screen_flipping) {
+        // The back page can only be shown whole.
+        screen_mark_dirty(x0, y0, x1 - x0, y1 - y0);
+        screen_update();
+        return;
+    }
+
+    size_t bytes_pp = framebuffer_bpp >> 3;
+
+    mutex_get(&graphics_flush_mutex);
+
+    for(int32_t row = y0; row < y1; row++) {
+        size_t offset = row * framebuffer_pitch + x0 * bytes_pp;
+
+        blit_ops->copy(framebuffer_addr + offset, back_framebuffer_addr + offset, (x1 - x0) * bytes_pp);
+    }
+
+    screen_flushed += (size_t)(y1 - y0) * (x1 - x0) * bytes_pp;
+
     mutex_release(&graphics_flush_mutex);
 }
@@ -0,0 +1,295 @@
+/**
+ * @file io/surface.c
+ * @brief Поверхности программ: буферы пикселей в общей с ядром памяти
+ * @date 2026-10-19
+ * @copyright Copyright SayoriOS Team (c) 2022-2026
+ */
+
+#include "io/surface.h"
+#include "io/screen.h"
+#include "io/logging.h"
+#include "lib/idtable.h"
+#include "lib/math.h"
+#include "lib/string.h"
+#include "mem/pmm.h"
+#include "mem/vmm.h"
+#include "sys/sync.h"
+#include "sys/scheduler/process.h"
+#include "sys/scheduler/scheduler.h"
+
+static idtable_t surface_table = {0};
+static mutex_t surface_table_lock = {false};
+
+// Held across whole operations (copies included), so waiters yield instead of spinning.
+static void surface_table_lock_acquire() {
+    while(__atomic_test_and_set(&surface_table_lock.lock, __ATOMIC_ACQUIRE)) {
+        yield();
+    }
+}
+
+void surfaces_init() {
+    idtable_init(&surface_table, SURFACE_TABLE_BITS);
+}
+
+// Table IDs start at 0, which is taken by the screen.
+static surface_t* surface_lookup(size_t id) {
+    if(id == SURFACE_SCREEN) {
+        return NULL;
+    }
+
+    return idtable_get(&surface_table, id - 1);
+}
+
+static void surface_free(surface_t* surface) {
+    phys_free_multi_pages(surface->physical, surface->pages);
+    kfree(surface);
+}
+
+/**
+ * @brief Создаёт поверхность текущего процесса и отображает её в его адресное пространство
+ *
+ * @param width - Ширина (до SURFACE_MAX_SIDE)
+ * @param height - Высота (до SURFACE_MAX_SIDE)
+ * @param address - Адрес у процесса, выровненный по странице; страницы должны быть свободны
+ * @return ssize_t - ID поверхности или -1
+ */
+ssize_t surface_create(uint32_t width, uint32_t height, size_t address) {
+    if(width == 0 || height == 0 || width > SURFACE_MAX_SIDE || height > SURFACE_MAX_SIDE) {
+        return -1;
+    }
+
+    if(address == 0 || (address & (PAGE_SIZE - 1)) != 0) {
+        return -1;
+    }
+
+    process_t* process = get_current_proc();
+    page_directory_t* page_dir = (page_directory_t*)process->page_dir_virt;
+
+    size_t pitch = width * 4;
+    size_t pages = ALIGN(pitch * height, PAGE_SIZE) / PAGE_SIZE;
+
+    if(address + pages * PAGE_SIZE < address) {
+        return -1;
+    }
+
+    // Two threads of the process must not both find the same range free.
+    surface_table_lock_acquire();
+
+    for(size_t i = 0; i < pages; i++) {
+        if(virt2phys(page_dir, address + i * PAGE_SIZE) != 0) {
+            mutex_release(&surface_table_lock);
+
+            qemu_err("Surface at %x would overlap mapped memory", address);
+            return -1;
+        }
+    }
+
+    surface_t* surface = kcalloc(1, sizeof(surface_t));
+
+    if(surface == NULL) {
+        mutex_release(&surface_table_lock);
+        return -1;
+    }
+
+    surface->physical = phys_alloc_multi_pages(pages);
+
+    if(surface->physical == 0) {
+        mutex_release(&surface_table_lock);
+
+        kfree(surface);
+        return -1;
+    }
+
+    surface->owner = process->pid;
+    surface->pages = pages;
+    surface->pixels = (blit_surface_t){
+        .pixels = (uint8_t*)address,
+        .pitch = pitch,
+        .width = width,
+        .height = height,
+        .bpp = 32,
+    };
+
+    size_t id = idtable_alloc(&surface_table, surface);
+
+    if(id == IDTABLE_INVALID_ID) {
+        mutex_release(&surface_table_lock);
+
+        surface_free(surface);
+        return -1;
+    }
+
+    surface->id = id + 1;
+
+    map_pages(page_dir, surface->physical, address, pages * PAGE_SIZE, PAGE_USER | PAGE_WRITEABLE);
+    memset((void*)address, 0, pages * PAGE_SIZE);
+
+    mutex_release(&surface_table_lock);
+
+    qemu_log("Surface #%d: %dx%d at %x for PID %d", surface->id, width, height, address, surface->owner);
+
+    return (ssize_t)surface->id;
+}
+
+/**
+ * @brief Поверхность текущего процесса. Если она нашлась, таблица поверхностей остаётся
+ *        заблокированной, и поверхность нельзя удалить до вызова `surface_put`
+ *
+ * @param id - ID поверхности
+ * @return surface_t* - Поверхность или NULL, если её нет или она чужая
+ */
+surface_t* surface_get(size_t id) {
+    surface_table_lock_acquire();
+
+    surface_t* surface = surface_lookup(id);
+
+    if(surface == NULL || surface->owner != get_current_proc()->pid) {
+        mutex_release(&surface_table_lock);
+        return NULL;
+    }
+
+    return surface;
+}
+
+/**
+ * @brief Отпускает поверхность, полученную через `surface_get`
+ *
+ * @param surface - Поверхность
+ */
+void surface_put(surface_t* surface) {
+    (void)surface;
+
+    mutex_release(&surface_table_lock);
+}
+
+/**
+ * @brief Удаляет поверхность текущего процесса и убирает её из его адресного пространства
+ *
+ * @param id - ID поверхности
+ * @return true - если поверхность была
+ */
+bool surface_destroy(size_t id) {
+    process_t* process = get_current_proc();
+
+    surface_table_lock_acquire();
+
+    surface_t* surface = surface_lookup(id);
+
+    if(surface == NULL || surface->owner != process->pid) {
+        mutex_release(&surface_table_lock);
+        return false;
+    }
+
+    idtable_remove(&surface_table, id - 1);
+
+    mutex_release(&surface_table_lock);
+
+    unmap_pages_overlapping((page_directory_t*)process->page_dir_virt,
+                            (size_t)surface->pixels.pixels, surface->pages * PAGE_SIZE);
+
+    surface_free(surface);
+
+    return true;
+}
+
+/**
+ * @brief Освобождает поверхности завершившегося процесса
+ *
+ * Каталог страниц процесса удаляется следом, поэтому страницы из него не убираются.
+ *
+ * @param pid - PID процесса
+ */
+void surface_destroy_process(size_t pid) {
+    surface_table_lock_acquire();
+
+    for(size_t slot = 0; slot < surface_table.capacity; slot++) {
+        surface_t* surface = surface_table.objects[slot];
+
+        if(surface == NULL || surface->owner != pid) {
+            continue;
+        }
+
+        idtable_remove(&surface_table, surface->id - 1);
+        surface_free(surface);
+    }
+
+    mutex_release(&surface_table_lock);
+}
+
+/**
+ * @brief Задаёт положение поверхности на экране
+ *
+ * @param id - ID поверхности
+ * @param x - Левый край
+ * @param y - Верхний край
+ * @return true - если поверхность есть
+ */
+bool surface_move(size_t id, int32_t x, int32_t y) {
+    surface_t* surface = surface_get(id);
+
+    if(surface == NULL) {
+        return false;
+    }
+
+    surface->x = x;
+    surface->y = y;
+
+    surface_put(surface);
+
+    return true;
+}
+
+/**
+ * @brief Выводит изменённые прямоугольники поверхности на экран
+ *
+ * Каждый прямоугольник копируется один раз, сразу в задний буфер в формате экрана,
+ * а на экран уходят только они.
+ *
+ * @param id - ID поверхности
+ * @param rects - Прямоугольники или NULL, чтобы вывести поверхность целиком
+ * @param count - Количество прямоугольников
+ * @return true - если поверхность есть
+ */
+bool surface_present(size_t id, const surface_rect_t* rects, size_t count) {
+    surface_t* surface = surface_get(id);
+
+    if(surface == NULL) {
+        return false;
+    }
+
+    surface_rect_t whole = {0, 0, surface->pixels.width, surface->pixels.height};
+
+    if(rects == NULL || count == 0) {
+        rects = &whole;
+        count = 1;
+    }
+
+    blit_surface_t screen;
+
+    screen_back_surface(&screen);
+
+    for(size_t i = 0; i < count; i++) {
+        // Clip to the surface, so nothing outside of it reaches the screen.
+        int32_t width = MIN(rects[i].width, (uint32_t)SURFACE_MAX_SIDE);
+        int32_t height = MIN(rects[i].height, (uint32_t)SURFACE_MAX_SIDE);
+        int32_t x0 = MAX(rects[i].x, 0);
+        int32_t y0 = MAX(rects[i].y, 0);
+        int32_t x1 = MIN(rects[i].x + width, (int32_t)surface->pixels.width);
+        int32_t y1 = MIN(rects[i].y + height, (int32_t)surface->pixels.height);
+
+        if(x0 >= x1 || y0 >= y1) {
+            continue;
+        }
+
+        blit_copy_rect(&screen, surface->x + x0, surface->y + y0,
+                       &surface->pixels, x0, y0, x1 - x0, y1 - y0);
+
+        screen_mark_dirty(surface->x + x0, surface->y + y0, x1 - x0, y1 - y0);
+    }
+
+    surface_put(surface);
+
+    screen_update();
+
+    return true;
+}
@@ -26,10 +26,12 @@
 #include "sys/cpuid.h"
 #include "sys/scheduler/scheduler.h"
 #include "sys/scheduler/thread.h"
+#include "sys/scheduler/workqueue.h"
 
 #ifdef NOCTURNE_X86
 #include "arch/x86/msr.h"
 #include "arch/x86/mtrr.h"
+#include "arch/x86/pat.h"
 #include "arch/x86/cputemp.h"
 #include <arch/x86/gdt.h>
 #include <arch/x86/idt.h>
@@ -46,12 +48,17 @@
 #include "sys/file_descriptors.h"
 #include "drv/ps2.h"
 #include "net/dhcp.h"
+#include "net/tcp.h"
 #include "gfx/intel.h"
+#include "gfx/bochs.h"
 
 #include <drv/disk/media_notifier.h>
 
 #include <lib/pixel.h>
+#include "io/surface.h"
+#include "gui/compositor.h"
 #include <net/socket.h>
+#include "net/loopback.h"
 
 #include <generated/input.h>
 
@@ -156,7 +163,12 @@ void __attribute__((noreturn)) kmain(const multiboot_header_t *mboot)
     vmm_init();
     qemu_ok("VMM OK!");
 
+    // MTRR and PAT setup check CPU features, the heap is needed for the model strings.
+    cpu_get_info(&boot_cpu_info);
+    qemu_log("Boot CPU: %s (%s)", boot_cpu_info.model_string, boot_cpu_info.brand_string);
+
     mtrr_init();
+    pat_init();
 
     __asm__ volatile("cli");
     
@@ -189,13 +201,11 @@ void __attribute__((noreturn)) kmain(const multiboot_header_t *mboot)
     ps2_keyboard_install_irq();
     ps2_mouse_install_irq();
 
-    cpu_get_info(&boot_cpu_info);
-    qemu_log("Boot CPU: %s (%s)", boot_cpu_info.model_string, boot_cpu_info.brand_string);
-    
     // kHandlerCMD((char *)mboot->cmdline);
     
     qemu_log("Initializing Task Manager...");
     init_task_manager();
+    workqueue_init();
 
     // thread_create(get_current_proc(), task01, 0x100, THREAD_KERNEL, NULL, 0);
 
@@ -225,9 +235,14 @@ void __attribute__((noreturn)) kmain(const multiboot_header_t *mboot)
 
     kernel_start_time = getTicks();
 
+    blit_init();
+
     qemu_log("Initializing the virtual video memory manager...");
     init_vbe(mboot);
 
+    surfaces_init();
+    compositor_init();
+
     psf_init("rd0:/Sayori/Fonts/UniCyrX-ibm-8x16.psf");
 
     qemu_log("Initalizing fonts...");
@@ -271,9 +286,21 @@ void __attribute__((noreturn)) kmain(const multiboot_header_t *mboot)
     bootScreenPaint("Инициализация ARP...");
     arp_init();
 
+    bootScreenPaint("Инициализация TCP...");
+    tcp_init();
+    sockets_init();
+
+    loopback_init();
+
     bootScreenPaint("Инициализация RTL8139...");
     rtl8139_init();
 
+    bootScreenPaint("Инициализация E1000...");
+    e1000_init();
+
+    bootScreenPaint("Инициализация VIRTIO-NET...");
+    virtio_net_init();
+
     bootScreenPaint("Инициализация DHCP...");
     dhcp_init_all_cards();
 
@@ -353,6 +380,12 @@ void __attribute__((noreturn)) kmain(const multiboot_header_t *mboot)
 
     igfx_init();
 
+    // 24-bit modes are drawn byte by byte, the same resolution in 32 bits is much cheaper.
+    if(bochs_init() && getDisplayBpp() != 32
+       && screen_set_mode(getScreenWidth(), getScreenHeight(), 32)) {
+        tty_fit_screen();
+    }
+
     rust_main();
 
     qemu_log("System initialized everything at: %f seconds.", (double)(getTicks() - kernel_start_time) / getFrequency());
@@ -369,28 +402,3 @@ void __attribute__((noreturn)) kmain(const multiboot_header_t *mboot)
     while (1)
         ;
 }
-
-// TODO: The following code is a sketch of future socket system. It may change, may not.
-
-// void net_test() {
-//     socket_address_t server_addr = {
-//         .address = {192, 168, 1, 128},
-//         .port = 9999
-//     };
-
-//     char data[32] = {0};
-
-//     socket_t* srv_sock = socket_new(&server_addr, PROTO_TCP);
-//     socket_t* client_sock = socket_listen(srv_sock);
-
-//     if(client_sock) {
-//         socket_read_until_newline(client_sock, data);
-
-//         socket_close(client_sock);
-//     }
-
-//     int length = strlen(data);
-
-//     qemu_note("Received %d bytes with data: `%s`", length, data);
-//     socket_close(srv_sock);
-// }
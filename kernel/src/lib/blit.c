@@ -0,0 +1,592 @@
+/**
+ * @file lib/blit.c
+ * @brief Заливка, копирование, смешивание и преобразование пикселей
+ * @date 2026-10-19
+ * @copyright Copyright SayoriOS Team (c) 2022-2026
+ */
+
+#include "common.h"
+#include "lib/blit.h"
+#include "lib/math.h"
+#include "lib/string.h"
+#include "io/logging.h"
+
+#ifdef NOCTURNE_X86
+    #include "sys/cpuid.h"
+    #include "arch/x86/cpufeature.h"
+
+    #ifdef __SSE2__
+        #include <emmintrin.h>
+
+        #define BLIT_SSE2
+    #endif
+#endif
+
+typedef uint32_t __attribute__((aligned(1), may_alias)) unaligned_u32;
+
+// Four 24-bit pixels of one color packed into three words, as they lie in memory.
+static inline __attribute__((always_inline)) void blit_pattern24(uint32_t color, uint32_t out[3]) {
+    color &= 0xFFFFFF;
+
+    out[0] = color | (color << 24);
+    out[1] = (color >> 8) | (color << 16);
+    out[2] = (color >> 16) | (color << 8);
+}
+
+static void blit_fill24_tail(uint8_t* dst, uint32_t color, size_t count) {
+    for(size_t i = 0; i < count; i++) {
+        dst[0] = color & 0xFF;
+        dst[1] = (color >> 8) & 0xFF;
+        dst[2] = (color >> 16) & 0xFF;
+        dst += 3;
+    }
+}
+
+static void generic_fill32(uint32_t* dst, uint32_t color, size_t count) {
+    for(size_t i = 0; i < count; i++) {
+        dst[i] = color;
+    }
+}
+
+static void generic_fill24(uint8_t* dst, uint32_t color, size_t count) {
+    uint32_t pattern[3];
+
+    blit_pattern24(color, pattern);
+
+    for(; count >= 4; count -= 4) {
+        ((unaligned_u32*)dst)[0] = pattern[0];
+        ((unaligned_u32*)dst)[1] = pattern[1];
+        ((unaligned_u32*)dst)[2] = pattern[2];
+        dst += 12;
+    }
+
+    blit_fill24_tail(dst, color, count);
+}
+
+static void generic_copy(void* dst, const void* src, size_t bytes) {
+    memcpy(dst, src, bytes);
+}
+
+// Same formula as `rgba_blend`, which keeps the result within 16 bits for the SSE2 version.
+static inline __attribute__((always_inline)) uint32_t blit_blend_pixel(uint32_t fg, uint32_t bg) {
+    uint32_t alpha = (fg >> 24) + 1;
+    uint32_t inv_alpha = 257 - alpha;
+
+    uint32_t b = ((fg & 0xFF) * alpha + (bg & 0xFF) * inv_alpha) >> 8;
+    uint32_t g = (((fg >> 8) & 0xFF) * alpha + ((bg >> 8) & 0xFF) * inv_alpha) >> 8;
+    uint32_t r = (((fg >> 16) & 0xFF) * alpha + ((bg >> 16) & 0xFF) * inv_alpha) >> 8;
+
+    return 0xFF000000 | (r << 16) | (g << 8) | b;
+}
+
+static void generic_blend32(uint32_t* dst, const uint32_t* src, size_t count) {
+    for(size_t i = 0; i < count; i++) {
+        dst[i] = blit_blend_pixel(src[i], dst[i]);
+    }
+}
+
+static void generic_convert_24_to_32(uint32_t* dst, const uint8_t* src, size_t count) {
+    for(; count >= 4; count -= 4) {
+        uint32_t w0 = ((const unaligned_u32*)src)[0];
+        uint32_t w1 = ((const unaligned_u32*)src)[1];
+        uint32_t w2 = ((const unaligned_u32*)src)[2];
+
+        dst[0] = w0 & 0xFFFFFF;
+        dst[1] = (w0 >> 24) | ((w1 & 0xFFFF) << 8);
+        dst[2] = (w1 >> 16) | ((w2 & 0xFF) << 16);
+        dst[3] = w2 >> 8;
+
+        src += 12;
+        dst += 4;
+    }
+
+    for(; count; count--) {
+        *dst++ = src[0] | (src[1] << 8) | (src[2] << 16);
+        src += 3;
+    }
+}
+
+static void generic_convert_32_to_24(uint8_t* dst, const uint32_t* src, size_t count) {
+    for(; count >= 4; count -= 4) {
+        ((unaligned_u32*)dst)[0] = (src[0] & 0xFFFFFF) | (src[1] << 24);
+        ((unaligned_u32*)dst)[1] = ((src[1] >> 8) & 0xFFFF) | (src[2] << 16);
+        ((unaligned_u32*)dst)[2] = ((src[2] >> 16) & 0xFF) | (src[3] << 8);
+
+        src += 4;
+        dst += 12;
+    }
+
+    for(; count; count--) {
+        dst[0] = *src & 0xFF;
+        dst[1] = (*src >> 8) & 0xFF;
+        dst[2] = (*src >> 16) & 0xFF;
+
+        src++;
+        dst += 3;
+    }
+}
+
+static const blit_ops_t blit_ops_generic = {
+    .name = "generic",
+    .fill32 = generic_fill32,
+    .fill24 = generic_fill24,
+    .copy = generic_copy,
+    .blend32 = generic_blend32,
+    .convert_24_to_32 = generic_convert_24_to_32,
+    .convert_32_to_24 = generic_convert_32_to_24,
+};
+
+#ifdef NOCTURNE_X86
+// Enhanced REP MOVSB: byte moves are as fast as dword ones and need no tail.
+static bool blit_erms = false;
+
+static void rep_fill32(uint32_t* dst, uint32_t color, size_t count) {
+    __asm__ volatile("rep stosl" : "+D"(dst), "+c"(count) : "a"(color) : "memory");
+}
+
+static void rep_copy(void* dst, const void* src, size_t bytes) {
+    if(blit_erms) {
+        __asm__ volatile("rep movsb" : "+D"(dst), "+S"(src), "+c"(bytes) :: "memory");
+        return;
+    }
+
+    size_t words = bytes / 4;
+    size_t tail = bytes % 4;
+
+    __asm__ volatile("rep movsl" : "+D"(dst), "+S"(src), "+c"(words) :: "memory");
+    __asm__ volatile("rep movsb" : "+D"(dst), "+S"(src), "+c"(tail) :: "memory");
+}
+
+/**
+ * The first four pixels are written by hand, then `rep movsl` copies the span onto itself
+ * three words ahead: every word it reads has already been written, so the pattern repeats.
+ */
+static void rep_fill24(uint8_t* dst, uint32_t color, size_t count) {
+    if(count < 8) {
+        generic_fill24(dst, color, count);
+        return;
+    }
+
+    uint32_t pattern[3];
+
+    blit_pattern24(color, pattern);
+
+    ((unaligned_u32*)dst)[0] = pattern[0];
+    ((unaligned_u32*)dst)[1] = pattern[1];
+    ((unaligned_u32*)dst)[2] = pattern[2];
+
+    size_t rest = count * 3 - 12;
+    size_t words = rest / 4;
+    const uint8_t* src = dst;
+    uint8_t* out = dst + 12;
+
+    __asm__ volatile("rep movsl" : "+D"(out), "+S"(src), "+c"(words) :: "memory");
+
+    for(size_t i = 0; i < rest % 4; i++) {
+        out[i] = src[i];
+    }
+}
+
+static const blit_ops_t blit_ops_rep = {
+    .name = "rep",
+    .fill32 = rep_fill32,
+    .fill24 = rep_fill24,
+    .copy = rep_copy,
+    .blend32 = generic_blend32,
+    .convert_24_to_32 = generic_convert_24_to_32,
+    .convert_32_to_24 = generic_convert_32_to_24,
+};
+#endif
+
+#ifdef BLIT_SSE2
+__attribute__((force_align_arg_pointer)) static void sse2_fill32(uint32_t* dst, uint32_t color, size_t count) {
+    for(; count && ((size_t)dst & 15); count--) {
+        *dst++ = color;
+    }
+
+    __m128i value = _mm_set1_epi32(color);
+
+    for(; count >= 16; count -= 16) {
+        _mm_store_si128((__m128i*)dst, value);
+        _mm_store_si128((__m128i*)(dst + 4), value);
+        _mm_store_si128((__m128i*)(dst + 8), value);
+        _mm_store_si128((__m128i*)(dst + 12), value);
+        dst += 16;
+    }
+
+    for(; count >= 4; count -= 4) {
+        _mm_store_si128((__m128i*)dst, value);
+        dst += 4;
+    }
+
+    generic_fill32(dst, color, count);
+}
+
+// Sixteen pixels are 48 bytes, three vectors of the pattern shifted by one word each.
+__attribute__((force_align_arg_pointer)) static void sse2_fill24(uint8_t* dst, uint32_t color, size_t count) {
+    uint32_t p[3];
+
+    blit_pattern24(color, p);
+
+    __m128i a = _mm_setr_epi32(p[0], p[1], p[2], p[0]);
+    __m128i b = _mm_setr_epi32(p[1], p[2], p[0], p[1]);
+    __m128i c = _mm_setr_epi32(p[2], p[0], p[1], p[2]);
+
+    for(; count >= 16; count -= 16) {
+        _mm_storeu_si128((__m128i*)dst, a);
+        _mm_storeu_si128((__m128i*)(dst + 16), b);
+        _mm_storeu_si128((__m128i*)(dst + 32), c);
+        dst += 48;
+    }
+
+    generic_fill24(dst, color, count);
+}
+
+__attribute__((force_align_arg_pointer)) static void sse2_copy(void* dst, const void* src, size_t bytes) {
+    uint8_t* d = dst;
+    const uint8_t* s = src;
+
+    // All four loads go before the stores, so a destination just before the source is safe.
+    for(; bytes >= 64; bytes -= 64) {
+        __m128i x0 = _mm_loadu_si128((const __m128i*)s);
+        __m128i x1 = _mm_loadu_si128((const __m128i*)(s + 16));
+        __m128i x2 = _mm_loadu_si128((const __m128i*)(s + 32));
+        __m128i x3 = _mm_loadu_si128((const __m128i*)(s + 48));
+
+        _mm_storeu_si128((__m128i*)d, x0);
+        _mm_storeu_si128((__m128i*)(d + 16), x1);
+        _mm_storeu_si128((__m128i*)(d + 32), x2);
+        _mm_storeu_si128((__m128i*)(d + 48), x3);
+
+        s += 64;
+        d += 64;
+    }
+
+    for(; bytes >= 16; bytes -= 16) {
+        _mm_storeu_si128((__m128i*)d, _mm_loadu_si128((const __m128i*)s));
+        s += 16;
+        d += 16;
+    }
+
+    for(; bytes; bytes--) {
+        *d++ = *s++;
+    }
+}
+
+// Four pixels at a time, two per vector in 16-bit lanes: 255 * 257 still fits.
+__attribute__((force_align_arg_pointer)) static void sse2_blend32(uint32_t* dst, const uint32_t* src, size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i full = _mm_set1_epi16(256);
+    const __m128i opaque = _mm_set1_epi32(0xFF000000);
+
+    for(; count >= 4; count -= 4) {
+        __m128i s = _mm_loadu_si128((const __m128i*)src);
+        __m128i d = _mm_loadu_si128((const __m128i*)dst);
+
+        __m128i s_lo = _mm_unpacklo_epi8(s, zero);
+        __m128i s_hi = _mm_unpackhi_epi8(s, zero);
+        __m128i d_lo = _mm_unpacklo_epi8(d, zero);
+        __m128i d_hi = _mm_unpackhi_epi8(d, zero);
+
+        __m128i a_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_lo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        __m128i a_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_hi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+
+        __m128i r_lo = _mm_add_epi16(_mm_mullo_epi16(s_lo, _mm_add_epi16(a_lo, one)),
+                                     _mm_mullo_epi16(d_lo, _mm_sub_epi16(full, a_lo)));
+        __m128i r_hi = _mm_add_epi16(_mm_mullo_epi16(s_hi, _mm_add_epi16(a_hi, one)),
+                                     _mm_mullo_epi16(d_hi, _mm_sub_epi16(full, a_hi)));
+
+        __m128i result = _mm_packus_epi16(_mm_srli_epi16(r_lo, 8), _mm_srli_epi16(r_hi, 8));
+
+        _mm_storeu_si128((__m128i*)dst, _mm_or_si128(result, opaque));
+
+        src += 4;
+        dst += 4;
+    }
+
+    generic_blend32(dst, src, count);
+}
+
+static const blit_ops_t blit_ops_sse2 = {
+    .name = "sse2",
+    .fill32 = sse2_fill32,
+    .fill24 = sse2_fill24,
+    .copy = sse2_copy,
+    .blend32 = sse2_blend32,
+    .convert_24_to_32 = generic_convert_24_to_32,
+    .convert_32_to_24 = generic_convert_32_to_24,
+};
+#endif
+
+// Fastest first.
+static const blit_ops_t* const blit_variants[] = {
+#ifdef BLIT_SSE2
+    &blit_ops_sse2,
+#endif
+#ifdef NOCTURNE_X86
+    &blit_ops_rep,
+#endif
+    &blit_ops_generic,
+};
+
+static size_t blit_available = sizeof(blit_variants) / sizeof(blit_variants[0]);
+
+const blit_ops_t* blit_ops = &blit_ops_generic;
+
+/**
+ * @brief Выбирает самый быстрый вариант ядер, который поддерживает процессор
+ */
+void blit_init() {
+    size_t first = 0;
+
+#ifdef BLIT_SSE2
+    if(!boot_cpu_has(X86_FEATURE_SSE2)) {
+        first = 1;
+    }
+#endif
+
+#ifdef NOCTURNE_X86
+    blit_erms = boot_cpu_has(X86_FEATURE_ERMS);
+#endif
+
+    // Variants the CPU cannot run are hidden from the benchmark too.
+    blit_available = sizeof(blit_variants) / sizeof(blit_variants[0]) - first;
+    blit_ops = blit_variants[first];
+
+    qemu_ok("Blitter: %s", blit_ops->name);
+}
+
+/**
+ * @brief Количество вариантов ядер, доступных на этом процессоре
+ *
+ * @return size_t - Количество
+ */
+size_t blit_variant_count() {
+    return blit_available;
+}
+
+/**
+ * @brief Вариант ядер по номеру, от самого быстрого
+ *
+ * @param index - Номер, меньше blit_variant_count()
+ * @return const blit_ops_t* - Ядра или NULL
+ */
+const blit_ops_t* blit_variant(size_t index) {
+    size_t total = sizeof(blit_variants) / sizeof(blit_variants[0]);
+
+    if(index >= blit_available) {
+        return NULL;
+    }
+
+    return blit_variants[index + total - blit_available];
+}
+
+static inline __attribute__((always_inline)) uint8_t* blit_pixel_at(const blit_surface_t* surface, uint32_t x, uint32_t y) {
+    return surface->pixels + y * surface->pitch + x * (surface->bpp >> 3);
+}
+
+static inline __attribute__((always_inline)) bool blit_supported(uint32_t bpp) {
+    return bpp == 24 || bpp == 32;
+}
+
+/**
+ * @brief Заливает горизонтальный отрезок, обрезая его по границам
+ *
+ * @param surface - Куда рисовать
+ * @param x - Начало
+ * @param y - Строка
+ * @param length - Длина в пикселях
+ * @param color - Цвет
+ */
+void blit_fill_span(const blit_surface_t* surface, int x, int y, int length, uint32_t color) {
+    blit_fill_rect(surface, x, y, length, 1, color);
+}
+
+/**
+ * @brief Заливает прямоугольник одним цветом, обрезая его по границам
+ *
+ * @param surface - Куда рисовать
+ * @param x - Левый край
+ * @param y - Верхний край
+ * @param width - Ширина
+ * @param height - Высота
+ * @param color - Цвет
+ */
+void blit_fill_rect(const blit_surface_t* surface, int x, int y, int width, int height, uint32_t color) {
+    if(!blit_supported(surface->bpp) || width <= 0 || height <= 0) {
+        return;
+    }
+
+    int32_t x0 = MAX(x, 0);
+    int32_t y0 = MAX(y, 0);
+    int32_t x1 = MIN(x + width, (int32_t)surface->width);
+    int32_t y1 = MIN(y + height, (int32_t)surface->height);
+
+    if(x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    size_t count = x1 - x0;
+    size_t rows = y1 - y0;
+    uint8_t* row = blit_pixel_at(surface, x0, y0);
+
+    if(surface->bpp == 32) {
+        // Whole rows without padding make one long span.
+        if(count == surface->width && surface->pitch == count * 4) {
+            count *= rows;
+            rows = 1;
+        }
+
+        for(size_t i = 0; i < rows; i++) {
+            blit_ops->fill32((uint32_t*)row, color, count);
+            row += surface->pitch;
+        }
+    } else {
+        for(size_t i = 0; i < rows; i++) {
+            blit_ops->fill24(row, color, count);
+            row += surface->pitch;
+        }
+    }
+}
+
+/**
+ * @brief Копирует прямоугольник, преобразуя пиксели, если форматы разные
+ *
+ * Источник и приёмник могут быть одним буфером, в том числе с перекрытием (прокрутка).
+ *
+ * @param dst - Куда копировать
+ * @param dst_x - Левый край в приёмнике
+ * @param dst_y - Верхний край в приёмнике
+ * @param src - Откуда копировать
+ * @param src_x - Левый край в источнике
+ * @param src_y - Верхний край в источнике
+ * @param width - Ширина
+ * @param height - Высота
+ */
+void blit_copy_rect(const blit_surface_t* dst, int dst_x, int dst_y,
+                    const blit_surface_t* src, int src_x, int src_y, int width, int height) {
+    if(!blit_supported(dst->bpp) || !blit_supported(src->bpp)) {
+        return;
+    }
+
+    // Clip the left and top edges against both surfaces, then the size.
+    int32_t shift_x = MAX(MAX(-dst_x, -src_x), 0);
+    int32_t shift_y = MAX(MAX(-dst_y, -src_y), 0);
+
+    dst_x += shift_x;
+    src_x += shift_x;
+    dst_y += shift_y;
+    src_y += shift_y;
+
+    width = MIN(width - shift_x, MIN((int32_t)dst->width - dst_x, (int32_t)src->width - src_x));
+    height = MIN(height - shift_y, MIN((int32_t)dst->height - dst_y, (int32_t)src->height - src_y));
+
+    if(width <= 0 || height <= 0) {
+        return;
+    }
+
+    size_t row_bytes = width * (dst->bpp >> 3);
+    uint8_t* to = blit_pixel_at(dst, dst_x, dst_y);
+    const uint8_t* from = blit_pixel_at(src, src_x, src_y);
+    ssize_t to_pitch = dst->pitch;
+    ssize_t from_pitch = src->pitch;
+
+    if(dst->bpp != src->bpp) {
+        for(int32_t i = 0; i < height; i++) {
+            blit_convert(to, dst->bpp, from, src->bpp, width);
+
+            to += to_pitch;
+            from += from_pitch;
+        }
+
+        return;
+    }
+
+    bool same = dst->pixels == src->pixels;
+
+    // Scrolling down: go from the bottom row so no row is overwritten before it is read.
+    if(same && dst_y > src_y) {
+        to += (height - 1) * to_pitch;
+        from += (height - 1) * from_pitch;
+        to_pitch = -to_pitch;
+        from_pitch = -from_pitch;
+    }
+
+    // Only a move to the right within the same rows needs a backward copy.
+    bool backward = same && dst_y == src_y && dst_x > src_x;
+
+    for(int32_t i = 0; i < height; i++) {
+        if(backward) {
+            memmove(to, (void*)from, row_bytes);
+        } else {
+            blit_ops->copy(to, from, row_bytes);
+        }
+
+        to += to_pitch;
+        from += from_pitch;
+    }
+}
+
+/**
+ * @brief Накладывает отрезок пикселей с альфой на буфер
+ *
+ * @param surface - Куда рисовать
+ * @param x - Начало
+ * @param y - Строка
+ * @param argb - Пиксели 0xAARRGGBB
+ * @param length - Количество пикселей
+ */
+void blit_blend_span(const blit_surface_t* surface, int x, int y, const uint32_t* argb, int length) {
+    if(!blit_supported(surface->bpp) || y < 0 || y >= (int32_t)surface->height) {
+        return;
+    }
+
+    if(x < 0) {
+        argb -= x;
+        length += x;
+        x = 0;
+    }
+
+    length = MIN(length, (int32_t)surface->width - x);
+
+    if(length <= 0) {
+        return;
+    }
+
+    uint8_t* row = blit_pixel_at(surface, x, y);
+
+    if(surface->bpp == 32) {
+        blit_ops->blend32((uint32_t*)row, argb, length);
+        return;
+    }
+
+    for(int32_t i = 0; i < length; i++) {
+        uint32_t bg = row[0] | (row[1] << 8) | (row[2] << 16);
+        uint32_t pixel = blit_blend_pixel(argb[i], bg);
+
+        row[0] = pixel & 0xFF;
+        row[1] = (pixel >> 8) & 0xFF;
+        row[2] = (pixel >> 16) & 0xFF;
+        row += 3;
+    }
+}
+
+/**
+ * @brief Преобразует пиксели между форматами 24 и 32 бит (или просто копирует)
+ *
+ * @param dst - Куда
+ * @param dst_bpp - Формат приёмника
+ * @param src - Откуда
+ * @param src_bpp - Формат источника
+ * @param count - Количество пикселей
+ */
+void blit_convert(void* dst, uint32_t dst_bpp, const void* src, uint32_t src_bpp, size_t count) {
+    if(dst_bpp == src_bpp) {
+        blit_ops->copy(dst, src, count * (dst_bpp >> 3));
+    } else if(dst_bpp == 32 && src_bpp == 24) {
+        blit_ops->convert_24_to_32(dst, src, count);
+    } else if(dst_bpp == 24 && src_bpp == 32) {
+        blit_ops->convert_32_to_24(dst, src, count);
+    }
+}
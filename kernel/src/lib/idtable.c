@@ -0,0 +1,120 @@
+/**
+ * @file lib/idtable.c
+ * @author NDRAEY (pikachu_andrey@vk.com)
+ * @brief Таблица объектов с доступом по идентификатору за O(1)
+ * @version 0.4.3
+ * @date 2026-10-19
+ * @copyright Copyright SayoriOS Team (c) 2022-2026
+ */
+
+#include "lib/idtable.h"
+#include "mem/vmm.h"
+#include "io/logging.h"
+
+/**
+ * @brief Инициализирует таблицу на `1 << slot_bits` элементов
+ *
+ * @param table - Таблица
+ * @param slot_bits - Количество бит идентификатора под номер ячейки
+ * @return true - если память выделена
+ */
+bool idtable_init(idtable_t* table, size_t slot_bits) {
+    table->slot_bits = slot_bits;
+    table->capacity = 1U << slot_bits;
+    table->count = 0;
+
+    table->objects = kcalloc(table->capacity, sizeof(void*));
+    table->generations = kcalloc(table->capacity, sizeof(size_t));
+    table->free_slots = kcalloc(table->capacity, sizeof(size_t));
+
+    if(!table->objects || !table->generations || !table->free_slots) {
+        qemu_err("Failed to allocate ID table of %d entries", table->capacity);
+
+        kfree(table->objects);
+        kfree(table->generations);
+        kfree(table->free_slots);
+
+        return false;
+    }
+
+    // Slots are given in ascending order, so the first ID is 0.
+    for(size_t i = 0; i < table->capacity; i++) {
+        table->free_slots[i] = i;
+    }
+
+    table->free_head = 0;
+    table->free_count = table->capacity;
+
+    return true;
+}
+
+/**
+ * @brief Кладёт объект в таблицу
+ *
+ * @param table - Таблица
+ * @param object - Объект
+ * @return size_t - Идентификатор объекта или IDTABLE_INVALID_ID, если места нет
+ */
+size_t idtable_alloc(idtable_t* table, void* object) {
+    if(table->free_count == 0) {
+        return IDTABLE_INVALID_ID;
+    }
+
+    size_t slot = table->free_slots[table->free_head];
+
+    table->free_head = (table->free_head + 1) & (table->capacity - 1);
+    table->free_count--;
+
+    table->objects[slot] = object;
+    table->count++;
+
+    size_t id = (table->generations[slot] << table->slot_bits) | slot;
+
+    // Never give out the reserved value.
+    if(id == IDTABLE_INVALID_ID) {
+        table->generations[slot] = 0;
+        id = slot;
+    }
+
+    return id;
+}
+
+/**
+ * @brief Ищет объект по идентификатору
+ *
+ * @return void* - Объект или NULL, если идентификатор устарел или не выдавался
+ */
+void* idtable_get(const idtable_t* table, size_t id) {
+    if(id == IDTABLE_INVALID_ID) {
+        return NULL;
+    }
+
+    size_t slot = id & (table->capacity - 1);
+
+    if(table->generations[slot] != (id >> table->slot_bits)) {
+        return NULL;
+    }
+
+    return table->objects[slot];
+}
+
+/**
+ * @brief Освобождает идентификатор
+ */
+void idtable_remove(idtable_t* table, size_t id) {
+    if(idtable_get(table, id) == NULL) {
+        return;
+    }
+
+    size_t slot = id & (table->capacity - 1);
+
+    table->objects[slot] = NULL;
+    // Generation must fit into the bits left after the slot number.
+    table->generations[slot] = (table->generations[slot] + 1) & (IDTABLE_INVALID_ID >> table->slot_bits);
+    table->count--;
+
+    size_t tail = (table->free_head + table->free_count) & (table->capacity - 1);
+
+    table->free_slots[tail] = slot;
+    table->free_count++;
+}
@@ -22,11 +22,7 @@
  * @param color - цвет заливки
  */
 void drawRect(uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t color){
-	for (__typeof__(x) _y = y, endy = y+h; _y < endy; _y++){
-		for (__typeof__(x) _x = x, endx = x+w; _x < endx; _x++){
-            set_pixel(_x, _y, color);
-        }
-    }
+	screen_fill_rect(x, y, w, h, color);
 }
 
 /**
@@ -39,15 +35,10 @@ void drawRect(uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t color){
  * @param color - Цвет
 */
 void drawRectBorder(int x, int y, int w, int h, int color){
-	for (int _x = x; _x < x+w ; _x++){
-		set_pixel(_x, y, color);
-		set_pixel(_x, y+h, color);
-    }
-    for (int _y = y; _y < y+h; _y++){
-		
-		set_pixel(x, _y, color);
-		set_pixel(x+w, _y, color);
-    }
+	screen_fill_rect(x, y, w, 1, color);
+	screen_fill_rect(x, y + h, w, 1, color);
+	screen_fill_rect(x, y, 1, h, color);
+	screen_fill_rect(x + w, y, 1, h, color);
 }
 
 /**
@@ -59,9 +50,7 @@ void drawRectBorder(int x, int y, int w, int h, int color){
  * @param color - Цвет
 */
 void drawHorizontalLine(int x1, int x2, int y, uint32_t color) {
-    for (int x = x1; x <= x2; x++) {
-        set_pixel(x, y, color);
-    }
+    screen_fill_rect(x1, y, x2 - x1 + 1, 1, color);
 }
 
 /**
@@ -73,9 +62,7 @@ void drawHorizontalLine(int x1, int x2, int y, uint32_t color) {
  * @param color - Цвет
 */
 void drawVerticalLine(int y1, int y2, int x, uint32_t color) {
-    for (int y = y1; y <= y2; y++) {
-        set_pixel(x, y, color);
-    }
+    screen_fill_rect(x, y1, 1, y2 - y1 + 1, color);
 }
 
 /**
@@ -0,0 +1,46 @@
+/**
+ * @file lib/spsc_ring.c
+ * @author NDRAEY (pikachu_andrey@vk.com)
+ * @brief Кольцевой буфер для одного производителя и одного потребителя
+ * @version 0.4.3
+ * @date 2026-10-19
+ * @copyright Copyright SayoriOS Team (c) 2022-2026
+ */
+
+#include "lib/spsc_ring.h"
+#include "mem/vmm.h"
+
+/**
+ * @brief Инициализирует кольцевой буфер
+ *
+ * @param ring - Буфер
+ * @param capacity - Количество слотов (степень двойки)
+ * @return true - если успешно
+ */
+bool spsc_ring_init(spsc_ring_t* ring, size_t capacity) {
+    if(capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        return false;
+    }
+
+    ring->slots = kcalloc(capacity, sizeof(void*));
+
+    if(ring->slots == NULL) {
+        return false;
+    }
+
+    ring->head = 0;
+    ring->tail = 0;
+    ring->mask = capacity - 1;
+
+    return true;
+}
+
+/**
+ * @brief Освобождает слоты буфера (но не то, на что они указывают)
+ */
+void spsc_ring_destroy(spsc_ring_t* ring) {
+    kfree(ring->slots);
+
+    ring->slots = NULL;
+    ring->mask = 0;
+}
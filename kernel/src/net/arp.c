@@ -6,11 +6,134 @@
 #include "lib/string.h"
 #include <io/logging.h>
 #include "net/ethernet.h"
+#include "net/netbuf.h"
+#include "sys/scheduler/scheduler.h"
+#include "arch/x86/pit.h"
+
+#define TICKS_PASSED(now, deadline) ((ssize_t)((now) - (deadline)) >= 0)
 
 uint8_t default_broadcast_mac_address[] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
 
-arp_table_entry_t arp_table[ARP_TABLE_MAX_SIZE] = {0};
-size_t arp_table_curr = 0;
+static arp_table_entry_t* arp_table[ARP_HASH_SIZE] = {0};
+
+// Protects the table, every entry and the statistics.
+static mutex_t arp_lock = {false};
+
+static arp_stats_t arp_stats = {0};
+static thread_t* arp_timer_thread = NULL;
+
+static void arp_lock_acquire() {
+    while(__atomic_test_and_set(&arp_lock.lock, __ATOMIC_ACQUIRE)) {
+        yield();
+    }
+}
+
+static void arp_lock_release() {
+    mutex_release(&arp_lock);
+}
+
+static size_t arp_hash(uint32_t ip) {
+    ip ^= ip >> 16;
+    ip *= 0x45d9f3b;
+    ip ^= ip >> 16;
+
+    return ip & (ARP_HASH_SIZE - 1);
+}
+
+static arp_table_entry_t* arp_find(uint32_t ip) {
+    for(arp_table_entry_t* entry = arp_table[arp_hash(ip)]; entry; entry = entry->next) {
+        if(entry->ip_addr == ip) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static void arp_unlink(arp_table_entry_t* entry) {
+    arp_table_entry_t** link = &arp_table[arp_hash(entry->ip_addr)];
+
+    while(*link != entry) {
+        link = &(*link)->next;
+    }
+
+    *link = entry->next;
+
+    arp_stats.entries--;
+}
+
+static void arp_drop_pending(arp_table_entry_t* entry) {
+    netbuf_t* next;
+
+    for(netbuf_t* buf = entry->pending_head; buf; buf = next) {
+        next = buf->next;
+
+        netbuf_free(buf);
+
+        arp_stats.pending_dropped++;
+    }
+
+    entry->pending_head = entry->pending_tail = NULL;
+    entry->pending_count = 0;
+}
+
+// Frees the stale entry that expires first. Table is small, and it is only scanned when full.
+static bool arp_evict() {
+    arp_table_entry_t* victim = NULL;
+
+    for(size_t i = 0; i < ARP_HASH_SIZE; i++) {
+        for(arp_table_entry_t* entry = arp_table[i]; entry; entry = entry->next) {
+            if(entry->state == ARP_STATE_STALE
+               && (victim == NULL || (ssize_t)(entry->deadline - victim->deadline) < 0)) {
+                victim = entry;
+            }
+        }
+    }
+
+    if(victim == NULL) {
+        return false;
+    }
+
+    arp_unlink(victim);
+    arp_drop_pending(victim);
+    kfree(victim);
+
+    arp_stats.evicted++;
+
+    return true;
+}
+
+static arp_table_entry_t* arp_create(netcard_entry_t* card, uint32_t ip) {
+    if(arp_stats.entries >= ARP_TABLE_MAX_SIZE && !arp_evict()) {
+        return NULL;
+    }
+
+    arp_table_entry_t* entry = kcalloc(sizeof(arp_table_entry_t), 1);
+
+    if(entry == NULL) {
+        return NULL;
+    }
+
+    entry->card = card;
+    entry->ip_addr = ip;
+
+    size_t bucket = arp_hash(ip);
+
+    entry->next = arp_table[bucket];
+    arp_table[bucket] = entry;
+
+    arp_stats.entries++;
+
+    return entry;
+}
+
+static void arp_request(arp_table_entry_t* entry) {
+    uint8_t zero_mac[6] = {0};
+
+    arp_send_packet(entry->card, zero_mac, (uint8_t*)&entry->ip_addr);
+
+    arp_stats.requests_sent++;
+}
 
 void arp_handle_packet(netcard_entry_t* card, arp_packet_t* arp_packet, SAYORI_UNUSED size_t len) {
     uint8_t dest_mac[6];
@@ -18,12 +141,14 @@ void arp_handle_packet(netcard_entry_t* card, arp_packet_t* arp_packet, SAYORI_U
     
     memcpy(dest_mac, arp_packet->src_mac, 6);
     memcpy(dest_ip, arp_packet->src_ip, 4);
-    
+
+    bool for_us = memcmp((const char*)arp_packet->dest_ip, (const char*)card->ipv4_addr, 4) == 0;
+
     if(ntohs(arp_packet->opcode) == ARP_REQUEST) {
         qemu_warn("ARP REQUEST");
 
-        if(memcmp((const char*)arp_packet->dest_ip, (const char*)card->ipv4_addr, 4) != 0) {
-            // Set source MAC address, IP address (hardcode the IP address as 10.2.2.3 until we really get one...)
+        if(for_us) {
+            // Set source MAC address, IP address
             card->get_mac_addr(arp_packet->src_mac);
             
             arp_packet->src_ip[0] = card->ipv4_addr[0];
@@ -78,14 +203,29 @@ void arp_handle_packet(netcard_entry_t* card, arp_packet_t* arp_packet, SAYORI_U
 		qemu_log("Got unknown ARP opcode (%d)", arp_packet->opcode);
 	    }
  
-    // Now, store the ip-mac address mapping relation
-    
-	arp_lookup_add(dest_mac, dest_ip);
+    // RFC 826: the sender is always refreshed, but only added when it talks to us,
+    // so broadcasts of other hosts do not fill the table.
+    arp_lock_acquire();
 
+    if(for_us || arp_find(*(uint32_t*)dest_ip)) {
+        arp_lock_release();
+
+        arp_lookup_add(card, dest_mac, dest_ip);
+    } else {
+        arp_lock_release();
+    }
 }
 
 void arp_send_packet(netcard_entry_t* card, uint8_t* dest_mac, uint8_t* dest_ip) {
-    arp_packet_t* arp_packet = kcalloc(sizeof(arp_packet_t), 1);
+    netbuf_t* buf = netbuf_alloc(NETBUF_HEADROOM, sizeof(arp_packet_t));
+
+    if(buf == NULL) {
+        return;
+    }
+
+    arp_packet_t* arp_packet = netbuf_put(buf, sizeof(arp_packet_t));
+
+    memset(arp_packet, 0, sizeof(arp_packet_t));
 
     card->get_mac_addr(arp_packet->src_mac);
     
@@ -112,69 +252,254 @@ void arp_send_packet(netcard_entry_t* card, uint8_t* dest_mac, uint8_t* dest_ip)
     arp_packet->protocol = htons(ETHERNET_TYPE_IPV4);
 
     // Now send it with ethernet
-    ethernet_send_packet(
-			card,
-			default_broadcast_mac_address,
-			(uint8_t*)arp_packet,
-			sizeof(arp_packet_t),
-			ETHERNET_TYPE_ARP);
-}
-
-void arp_lookup_add(uint8_t* ret_hardware_addr, uint8_t * ip_addr) {
-    	qemu_note("lookup add: [%x:%x:%x:%x:%x:%x] is [%d.%d.%d.%d]", 
-			ret_hardware_addr[0],
-			ret_hardware_addr[1],
-			ret_hardware_addr[2],
-			ret_hardware_addr[3],
-			ret_hardware_addr[4],
-			ret_hardware_addr[5],
-			ip_addr[0],
-			ip_addr[1],
-			ip_addr[2],
-			ip_addr[3]);
-
-	memcpy(&arp_table[arp_table_curr].ip_addr, ip_addr, 4);
-	memcpy(&arp_table[arp_table_curr].mac_addr, ret_hardware_addr, 6);
-    
-	if(arp_table_curr < ARP_TABLE_MAX_SIZE) {
-		arp_table_curr++;
-	}
-    
-	if(arp_table_curr >= ARP_TABLE_MAX_SIZE) {
-		arp_table_curr = 0;
-	}
+    ethernet_send_netbuf(card, default_broadcast_mac_address, buf, ETHERNET_TYPE_ARP);
 }
 
+/**
+ * @brief Запоминает адрес соседа и отправляет ждущие его пакеты
+ *
+ * @param card - Сетевая карта, через которую виден сосед
+ * @param hardware_addr - MAC-адрес
+ * @param ip_addr - IPv4-адрес
+ */
+void arp_lookup_add(netcard_entry_t* card, const uint8_t* hardware_addr, const uint8_t* ip_addr) {
+    uint32_t ip = *(const uint32_t*)ip_addr;
+
+    arp_lock_acquire();
+
+    arp_table_entry_t* entry = arp_find(ip);
+
+    if(entry == NULL) {
+        entry = arp_create(card, ip);
+
+        if(entry == NULL) {
+            arp_lock_release();
+            return;
+        }
+    }
+
+    if(entry->state == ARP_STATE_INCOMPLETE) {
+        qemu_note("ARP: %d.%d.%d.%d is at %x:%x:%x:%x:%x:%x",
+                  ip_addr[0], ip_addr[1], ip_addr[2], ip_addr[3],
+                  hardware_addr[0], hardware_addr[1], hardware_addr[2],
+                  hardware_addr[3], hardware_addr[4], hardware_addr[5]);
+
+        arp_stats.resolved++;
+    }
+
+    entry->card = card;
+    memcpy(entry->mac_addr, hardware_addr, 6);
+    entry->state = ARP_STATE_REACHABLE;
+    entry->deadline = getTicks() + ARP_REACHABLE_TIME;
+    entry->requests = 0;
+
+    netbuf_t* pending = entry->pending_head;
+
+    entry->pending_head = entry->pending_tail = NULL;
+    entry->pending_count = 0;
+
+    // Sending only queues the frame for the TX worker, so it is fine under the lock.
+    while(pending) {
+        netbuf_t* next = pending->next;
+
+        ethernet_send_netbuf(pending->card, entry->mac_addr, pending, ETHERNET_TYPE_IPV4);
+
+        pending = next;
+    }
+
+    arp_lock_release();
+}
+
+/**
+ * @brief Ищет MAC-адрес соседа, не отправляя запросов
+ *
+ * @param ret_hardware_addr - Получает MAC-адрес
+ * @param ip_addr - IPv4-адрес
+ * @return true, если адрес известен
+ */
 bool arp_lookup(uint8_t* ret_hardware_addr, const uint8_t* ip_addr) {
-    uint32_t ip_entry = *((uint32_t*)(ip_addr));
-
-	qemu_log("Looking up: %d.%d.%d.%d", ip_addr[0], ip_addr[1], ip_addr[2], ip_addr[3]);
-
-    for(int i = 0; i < ARP_TABLE_MAX_SIZE; i++) {
-        if(arp_table[i].ip_addr == ip_entry) {
-            memcpy(ret_hardware_addr, arp_table[i].mac_addr, 6);
-			qemu_ok("Found %x:%x:%x:%x:%x:%x!",
-						arp_table[i].mac_addr[0],
-						arp_table[i].mac_addr[1],
-						arp_table[i].mac_addr[2],
-						arp_table[i].mac_addr[3],
-						arp_table[i].mac_addr[4],
-						arp_table[i].mac_addr[5]);
-            return true;
+    bool found = false;
+
+    arp_lock_acquire();
+
+    arp_table_entry_t* entry = arp_find(*(const uint32_t*)ip_addr);
+
+    if(entry && entry->state != ARP_STATE_INCOMPLETE) {
+        memcpy(ret_hardware_addr, entry->mac_addr, 6);
+        found = true;
+    }
+
+    arp_lock_release();
+
+    return found;
+}
+
+/**
+ * @brief Отправляет IPv4-пакет соседу, разрешая его адрес при необходимости
+ *
+ * Пока ответа нет, пакет ждёт в очереди соседа (не больше ARP_MAX_PENDING,
+ * старые вытесняются). Если сосед так и не ответил, очередь отбрасывается.
+ *
+ * @param card - Сетевая карта
+ * @param ip_addr - IPv4-адрес соседа
+ * @param buf - Пакет с IPv4-заголовком, забирается во владение
+ */
+void arp_output(netcard_entry_t* card, const uint8_t ip_addr[4], netbuf_t* buf) {
+    uint32_t ip = *(const uint32_t*)ip_addr;
+
+    // Loopback delivers every frame to itself, whatever the address.
+    if(ip == 0xFFFFFFFF || (card->features & NETCARD_FEATURE_LOOPBACK)) {
+        ethernet_send_netbuf(card, default_broadcast_mac_address, buf, ETHERNET_TYPE_IPV4);
+        return;
+    }
+
+    arp_lock_acquire();
+
+    arp_table_entry_t* entry = arp_find(ip);
+
+    if(entry && entry->state != ARP_STATE_INCOMPLETE) {
+        if(entry->state == ARP_STATE_STALE && entry->requests == 0) {
+            // Keep using the old address and confirm it with a request on the way (RFC 1122 2.3.2.1).
+            entry->deadline = getTicks() + ARP_RETRANSMIT_TIME;
+            entry->requests = 1;
+
+            arp_request(entry);
+        }
+
+        ethernet_send_netbuf(card, entry->mac_addr, buf, ETHERNET_TYPE_IPV4);
+
+        arp_lock_release();
+        return;
+    }
+
+    bool created = false;
+
+    if(entry == NULL) {
+        entry = arp_create(card, ip);
+
+        if(entry == NULL) {
+            arp_stats.pending_dropped++;
+
+            arp_lock_release();
+
+            netbuf_free(buf);
+            return;
+        }
+
+        created = true;
+    }
+
+    if(entry->pending_count == ARP_MAX_PENDING) {
+        netbuf_t* oldest = entry->pending_head;
+
+        entry->pending_head = oldest->next;
+        entry->pending_count--;
+
+        netbuf_free(oldest);
+
+        arp_stats.pending_dropped++;
+    }
+
+    buf->card = card;
+    buf->next = NULL;
+
+    if(entry->pending_tail) {
+        entry->pending_tail->next = buf;
+    } else {
+        entry->pending_head = buf;
+    }
+
+    entry->pending_tail = buf;
+    entry->pending_count++;
+
+    if(created) {
+        entry->deadline = getTicks() + ARP_RETRANSMIT_TIME;
+        entry->requests = 1;
+
+        arp_request(entry);
+    }
+
+    arp_lock_release();
+
+    if(created) {
+        // Timer may sleep for long while the table is idle.
+        thread_wake(arp_timer_thread);
+    }
+}
+
+static void arp_entry_timers(arp_table_entry_t* entry, size_t now) {
+    if(!TICKS_PASSED(now, entry->deadline)) {
+        return;
+    }
+
+    if(entry->state == ARP_STATE_REACHABLE) {
+        entry->state = ARP_STATE_STALE;
+        entry->deadline = now + ARP_STALE_TIME;
+        return;
+    }
+
+    // Stale entry without a request in flight was simply not used for long.
+    if(entry->state == ARP_STATE_STALE && entry->requests == 0) {
+        arp_unlink(entry);
+        kfree(entry);
+        return;
+    }
+
+    if(entry->requests < ARP_MAX_REQUESTS) {
+        entry->requests++;
+        entry->deadline = now + ARP_RETRANSMIT_TIME;
+
+        arp_request(entry);
+        return;
+    }
+
+    SAYORI_UNUSED uint8_t* ip = (uint8_t*)&entry->ip_addr;
+
+    qemu_err("ARP: %d.%d.%d.%d is unreachable", ip[0], ip[1], ip[2], ip[3]);
+
+    arp_stats.unreachable++;
+
+    arp_unlink(entry);
+    arp_drop_pending(entry);
+    kfree(entry);
+}
+
+__attribute__((noreturn)) static void arp_timer_loop() {
+    while(1) {
+        __asm__ volatile("cli");
+
+        sched_wait(arp_stats.entries ? ARP_TIMER_INTERVAL : SCHED_MAX_IDLE_TICKS);
+
+        size_t now = getTicks();
+
+        arp_lock_acquire();
+
+        for(size_t i = 0; i < ARP_HASH_SIZE; i++) {
+            arp_table_entry_t* next;
+
+            for(arp_table_entry_t* entry = arp_table[i]; entry; entry = next) {
+                next = entry->next;
+
+                arp_entry_timers(entry, now);
+            }
         }
+
+        arp_lock_release();
     }
+}
+
+void arp_get_stats(arp_stats_t* out) {
+    arp_lock_acquire();
 
-	qemu_err("Failed!");
+    *out = arp_stats;
 
-    return false;
+    arp_lock_release();
 }
 
 void arp_init() {
-    uint8_t broadcast_ip[4];
-    uint8_t broadcast_mac[6];
+    arp_timer_thread = thread_create_arg1(get_current_proc(), arp_timer_loop, 0x4000, THREAD_KERNEL, 0);
 
-    memset(broadcast_ip, 0xff, 4);
-    memset(broadcast_mac, 0xff, 6);
- 
-    arp_lookup_add(broadcast_mac, broadcast_ip);
+    thread_set_sched_class(arp_timer_thread, SCHED_CLASS_INTERACTIVE, 0);
+
+    qemu_ok("ARP: %d buckets, up to %d neighbors", ARP_HASH_SIZE, ARP_TABLE_MAX_SIZE);
 }
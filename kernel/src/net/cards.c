@@ -1,6 +1,8 @@
 #include "common.h"
 #include "net/cards.h"
 #include "mem/vmm.h"
+#include "net/stack.h"
+#include "lib/string.h"
 
 netcard_entry_t** netcards_list = 0;
 size_t netcards_list_capacity = 0;
@@ -13,6 +15,10 @@ void netcards_list_init() {
 }
 
 void netcard_add(netcard_entry_t *card) {
+    if(!netstack_attach_card(card)) {
+        return;
+    }
+
     netcards_list_capacity++;
     netcards_list = krealloc(netcards_list, sizeof(netcard_entry_t*) * netcards_list_capacity);
 
@@ -28,4 +34,29 @@ netcard_entry_t* netcard_get(size_t index) {
         return 0;
 
     return netcards_list[index];
-}
\ No newline at end of file
+}
+/**
+ * @brief Выбирает карту для отправки на адрес
+ *
+ * @param ip - Адрес получателя
+ * @return netcard_entry_t* - Карта с этим адресом, для 127.0.0.0/8 - петлевая, иначе первая внешняя (или NULL)
+ */
+netcard_entry_t* netcard_route(const uint8_t ip[4]) {
+    netcard_entry_t* fallback = NULL;
+
+    for(size_t i = 0; i < netcards_count; i++) {
+        netcard_entry_t* card = netcards_list[i];
+
+        if(memcmp((const char*)card->ipv4_addr, (const char*)ip, 4) == 0) {
+            return card;
+        }
+
+        bool loopback = card->ipv4_addr[0] == 127;
+
+        if(fallback == NULL && loopback == (ip[0] == 127)) {
+            fallback = card;
+        }
+    }
+
+    return fallback;
+}
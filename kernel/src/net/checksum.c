@@ -0,0 +1,351 @@
+/**
+ * @brief Контрольная сумма Интернета для IPv4, ICMP, UDP и TCP
+ * @date 2026-10-19
+ * @copyright Copyright SayoriOS Team (c) 2022-2026
+ */
+
+#include "common.h"
+#include "net/checksum.h"
+#include "net/endianess.h"
+#include "mem/vmm.h"
+#include "lib/rand.h"
+#include "lib/string.h"
+#include "io/logging.h"
+#include "arch/x86/cpuinfo.h"
+#include "arch/x86/pit.h"
+
+#if defined(NOCTURNE_X86) && defined(__SSE2__)
+    #include <emmintrin.h>
+
+    #define CHECKSUM_SSE2
+#endif
+
+// Packet data has no alignment guarantees, x86 loads it unaligned without penalty.
+typedef uint16_t __attribute__((aligned(1), may_alias)) unaligned_u16;
+typedef uint32_t __attribute__((aligned(1), may_alias)) unaligned_u32;
+
+// Shorter runs are not worth the SSE2 setup and the horizontal sum.
+#define CHECKSUM_SSE2_MIN 64
+
+static uint32_t checksum_fold64(uint64_t acc) {
+    acc = (acc & 0xFFFFFFFF) + (acc >> 32);
+    acc = (acc & 0xFFFFFFFF) + (acc >> 32);
+
+    return (uint32_t)acc;
+}
+
+#ifdef CHECKSUM_SSE2
+/**
+ * Sums `blocks` 32-byte blocks as 32-bit words in two 64-bit lanes, which never overflow.
+ * Sums of 32-bit words fold into the same 16-bit one's complement sum as sums of 16-bit words.
+ */
+static inline __attribute__((always_inline)) uint64_t checksum_run_sse2(uint8_t* dst, const uint8_t* src,
+                                                                        size_t blocks, bool copy) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lanes = zero;
+
+    for(size_t i = 0; i < blocks; i++) {
+        __m128i a = _mm_loadu_si128((const __m128i*)src);
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + 16));
+
+        if(copy) {
+            _mm_storeu_si128((__m128i*)dst, a);
+            _mm_storeu_si128((__m128i*)(dst + 16), b);
+            dst += 32;
+        }
+
+        lanes = _mm_add_epi64(lanes, _mm_unpacklo_epi32(a, zero));
+        lanes = _mm_add_epi64(lanes, _mm_unpackhi_epi32(a, zero));
+        lanes = _mm_add_epi64(lanes, _mm_unpacklo_epi32(b, zero));
+        lanes = _mm_add_epi64(lanes, _mm_unpackhi_epi32(b, zero));
+
+        src += 32;
+    }
+
+    uint64_t out[2];
+    _mm_storeu_si128((__m128i*)out, lanes);
+
+    return out[0] + out[1];
+}
+#endif
+
+// Common body of `checksum_partial` and `checksum_copy`, `copy` is a constant in both.
+static inline __attribute__((always_inline)) uint32_t checksum_run(uint8_t* dst, const uint8_t* src, size_t len,
+                                                                   uint32_t sum, bool copy) {
+    uint64_t acc = sum;
+
+#ifdef CHECKSUM_SSE2
+    if(len >= CHECKSUM_SSE2_MIN) {
+        size_t blocks = len / 32;
+
+        acc += checksum_run_sse2(dst, src, blocks, copy);
+
+        src += blocks * 32;
+        dst += copy ? blocks * 32 : 0;
+        len -= blocks * 32;
+    }
+#endif
+
+    // 64-bit accumulator takes 2^32 words before it can overflow, far more than any buffer.
+    while(len >= 16) {
+        uint32_t w0 = ((const unaligned_u32*)src)[0];
+        uint32_t w1 = ((const unaligned_u32*)src)[1];
+        uint32_t w2 = ((const unaligned_u32*)src)[2];
+        uint32_t w3 = ((const unaligned_u32*)src)[3];
+
+        if(copy) {
+            ((unaligned_u32*)dst)[0] = w0;
+            ((unaligned_u32*)dst)[1] = w1;
+            ((unaligned_u32*)dst)[2] = w2;
+            ((unaligned_u32*)dst)[3] = w3;
+            dst += 16;
+        }
+
+        acc += (uint64_t)w0 + w1 + w2 + w3;
+
+        src += 16;
+        len -= 16;
+    }
+
+    while(len >= 4) {
+        uint32_t w = *(const unaligned_u32*)src;
+
+        if(copy) {
+            *(unaligned_u32*)dst = w;
+            dst += 4;
+        }
+
+        acc += w;
+
+        src += 4;
+        len -= 4;
+    }
+
+    if(len >= 2) {
+        uint16_t w = *(const unaligned_u16*)src;
+
+        if(copy) {
+            *(unaligned_u16*)dst = w;
+            dst += 2;
+        }
+
+        acc += w;
+
+        src += 2;
+        len -= 2;
+    }
+
+    // The odd byte is padded with zero, it is the first byte of a word in network order.
+    if(len) {
+        if(copy) {
+            *dst = *src;
+        }
+
+        acc += (uint16_t)(htons((uint16_t)*src << 8));
+    }
+
+    return checksum_fold64(acc);
+}
+
+/**
+ * @brief Добавляет данные к частичной сумме
+ *
+ * @param data - Данные
+ * @param len - Длина в байтах
+ * @param sum - Сумма предыдущих данных (0 для первого блока)
+ * @return uint32_t - Частичная сумма, её сворачивает `checksum_fold`
+ */
+__attribute__((force_align_arg_pointer)) uint32_t checksum_partial(const void* data, size_t len, uint32_t sum) {
+    return checksum_run(NULL, data, len, sum, false);
+}
+
+/**
+ * @brief Копирует данные и суммирует их за один проход
+ *
+ * @param dst - Куда копировать
+ * @param src - Откуда копировать
+ * @param len - Длина в байтах
+ * @param sum - Сумма предыдущих данных
+ * @return uint32_t - Частичная сумма
+ */
+__attribute__((force_align_arg_pointer)) uint32_t checksum_copy(void* dst, const void* src, size_t len, uint32_t sum) {
+    return checksum_run(dst, src, len, sum, true);
+}
+
+/**
+ * @brief Добавляет псевдозаголовок IPv4 к сумме, не собирая его в памяти
+ *
+ * @param src - Адрес отправителя
+ * @param dst - Адрес получателя
+ * @param protocol - Протокол (IP_PROTOCOL_*)
+ * @param length - Длина заголовка транспортного уровня и данных
+ * @param sum - Сумма, к которой добавляется псевдозаголовок
+ * @return uint32_t - Частичная сумма
+ */
+uint32_t checksum_pseudo_header(const uint8_t src[4], const uint8_t dst[4], uint8_t protocol, uint16_t length,
+                                uint32_t sum) {
+    uint64_t acc = sum;
+
+    acc += *(const unaligned_u32*)src;
+    acc += *(const unaligned_u32*)dst;
+    // Zero byte and the protocol, then the length, both as words in network order.
+    acc += htons(protocol);
+    acc += htons(length);
+
+    return checksum_fold64(acc);
+}
+
+/**
+ * @brief Обновляет контрольную сумму после замены 16-битного поля (RFC 1624)
+ *
+ * @param check - Значение поля контрольной суммы
+ * @param old_value - Старое значение поля, как оно лежит в пакете
+ * @param new_value - Новое значение поля, как оно лежит в пакете
+ * @return uint16_t - Новое значение поля контрольной суммы
+ */
+uint16_t checksum_replace16(uint16_t check, uint16_t old_value, uint16_t new_value) {
+    uint32_t sum = (uint16_t)~check;
+
+    sum = checksum_add(sum, (uint16_t)~old_value);
+    sum = checksum_add(sum, new_value);
+
+    return checksum_fold(sum);
+}
+
+/**
+ * @brief Обновляет контрольную сумму после замены 32-битного поля (например, адреса)
+ *
+ * @param check - Значение поля контрольной суммы
+ * @param old_value - Старое значение поля, как оно лежит в пакете
+ * @param new_value - Новое значение поля, как оно лежит в пакете
+ * @return uint16_t - Новое значение поля контрольной суммы
+ */
+uint16_t checksum_replace32(uint16_t check, uint32_t old_value, uint32_t new_value) {
+    uint32_t sum = (uint16_t)~check;
+
+    sum = checksum_add(sum, ~old_value);
+    sum = checksum_add(sum, new_value);
+
+    return checksum_fold(sum);
+}
+
+/**
+ * @brief Считает контрольную сумму блока целиком
+ *
+ * @param data - Данные
+ * @param len - Длина в байтах
+ * @return uint16_t - Значение поля контрольной суммы (0, если блок с ней цел)
+ */
+uint16_t checksum(const void* data, size_t len) {
+    return checksum_fold(checksum_partial(data, len, 0));
+}
+
+// Word at a time, as every protocol used to do it. Kept as the baseline of the benchmark.
+static uint32_t checksum_reference(const void* data, size_t len) {
+    const uint16_t* ptr = data;
+    uint32_t sum = 0;
+
+    while(len > 1) {
+        sum += *ptr++;
+        len -= 2;
+    }
+
+    if(len > 0) {
+        sum += *(const uint8_t*)ptr;
+    }
+
+    while(sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+
+    return sum;
+}
+
+/**
+ * @brief Измеряет скорость подсчёта контрольных сумм и сверяет результаты
+ *
+ * @param length - Длина буфера в байтах
+ * @param rounds - Количество проходов каждого варианта
+ * @param out - Такты TSC на все проходы каждого варианта
+ * @return true - Если результаты всех вариантов совпали
+ */
+bool checksum_benchmark(size_t length, size_t rounds, checksum_bench_t* out) {
+    if(length == 0 || rounds == 0 || out == NULL) {
+        return false;
+    }
+
+    uint8_t* src = kmalloc_common(length, 16);
+    uint8_t* dst = kmalloc_common(length, 16);
+
+    if(src == NULL || dst == NULL) {
+        kfree(src);
+        kfree(dst);
+
+        return false;
+    }
+
+    for(size_t i = 0; i < length; i++) {
+        src[i] = rand();
+    }
+
+    uint16_t expected = (uint16_t)~checksum_reference(src, length);
+    bool valid = checksum(src, length) == expected;
+
+    memset(dst, 0, length);
+    valid &= checksum_fold(checksum_copy(dst, src, length, 0)) == expected;
+    valid &= memcmp((const char*)dst, (const char*)src, length) == 0;
+
+    // Sums of the odd tail taken at an odd offset must match too.
+    if(length > 1) {
+        uint32_t sum = checksum_partial(src, 1, 0);
+        sum = checksum_block_add(sum, checksum_partial(src + 1, length - 1, 0), 1);
+
+        valid &= checksum_fold(sum) == expected;
+    }
+
+    if(!valid) {
+        qemu_err("Checksum mismatch on %d bytes", length);
+    }
+
+    volatile uint32_t sink = 0;
+    uint64_t start;
+
+    start = rdtsc();
+    for(size_t i = 0; i < rounds; i++) {
+        sink += checksum_reference(src, length);
+    }
+    out->reference_tsc = rdtsc() - start;
+
+    start = rdtsc();
+    for(size_t i = 0; i < rounds; i++) {
+        sink += checksum_partial(src, length, 0);
+    }
+    out->partial_tsc = rdtsc() - start;
+
+    start = rdtsc();
+    for(size_t i = 0; i < rounds; i++) {
+        memcpy(dst, src, length);
+        sink += checksum_partial(dst, length, 0);
+    }
+    out->memcpy_tsc = rdtsc() - start;
+
+    start = rdtsc();
+    for(size_t i = 0; i < rounds; i++) {
+        sink += checksum_copy(dst, src, length, 0);
+    }
+    out->copy_tsc = rdtsc() - start;
+
+    (void)sink;
+
+    out->tsc_per_ms = timer_tsc_per_ms();
+#ifdef CHECKSUM_SSE2
+    out->sse2 = true;
+#else
+    out->sse2 = false;
+#endif
+
+    kfree(src);
+    kfree(dst);
+
+    return valid;
+}
@@ -168,6 +168,10 @@ void dhcp_init_all_cards() {
 	for(size_t i = 0; i < netcards_get_count(); i++) {
 		netcard_entry_t* card = netcard_get(i);
 
+		if(card->features & NETCARD_FEATURE_LOOPBACK) {
+			continue;
+		}
+
 		qemu_log("Initializing DHCP for: %s", card->name);
 
 		dhcp_discover(card);
@@ -91,25 +91,36 @@ void ethernet_dump(void* data, size_t size, uint16_t type){
 	}
 }
 
-void ethernet_send_packet(netcard_entry_t* card, uint8_t* dest_mac, uint8_t* data, size_t len, uint16_t type) {
+void ethernet_send_netbuf(netcard_entry_t* card, const uint8_t* dest_mac, netbuf_t* buf, uint16_t type) {
     assert(card == 0, "%s", "Card is nullptr.");
 
-    uint8_t src_mac[6];
-    card->get_mac_addr(src_mac);
-    
-    ethernet_frame_t* frame = kmalloc(sizeof(ethernet_frame_t) + len);
-    void* frame_data = (char*)frame + sizeof(ethernet_frame_t);
+    // Short frames are padded up to the minimum in place.
+    if(buf->len + sizeof(ethernet_frame_t) < ETHERNET_MIN_FRAME_SIZE) {
+        size_t padding = ETHERNET_MIN_FRAME_SIZE - sizeof(ethernet_frame_t) - buf->len;
+
+        memset(netbuf_put(buf, padding), 0, padding);
+    }
 
-    memcpy(frame->src_mac, src_mac, 6);
+    ethernet_frame_t* frame = netbuf_push(buf, sizeof(ethernet_frame_t));
+
+    card->get_mac_addr(frame->src_mac);
     memcpy(frame->dest_mac, dest_mac, 6);
-    memcpy(frame_data, data, len);
 
     frame->type = htons(type);
 
-    netstack_push(card, frame, sizeof(ethernet_frame_t) + len);
-    //card->send_packet(frame, sizeof(ethernet_frame_t) + len);
+    netstack_push_netbuf(card, buf);
+}
+
+void ethernet_send_packet(netcard_entry_t* card, uint8_t* dest_mac, uint8_t* data, size_t len, uint16_t type) {
+    netbuf_t* buf = netbuf_alloc(NETBUF_HEADROOM, len);
+
+    if(buf == NULL) {
+        return;
+    }
+
+    memcpy(netbuf_put(buf, len), data, len);
 
-    kfree(frame);
+    ethernet_send_netbuf(card, dest_mac, buf, type);
 }
 
 void ethernet_handle_packet(netcard_entry_t *card, ethernet_frame_t *packet, size_t len) {
@@ -1,7 +1,41 @@
 #include "net/icmp.h"
+#include "net/ipv4.h"
+#include "net/netbuf.h"
+#include "net/checksum.h"
+#include "lib/string.h"
 #include <io/logging.h>
 
-void icmp_handle_packet(SAYORI_UNUSED netcard_entry_t* card, SAYORI_UNUSED char* packet_data) {
-	qemu_log("Type: %x", *packet_data);
-	qemu_log("Code: %x", *(packet_data + 1));
-}
\ No newline at end of file
+void icmp_handle_packet(netcard_entry_t* card, ipv4_packet_t* ip, char* packet_data, size_t length) {
+	if(length < sizeof(icmp_header_t) || checksum(packet_data, length) != 0) {
+		return;
+	}
+
+	icmp_header_t* header = (icmp_header_t*)packet_data;
+
+	qemu_log("Type: %x", header->type);
+	qemu_log("Code: %x", header->code);
+
+	if(header->type != ICMP_ECHO_REQUEST || header->code != 0) {
+		return;
+	}
+
+	netbuf_t* buf = netbuf_alloc(NETBUF_HEADROOM, length);
+
+	if(buf == NULL) {
+		return;
+	}
+
+	// The reply is the request with another type, so only the first word of the sum changes.
+	icmp_header_t* reply = netbuf_put(buf, length);
+	memcpy(reply, packet_data, length);
+
+	uint16_t old_word, new_word;
+	memcpy(&old_word, reply, 2);
+
+	reply->type = ICMP_ECHO_REPLY;
+
+	memcpy(&new_word, reply, 2);
+	reply->checksum = checksum_replace16(reply->checksum, old_word, new_word);
+
+	ipv4_send_netbuf(card, ip->Source, buf, ETH_IPv4_HEAD_ICMPv4);
+}
@@ -12,12 +12,23 @@
 #include "net/udp.h"
 #include "net/icmp.h"
 #include "net/tcp.h"
+#include "net/checksum.h"
 
 void ipv4_handle_packet(netcard_entry_t *card, char *packet, size_t packet_size) {
 	ipv4_packet_t* ipv4_pkt = (ipv4_packet_t*)packet;
 
+	if(packet_size < sizeof(ipv4_packet_t) || checksum(ipv4_pkt, sizeof(ipv4_packet_t)) != 0) {
+		qemu_warn("IPv4: Bad header checksum, dropped");
+		return;
+	}
+
 	ipv4_pkt->TotalLength = ntohs(ipv4_pkt->TotalLength);
 
+	// Frames may be padded, but never shorter than the packet.
+	if(ipv4_pkt->TotalLength < sizeof(ipv4_packet_t) || ipv4_pkt->TotalLength > packet_size) {
+		return;
+	}
+
 	qemu_warn("IPV4");
 	qemu_log("  |--- Version: %x", ipv4_pkt->Version);
 	qemu_log("  |--- DSF: %x", ipv4_pkt->DSF);
@@ -40,19 +51,21 @@ void ipv4_handle_packet(netcard_entry_t *card, char *packet, size_t packet_size)
 			eth_frame->src_mac[4],
 			eth_frame->src_mac[5]);
 
-	// EXPERIMENTAL!
-	arp_lookup_add(eth_frame->src_mac, ipv4_pkt->Source);
+	// Peers talking to us are on the link, remember them to answer without a request.
+	if(!(card->features & NETCARD_FEATURE_LOOPBACK)) {
+		arp_lookup_add(card, eth_frame->src_mac, ipv4_pkt->Source);
+	}
 
 	if (ipv4_pkt->Protocol == ETH_IPv4_HEAD_UDP) {
-		udp_handle_packet(card, (udp_packet_t *) (packet + sizeof(ipv4_packet_t)));
+		udp_handle_packet(card, ipv4_pkt, (udp_packet_t *) (packet + sizeof(ipv4_packet_t)));
 	} else if(ipv4_pkt->Protocol == ETH_IPv4_HEAD_ICMPv4) {
-		qemu_err("ICMP not implemented!");
-
-		icmp_handle_packet(card, packet + sizeof(ipv4_packet_t));
+		icmp_handle_packet(card, ipv4_pkt, packet + sizeof(ipv4_packet_t),
+						   ipv4_pkt->TotalLength - sizeof(ipv4_packet_t));
 	} else if(ipv4_pkt->Protocol == ETH_IPv4_HEAD_TCP) {
        		qemu_note("HANDLING TCP!");
 
-        	tcp_handle_packet(card, (tcp_packet_t*)(packet + sizeof(ipv4_packet_t)));
+		tcp_handle_packet(card, ipv4_pkt, (tcp_packet_t*)(packet + sizeof(ipv4_packet_t)),
+						  ipv4_pkt->TotalLength - sizeof(ipv4_packet_t));
 	} else {
 		#ifndef RELEASE
 		qemu_log("  | |--- Header: [%x] %s", ipv4_pkt->Protocol, "Unknown");
@@ -64,29 +77,14 @@ void ipv4_handle_packet(netcard_entry_t *card, char *packet, size_t packet_size)
 	}
 }
 
-uint16_t ipv4_checksum(ipv4_packet_t* packet) {
-	// Treat the packet header as a 2-byte-integer array
-	// Sum all integers up and flip all bits
-	size_t array_size = sizeof(ipv4_packet_t) / 2;
-	uint16_t* array = (uint16_t*)packet;
-	uint32_t sum = 0;
-
-	for(size_t i = 0; i < array_size; i++) {
-		sum += bit_flip_short(array[i]);
-	}
+void ipv4_send_netbuf(netcard_entry_t *card, const uint8_t dest_ip[4], netbuf_t* buf, uint8_t protocol) {
+	size_t size = buf->len;
 
-	uint32_t carry = sum >> 16;
-	sum = sum & 0x0000ffff;
-	sum = sum + carry;
-
-	return ~sum;
-}
+	qemu_log("IP send: %d bytes", size);
 
-void ipv4_send_packet(netcard_entry_t *card, uint8_t dest_ip[4], const void *data, size_t size, uint8_t protocol) {
-	ipv4_packet_t* ipv4_pkt = kcalloc(1, sizeof(ipv4_packet_t) + size);
-	char* pkt_data = (char*)ipv4_pkt + sizeof(ipv4_packet_t);
+	ipv4_packet_t* ipv4_pkt = netbuf_push(buf, sizeof(ipv4_packet_t));
 
-	qemu_log("IP send: %d bytes", size);
+	memset(ipv4_pkt, 0, sizeof(ipv4_packet_t));
 
 	ipv4_pkt->Version = 4;
 	ipv4_pkt->HeaderLength = 5;
@@ -99,30 +97,22 @@ void ipv4_send_packet(netcard_entry_t *card, uint8_t dest_ip[4], const void *dat
 	ipv4_pkt->Checksum = 0;
 	ipv4_pkt->ID = 0;
 
-	ipv4_pkt->Checksum = htons(ipv4_checksum(ipv4_pkt));
-
-	memcpy(pkt_data, data, size);
-
-	uint8_t dest_mac[6] = {0};
-	uint8_t arp_zero[6] = {0};
+	ipv4_pkt->Checksum = checksum(ipv4_pkt, sizeof(ipv4_packet_t));
 
-	size_t spin = 10;
+	qemu_log("Total IP packet size: %d", buf->len);
 
-	while(!arp_lookup(dest_mac, dest_ip) && --spin) {
-		arp_send_packet(card, arp_zero, dest_ip);
-	}
+	// Queued until the neighbor is resolved, so this never blocks.
+	arp_output(card, dest_ip, buf);
+}
 
-	if(spin == 0) {
-		qemu_err("%u.%u.%u.%u is unreachable", dest_ip[0], dest_ip[1], dest_ip[2], dest_ip[3]);
+void ipv4_send_packet(netcard_entry_t *card, uint8_t dest_ip[4], const void *data, size_t size, uint8_t protocol) {
+	netbuf_t* buf = netbuf_alloc(NETBUF_HEADROOM, size);
 
-		goto end;
+	if(buf == NULL) {
+		return;
 	}
 
-	qemu_log("Total IP packet size: %d", sizeof(ipv4_packet_t) + size);
-
-	ethernet_send_packet(card, dest_mac, (uint8_t *) ipv4_pkt, sizeof(ipv4_packet_t) + size, ETHERNET_TYPE_IPV4);
-
-	end:
+	memcpy(netbuf_put(buf, size), data, size);
 
-	kfree(ipv4_pkt);
+	ipv4_send_netbuf(card, dest_ip, buf, protocol);
 }
@@ -0,0 +1,45 @@
+/**
+ * @file net/loopback.c
+ * @brief Петлевая сетевая карта `lo` (127.0.0.1)
+ * @date 2026-10-19
+ * @copyright Copyright SayoriOS Team (c) 2022-2026
+ */
+
+#include "net/loopback.h"
+#include "net/stack.h"
+#include "net/netbuf.h"
+#include "lib/string.h"
+#include <io/logging.h>
+
+static void loopback_get_mac(uint8_t mac[6]) {
+	memset(mac, 0, 6);
+}
+
+// Frame goes back into the RX ring as is: no copy and no checksum offload needed,
+// protocols sum it in software like with any card without NETCARD_FEATURE_TX_CSUM.
+static bool loopback_send_netbuf(netbuf_t* buf) {
+	netstack_receive_netbuf(buf->card, buf);
+
+	return true;
+}
+
+static void loopback_send_packet(void* data, size_t length);
+
+static netcard_entry_t loopback_card = {
+	.name = "lo",
+	.ipv4_addr = {127, 0, 0, 1},
+	.get_mac_addr = loopback_get_mac,
+	.send_packet = loopback_send_packet,
+	.send_netbuf = loopback_send_netbuf,
+	.features = NETCARD_FEATURE_LOOPBACK,
+};
+
+static void loopback_send_packet(void* data, size_t length) {
+	netstack_transfer(&loopback_card, data, length);
+}
+
+void loopback_init() {
+	netcard_add(&loopback_card);
+
+	qemu_ok("Loopback card is up: 127.0.0.1");
+}
@@ -0,0 +1,282 @@
+/**
+ * @file net/netbench.c
+ * @brief Замеры сетевого стека через петлевую карту
+ * @date 2026-10-19
+ * @copyright Copyright SayoriOS Team (c) 2022-2026
+ */
+
+#include "net/netbench.h"
+#include "net/socket.h"
+#include "net/errno.h"
+#include "net/cards.h"
+#include "lib/math.h"
+#include "lib/string.h"
+#include "mem/vmm.h"
+#include "arch/x86/cpuinfo.h"
+#include "arch/x86/pit.h"
+#include <io/logging.h>
+
+static const socket_address_t netbench_address = {
+    .address = {127, 0, 0, 1},
+    .port = NETBENCH_PORT,
+};
+
+typedef struct {
+    netcard_entry_t*    card;
+    netstack_stats_t    stats;
+    netstack_counters_t counters;
+    uint64_t            start_tsc;
+} netbench_run_t;
+
+static bool netbench_prepare(netbench_run_t* run) {
+    run->card = netcard_route(netbench_address.address);
+
+    return run->card && (run->card->features & NETCARD_FEATURE_LOOPBACK);
+}
+
+static void netbench_start(netbench_run_t* run) {
+    netstack_get_stats(run->card, &run->stats);
+    netstack_get_counters(&run->counters);
+
+    run->start_tsc = rdtsc();
+}
+
+// Everything else using the stack at the same time is counted too.
+static void netbench_finish(const netbench_run_t* run, netbench_result_t* out) {
+    uint64_t cycles = rdtsc() - run->start_tsc;
+    uint64_t tsc_per_ms = timer_tsc_per_ms();
+
+    netstack_stats_t stats;
+    netstack_counters_t counters;
+
+    netstack_get_stats(run->card, &stats);
+    netstack_get_counters(&counters);
+
+    out->elapsed_us = tsc_per_ms ? cycles * 1000 / tsc_per_ms : 0;
+    out->frames = stats.tx_packets - run->stats.tx_packets;
+    out->counters.allocations = counters.allocations - run->counters.allocations;
+    out->counters.heap_allocations = counters.heap_allocations - run->counters.heap_allocations;
+    out->counters.copies = counters.copies - run->counters.copies;
+    out->counters.copied_bytes = counters.copied_bytes - run->counters.copied_bytes;
+}
+
+/**
+ * @brief Скорость пересылки датаграмм UDP через 127.0.0.1
+ *
+ * Датаграммы отправляются пачками по NETBENCH_UDP_BURST, каждая пачка дожидается приёма.
+ *
+ * @param count - Количество датаграмм
+ * @param payload - Размер датаграммы (до SOCKET_UDP_MAX_PAYLOAD)
+ * @param out - Результат
+ * @return ssize_t - 0 или -NET_E*
+ */
+ssize_t netbench_udp(size_t count, size_t payload, netbench_result_t* out) {
+    memset(out, 0, sizeof(netbench_result_t));
+
+    if(payload == 0 || payload > SOCKET_UDP_MAX_PAYLOAD) {
+        return -NET_EMSGSIZE;
+    }
+
+    netbench_run_t run;
+
+    if(!netbench_prepare(&run)) {
+        return -NET_ENETUNREACH;
+    }
+
+    ssize_t result = 0;
+    ssize_t server = socket_create(SOCKET_AF_INET, SOCKET_DGRAM, 0);
+    ssize_t client = socket_create(SOCKET_AF_INET, SOCKET_DGRAM, 0);
+    uint8_t* data = kcalloc(payload, 1);
+
+    if(server < 0 || client < 0) {
+        result = server < 0 ? server : client;
+        goto end;
+    }
+
+    if(data == NULL) {
+        result = -NET_ENOMEM;
+        goto end;
+    }
+
+    result = socket_bind(server, &netbench_address);
+
+    if(result < 0) {
+        goto end;
+    }
+
+    netbench_start(&run);
+
+    for(size_t sent = 0; sent < count;) {
+        size_t burst = MIN(count - sent, (size_t)NETBENCH_UDP_BURST);
+        size_t received = 0;
+
+        for(size_t i = 0; i < burst; i++) {
+            result = socket_sendto(client, data, payload, 0, &netbench_address);
+
+            if(result < 0) {
+                goto end;
+            }
+        }
+
+        sent += burst;
+
+        while(received < burst) {
+            result = socket_recvfrom(server, data, payload, SOCKET_MSG_DONTWAIT, NULL);
+
+            if(result >= 0) {
+                received++;
+                out->bytes += result;
+                continue;
+            }
+
+            if(result != -NET_EAGAIN) {
+                goto end;
+            }
+
+            socket_poll_t fd = {.fd = server, .events = SOCKET_POLL_IN};
+
+            if(socket_poll(&fd, 1, NETBENCH_TIMEOUT_MS) <= 0) {
+                break;
+            }
+        }
+
+        out->datagrams += received;
+        out->lost += burst - received;
+    }
+
+    result = 0;
+
+    netbench_finish(&run, out);
+
+    qemu_log("NETBENCH UDP: %d x %d bytes, %d lost, %d us", count, payload, out->lost, (uint32_t)out->elapsed_us);
+
+end:
+    if(server >= 0) {
+        socket_close(server);
+    }
+
+    if(client >= 0) {
+        socket_close(client);
+    }
+
+    kfree(data);
+
+    return result;
+}
+
+/**
+ * @brief Скорость передачи потока TCP через 127.0.0.1
+ *
+ * Отправитель и получатель работают в одном потоке на неблокирующих вызовах.
+ *
+ * @param bytes - Сколько передать
+ * @param out - Результат
+ * @return ssize_t - 0 или -NET_E*
+ */
+ssize_t netbench_tcp(size_t bytes, netbench_result_t* out) {
+    memset(out, 0, sizeof(netbench_result_t));
+
+    netbench_run_t run;
+
+    if(!netbench_prepare(&run)) {
+        return -NET_ENETUNREACH;
+    }
+
+    ssize_t result = 0;
+    ssize_t server = -1;
+    ssize_t listener = socket_create(SOCKET_AF_INET, SOCKET_STREAM, 0);
+    ssize_t client = socket_create(SOCKET_AF_INET, SOCKET_STREAM, 0);
+    uint8_t* data = kcalloc(NETBENCH_TCP_CHUNK, 1);
+
+    if(listener < 0 || client < 0) {
+        result = listener < 0 ? listener : client;
+        goto end;
+    }
+
+    if(data == NULL) {
+        result = -NET_ENOMEM;
+        goto end;
+    }
+
+    // The stack completes the handshake by itself, so a blocking connect is safe before accept.
+    if((result = socket_bind(listener, &netbench_address)) < 0
+       || (result = socket_listen(listener, 1)) < 0
+       || (result = socket_connect(client, &netbench_address)) < 0) {
+        goto end;
+    }
+
+    server = socket_accept(listener, NULL);
+
+    if(server < 0) {
+        result = server;
+        goto end;
+    }
+
+    netbench_start(&run);
+
+    size_t sent = 0;
+
+    while(out->bytes < bytes) {
+        bool progress = false;
+
+        if(sent < bytes) {
+            result = socket_send(client, data, MIN(bytes - sent, (size_t)NETBENCH_TCP_CHUNK), SOCKET_MSG_DONTWAIT);
+
+            if(result > 0) {
+                sent += result;
+                progress = true;
+            } else if(result != -NET_EAGAIN) {
+                goto end;
+            }
+        }
+
+        result = socket_recv(server, data, NETBENCH_TCP_CHUNK, SOCKET_MSG_DONTWAIT);
+
+        if(result > 0) {
+            out->bytes += result;
+            progress = true;
+        } else if(result == 0) {
+            result = -NET_ECONNRESET;
+            goto end;
+        } else if(result != -NET_EAGAIN) {
+            goto end;
+        }
+
+        if(progress) {
+            continue;
+        }
+
+        socket_poll_t fds[2] = {
+            {.fd = server, .events = SOCKET_POLL_IN},
+            {.fd = client, .events = SOCKET_POLL_OUT},
+        };
+
+        if(socket_poll(fds, sent < bytes ? 2 : 1, NETBENCH_TIMEOUT_MS) <= 0) {
+            result = -NET_ETIMEDOUT;
+            goto end;
+        }
+    }
+
+    result = 0;
+
+    netbench_finish(&run, out);
+
+    qemu_log("NETBENCH TCP: %d bytes, %d frames, %d us", bytes, out->frames, (uint32_t)out->elapsed_us);
+
+end:
+    if(server >= 0) {
+        socket_close(server);
+    }
+
+    if(client >= 0) {
+        socket_close(client);
+    }
+
+    if(listener >= 0) {
+        socket_close(listener);
+    }
+
+    kfree(data);
+
+    return result;
+}
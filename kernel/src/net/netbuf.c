@@ -0,0 +1,161 @@
+/**
+ * @file net/netbuf.c
+ * @author NDRAEY (pikachu_andrey@vk.com)
+ * @brief Буферы сетевых пакетов с резервом под заголовки
+ * @version 0.4.3
+ * @date 2026-10-19
+ * @copyright Copyright SayoriOS Team (c) 2022-2026
+ */
+
+#include "net/netbuf.h"
+#include "net/checksum.h"
+#include "net/stack.h"
+#include "mem/vmm.h"
+#include "mem/pmm.h"
+#include "sys/sync.h"
+#include <io/logging.h>
+
+static netbuf_t* netbuf_cache = NULL;
+static size_t netbuf_cache_count = 0;
+
+/**
+ * @brief Выделяет буфер пакета
+ *
+ * @param headroom - Место, оставляемое под заголовки (обычно NETBUF_HEADROOM)
+ * @param length - Размер данных, которые будут добавлены `netbuf_put`
+ * @return netbuf_t* - Пустой буфер (len = 0) или NULL, если пакет не помещается или нет памяти
+ */
+netbuf_t* netbuf_alloc(size_t headroom, size_t length) {
+    if(headroom + length > NETBUF_SIZE) {
+        qemu_err("Packet is too big: %d + %d bytes", headroom, length);
+        return NULL;
+    }
+
+    size_t flags = irq_save();
+
+    netbuf_t* buf = netbuf_cache;
+
+    if(buf) {
+        netbuf_cache = buf->next;
+        netbuf_cache_count--;
+    }
+
+    irq_restore(flags);
+
+    netstack_count_allocation(buf == NULL);
+
+    if(buf == NULL) {
+        buf = kcalloc(sizeof(netbuf_t), 1);
+
+        if(buf == NULL) {
+            return NULL;
+        }
+
+        buf->head = kmalloc_common(NETBUF_SIZE, NETBUF_SIZE);
+
+        if(buf->head == NULL) {
+            kfree(buf);
+            return NULL;
+        }
+
+        buf->capacity = NETBUF_SIZE;
+        buf->phys = virt2phys_precise(get_kernel_page_directory(), (virtual_addr_t)buf->head);
+    }
+
+    buf->next = NULL;
+    buf->card = NULL;
+    buf->data = buf->head + headroom;
+    buf->len = 0;
+    buf->csum_partial = false;
+    buf->csum_valid = false;
+
+    return buf;
+}
+
+/**
+ * @brief Освобождает буфер пакета (возвращает его в кэш, если там есть место)
+ */
+void netbuf_free(netbuf_t* buf) {
+    if(buf == NULL) {
+        return;
+    }
+
+    size_t flags = irq_save();
+
+    if(netbuf_cache_count < NETBUF_CACHE_SIZE) {
+        buf->next = netbuf_cache;
+        netbuf_cache = buf;
+        netbuf_cache_count++;
+
+        irq_restore(flags);
+
+        return;
+    }
+
+    irq_restore(flags);
+
+    kfree(buf->head);
+    kfree(buf);
+}
+
+/**
+ * @brief Добавляет место в конец пакета
+ *
+ * @return void* - Указатель на добавленное место
+ */
+void* netbuf_put(netbuf_t* buf, size_t length) {
+    assert(netbuf_tailroom(buf) < length, "No tailroom for %d bytes", length);
+
+    void* tail = buf->data + buf->len;
+
+    buf->len += length;
+    // The caller writes the data itself, the sum no longer covers it.
+    buf->csum_valid = false;
+
+    return tail;
+}
+
+/**
+ * @brief Копирует данные в конец пакета, попутно считая их контрольную сумму
+ *
+ * Сумма всех данных, добавленных так в пустой буфер, остаётся в `csum`,
+ * транспортному уровню остаётся досчитать только свой заголовок.
+ */
+void netbuf_put_copy(netbuf_t* buf, const void* data, size_t length) {
+    size_t offset = buf->len;
+    bool valid = offset == 0 || buf->csum_valid;
+
+    uint32_t sum = checksum_copy(netbuf_put(buf, length), data, length, 0);
+    netstack_count_copy(length);
+
+    buf->csum = offset ? checksum_block_add(buf->csum, sum, offset) : sum;
+    buf->csum_valid = valid;
+}
+
+/**
+ * @brief Добавляет место под заголовок в начало пакета
+ *
+ * @return void* - Новое начало пакета
+ */
+void* netbuf_push(netbuf_t* buf, size_t length) {
+    assert(netbuf_headroom(buf) < length, "No headroom for %d bytes", length);
+
+    buf->data -= length;
+    buf->len += length;
+
+    return buf->data;
+}
+
+/**
+ * @brief Убирает заголовок из начала пакета
+ *
+ * @return void* - Новое начало пакета
+ */
+void* netbuf_pull(netbuf_t* buf, size_t length) {
+    assert(buf->len < length, "Packet is shorter than %d bytes", length);
+
+    buf->data += length;
+    buf->len -= length;
+
+    return buf->data;
+}
@@ -0,0 +1,842 @@
+/**
+ * @file net/socket.c
+ * @author NDRAEY (pikachu_andrey@vk.com)
+ * @brief Сокеты Беркли поверх TCP и UDP для пользовательских программ
+ * @version 0.4.3
+ * @date 2026-10-19
+ * @copyright Copyright SayoriOS Team (c) 2022-2026
+ */
+
+#include "net/socket.h"
+#include "net/errno.h"
+#include "net/cards.h"
+#include "net/udp.h"
+#include "net/netbuf.h"
+#include "net/stack.h"
+#include "lib/idtable.h"
+#include "lib/math.h"
+#include "lib/string.h"
+#include "mem/vmm.h"
+#include "sys/sync.h"
+#include "arch/x86/pit.h"
+#include <io/logging.h>
+
+_Static_assert(SOCKET_POLL_IN == TCP_POLL_IN && SOCKET_POLL_OUT == TCP_POLL_OUT
+               && SOCKET_POLL_ERR == TCP_POLL_ERR && SOCKET_POLL_HUP == TCP_POLL_HUP,
+               "TCP readiness bits are passed to poll as is");
+
+static idtable_t socket_table = {0};
+static mutex_t socket_table_lock = {false};
+
+static void socket_table_lock_acquire() {
+    while(__atomic_test_and_set(&socket_table_lock.lock, __ATOMIC_ACQUIRE)) {
+        yield();
+    }
+}
+
+void sockets_init() {
+    idtable_init(&socket_table, SOCKET_TABLE_BITS);
+}
+
+static void socket_free(socket_t* sock);
+
+// Takes a reference, the caller drops it with `socket_put`.
+static socket_t* socket_get(int32_t fd) {
+    if(fd < 0) {
+        return NULL;
+    }
+
+    socket_table_lock_acquire();
+
+    socket_t* sock = idtable_get(&socket_table, (size_t)fd);
+
+    // Descriptors are global, a process only gets its own.
+    if(sock == NULL || sock->owner != get_current_proc()->pid) {
+        mutex_release(&socket_table_lock);
+        return NULL;
+    }
+
+    sock->refs++;
+
+    mutex_release(&socket_table_lock);
+
+    return sock;
+}
+
+static void socket_put(socket_t* sock) {
+    socket_table_lock_acquire();
+
+    bool last = --sock->refs == 0;
+
+    mutex_release(&socket_table_lock);
+
+    if(last) {
+        socket_free(sock);
+    }
+}
+
+static ssize_t socket_install(socket_t* sock) {
+    sock->owner = get_current_proc()->pid;
+    sock->refs = 1;     // Held by the table
+
+    socket_table_lock_acquire();
+
+    size_t fd = idtable_alloc(&socket_table, sock);
+
+    sock->fd = fd;
+
+    mutex_release(&socket_table_lock);
+
+    if(fd == IDTABLE_INVALID_ID || fd > 0x7FFFFFFF) {
+        return -NET_EMFILE;
+    }
+
+    return (ssize_t)fd;
+}
+
+static bool socket_address_any(const socket_address_t* address) {
+    return (address->address[0] | address->address[1] | address->address[2] | address->address[3]) == 0;
+}
+
+/**
+ * @brief Принимает датаграмму на порт сокета (выполняется в потоке приёма)
+ */
+static void socket_udp_handler(void* ctx, SAYORI_UNUSED netcard_entry_t* card, const uint8_t src_ip[4], uint16_t src_port,
+                               const void* data, size_t len) {
+    socket_t* sock = ctx;
+
+    // Connected socket only hears its peer.
+    if(sock->connected && (sock->remote.port != src_port
+                           || memcmp((const char*)sock->remote.address, (const char*)src_ip, 4) != 0)) {
+        return;
+    }
+
+    if(sock->rx_count >= SOCKET_UDP_QUEUE_LENGTH) {
+        sock->rx_dropped++;
+        return;
+    }
+
+    socket_datagram_t* datagram = kmalloc(sizeof(socket_datagram_t) + len);
+
+    netstack_count_allocation(true);
+
+    if(datagram == NULL) {
+        sock->rx_dropped++;
+        return;
+    }
+
+    datagram->next = NULL;
+    memcpy(datagram->from.address, src_ip, 4);
+    datagram->from.port = src_port;
+    datagram->len = len;
+    memcpy(datagram->data, data, len);
+    netstack_count_copy(len);
+
+    size_t flags = irq_save();
+
+    if(sock->rx_tail) {
+        sock->rx_tail->next = datagram;
+    } else {
+        sock->rx_head = datagram;
+    }
+
+    sock->rx_tail = datagram;
+    sock->rx_count++;
+
+    irq_restore(flags);
+
+    wait_queue_wake_all(&sock->waiters);
+}
+
+static ssize_t socket_udp_autobind(socket_t* sock) {
+    if(sock->bound) {
+        return 0;
+    }
+
+    uint16_t port = udp_bind(0, socket_udp_handler, sock);
+
+    if(port == 0) {
+        return -NET_EADDRINUSE;
+    }
+
+    memset(&sock->local, 0, sizeof(socket_address_t));
+    sock->local.port = port;
+    sock->bound = true;
+
+    return 0;
+}
+
+/**
+ * @brief Создаёт сокет
+ *
+ * @param domain - SOCKET_AF_INET
+ * @param type - SOCKET_STREAM или SOCKET_DGRAM, можно с SOCKET_NONBLOCK
+ * @param protocol - 0 или номер протокола IPv4 (6 / 17)
+ * @return ssize_t - Дескриптор или -NET_E*
+ */
+ssize_t socket_create(uint32_t domain, uint32_t type, uint32_t protocol) {
+    if(domain != SOCKET_AF_INET) {
+        return -NET_EAFNOSUPPORT;
+    }
+
+    uint32_t kind = type & SOCKET_TYPE_MASK;
+
+    if((kind == SOCKET_STREAM && protocol != 0 && protocol != ETH_IPv4_HEAD_TCP)
+       || (kind == SOCKET_DGRAM && protocol != 0 && protocol != ETH_IPv4_HEAD_UDP)
+       || (kind != SOCKET_STREAM && kind != SOCKET_DGRAM)) {
+        return -NET_EPROTONOSUPPORT;
+    }
+
+    socket_t* sock = kcalloc(sizeof(socket_t), 1);
+
+    if(sock == NULL) {
+        return -NET_ENOMEM;
+    }
+
+    sock->type = kind;
+    sock->nonblock = (type & SOCKET_NONBLOCK) != 0;
+
+    ssize_t fd = socket_install(sock);
+
+    if(fd < 0) {
+        kfree(sock);
+    }
+
+    return fd;
+}
+
+static ssize_t socket_bind_ref(socket_t* sock, const socket_address_t* address) {
+    if(address == NULL) {
+        return -NET_EFAULT;
+    }
+
+    if(sock->bound || sock->tcp) {
+        return -NET_EINVAL;
+    }
+
+    if(!socket_address_any(address) && netcard_route(address->address) == NULL) {
+        return -NET_EINVAL;
+    }
+
+    sock->local = *address;
+
+    if(sock->type == SOCKET_DGRAM) {
+        uint16_t port = udp_bind(address->port, socket_udp_handler, sock);
+
+        if(port == 0) {
+            return -NET_EADDRINUSE;
+        }
+
+        sock->local.port = port;
+    }
+
+    sock->bound = true;
+
+    return 0;
+}
+
+/**
+ * @brief Привязывает сокет к адресу
+ *
+ * @param fd - Дескриптор
+ * @param address - Адрес (0.0.0.0 - любой); порт 0 у UDP - выбрать свободный
+ * @return ssize_t - 0 или -NET_E*
+ */
+ssize_t socket_bind(int32_t fd, const socket_address_t* address) {
+    socket_t* sock = socket_get(fd);
+
+    if(sock == NULL) {
+        return -NET_EBADF;
+    }
+
+    ssize_t result = socket_bind_ref(sock, address);
+
+    socket_put(sock);
+
+    return result;
+}
+
+static ssize_t socket_listen_ref(socket_t* sock, size_t backlog) {
+    if(sock->type != SOCKET_STREAM) {
+        return -NET_EOPNOTSUPP;
+    }
+
+    if(sock->tcp) {
+        return sock->tcp->state == TCP_LISTEN ? 0 : -NET_EISCONN;
+    }
+
+    if(!sock->bound || sock->local.port == 0) {
+        return -NET_EINVAL;
+    }
+
+    netcard_entry_t* card = socket_address_any(&sock->local) ? NULL : netcard_route(sock->local.address);
+    int error = 0;
+
+    sock->tcp = tcp_listen(card, sock->local.port, backlog, &error);
+
+    return sock->tcp ? 0 : -error;
+}
+
+/**
+ * @brief Начинает принимать соединения
+ *
+ * @param fd - Дескриптор привязанного потокового сокета
+ * @param backlog - Длина очереди соединений
+ * @return ssize_t - 0 или -NET_E*
+ */
+ssize_t socket_listen(int32_t fd, size_t backlog) {
+    socket_t* sock = socket_get(fd);
+
+    if(sock == NULL) {
+        return -NET_EBADF;
+    }
+
+    ssize_t result = socket_listen_ref(sock, backlog);
+
+    socket_put(sock);
+
+    return result;
+}
+
+static ssize_t socket_accept_ref(socket_t* sock, socket_address_t* address) {
+    if(sock->type != SOCKET_STREAM || sock->tcp == NULL || sock->tcp->state != TCP_LISTEN) {
+        return -NET_EINVAL;
+    }
+
+    int error = 0;
+    tcp_connection_t* connection = tcp_accept(sock->tcp, sock->nonblock, &error);
+
+    if(connection == NULL) {
+        return -error;
+    }
+
+    socket_t* child = kcalloc(sizeof(socket_t), 1);
+
+    if(child == NULL) {
+        tcp_close(connection);
+        return -NET_ENOMEM;
+    }
+
+    child->type = SOCKET_STREAM;
+    child->bound = true;
+    child->connected = true;
+    child->tcp = connection;
+
+    memcpy(child->local.address, connection->local_ip, 4);
+    child->local.port = connection->local_port;
+    memcpy(child->remote.address, connection->remote_ip, 4);
+    child->remote.port = connection->remote_port;
+
+    ssize_t child_fd = socket_install(child);
+
+    if(child_fd < 0) {
+        tcp_close(connection);
+        kfree(child);
+
+        return child_fd;
+    }
+
+    if(address) {
+        *address = child->remote;
+    }
+
+    return child_fd;
+}
+
+/**
+ * @brief Забирает входящее соединение
+ *
+ * @param fd - Дескриптор слушающего сокета
+ * @param address - Получает адрес собеседника (может быть NULL)
+ * @return ssize_t - Дескриптор нового сокета или -NET_E*
+ */
+ssize_t socket_accept(int32_t fd, socket_address_t* address) {
+    socket_t* sock = socket_get(fd);
+
+    if(sock == NULL) {
+        return -NET_EBADF;
+    }
+
+    ssize_t result = socket_accept_ref(sock, address);
+
+    socket_put(sock);
+
+    return result;
+}
+
+static ssize_t socket_connect_ref(socket_t* sock, const socket_address_t* address) {
+    if(address == NULL) {
+        return -NET_EFAULT;
+    }
+
+    if(sock->type == SOCKET_DGRAM) {
+        ssize_t result = socket_udp_autobind(sock);
+
+        if(result < 0) {
+            return result;
+        }
+
+        sock->remote = *address;
+        sock->connected = true;
+
+        return 0;
+    }
+
+    if(sock->tcp) {
+        tcp_state_t state = sock->tcp->state;
+
+        return (state == TCP_SYN_SENT || state == TCP_SYN_RECEIVED) ? -NET_EALREADY : -NET_EISCONN;
+    }
+
+    netcard_entry_t* card = netcard_route(address->address);
+
+    if(card == NULL) {
+        return -NET_ENETUNREACH;
+    }
+
+    int error = 0;
+    tcp_connection_t* connection = tcp_connect(card, address->address, address->port,
+                                               sock->bound ? sock->local.port : 0, sock->nonblock, &error);
+
+    if(connection == NULL) {
+        return -error;
+    }
+
+    sock->tcp = connection;
+    sock->remote = *address;
+
+    memcpy(sock->local.address, connection->local_ip, 4);
+    sock->local.port = connection->local_port;
+    sock->bound = true;
+    sock->connected = true;
+
+    return error ? -error : 0;
+}
+
+/**
+ * @brief Соединяет сокет (у UDP - запоминает получателя по умолчанию)
+ *
+ * @param fd - Дескриптор
+ * @param address - Адрес собеседника
+ * @return ssize_t - 0, -NET_EINPROGRESS для неблокирующего TCP, или -NET_E*
+ */
+ssize_t socket_connect(int32_t fd, const socket_address_t* address) {
+    socket_t* sock = socket_get(fd);
+
+    if(sock == NULL) {
+        return -NET_EBADF;
+    }
+
+    ssize_t result = socket_connect_ref(sock, address);
+
+    socket_put(sock);
+
+    return result;
+}
+
+static ssize_t socket_sendto_ref(socket_t* sock, const void* data, size_t len, uint32_t flags, const socket_address_t* address) {
+    bool nonblock = sock->nonblock || (flags & SOCKET_MSG_DONTWAIT);
+
+    if(sock->type == SOCKET_STREAM) {
+        if(sock->tcp == NULL || sock->tcp->state == TCP_LISTEN) {
+            return -NET_ENOTCONN;
+        }
+
+        return tcp_send(sock->tcp, data, len, nonblock);
+    }
+
+    if(address == NULL) {
+        if(!sock->connected) {
+            return -NET_ENOTCONN;
+        }
+
+        address = &sock->remote;
+    }
+
+    if(len > SOCKET_UDP_MAX_PAYLOAD) {
+        return -NET_EMSGSIZE;
+    }
+
+    ssize_t result = socket_udp_autobind(sock);
+
+    if(result < 0) {
+        return result;
+    }
+
+    netcard_entry_t* card = netcard_route(address->address);
+
+    if(card == NULL) {
+        return -NET_ENETUNREACH;
+    }
+
+    netbuf_t* buf = netbuf_alloc(NETBUF_HEADROOM, len);
+
+    if(buf == NULL) {
+        return -NET_ENOMEM;
+    }
+
+    netbuf_put_copy(buf, data, len);
+
+    udp_send_netbuf(card, address->address, sock->local.port, address->port, buf);
+
+    return len;
+}
+
+/**
+ * @brief Отправляет датаграмму (у TCP адрес игнорируется)
+ *
+ * @param fd - Дескриптор
+ * @param data - Данные
+ * @param len - Длина
+ * @param flags - SOCKET_MSG_*
+ * @param address - Получатель (NULL - тот, что задан `socket_connect`)
+ * @return ssize_t - Сколько отправлено или -NET_E*
+ */
+ssize_t socket_sendto(int32_t fd, const void* data, size_t len, uint32_t flags, const socket_address_t* address) {
+    socket_t* sock = socket_get(fd);
+
+    if(sock == NULL) {
+        return -NET_EBADF;
+    }
+
+    ssize_t result = socket_sendto_ref(sock, data, len, flags, address);
+
+    socket_put(sock);
+
+    return result;
+}
+
+ssize_t socket_send(int32_t fd, const void* data, size_t len, uint32_t flags) {
+    return socket_sendto(fd, data, len, flags, NULL);
+}
+
+static ssize_t socket_recvfrom_ref(socket_t* sock, void* data, size_t len, uint32_t flags, socket_address_t* address) {
+    bool nonblock = sock->nonblock || (flags & SOCKET_MSG_DONTWAIT);
+
+    if(sock->type == SOCKET_STREAM) {
+        if(sock->tcp == NULL || sock->tcp->state == TCP_LISTEN) {
+            return -NET_ENOTCONN;
+        }
+
+        if(address) {
+            *address = sock->remote;
+        }
+
+        return tcp_recv(sock->tcp, data, len, nonblock);
+    }
+
+    socket_datagram_t* datagram;
+
+    while(1) {
+        size_t irq_flags = irq_save();
+
+        datagram = sock->rx_head;
+
+        if(datagram) {
+            sock->rx_head = datagram->next;
+
+            if(sock->rx_head == NULL) {
+                sock->rx_tail = NULL;
+            }
+
+            sock->rx_count--;
+
+            irq_restore(irq_flags);
+            break;
+        }
+
+        if(sock->closed) {
+            irq_restore(irq_flags);
+            return -NET_EBADF;
+        }
+
+        if(nonblock) {
+            irq_restore(irq_flags);
+            return -NET_EAGAIN;
+        }
+
+        // Interrupts are still off, so the datagram can't slip in before we sleep.
+        wait_queue_entry_t entry;
+
+        wait_queue_add(&sock->waiters, &entry);
+
+        sched_wait(SCHED_MAX_IDLE_TICKS);
+
+        wait_queue_remove(&sock->waiters, &entry);
+    }
+
+    size_t count = MIN(len, datagram->len);
+
+    memcpy(data, datagram->data, count);
+    netstack_count_copy(count);
+
+    if(address) {
+        *address = datagram->from;
+    }
+
+    kfree(datagram);
+
+    return count;
+}
+
+/**
+ * @brief Получает данные
+ *
+ * @param fd - Дескриптор
+ * @param data - Буфер
+ * @param len - Размер буфера (лишняя часть датаграммы теряется)
+ * @param flags - SOCKET_MSG_*
+ * @param address - Получает адрес отправителя (может быть NULL)
+ * @return ssize_t - Сколько получено, 0 - конец потока, или -NET_E*
+ */
+ssize_t socket_recvfrom(int32_t fd, void* data, size_t len, uint32_t flags, socket_address_t* address) {
+    socket_t* sock = socket_get(fd);
+
+    if(sock == NULL) {
+        return -NET_EBADF;
+    }
+
+    ssize_t result = socket_recvfrom_ref(sock, data, len, flags, address);
+
+    socket_put(sock);
+
+    return result;
+}
+
+ssize_t socket_recv(int32_t fd, void* data, size_t len, uint32_t flags) {
+    return socket_recvfrom(fd, data, len, flags, NULL);
+}
+
+static ssize_t socket_shutdown_ref(socket_t* sock, uint32_t how) {
+    if(sock->type != SOCKET_STREAM || sock->tcp == NULL || sock->tcp->state == TCP_LISTEN) {
+        return -NET_ENOTCONN;
+    }
+
+    if(how >= SOCKET_SHUT_WR) {
+        tcp_shutdown(sock->tcp);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Закрывает отправку (SOCKET_SHUT_WR и выше), приём продолжает работать
+ *
+ * @param fd - Дескриптор
+ * @param how - 0 - приём, 1 - отправка, 2 - оба
+ * @return ssize_t - 0 или -NET_E*
+ */
+ssize_t socket_shutdown(int32_t fd, uint32_t how) {
+    socket_t* sock = socket_get(fd);
+
+    if(sock == NULL) {
+        return -NET_EBADF;
+    }
+
+    ssize_t result = socket_shutdown_ref(sock, how);
+
+    socket_put(sock);
+
+    return result;
+}
+
+static void socket_free(socket_t* sock) {
+    if(sock->tcp) {
+        tcp_close(sock->tcp);
+    }
+
+    if(sock->type == SOCKET_DGRAM && sock->bound) {
+        // No handler runs with this socket after that.
+        udp_unbind(sock->local.port);
+    }
+
+    while(sock->rx_head) {
+        socket_datagram_t* datagram = sock->rx_head;
+
+        sock->rx_head = datagram->next;
+
+        kfree(datagram);
+    }
+
+    kfree(sock);
+}
+
+/**
+ * @brief Закрывает сокет. Если другой поток в этот момент работает с ним, сокет освобождается,
+ *        когда тот закончит.
+ *
+ * @param fd - Дескриптор
+ * @return ssize_t - 0 или -NET_EBADF
+ */
+ssize_t socket_close(int32_t fd) {
+    if(fd < 0) {
+        return -NET_EBADF;
+    }
+
+    size_t pid = get_current_proc()->pid;
+
+    socket_table_lock_acquire();
+
+    socket_t* sock = idtable_get(&socket_table, (size_t)fd);
+
+    if(sock && sock->owner == pid) {
+        idtable_remove(&socket_table, (size_t)fd);
+
+        sock->closed = true;
+    } else {
+        sock = NULL;
+    }
+
+    mutex_release(&socket_table_lock);
+
+    if(sock == NULL) {
+        return -NET_EBADF;
+    }
+
+    // Threads waiting for a datagram see `closed` and return.
+    wait_queue_wake_all(&sock->waiters);
+
+    socket_put(sock);
+
+    return 0;
+}
+
+/**
+ * @brief Закрывает сокеты завершившегося процесса
+ *
+ * @param pid - PID процесса
+ */
+void socket_close_process(size_t pid) {
+    for(size_t slot = 0; slot < socket_table.capacity; slot++) {
+        socket_table_lock_acquire();
+
+        socket_t* sock = socket_table.objects[slot];
+
+        if(sock == NULL || sock->owner != pid) {
+            mutex_release(&socket_table_lock);
+            continue;
+        }
+
+        idtable_remove(&socket_table, sock->fd);
+
+        sock->closed = true;
+
+        mutex_release(&socket_table_lock);
+
+        // Connections are closed outside of the table lock, like in socket_close.
+        socket_put(sock);
+    }
+}
+
+static wait_queue_t* socket_wait_queue(socket_t* sock) {
+    return sock->tcp ? tcp_wait_queue(sock->tcp) : &sock->waiters;
+}
+
+static uint32_t socket_readiness(socket_t* sock) {
+    if(sock->type == SOCKET_STREAM) {
+        // Not connected yet: nothing will ever happen to it.
+        return sock->tcp ? tcp_poll(sock->tcp) : SOCKET_POLL_HUP;
+    }
+
+    return SOCKET_POLL_OUT | (sock->rx_head ? SOCKET_POLL_IN : 0);
+}
+
+/**
+ * @brief Ждёт готовности любого из сокетов
+ *
+ * @param fds - Сокеты и события, которые интересуют (`revents` заполняется)
+ * @param count - Количество (до SOCKET_POLL_MAX)
+ * @param timeout_ms - Таймаут в миллисекундах (-1 - без таймаута, 0 - только проверить)
+ * @return ssize_t - Количество готовых сокетов или -NET_E*
+ */
+ssize_t socket_poll(socket_poll_t* fds, size_t count, int32_t timeout_ms) {
+    if(count > SOCKET_POLL_MAX || (count && fds == NULL)) {
+        return -NET_EINVAL;
+    }
+
+    socket_t** sockets = kcalloc(sizeof(socket_t*), MAX(count, (size_t)1));
+    wait_queue_t** queues = kcalloc(sizeof(wait_queue_t*), MAX(count, (size_t)1));
+    wait_queue_entry_t* entries = kcalloc(sizeof(wait_queue_entry_t), MAX(count, (size_t)1));
+
+    if(sockets == NULL || queues == NULL || entries == NULL) {
+        kfree(sockets);
+        kfree(queues);
+        kfree(entries);
+
+        return -NET_ENOMEM;
+    }
+
+    // Stay registered for the whole call: a wakeup marks the entry, so none is lost between checks.
+    for(size_t i = 0; i < count; i++) {
+        sockets[i] = socket_get(fds[i].fd);
+
+        if(sockets[i]) {
+            queues[i] = socket_wait_queue(sockets[i]);
+
+            wait_queue_add(queues[i], &entries[i]);
+        }
+    }
+
+    size_t start = getTicks();
+    size_t ready;
+
+    while(1) {
+        ready = 0;
+
+        for(size_t i = 0; i < count; i++) {
+            entries[i].woken = false;
+        }
+
+        for(size_t i = 0; i < count; i++) {
+            uint32_t mask = sockets[i] ? socket_readiness(sockets[i]) : SOCKET_POLL_NVAL;
+
+            fds[i].revents = mask & (fds[i].events | SOCKET_POLL_ERR | SOCKET_POLL_HUP | SOCKET_POLL_NVAL);
+
+            if(fds[i].revents) {
+                ready++;
+            }
+        }
+
+        if(ready || timeout_ms == 0) {
+            break;
+        }
+
+        size_t elapsed = getTicks() - start;
+
+        if(timeout_ms > 0 && elapsed >= (size_t)timeout_ms) {
+            break;
+        }
+
+        size_t wait = timeout_ms > 0 ? MIN((size_t)timeout_ms - elapsed, (size_t)SCHED_MAX_IDLE_TICKS) : SCHED_MAX_IDLE_TICKS;
+
+        __asm__ volatile("cli");
+
+        bool woken = false;
+
+        for(size_t i = 0; i < count && !woken; i++) {
+            woken = entries[i].woken;
+        }
+
+        if(woken) {
+            __asm__ volatile("sti");
+        } else {
+            sched_wait(wait);
+        }
+    }
+
+    for(size_t i = 0; i < count; i++) {
+        if(queues[i]) {
+            wait_queue_remove(queues[i], &entries[i]);
+        }
+
+        if(sockets[i]) {
+            socket_put(sockets[i]);
+        }
+    }
+
+    kfree(sockets);
+    kfree(queues);
+    kfree(entries);
+
+    return ready;
+}
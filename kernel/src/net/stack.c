@@ -4,95 +4,395 @@
 
 #include "net/cards.h"
 #include "net/stack.h"
-#include "../lib/libvector/include/vector.h"
 #include "mem/vmm.h"
 #include <io/logging.h>
 #include "sys/scheduler/scheduler.h"
+#include "sys/scheduler/workqueue.h"
+#include "sys/sync.h"
 #include "net/ethernet.h"
+#include "net/netbuf.h"
+#include "lib/math.h"
 
-volatile vector_t* system_network_incoming_queue = 0;
-volatile vector_t* system_network_outgoing_queue = 0;
+static void netstack_rx_handler(void* arg);
+static void netstack_tx_handler(void* arg);
 
-void netstack_processor();
-void netstack_processor_out();
+// Both directions are drained by work items instead of dedicated polling threads.
+// TX goes to another worker, so replies sent from the RX path are not stuck behind it.
+static work_t netstack_rx_work = WORK_INITIALIZER(netstack_rx_handler, NULL, WORK_PRIORITY_NORMAL);
+static work_t netstack_tx_work = WORK_INITIALIZER(netstack_tx_handler, NULL, WORK_PRIORITY_HIGH);
+
+static struct {
+	netstack_rx_listener_t listener;
+	void* ctx;
+} netstack_rx_listeners[NETSTACK_MAX_RX_LISTENERS] = {0};
+
+static netstack_counters_t netstack_counters = {0};
 
 void netstack_init() {
-    system_network_incoming_queue = vector_new();
-    system_network_outgoing_queue = vector_new();
+	qemu_log("Network stack: %d RX / %d TX slots per card", NETSTACK_RX_RING_SIZE, NETSTACK_TX_RING_SIZE);
+}
+
+// Frees the queues of a card that never got attached. Slots that were not filled are NULL.
+static void netstack_card_free(netstack_card_t* stack) {
+	if(stack->rx.slots) {
+		for(size_t i = 0; i < NETSTACK_RX_RING_SIZE; i++) {
+			if(stack->rx.slots[i]) {
+				netbuf_free(stack->rx.slots[i]);
+			}
+		}
+	}
 
-	thread_create(get_current_proc(), netstack_processor, 0x1000, THREAD_KERNEL, NULL, 0);
-	thread_create(get_current_proc(), netstack_processor_out, 0x1000, THREAD_KERNEL, NULL, 0);
+	spsc_ring_destroy(&stack->rx);
+	spsc_ring_destroy(&stack->tx);
+
+	kfree(stack);
+}
+
+/**
+ * @brief Создаёт очереди стека для сетевой карты
+ *
+ * @param card - Сетевая карта
+ * @return true - если успешно
+ */
+bool netstack_attach_card(netcard_entry_t* card) {
+	netstack_card_t* stack = kcalloc(sizeof(netstack_card_t), 1);
+
+	if(stack == NULL) {
+		qemu_err("Failed to allocate queues for %s", card->name);
+		return false;
+	}
+
+	stack->card = card;
+
+	if(!spsc_ring_init(&stack->rx, NETSTACK_RX_RING_SIZE) || !spsc_ring_init(&stack->tx, NETSTACK_TX_RING_SIZE)) {
+		qemu_err("Failed to allocate queues for %s", card->name);
+
+		netstack_card_free(stack);
+
+		return false;
+	}
+
+	// RX slots own their buffers for the whole lifetime of the card.
+	for(size_t i = 0; i < NETSTACK_RX_RING_SIZE; i++) {
+		stack->rx.slots[i] = netbuf_alloc(0, 0);
+
+		if(stack->rx.slots[i] == NULL) {
+			qemu_err("Failed to allocate RX buffers for %s", card->name);
+
+			netstack_card_free(stack);
+
+			return false;
+		}
+	}
+
+	card->stack = stack;
+
+	return true;
+}
+
+void netstack_push_netbuf(netcard_entry_t* card, netbuf_t* buf) {
+	netstack_card_t* stack = card->stack;
+
+	if(stack == NULL) {
+		netbuf_free(buf);
+		return;
+	}
+
+	buf->card = card;
+
+	// Any thread may send, so producers are serialized here.
+	size_t flags = irq_save();
+
+	bool queued = spsc_ring_push(&stack->tx, buf);
+
+	if(!queued) {
+		stack->stats.tx_dropped++;
+	}
+
+	irq_restore(flags);
+
+	if(!queued) {
+		netbuf_free(buf);
+		return;
+	}
+
+	workqueue_queue_work(&netstack_tx_work);
 }
 
 void netstack_push(netcard_entry_t* card, void* packet_data, size_t length) {
-	netqueue_item_t* item = kcalloc(sizeof(netqueue_item_t), 1);
-	void* data = kcalloc(1, length);
+	netbuf_t* buf = netbuf_alloc(0, length);
+
+	if(buf == NULL) {
+		return;
+	}
 
-	memcpy(data, packet_data, length);
+	memcpy(netbuf_put(buf, length), packet_data, length);
+	netstack_count_copy(length);
 
-	item->data = data;
-	item->card = card;
-	item->length = length;
+	netstack_push_netbuf(card, buf);
+}
 
-	vector_push_back((vector_t*)system_network_outgoing_queue, (size_t) item);
+static void netstack_rx_produce(netstack_card_t* stack) {
+	spsc_ring_produce(&stack->rx);
+
+	stack->stats.rx_packets++;
+
+	// While polling, the RX work item delivers the frames right after `poll` returns.
+	if(!stack->polling) {
+		workqueue_queue_work(&netstack_rx_work);
+	}
 }
 
 void netstack_transfer(netcard_entry_t* card, void* packet_data, size_t length) {
-	netqueue_item_t* item = kcalloc(sizeof(netqueue_item_t), 1);
-	void* data = kcalloc(1, length);
+	netstack_card_t* stack = card->stack;
+
+	if(stack == NULL) {
+		return;
+	}
+
+	void** slot = spsc_ring_producer_slot(&stack->rx);
+
+	if(slot == NULL || length > NETBUF_SIZE) {
+		stack->stats.rx_dropped++;
+		return;
+	}
+
+	netbuf_t* buf = *slot;
+
+	buf->card = card;
+	buf->data = buf->head;
+	buf->len = 0;
+
+	memcpy(netbuf_put(buf, length), packet_data, length);
+	netstack_count_copy(length);
+
+	netstack_rx_produce(stack);
+}
+
+/**
+ * @brief Отдаёт буфер на приём целиком, без копирования
+ *
+ * Буфер занимает слот кольца, а прежний буфер слота освобождается.
+ * Для карт, у которых кадр уже лежит в netbuf (петлевая).
+ *
+ * @param card - Сетевая карта
+ * @param buf - Кадр (стек становится его владельцем)
+ */
+void netstack_receive_netbuf(netcard_entry_t* card, netbuf_t* buf) {
+	netstack_card_t* stack = card->stack;
+
+	if(stack == NULL) {
+		netbuf_free(buf);
+		return;
+	}
+
+	void** slot = spsc_ring_producer_slot(&stack->rx);
 
-	memcpy(data, packet_data, length);
+	if(slot == NULL) {
+		stack->stats.rx_dropped++;
 
-	item->data = data;
-	item->card = card;
-	item->length = length;
+		netbuf_free(buf);
+		return;
+	}
+
+	netbuf_t* old = *slot;
+
+	buf->card = card;
+	*slot = buf;
+
+	netstack_rx_produce(stack);
 
-	vector_push_back((vector_t*)system_network_incoming_queue, (size_t) item);
+	netbuf_free(old);
 }
 
+/**
+ * @brief Переводит карту в режим опроса
+ *
+ * Вместо обработки кадров в прерывании карта маскирует свои RX-прерывания и вызывает
+ * эту функцию. Дальше RX-обработчик стека забирает кадры через `poll` порциями по
+ * NETSTACK_POLL_BUDGET и включает прерывания обратно, когда кадры кончились.
+ * Под потоком пакетов система так не застревает в прерываниях.
+ *
+ * @param card - Сетевая карта
+ */
+void netstack_schedule_poll(netcard_entry_t* card) {
+	netstack_card_t* stack = card->stack;
 
-netqueue_item_t* netstack_pop() {
-    netqueue_item_t* data = (void *) vector_pop_back((vector_t*)system_network_incoming_queue).element;
+	if(stack == NULL) {
+		return;
+	}
+
+	stack->stats.interrupts++;
+	stack->polling = true;
 
-    return data;
+	workqueue_queue_work(&netstack_rx_work);
 }
 
-netqueue_item_t* netstack_poll() {
-    while(system_network_incoming_queue->size == 0) {
-		__asm__ volatile("hlt");
-		yield();
+bool netstack_get_stats(netcard_entry_t* card, netstack_stats_t* out) {
+	if(card->stack == NULL) {
+		return false;
 	}
 
-    return netstack_pop();
+	size_t flags = irq_save();
+
+	*out = card->stack->stats;
+
+	irq_restore(flags);
+
+	return true;
 }
 
-void netstack_processor_out() {
-	qemu_note("OUTGOING NETWORK QUEUE IS WORKING NOW!");
+void netstack_count_allocation(bool heap) {
+	__atomic_fetch_add(&netstack_counters.allocations, 1, __ATOMIC_RELAXED);
+
+	if(heap) {
+		__atomic_fetch_add(&netstack_counters.heap_allocations, 1, __ATOMIC_RELAXED);
+	}
+}
 
-	while(1) {
-		for(int i = system_network_outgoing_queue->size; i > 0; i--) {
-			qemu_log("%d packets remaining", i);
+void netstack_count_copy(size_t length) {
+	__atomic_fetch_add(&netstack_counters.copies, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&netstack_counters.copied_bytes, length, __ATOMIC_RELAXED);
+}
+
+void netstack_get_counters(netstack_counters_t* out) {
+	out->allocations = __atomic_load_n(&netstack_counters.allocations, __ATOMIC_RELAXED);
+	out->heap_allocations = __atomic_load_n(&netstack_counters.heap_allocations, __ATOMIC_RELAXED);
+	out->copies = __atomic_load_n(&netstack_counters.copies, __ATOMIC_RELAXED);
+	out->copied_bytes = __atomic_load_n(&netstack_counters.copied_bytes, __ATOMIC_RELAXED);
+}
 
-			netqueue_item_t* item = (void*)vector_pop_back((vector_t*)system_network_outgoing_queue).element;
-			item->card->send_packet(item->data, item->length);
+static void netstack_tx_handler(SAYORI_UNUSED void* arg) {
+	for(size_t i = 0; i < netcards_get_count(); i++) {
+		netcard_entry_t* card = netcard_get(i);
+		netstack_card_t* stack = card->stack;
+		netbuf_t* buf;
+		size_t sent = 0;
+
+		while((buf = stack->tx_stalled ? stack->tx_stalled : spsc_ring_pop(&stack->tx)) != NULL) {
+			stack->tx_stalled = NULL;
+
+			if(buf->card->send_netbuf) {
+				// The card's ring is full: the frame waits for `netstack_tx_resume`.
+				if(!buf->card->send_netbuf(buf)) {
+					stack->tx_stalled = buf;
+					break;
+				}
+			} else {
+				buf->card->send_packet(buf->data, buf->len);
+
+				netbuf_free(buf);
+			}
+
+			stack->stats.tx_packets++;
+			sent++;
 		}
 
-        yield();
+		// Lets the card ring its doorbell once per batch.
+		if(sent && card->flush) {
+			card->flush();
+		}
 	}
 }
 
-void netstack_processor() {
-	qemu_note("NETWORK QUEUE IS WORKING NOW!");
+void netstack_tx_resume(SAYORI_UNUSED netcard_entry_t* card) {
+	// The card may refuse a frame before the TX work item marks it stalled, so don't check.
+	workqueue_queue_work(&netstack_tx_work);
+}
+
+bool netstack_add_rx_listener(netstack_rx_listener_t listener, void* ctx) {
+	size_t flags = irq_save();
 
-	while(1) {
-		qemu_note("WAITING FOR PACKET");
-		netqueue_item_t* item = netstack_poll();
-	
-		qemu_note("RECEIVED PACKET");
-		// item->card->send_packet(item->data, item->length);
+	for(size_t i = 0; i < NETSTACK_MAX_RX_LISTENERS; i++) {
+		if(netstack_rx_listeners[i].listener == NULL) {
+			netstack_rx_listeners[i].listener = listener;
+			netstack_rx_listeners[i].ctx = ctx;
+
+			irq_restore(flags);
+
+			return true;
+		}
+	}
+
+	irq_restore(flags);
+
+	return false;
+}
 
-		ethernet_handle_packet(item->card, item->data, item->length);
+void netstack_remove_rx_listener(netstack_rx_listener_t listener, void* ctx) {
+	size_t flags = irq_save();
+
+	for(size_t i = 0; i < NETSTACK_MAX_RX_LISTENERS; i++) {
+		if(netstack_rx_listeners[i].listener == listener && netstack_rx_listeners[i].ctx == ctx) {
+			netstack_rx_listeners[i].listener = NULL;
+			netstack_rx_listeners[i].ctx = NULL;
+		}
+	}
+
+	irq_restore(flags);
+}
+
+// Returns true if the card still has frames and must be polled again.
+static bool netstack_poll_card(netcard_entry_t* card, netstack_card_t* stack) {
+	// Never ask for more frames than there are free slots.
+	size_t room = spsc_ring_capacity(&stack->rx) - spsc_ring_count(&stack->rx);
+	size_t budget = MIN(room, (size_t)NETSTACK_POLL_BUDGET);
+
+	size_t done = card->poll(budget);
+
+	stack->stats.polls++;
+
+	if(done == budget) {
+		return true;
+	}
+
+	stack->polling = false;
+
+	if(!card->rx_irq_enable()) {
+		stack->polling = true;
+		return true;
+	}
+
+	return false;
+}
+
+static void netstack_rx_handler(SAYORI_UNUSED void* arg) {
+	bool again = false;
+
+	for(size_t i = 0; i < netcards_get_count(); i++) {
+		netcard_entry_t* card = netcard_get(i);
+		netstack_card_t* stack = card->stack;
+		void** slot;
+
+		if(stack->polling && card->poll && netstack_poll_card(card, stack)) {
+			again = true;
+		}
+
+		// Frames are handled in place; the slot goes back to the IRQ handler afterwards.
+		while((slot = spsc_ring_consumer_slot(&stack->rx)) != NULL) {
+			netbuf_t* buf = *slot;
+
+			for(size_t j = 0; j < NETSTACK_MAX_RX_LISTENERS; j++) {
+				size_t flags = irq_save();
+
+				netstack_rx_listener_t listener = netstack_rx_listeners[j].listener;
+				void* ctx = netstack_rx_listeners[j].ctx;
+
+				irq_restore(flags);
+
+				if(listener) {
+					listener(card, buf->data, buf->len, ctx);
+				}
+			}
+
+			ethernet_handle_packet(card, (ethernet_frame_t*)buf->data, buf->len);
+
+			spsc_ring_consume(&stack->rx);
+		}
+	}
 
-		qemu_ok("PACKET HANDLING FINISHED!");
+	// Requeued instead of looping, so a busy card does not starve the rest of the worker.
+	if(again) {
+		workqueue_queue_work(&netstack_rx_work);
 	}
 }
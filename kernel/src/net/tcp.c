@@ -6,252 +6,1802 @@
 #include "net/cards.h"
 #include "net/ethernet.h"
 #include "net/tcp.h"
+#include "net/errno.h"
 #include "net/endianess.h"
 #include <io/logging.h>
 #include "net/ipv4.h"
 #include "mem/vmm.h"
+#include "net/netbuf.h"
+#include "net/checksum.h"
+#include "net/stack.h"
 #include "lib/rand.h"
+#include "lib/math.h"
+#include "lib/string.h"
+#include "sys/sync.h"
+#include "sys/scheduler/scheduler.h"
+#include "arch/x86/pit.h"
 
+// Sequence numbers wrap around, so they are compared by the sign of the difference.
+#define SEQ_LT(a, b)    ((int32_t)((a) - (b)) < 0)
+#define SEQ_LEQ(a, b)   ((int32_t)((a) - (b)) <= 0)
+#define SEQ_GT(a, b)    ((int32_t)((a) - (b)) > 0)
+#define SEQ_GEQ(a, b)   ((int32_t)((a) - (b)) >= 0)
+#define SEQ_MAX(a, b)   (SEQ_GT(a, b) ? (a) : (b))
 
-#define MAX_CONNECTIONS 64
+#define TICKS_PASSED(now, deadline) ((ssize_t)((now) - (deadline)) >= 0)
 
-volatile tcp_connection_t TCP_CONNECTIONS[MAX_CONNECTIONS] = {};
+// Fields of a received segment in host byte order.
+typedef struct {
+	uint32_t	seq;
+	uint32_t	ack;
+	uint8_t		flags;
+	uint32_t	window;
+	uint16_t	mss;
+	uint8_t*	data;
+	size_t		len;
+} tcp_input_t;
+
+static tcp_connection_t* tcp_table[TCP_HASH_SIZE] = {0};
+static tcp_connection_t* tcp_listeners = NULL;
+
+// Protects every connection, the table and the statistics.
+static mutex_t tcp_lock = {false};
+
+static tcp_stats_t tcp_stats = {0};
+static uint16_t tcp_next_port = TCP_EPHEMERAL_PORT_MIN;
+static thread_t* tcp_timer_thread = NULL;
+
+static const char* tcp_state_names[TCP_STATE_COUNT] = {
+	[TCP_CLOSED] = "CLOSED",
+	[TCP_LISTEN] = "LISTEN",
+	[TCP_SYN_SENT] = "SYN_SENT",
+	[TCP_SYN_RECEIVED] = "SYN_RECEIVED",
+	[TCP_ESTABLISHED] = "ESTABLISHED",
+	[TCP_FIN_WAIT_1] = "FIN_WAIT_1",
+	[TCP_FIN_WAIT_2] = "FIN_WAIT_2",
+	[TCP_CLOSE_WAIT] = "CLOSE_WAIT",
+	[TCP_CLOSING] = "CLOSING",
+	[TCP_LAST_ACK] = "LAST_ACK",
+	[TCP_TIME_WAIT] = "TIME_WAIT",
+};
+
+static void tcp_lock_acquire() {
+	// The holder may be preempted: give it the CPU instead of spinning out our timeslice.
+	while(__atomic_test_and_set(&tcp_lock.lock, __ATOMIC_ACQUIRE)) {
+		yield();
+	}
+}
+
+static void tcp_lock_release() {
+	mutex_release(&tcp_lock);
+}
+
+// `tcp_length` covers the header and the payload, which must follow it in memory.
+// Over a received segment (with its checksum field) the result is 0 if it is intact.
+uint16_t tcp_calculate_checksum(uint32_t src_addr, uint32_t dst_addr, tcp_packet_t *tcp_packet, uint16_t tcp_length) {
+    uint32_t sum = checksum_pseudo_header((const uint8_t*)&src_addr, (const uint8_t*)&dst_addr,
+                                          ETH_IPv4_HEAD_TCP, tcp_length, 0);
+
+    return checksum_fold(checksum_partial(tcp_packet, tcp_length, sum));
+}
+
+/* Ring buffers */
+
+static size_t tcp_buffer_free(const tcp_buffer_t* buffer) {
+	return buffer->size - buffer->len;
+}
+
+static size_t tcp_buffer_write(tcp_buffer_t* buffer, const uint8_t* data, size_t len) {
+	len = MIN(len, tcp_buffer_free(buffer));
+
+	size_t tail = (buffer->head + buffer->len) & (buffer->size - 1);
+	size_t first = MIN(len, buffer->size - tail);
+
+	memcpy(buffer->data + tail, data, first);
+	memcpy(buffer->data, data + first, len - first);
+	netstack_count_copy(len);
+
+	buffer->len += len;
+
+	return len;
+}
+
+// Copies `len` bytes starting `offset` bytes after the oldest one, without consuming them.
+static void tcp_buffer_peek(const tcp_buffer_t* buffer, size_t offset, uint8_t* out, size_t len) {
+	size_t start = (buffer->head + offset) & (buffer->size - 1);
+	size_t first = MIN(len, buffer->size - start);
+
+	memcpy(out, buffer->data + start, first);
+	memcpy(out + first, buffer->data, len - first);
+	netstack_count_copy(len);
+}
+
+// Same as `tcp_buffer_peek`, but appends the bytes to `buf`, summing them on the way.
+static void tcp_buffer_peek_netbuf(const tcp_buffer_t* buffer, size_t offset, netbuf_t* buf, size_t len) {
+	size_t start = (buffer->head + offset) & (buffer->size - 1);
+	size_t first = MIN(len, buffer->size - start);
+
+	netbuf_put_copy(buf, buffer->data + start, first);
+
+	if(len > first) {
+		netbuf_put_copy(buf, buffer->data, len - first);
+	}
+}
+
+static void tcp_buffer_consume(tcp_buffer_t* buffer, size_t len) {
+	buffer->head = (buffer->head + len) & (buffer->size - 1);
+	buffer->len -= len;
 
-int tcp_find_connection(uint8_t address[4], size_t port) {
-	for(int i = 0; i < MAX_CONNECTIONS; i++) {
-		if(memcmp((const char*)&TCP_CONNECTIONS[i].dest_ip_addr, (char*)address, 4) == 0
-			&& (TCP_CONNECTIONS[i].source_port == port || TCP_CONNECTIONS[i].dest_port == port)
-			&& TCP_CONNECTIONS[i].status != TCP_NONE) {
-			return i;
+	if(buffer->len == 0) {
+		buffer->head = 0;
+	}
+}
+
+/* Connection table */
+
+static size_t tcp_hash(const uint8_t remote_ip[4], uint16_t local_port, uint16_t remote_port) {
+	uint32_t hash;
+
+	memcpy(&hash, remote_ip, 4);
+
+	hash ^= ((uint32_t)local_port << 16) | remote_port;
+	hash *= 0x9E3779B1;
+
+	return (hash >> 16) & (TCP_HASH_SIZE - 1);
+}
+
+static void tcp_table_insert(tcp_connection_t* connection) {
+	size_t bucket = tcp_hash(connection->remote_ip, connection->local_port, connection->remote_port);
+
+	connection->hash_next = tcp_table[bucket];
+	tcp_table[bucket] = connection;
+}
+
+static void tcp_table_remove(tcp_connection_t* connection) {
+	size_t bucket = tcp_hash(connection->remote_ip, connection->local_port, connection->remote_port);
+
+	for(tcp_connection_t** link = &tcp_table[bucket]; *link; link = &(*link)->hash_next) {
+		if(*link == connection) {
+			*link = connection->hash_next;
+			connection->hash_next = NULL;
+			return;
+		}
+	}
+}
+
+static tcp_connection_t* tcp_lookup(const uint8_t local_ip[4], uint16_t local_port, const uint8_t remote_ip[4], uint16_t remote_port) {
+	tcp_connection_t* connection = tcp_table[tcp_hash(remote_ip, local_port, remote_port)];
+
+	for(; connection; connection = connection->hash_next) {
+		if(connection->local_port == local_port
+			&& connection->remote_port == remote_port
+			&& memcmp((const char*)connection->remote_ip, (const char*)remote_ip, 4) == 0
+			&& memcmp((const char*)connection->local_ip, (const char*)local_ip, 4) == 0) {
+			return connection;
+		}
+	}
+
+	return NULL;
+}
+
+static tcp_connection_t* tcp_find_listener(netcard_entry_t* card, uint16_t port) {
+	for(tcp_connection_t* listener = tcp_listeners; listener; listener = listener->hash_next) {
+		if(listener->local_port == port && (listener->card == NULL || listener->card == card)) {
+			return listener;
+		}
+	}
+
+	return NULL;
+}
+
+static bool tcp_port_in_use(uint16_t port) {
+	for(tcp_connection_t* listener = tcp_listeners; listener; listener = listener->hash_next) {
+		if(listener->local_port == port) {
+			return true;
 		}
 	}
 
-	return -1;
+	for(size_t i = 0; i < TCP_HASH_SIZE; i++) {
+		for(tcp_connection_t* connection = tcp_table[i]; connection; connection = connection->hash_next) {
+			if(connection->local_port == port) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+static tcp_connection_t* tcp_connection_new(netcard_entry_t* card, const uint8_t remote_ip[4], uint16_t local_port, uint16_t remote_port) {
+	tcp_connection_t* connection = kcalloc(sizeof(tcp_connection_t), 1);
+
+	if(connection == NULL) {
+		return NULL;
+	}
+
+	connection->send_buffer.data = kmalloc(TCP_SEND_BUFFER_SIZE);
+	connection->send_buffer.size = TCP_SEND_BUFFER_SIZE;
+	connection->recv_buffer.data = kmalloc(TCP_RECV_BUFFER_SIZE);
+	connection->recv_buffer.size = TCP_RECV_BUFFER_SIZE;
+
+	if(connection->send_buffer.data == NULL || connection->recv_buffer.data == NULL) {
+		kfree(connection->send_buffer.data);
+		kfree(connection->recv_buffer.data);
+		kfree(connection);
+
+		return NULL;
+	}
+
+	connection->card = card;
+	memcpy(connection->local_ip, card->ipv4_addr, 4);
+	memcpy(connection->remote_ip, remote_ip, 4);
+	connection->local_port = local_port;
+	connection->remote_port = remote_port;
+
+	connection->iss = (uint32_t)rand() ^ (uint32_t)(getTicks() << 12);
+	connection->snd_una = connection->iss;
+	connection->snd_nxt = connection->iss;
+	connection->snd_max = connection->iss;
+	connection->recover = connection->iss;
+	connection->mss = TCP_DEFAULT_MSS;
+	connection->rto = TCP_RTO_INITIAL;
+	connection->ssthresh = 0x7FFFFFFF;
+
+	// The timer thread sleeps long while there are no connections.
+	if(tcp_stats.active_connections++ == 0) {
+		thread_wake(tcp_timer_thread);
+	}
+
+	return connection;
+}
+
+static void tcp_connection_free(tcp_connection_t* connection) {
+	while(connection->ooo) {
+		tcp_segment_t* segment = connection->ooo;
+
+		connection->ooo = segment->next;
+
+		kfree(segment);
+	}
+
+	kfree(connection->send_buffer.data);
+	kfree(connection->recv_buffer.data);
+	kfree(connection);
+
+	tcp_stats.active_connections--;
+}
+
+/* Output */
+
+static uint32_t tcp_receive_window(const tcp_connection_t* connection) {
+	size_t space = tcp_buffer_free(&connection->recv_buffer);
+
+	// Receiver side silly window avoidance (RFC 1122, 4.2.3.3)
+	if(space < connection->mss) {
+		return 0;
+	}
+
+	return MIN(space, 0xFFFFu);
+}
+
+// Prepends the header to `buf` (it already holds the payload) and gives it to IPv4.
+static void tcp_transmit(netcard_entry_t* card, const uint8_t remote_ip[4], uint16_t local_port, uint16_t remote_port,
+						 uint32_t seq, uint32_t ack, uint8_t flags, uint16_t window, netbuf_t* buf) {
+	size_t header_length = sizeof(tcp_packet_t);
+
+	if(flags & TCP_FLAG_SYN) {
+		uint8_t* option = netbuf_push(buf, 4);
+
+		option[0] = TCP_OPTION_MSS;
+		option[1] = 4;
+		option[2] = TCP_MSS >> 8;
+		option[3] = TCP_MSS & 0xFF;
+
+		header_length += 4;
+	}
+
+	tcp_packet_t* header = netbuf_push(buf, sizeof(tcp_packet_t));
+
+	header->source = htons(local_port);
+	header->destination = htons(remote_port);
+	header->seq = htonl(seq);
+	header->ack_seq = htonl(ack);
+	header->data_offset = (header_length / 4) << 4;
+	header->flags = flags;
+	header->window = htons(window);
+	header->check = 0;
+	header->urg_ptr = 0;
+
+	uint32_t sum = checksum_pseudo_header(card->ipv4_addr, remote_ip, ETH_IPv4_HEAD_TCP, buf->len, 0);
+
+	if(card->features & NETCARD_FEATURE_TX_CSUM) {
+		// The card sums the segment itself, it only needs the pseudo header.
+		header->check = ~checksum_fold(sum);
+
+		buf->csum_partial = true;
+		buf->csum_start = (uint8_t*)header - buf->head;
+		buf->csum_offset = __builtin_offsetof(tcp_packet_t, check);
+	} else if(buf->csum_valid) {
+		// The payload was summed while it was copied in, only the header is left.
+		sum = checksum_block_add(sum, buf->csum, header_length);
+		header->check = checksum_fold(checksum_partial(header, header_length, sum));
+	} else {
+		header->check = checksum_fold(checksum_partial(header, buf->len, sum));
+	}
+
+	tcp_stats.segments_sent++;
+
+	ipv4_send_netbuf(card, remote_ip, buf, ETH_IPv4_HEAD_TCP);
+}
+
+/**
+ * @brief Отправляет сегмент соединения
+ *
+ * @param connection - Соединение
+ * @param seq - Номер последовательности
+ * @param flags - Флаги (ACK добавляется сам, кроме SYN_SENT)
+ * @param offset - Смещение данных в буфере отправки
+ * @param len - Длина данных
+ */
+static void tcp_send_segment(tcp_connection_t* connection, uint32_t seq, uint8_t flags, size_t offset, size_t len) {
+	netbuf_t* buf = netbuf_alloc(NETBUF_HEADROOM, len);
+
+	// Lost like on the wire, retransmission recovers it.
+	if(buf == NULL) {
+		return;
+	}
+
+	if(len) {
+		tcp_buffer_peek_netbuf(&connection->send_buffer, offset, buf, len);
+	}
+
+	uint32_t window = tcp_receive_window(connection);
+
+	if(connection->state != TCP_SYN_SENT) {
+		flags |= TCP_FLAG_ACK;
+
+		// Every segment carries the ACK, so a delayed one is not needed anymore.
+		connection->ack_deadline = 0;
+		connection->unacked_segments = 0;
+		connection->rcv_wnd_advertised = window;
+	}
+
+	tcp_transmit(connection->card, connection->remote_ip, connection->local_port, connection->remote_port,
+				 seq, (flags & TCP_FLAG_ACK) ? connection->rcv_nxt : 0, flags, window, buf);
+}
+
+static void tcp_ack_now(tcp_connection_t* connection) {
+	tcp_send_segment(connection, connection->snd_nxt, 0, 0, 0);
+}
+
+// Answers a segment that belongs to no connection (RFC 793, "Reset Generation").
+static void tcp_reply_reset(netcard_entry_t* card, const uint8_t remote_ip[4], uint16_t local_port, uint16_t remote_port, const tcp_input_t* in) {
+	if(in->flags & TCP_FLAG_RST) {
+		return;
+	}
+
+	netbuf_t* buf = netbuf_alloc(NETBUF_HEADROOM, 0);
+
+	if(buf == NULL) {
+		return;
+	}
+
+	tcp_stats.resets_sent++;
+
+	if(in->flags & TCP_FLAG_ACK) {
+		tcp_transmit(card, remote_ip, local_port, remote_port, in->ack, 0, TCP_FLAG_RST, 0, buf);
+	} else {
+		uint32_t seg_len = in->len + !!(in->flags & TCP_FLAG_SYN) + !!(in->flags & TCP_FLAG_FIN);
+
+		tcp_transmit(card, remote_ip, local_port, remote_port, 0, in->seq + seg_len, TCP_FLAG_RST | TCP_FLAG_ACK, 0, buf);
+	}
+}
+
+static void tcp_arm_retransmit(tcp_connection_t* connection) {
+	if(connection->rtx_deadline == 0) {
+		connection->rtx_deadline = getTicks() + connection->rto;
+	}
+}
+
+static bool tcp_can_send_data(tcp_state_t state) {
+	return state == TCP_ESTABLISHED || state == TCP_CLOSE_WAIT || state == TCP_FIN_WAIT_1
+		|| state == TCP_CLOSING || state == TCP_LAST_ACK;
 }
 
-bool tcp_new_connection(netcard_entry_t* card, uint8_t address[4], size_t port, size_t seq_nr) {
-	uint8_t empty_addr[4] = {0, 0, 0, 0};
-	int index = -1;
+/**
+ * @brief Отправляет всё, что позволяют окно получателя и окно перегрузки, затем FIN, если он запрошен
+ *
+ * @param connection - Соединение
+ */
+static void tcp_output(tcp_connection_t* connection) {
+	if(!tcp_can_send_data(connection->state)) {
+		return;
+	}
+
+	while(1) {
+		uint32_t flight = connection->snd_nxt - connection->snd_una;
+		size_t sent = MIN(flight, connection->send_buffer.len);
+		size_t unsent = connection->send_buffer.len - sent;
+
+		if(unsent == 0) {
+			// FIN goes right after the last byte, once.
+			if(connection->fin_queued && flight == connection->send_buffer.len) {
+				tcp_send_segment(connection, connection->snd_nxt, TCP_FLAG_FIN, 0, 0);
+
+				connection->snd_nxt++;
+				connection->snd_max = SEQ_MAX(connection->snd_max, connection->snd_nxt);
+
+				tcp_arm_retransmit(connection);
+			}
+
+			break;
+		}
+
+		uint32_t window = MIN(connection->cwnd, connection->snd_wnd);
+
+		if(flight >= window) {
+			// Closed window is probed by the retransmission timer (persist).
+			if(connection->snd_wnd == 0) {
+				tcp_arm_retransmit(connection);
+			}
 
-	for(int i = 0; i < MAX_CONNECTIONS; i++) {
-		if(memcmp((const char*)&TCP_CONNECTIONS[i].dest_ip_addr, (const char*)empty_addr, 4) == 0
-				&& TCP_CONNECTIONS[i].source_port == 0
-				&& TCP_CONNECTIONS[i].status == TCP_NONE) {
-			index = i;
 			break;
 		}
+
+		size_t len = MIN(unsent, MIN(window - flight, connection->mss));
+
+		tcp_send_segment(connection, connection->snd_nxt, len == unsent ? TCP_FLAG_PSH : 0, sent, len);
+
+		// Karn: segments sent again after a timeout are not timed (they are below `recover`).
+		if(!connection->rtt_pending && SEQ_GEQ(connection->snd_nxt, connection->recover)) {
+			connection->rtt_pending = true;
+			connection->rtt_seq = connection->snd_nxt;
+			connection->rtt_start = getTicks();
+		}
+
+		connection->snd_nxt += len;
+		connection->snd_max = SEQ_MAX(connection->snd_max, connection->snd_nxt);
+
+		tcp_arm_retransmit(connection);
 	}
+}
 
-	if(index == -1) {
-		return false;
+// Sends the first unacknowledged segment again.
+static void tcp_retransmit(tcp_connection_t* connection) {
+	tcp_stats.retransmits++;
+
+	// Karn: the next ACK can't tell which copy it acknowledges.
+	connection->rtt_pending = false;
+
+	if(connection->state == TCP_SYN_SENT || connection->state == TCP_SYN_RECEIVED) {
+		tcp_send_segment(connection, connection->iss, TCP_FLAG_SYN, 0, 0);
+		return;
 	}
 
-	memcpy((void*)&TCP_CONNECTIONS[index].dest_ip_addr, address, 4);
-	TCP_CONNECTIONS[index].source_port = port;
-	TCP_CONNECTIONS[index].status = TCP_CREATED;
-	TCP_CONNECTIONS[index].seq = seq_nr;
-	TCP_CONNECTIONS[index].card = card;
+	uint32_t flight = connection->snd_max - connection->snd_una;
+	size_t len = MIN(MIN(flight, connection->send_buffer.len), connection->mss);
 
-	return true;
+	if(len) {
+		tcp_send_segment(connection, connection->snd_una, 0, 0, len);
+	} else if(connection->fin_queued && flight > connection->send_buffer.len) {
+		tcp_send_segment(connection, connection->snd_una, TCP_FLAG_FIN, 0, 0);
+	}
 }
 
-typedef struct {
-    uint32_t src_addr;
-    uint32_t dst_addr;
-    uint8_t reserved;
-    uint8_t protocol;
-    uint16_t tcp_length;
-} __attribute__((packed)) ipv4_pseudo_header_t;
+/* State changes */
+
+/**
+ * @brief Переводит соединение в CLOSED и освобождает его, если оно больше никому не принадлежит.
+ *        После вызова к соединению обращаться нельзя.
+ *
+ * @param connection - Соединение
+ * @param error - NET_E* для пользователя или 0
+ */
+static void tcp_set_closed(tcp_connection_t* connection, int error) {
+	connection->state = TCP_CLOSED;
+
+	if(error && !connection->error) {
+		connection->error = error;
+	}
+
+	connection->rtx_deadline = 0;
+	connection->ack_deadline = 0;
+	connection->state_deadline = 0;
 
-uint16_t checksum(void *data, size_t len) {
-    uint32_t sum = 0;
-    uint16_t *ptr = (uint16_t *)data;
+	tcp_table_remove(connection);
 
-    while (len > 1) {
-        sum += *ptr++;
-        len -= 2;
-    }
+	wait_queue_wake_all(&connection->waiters);
 
-    // If odd byte left, pad with zero
-    if (len > 0) {
-        sum += *((uint8_t *)ptr);
-    }
+	if(connection->parent && !connection->queued) {
+		// Half-open child nobody has seen yet.
+		connection->parent->pending_count--;
 
-    // Fold 32-bit sum to 16-bit
-    while (sum >> 16) {
-        sum = (sum & 0xFFFF) + (sum >> 16);
-    }
+		tcp_connection_free(connection);
+	} else if(connection->user_closed) {
+		tcp_connection_free(connection);
+	}
+}
+
+static void tcp_abort(tcp_connection_t* connection, int error) {
+	tcp_state_t state = connection->state;
+
+	if(state == TCP_SYN_RECEIVED || state == TCP_ESTABLISHED || state == TCP_FIN_WAIT_1
+		|| state == TCP_FIN_WAIT_2 || state == TCP_CLOSE_WAIT) {
+		tcp_stats.resets_sent++;
 
-    return (uint16_t)(~sum);  // One's complement
+		tcp_send_segment(connection, connection->snd_nxt, TCP_FLAG_RST, 0, 0);
+	}
+
+	tcp_set_closed(connection, error);
 }
 
-// TODO: !!!
-uint16_t tcp_calculate_checksum(uint32_t src_addr, uint32_t dst_addr, tcp_packet_t *tcp_packet, uint16_t tcp_length) {
-    ipv4_pseudo_header_t pseudo_header;
-    pseudo_header.src_addr = src_addr;
-    pseudo_header.dst_addr = dst_addr;
-    pseudo_header.reserved = 0;
-    pseudo_header.protocol = 6; // TCP protocol number
-    pseudo_header.tcp_length = htons(tcp_length);
-
-    size_t buffer_size = sizeof(ipv4_pseudo_header_t) + tcp_length;
-    uint8_t *buffer = kmalloc(buffer_size);
-    if (!buffer) {
-        return 0; // Handle allocation failure
-    }
-
-    memcpy(buffer, &pseudo_header, sizeof(ipv4_pseudo_header_t));
-    memcpy(buffer + sizeof(ipv4_pseudo_header_t), tcp_packet, tcp_length);
-
-    uint16_t check = checksum(buffer, buffer_size);
-    kfree(buffer);
-    return check;
-}
-
-void tcp_handle_packet(netcard_entry_t *card, tcp_packet_t *packet) {
-	qemu_note("!!!!!!!!!!!!!!!!!!!!!!!! TCP !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!");
-
-	ipv4_packet_t *ipv4 = (ipv4_packet_t *)((size_t)packet - sizeof(ipv4_packet_t));
-	size_t data_payload_size = ipv4->TotalLength - sizeof(ipv4_packet_t);
-
-	qemu_log("Data payload size: %d", data_payload_size);
-
-	packet->source = ntohs(packet->source);
-	packet->destination = ntohs(packet->destination);
-
-	qemu_log("FROM: %u.%u.%u.%u", ipv4->Source[0], ipv4->Source[1], ipv4->Source[2], ipv4->Source[3]);
-
-	qemu_note("SRC: %d; DEST: %d", packet->source, packet->destination);
-
-	qemu_note("FLAGS: SYN: %d; ACK: %d; PSH: %d; FIN: %d", packet->syn, packet->ack, packet->psh, packet->fin);
-
-	packet->ack_seq = ntohl(packet->ack_seq);
-	packet->seq = ntohl(packet->seq);
-
-	int idx = -1;
-	uint16_t sp_port = ntohs(packet->source);
-	if(tcp_find_connection(ipv4->Source, sp_port) == -1) {
-		tcp_new_connection(card, ipv4->Source, sp_port, packet->seq);
-		qemu_ok("Created new connection (port: %d)!", sp_port);
-	}
-	idx = tcp_find_connection(ipv4->Source, sp_port);
-
-	tcp_connection_status_t current_status = TCP_CONNECTIONS[idx].status;
-	
-	qemu_note("Connection idx: %d; Status: %x", idx, current_status);
-	
-	// Stage 1. Packet arrived to create connection with us.
-	//          SYN is set; Connection is created by `tcp_new_connection` automatically.
-	//          We send SYN + ACK and wait for ACK. Mark connection as tcp_connection_status_t::TCP_CREATED.
-	bool is_stage_1 = current_status == TCP_CREATED && packet->syn && !packet->ack && !packet->psh && !packet->fin;
-	
-	// Stage 2. Packet arrived with connection establishment confirmation.
-	//          ACK is set; Connection is known as tcp_connection_status_t::TCP_CREATED;
-	//          We send nothing. Mark connection as tcp_connection_status_t::TCP_ESTABLISHED.
-	bool is_stage_2 = current_status == TCP_CREATED && !packet->syn && packet->ack && !packet->psh && !packet->fin;
-	// bool is_push = !packet->syn && !packet->ack && packet->psh && !packet->fin;
-
-	if(is_stage_1) {
-		qemu_note("== STAGE 1 ==");
-
-		tcp_packet_t* sendable_packet = kcalloc(sizeof(tcp_packet_t)/* + 8*/, 1);
-		memcpy(sendable_packet, packet, sizeof(tcp_packet_t));	
-
-		TCP_CONNECTIONS[idx].seq = rand();
-		TCP_CONNECTIONS[idx].ack = packet->seq + 1; // Use the received packet's seq (host order)
-	
-		sendable_packet->ack = 1;
-		sendable_packet->syn = 1; // Ensure SYN is set in response
-		sendable_packet->seq = htonl(TCP_CONNECTIONS[idx].seq);
-		sendable_packet->ack_seq = htonl(TCP_CONNECTIONS[idx].ack);
-	
-		uint16_t dest_port = sendable_packet->destination;
-		uint16_t src_port = sendable_packet->source;
-		sendable_packet->source = ntohs(dest_port);
-		sendable_packet->destination = ntohs(src_port);
-	
-		sendable_packet->doff = 5; // Header length (5 * 4 = 20 bytes)
-	
-		// Calculate checksum with correct IPs and TCP length
-		uint32_t src_ip, dst_ip;
-		memcpy(&src_ip, ipv4->Destination, 4); // Server's IP (from received packet's destination)
-		memcpy(&dst_ip, ipv4->Source, 4);      // Client's IP (from received packet's source)
-		uint16_t tcp_length = sizeof(tcp_packet_t); // Adjust if options are added
-	
-		sendable_packet->check = 0; // Reset checksum before calculation
-		sendable_packet->check = tcp_calculate_checksum(src_ip, dst_ip, sendable_packet, tcp_length);
-	
-		ipv4_send_packet(TCP_CONNECTIONS[idx].card, ipv4->Source, sendable_packet, sizeof(tcp_packet_t), ETH_IPv4_HEAD_TCP);
-
-		kfree(sendable_packet);
-
-		// TCP_CONNECTIONS[idx].source_port = ntohs(packet->destination);
-		TCP_CONNECTIONS[idx].dest_port = ntohs(packet->destination);
-		TCP_CONNECTIONS[idx].status = TCP_CREATED;
-	} else if(is_stage_2) {
-		qemu_note("== STAGE 2 ==");
-
-		volatile tcp_connection_t* connection = TCP_CONNECTIONS + idx;
-
-		connection->status = TCP_ESTABLISHED;
-
-		qemu_ok("Connection established!");
-
-		char* data = "Hello, world!\n";
-		size_t length = strlen(data);
-
-		tcp_send_packet((tcp_connection_t*)(TCP_CONNECTIONS + idx), data, length);
+static void tcp_enter_time_wait(tcp_connection_t* connection) {
+	connection->state = TCP_TIME_WAIT;
+	connection->state_deadline = getTicks() + 2 * TCP_MSL;
+	connection->rtx_deadline = 0;
+	connection->ack_deadline = 0;
+}
+
+static void tcp_enter_fin_wait_2(tcp_connection_t* connection) {
+	connection->state = TCP_FIN_WAIT_2;
+
+	// Peer may never close its side, don't keep an orphan forever.
+	if(connection->user_closed) {
+		connection->state_deadline = getTicks() + TCP_FIN_WAIT2_TIMEOUT;
+	}
+}
+
+/* RTT estimation (RFC 6298) */
+
+static void tcp_rtt_sample(tcp_connection_t* connection, uint32_t ack) {
+	if(!connection->rtt_pending || SEQ_LEQ(ack, connection->rtt_seq)) {
+		return;
+	}
+
+	connection->rtt_pending = false;
+
+	uint32_t rtt = MAX(getTicks() - connection->rtt_start, 1u);
+
+	if(connection->srtt == 0) {
+		connection->srtt = rtt << 3;
+		connection->rttvar = rtt << 1;
 	} else {
-		qemu_note("== ANOTHER STAGE! ==");
-		qemu_note("== ANOTHER STAGE! ==");
-		qemu_note("== ANOTHER STAGE! ==");
-		qemu_note("== ANOTHER STAGE! ==");
-		while(1);
+		int32_t delta = (int32_t)rtt - (int32_t)(connection->srtt >> 3);
+
+		connection->srtt = (uint32_t)((int32_t)connection->srtt + delta);
+
+		if(delta < 0) {
+			delta = -delta;
+		}
+
+		connection->rttvar = (uint32_t)((int32_t)connection->rttvar + delta - (int32_t)(connection->rttvar >> 2));
 	}
 
-	qemu_log("Finished handling");
+	// RTO = SRTT + max(G, 4 * RTTVAR), `rttvar` is already scaled by 4.
+	uint32_t rto = (connection->srtt >> 3) + MAX(connection->rttvar, (uint32_t)TCP_TIMER_INTERVAL);
+
+	connection->rto = MIN(MAX(rto, (uint32_t)TCP_RTO_MIN), (uint32_t)TCP_RTO_MAX);
 }
 
-void tcp_send_packet(tcp_connection_t* connection, void* data, size_t len) {
-	qemu_note("S: %d; D: %d", connection->source_port, connection->dest_port);
+static void tcp_established(tcp_connection_t* connection, uint32_t ack) {
+	connection->state = TCP_ESTABLISHED;
+
+	// Initial window (RFC 5681, 3.1)
+	connection->cwnd = MIN(4 * connection->mss, MAX(2 * connection->mss, 4380u));
+	connection->rtx_deadline = 0;
+	connection->rtx_count = 0;
 
-	tcp_packet_t* sendable_packet = kcalloc(sizeof(tcp_packet_t) + len, 1);
-	// memcpy(sendable_packet, packet, sizeof(tcp_packet_t));
+	tcp_rtt_sample(connection, ack);
 
-	char* inner_data = (char*)(sendable_packet + 1);
+	// A retransmitted SYN leaves backed off RTO behind.
+	if(connection->srtt == 0) {
+		connection->rto = TCP_RTO_INITIAL;
+	}
 
-	memcpy(inner_data, data, len);
+	wait_queue_wake_all(&connection->waiters);
+}
 
-	// qemu_log("CS: %x; CA: %x; PS: %x; PA: %x", connection->seq, connection->ack, packet->seq, packet->ack_seq);
-	// qemu_log("Was: %x; %x", connection->seq, connection->ack);
+/* Input */
 
-	connection->seq += 1;
+static uint16_t tcp_parse_mss(const tcp_packet_t* packet, size_t header_length) {
+	const uint8_t* option = (const uint8_t*)packet + sizeof(tcp_packet_t);
+	const uint8_t* end = (const uint8_t*)packet + header_length;
 
-	// qemu_log("Became: %x; %x (Should be: %x; %x)", connection->seq, connection->ack, packet->ack_seq, packet->seq);
+	while(option < end) {
+		if(*option == TCP_OPTION_END) {
+			break;
+		}
 
-	sendable_packet->source = connection->dest_port;
-	sendable_packet->destination = connection->source_port;
-	sendable_packet->window = 0xfffa;
-	sendable_packet->psh = 1;
-	sendable_packet->ack = 1;
-	sendable_packet->syn = 0;
-	sendable_packet->seq = htonl(connection->seq);
-	sendable_packet->ack_seq = htonl(connection->ack);
+		if(*option == TCP_OPTION_NOP) {
+			option++;
+			continue;
+		}
 
-	sendable_packet->doff = 5; // Header length (5 * 4 = 20 bytes)
+		if(option + 1 >= end || option[1] < 2 || option + option[1] > end) {
+			break;
+		}
 
-	// Calculate checksum with correct IPs and TCP length
-	uint32_t src_ip, dst_ip;
-	memcpy(&src_ip, connection->card->ipv4_addr, 4); // Server's IP (from received packet's destination)
-	memcpy(&dst_ip, &connection->dest_ip_addr, 4);      // Client's IP (from received packet's source)
-	uint16_t tcp_length = sizeof(tcp_packet_t); // Adjust if options are added
+		if(option[0] == TCP_OPTION_MSS && option[1] == 4) {
+			return (option[2] << 8) | option[3];
+		}
+
+		option += option[1];
+	}
+
+	return 0;
+}
+
+static void tcp_set_mss(tcp_connection_t* connection, const tcp_input_t* in) {
+	uint16_t mss = in->mss ? in->mss : TCP_DEFAULT_MSS;
+
+	connection->mss = MAX(MIN(mss, TCP_MSS), 64);
+}
+
+static void tcp_listen_input(tcp_connection_t* listener, netcard_entry_t* card, const uint8_t remote_ip[4],
+							 uint16_t local_port, uint16_t remote_port, const tcp_input_t* in) {
+	if(in->flags & TCP_FLAG_RST) {
+		return;
+	}
+
+	if(in->flags & TCP_FLAG_ACK) {
+		tcp_reply_reset(card, remote_ip, local_port, remote_port, in);
+		return;
+	}
+
+	if(!(in->flags & TCP_FLAG_SYN)) {
+		return;
+	}
+
+	// Backlog is full: drop the SYN, the peer will retry.
+	if(listener->pending_count + listener->accept_count >= listener->backlog) {
+		return;
+	}
+
+	tcp_connection_t* connection = tcp_connection_new(card, remote_ip, local_port, remote_port);
+
+	if(connection == NULL) {
+		return;
+	}
+
+	connection->parent = listener;
+	listener->pending_count++;
+
+	connection->irs = in->seq;
+	connection->rcv_nxt = in->seq + 1;
+	connection->snd_wnd = in->window;
+	connection->snd_wl1 = in->seq;
+	connection->snd_wl2 = connection->iss;
+	tcp_set_mss(connection, in);
+
+	connection->state = TCP_SYN_RECEIVED;
+
+	tcp_table_insert(connection);
+
+	tcp_send_segment(connection, connection->iss, TCP_FLAG_SYN, 0, 0);
+
+	connection->snd_nxt = connection->iss + 1;
+	connection->snd_max = connection->snd_nxt;
+	connection->rtt_pending = true;
+	connection->rtt_seq = connection->iss;
+	connection->rtt_start = getTicks();
+
+	tcp_arm_retransmit(connection);
+}
+
+static void tcp_syn_sent_input(tcp_connection_t* connection, const tcp_input_t* in) {
+	if(in->flags & TCP_FLAG_ACK) {
+		if(SEQ_LEQ(in->ack, connection->iss) || SEQ_GT(in->ack, connection->snd_max)) {
+			tcp_reply_reset(connection->card, connection->remote_ip, connection->local_port, connection->remote_port, in);
+			return;
+		}
+	}
+
+	if(in->flags & TCP_FLAG_RST) {
+		if(in->flags & TCP_FLAG_ACK) {
+			tcp_set_closed(connection, NET_ECONNREFUSED);
+		}
 
-	// CLARIFICATION: We set this field to zero to calculate checksum - the field should be zeroed.
-	//                If not, the checksum will be always invalid.
-	sendable_packet->check = 0;
-	sendable_packet->check = tcp_calculate_checksum(src_ip, dst_ip, sendable_packet, tcp_length + len);
+		return;
+	}
+
+	if(!(in->flags & TCP_FLAG_SYN)) {
+		return;
+	}
+
+	connection->irs = in->seq;
+	connection->rcv_nxt = in->seq + 1;
+	tcp_set_mss(connection, in);
+
+	if(in->flags & TCP_FLAG_ACK) {
+		connection->snd_una = in->ack;
+		connection->snd_wnd = in->window;
+		connection->snd_wl1 = in->seq;
+		connection->snd_wl2 = in->ack;
+
+		tcp_established(connection, in->ack);
+		tcp_ack_now(connection);
+	} else {
+		// Simultaneous open
+		connection->state = TCP_SYN_RECEIVED;
+
+		tcp_send_segment(connection, connection->iss, TCP_FLAG_SYN, 0, 0);
+	}
+}
+
+static bool tcp_segment_acceptable(const tcp_connection_t* connection, const tcp_input_t* in, uint32_t window) {
+	uint32_t seg_len = in->len + !!(in->flags & TCP_FLAG_SYN) + !!(in->flags & TCP_FLAG_FIN);
+	uint32_t start = in->seq - connection->rcv_nxt;
+
+	if(seg_len == 0) {
+		return window == 0 ? in->seq == connection->rcv_nxt : start < window;
+	}
+
+	if(window == 0) {
+		return false;
+	}
 
-	ipv4_send_packet(connection->card, (uint8_t*)&connection->dest_ip_addr, sendable_packet, sizeof(tcp_packet_t) + len, ETH_IPv4_HEAD_TCP);
+	uint32_t end = in->seq + seg_len - 1 - connection->rcv_nxt;
 
-	kfree(sendable_packet);
-}
\ No newline at end of file
+	return start < window || end < window;
+}
+
+// Final ACK of the three-way handshake. Returns false if the segment is dropped.
+static bool tcp_syn_received_ack(tcp_connection_t* connection, const tcp_input_t* in) {
+	if(SEQ_LEQ(in->ack, connection->snd_una) || SEQ_GT(in->ack, connection->snd_max)) {
+		tcp_reply_reset(connection->card, connection->remote_ip, connection->local_port, connection->remote_port, in);
+		return false;
+	}
+
+	connection->snd_una = connection->iss + 1;
+	connection->snd_wnd = in->window;
+	connection->snd_wl1 = in->seq;
+	connection->snd_wl2 = in->ack;
+
+	tcp_established(connection, in->ack);
+
+	tcp_connection_t* listener = connection->parent;
+
+	if(listener) {
+		listener->pending_count--;
+		listener->accept_count++;
+
+		connection->queued = true;
+		connection->accept_next = NULL;
+
+		if(listener->accept_tail) {
+			listener->accept_tail->accept_next = connection;
+		} else {
+			listener->accept_head = connection;
+		}
+
+		listener->accept_tail = connection;
+
+		wait_queue_wake_all(&listener->waiters);
+	}
+
+	return true;
+}
+
+/**
+ * @brief Окно перегрузки после подтверждения новых данных (RFC 5681, NewReno из RFC 6582)
+ *
+ * @param connection - Соединение
+ * @param acked - Сколько байт подтверждено
+ */
+static void tcp_congestion_ack(tcp_connection_t* connection, uint32_t acked) {
+	if(connection->in_recovery) {
+		if(SEQ_GEQ(connection->snd_una, connection->recover)) {
+			// Full ACK: everything sent before the loss arrived.
+			connection->cwnd = connection->ssthresh;
+			connection->in_recovery = false;
+		} else {
+			// Partial ACK: the next hole is lost too.
+			tcp_retransmit(connection);
+
+			connection->cwnd = connection->cwnd > acked ? connection->cwnd - acked : 0;
+
+			if(acked >= connection->mss) {
+				connection->cwnd += connection->mss;
+			}
+
+			connection->cwnd = MAX(connection->cwnd, connection->mss);
+		}
+	} else if(connection->cwnd < connection->ssthresh) {
+		connection->cwnd += MIN(acked, connection->mss);
+	} else {
+		connection->cwnd += MAX(connection->mss * connection->mss / connection->cwnd, 1u);
+	}
+
+	connection->dupacks = 0;
+}
+
+static void tcp_duplicate_ack(tcp_connection_t* connection, uint32_t ack) {
+	connection->dupacks++;
+
+	if(connection->in_recovery) {
+		// Every duplicate means one more segment has left the network.
+		connection->cwnd += connection->mss;
+		return;
+	}
+
+	if(connection->dupacks != TCP_DUPACK_THRESHOLD || !SEQ_GT(ack, connection->recover)) {
+		return;
+	}
+
+	uint32_t flight = connection->snd_max - connection->snd_una;
+
+	tcp_stats.fast_retransmits++;
+
+	connection->ssthresh = MAX(flight / 2, 2 * connection->mss);
+	connection->recover = connection->snd_max;
+	connection->in_recovery = true;
+
+	tcp_retransmit(connection);
+
+	connection->cwnd = connection->ssthresh + TCP_DUPACK_THRESHOLD * connection->mss;
+}
+
+/**
+ * @brief Обрабатывает поле ACK в синхронизированных состояниях
+ *
+ * @param connection - Соединение
+ * @param in - Сегмент
+ * @param fin_acked - Получает true, если подтверждён наш FIN
+ * @return false - если сегмент нужно отбросить
+ */
+static bool tcp_ack_input(tcp_connection_t* connection, const tcp_input_t* in, bool* fin_acked) {
+	*fin_acked = false;
+
+	// Acknowledges something never sent.
+	if(SEQ_GT(in->ack, connection->snd_max)) {
+		tcp_ack_now(connection);
+		return false;
+	}
+
+	uint32_t flight = connection->snd_max - connection->snd_una;
+	bool window_update = SEQ_LT(connection->snd_wl1, in->seq)
+		|| (connection->snd_wl1 == in->seq && SEQ_LEQ(connection->snd_wl2, in->ack));
+
+	if(SEQ_GT(in->ack, connection->snd_una)) {
+		uint32_t acked = in->ack - connection->snd_una;
+		size_t data_acked = acked;
+
+		// FIN takes one sequence number after the data.
+		if(data_acked > connection->send_buffer.len) {
+			data_acked = connection->send_buffer.len;
+			*fin_acked = connection->fin_queued;
+		}
+
+		tcp_buffer_consume(&connection->send_buffer, data_acked);
+
+		connection->snd_una = in->ack;
+
+		// Peer got segments we were going to send again after a timeout.
+		if(SEQ_LT(connection->snd_nxt, connection->snd_una)) {
+			connection->snd_nxt = connection->snd_una;
+		}
+
+		tcp_rtt_sample(connection, in->ack);
+		tcp_congestion_ack(connection, acked);
+
+		connection->rtx_count = 0;
+		connection->rtx_deadline = connection->snd_una != connection->snd_max ? getTicks() + connection->rto : 0;
+
+		wait_queue_wake_all(&connection->waiters);
+	} else if(in->ack == connection->snd_una && in->len == 0 && flight > 0
+			  && !(in->flags & (TCP_FLAG_SYN | TCP_FLAG_FIN)) && in->window == connection->snd_wnd) {
+		tcp_duplicate_ack(connection, in->ack);
+	}
+
+	if(window_update) {
+		connection->snd_wnd = in->window;
+		connection->snd_wl1 = in->seq;
+		connection->snd_wl2 = in->ack;
+	}
+
+	return true;
+}
+
+static void tcp_ooo_insert(tcp_connection_t* connection, uint32_t seq, const uint8_t* data, size_t len) {
+	tcp_segment_t** link = &connection->ooo;
+
+	while(*link && SEQ_LT((*link)->seq, seq)) {
+		link = &(*link)->next;
+	}
+
+	if(*link && (*link)->seq == seq && (*link)->len >= len) {
+		return;
+	}
+
+	if(connection->ooo_count >= TCP_MAX_OOO_SEGMENTS) {
+		tcp_stats.ooo_dropped++;
+		return;
+	}
+
+	tcp_segment_t* segment = kmalloc(sizeof(tcp_segment_t) + len);
+
+	netstack_count_allocation(true);
+
+	if(segment == NULL) {
+		tcp_stats.ooo_dropped++;
+		return;
+	}
+
+	segment->seq = seq;
+	segment->len = len;
+	memcpy(segment->data, data, len);
+	netstack_count_copy(len);
+
+	segment->next = *link;
+	*link = segment;
+
+	connection->ooo_count++;
+}
+
+// Moves out-of-order segments that became contiguous into the receive buffer.
+static void tcp_ooo_drain(tcp_connection_t* connection) {
+	while(connection->ooo && SEQ_LEQ(connection->ooo->seq, connection->rcv_nxt)) {
+		tcp_segment_t* segment = connection->ooo;
+
+		connection->ooo = segment->next;
+		connection->ooo_count--;
+
+		if(SEQ_GT(segment->seq + segment->len, connection->rcv_nxt)) {
+			size_t skip = connection->rcv_nxt - segment->seq;
+
+			connection->rcv_nxt += tcp_buffer_write(&connection->recv_buffer, segment->data + skip, segment->len - skip);
+		}
+
+		kfree(segment);
+	}
+}
+
+static void tcp_data_input(tcp_connection_t* connection, tcp_input_t* in) {
+	// Drop the part we already have.
+	if(SEQ_LT(in->seq, connection->rcv_nxt)) {
+		uint32_t skip = connection->rcv_nxt - in->seq;
+
+		if(skip > in->len) {
+			in->flags &= ~TCP_FLAG_FIN;
+			skip = in->len;
+		}
+
+		in->data += skip;
+		in->len -= skip;
+		in->seq += skip;
+	}
+
+	size_t space = tcp_buffer_free(&connection->recv_buffer);
+	uint32_t offset = in->seq - connection->rcv_nxt;
+
+	// And the part that does not fit.
+	if(offset + in->len > space) {
+		in->len = offset < space ? space - offset : 0;
+		in->flags &= ~TCP_FLAG_FIN;
+	}
+
+	if(in->len == 0) {
+		return;
+	}
+
+	if(offset) {
+		tcp_ooo_insert(connection, in->seq, in->data, in->len);
+
+		// Duplicate ACK tells the sender about the hole.
+		tcp_ack_now(connection);
+		return;
+	}
+
+	connection->rcv_nxt += tcp_buffer_write(&connection->recv_buffer, in->data, in->len);
+
+	bool filled_hole = connection->ooo != NULL;
+
+	tcp_ooo_drain(connection);
+
+	wait_queue_wake_all(&connection->waiters);
+
+	// ACK every second segment, the rest are delayed (RFC 1122, 4.2.3.2)
+	if(filled_hole || ++connection->unacked_segments >= 2) {
+		tcp_ack_now(connection);
+	} else if(connection->ack_deadline == 0) {
+		connection->ack_deadline = getTicks() + TCP_DELAYED_ACK;
+	}
+}
+
+static void tcp_fin_input(tcp_connection_t* connection) {
+	connection->rcv_nxt++;
+	connection->fin_received = true;
+
+	tcp_ack_now(connection);
+
+	if(connection->state == TCP_ESTABLISHED) {
+		connection->state = TCP_CLOSE_WAIT;
+	} else if(connection->state == TCP_FIN_WAIT_1) {
+		connection->state = TCP_CLOSING;
+	} else if(connection->state == TCP_FIN_WAIT_2) {
+		tcp_enter_time_wait(connection);
+	}
+
+	wait_queue_wake_all(&connection->waiters);
+}
+
+/**
+ * @brief Обработка сегмента существующего соединения (RFC 793, "SEGMENT ARRIVES")
+ *
+ * @param connection - Соединение
+ * @param in - Сегмент
+ */
+static void tcp_segment_arrives(tcp_connection_t* connection, tcp_input_t* in) {
+	if(connection->state == TCP_SYN_SENT) {
+		tcp_syn_sent_input(connection, in);
+		return;
+	}
+
+	uint32_t window = tcp_buffer_free(&connection->recv_buffer);
+
+	if(!tcp_segment_acceptable(connection, in, window)) {
+		if(in->flags & TCP_FLAG_RST) {
+			return;
+		}
+
+		if(connection->state == TCP_SYN_RECEIVED && (in->flags & TCP_FLAG_SYN)) {
+			// Our SYN-ACK was lost.
+			tcp_retransmit(connection);
+			return;
+		}
+
+		if(connection->state == TCP_TIME_WAIT && (in->flags & TCP_FLAG_FIN)) {
+			connection->state_deadline = getTicks() + 2 * TCP_MSL;
+		}
+
+		tcp_ack_now(connection);
+
+		// Zero window probes still carry a valid ACK.
+		if(!(window == 0 && in->seq == connection->rcv_nxt)) {
+			return;
+		}
+
+		in->len = 0;
+		in->flags &= ~TCP_FLAG_FIN;
+	}
+
+	if(in->flags & TCP_FLAG_RST) {
+		tcp_state_t state = connection->state;
+
+		if(state == TCP_SYN_RECEIVED) {
+			tcp_set_closed(connection, NET_ECONNREFUSED);
+		} else if(state == TCP_ESTABLISHED || state == TCP_FIN_WAIT_1 || state == TCP_FIN_WAIT_2 || state == TCP_CLOSE_WAIT) {
+			tcp_set_closed(connection, NET_ECONNRESET);
+		} else {
+			tcp_set_closed(connection, 0);
+		}
+
+		return;
+	}
+
+	// SYN inside the window: challenge ACK (RFC 5961, 4.2) instead of trusting it.
+	if(in->flags & TCP_FLAG_SYN) {
+		tcp_ack_now(connection);
+		return;
+	}
+
+	if(!(in->flags & TCP_FLAG_ACK)) {
+		return;
+	}
+
+	if(connection->state == TCP_SYN_RECEIVED && !tcp_syn_received_ack(connection, in)) {
+		return;
+	}
+
+	bool fin_acked;
+
+	if(!tcp_ack_input(connection, in, &fin_acked)) {
+		return;
+	}
+
+	if(fin_acked) {
+		if(connection->state == TCP_FIN_WAIT_1) {
+			tcp_enter_fin_wait_2(connection);
+		} else if(connection->state == TCP_CLOSING) {
+			tcp_enter_time_wait(connection);
+		} else if(connection->state == TCP_LAST_ACK) {
+			tcp_set_closed(connection, 0);
+			return;
+		}
+	}
+
+	tcp_state_t state = connection->state;
+
+	if(state == TCP_ESTABLISHED || state == TCP_FIN_WAIT_1 || state == TCP_FIN_WAIT_2) {
+		tcp_data_input(connection, in);
+
+		if((in->flags & TCP_FLAG_FIN) && !connection->fin_received && in->seq + in->len == connection->rcv_nxt) {
+			tcp_fin_input(connection);
+		}
+	}
+
+	tcp_output(connection);
+}
+
+void tcp_handle_packet(netcard_entry_t *card, ipv4_packet_t* ip, tcp_packet_t *packet, size_t length) {
+	if(length < sizeof(tcp_packet_t)) {
+		return;
+	}
+
+	size_t header_length = (packet->data_offset >> 4) * 4;
+
+	if(header_length < sizeof(tcp_packet_t) || header_length > length) {
+		return;
+	}
+
+	uint32_t src_ip, dst_ip;
+	memcpy(&src_ip, ip->Source, 4);
+	memcpy(&dst_ip, ip->Destination, 4);
+
+	if(tcp_calculate_checksum(src_ip, dst_ip, packet, length) != 0) {
+		tcp_stats.checksum_errors++;
+		return;
+	}
+
+	tcp_input_t in = {
+		.seq = ntohl(packet->seq),
+		.ack = ntohl(packet->ack_seq),
+		.flags = packet->flags,
+		.window = ntohs(packet->window),
+		.mss = 0,
+		.data = (uint8_t*)packet + header_length,
+		.len = length - header_length,
+	};
+
+	if(in.flags & TCP_FLAG_SYN) {
+		in.mss = tcp_parse_mss(packet, header_length);
+	}
+
+	uint16_t local_port = ntohs(packet->destination);
+	uint16_t remote_port = ntohs(packet->source);
+
+	tcp_lock_acquire();
+
+	tcp_stats.segments_received++;
+
+	tcp_connection_t* connection = tcp_lookup(ip->Destination, local_port, ip->Source, remote_port);
+
+	if(connection) {
+		tcp_segment_arrives(connection, &in);
+	} else {
+		tcp_connection_t* listener = tcp_find_listener(card, local_port);
+
+		if(listener) {
+			tcp_listen_input(listener, card, ip->Source, local_port, remote_port, &in);
+		} else {
+			tcp_reply_reset(card, ip->Source, local_port, remote_port, &in);
+		}
+	}
+
+	tcp_lock_release();
+}
+
+/* Timers */
+
+static void tcp_retransmit_timeout(tcp_connection_t* connection, size_t now) {
+	uint32_t flight = connection->snd_max - connection->snd_una;
+	bool synchronized = tcp_can_send_data(connection->state);
+
+	// Peer closed its window: probe it with one byte, this is not a loss (persist timer).
+	if(synchronized && connection->snd_wnd == 0 && connection->send_buffer.len > 0) {
+		if(flight == 0) {
+			connection->snd_nxt++;
+			connection->snd_max = connection->snd_nxt;
+		}
+
+		tcp_send_segment(connection, connection->snd_una, 0, 0, 1);
+
+		connection->rto = MIN(connection->rto * 2, (uint32_t)TCP_RTO_MAX);
+		connection->rtx_deadline = now + connection->rto;
+
+		return;
+	}
+
+	if(flight == 0) {
+		connection->rtx_deadline = 0;
+		return;
+	}
+
+	uint32_t limit = synchronized ? TCP_DATA_RETRIES : TCP_SYN_RETRIES;
+
+	if(connection->rtx_count >= limit) {
+		tcp_stats.timeouts++;
+
+		tcp_set_closed(connection, NET_ETIMEDOUT);
+		return;
+	}
+
+	connection->rtx_count++;
+	connection->rto = MIN(connection->rto * 2, (uint32_t)TCP_RTO_MAX);
+	connection->rtx_deadline = now + connection->rto;
+
+	if(!synchronized) {
+		tcp_retransmit(connection);
+		return;
+	}
+
+	// Everything in flight is considered lost: restart from one segment (RFC 5681, 3.1).
+	connection->ssthresh = MAX(flight / 2, 2 * connection->mss);
+	connection->cwnd = connection->mss;
+	connection->dupacks = 0;
+	connection->in_recovery = false;
+	connection->recover = connection->snd_max;
+	connection->rtt_pending = false;
+
+	connection->snd_nxt = connection->snd_una;
+
+	tcp_stats.retransmits++;
+
+	tcp_output(connection);
+}
+
+static void tcp_connection_timers(tcp_connection_t* connection, size_t now) {
+	if(connection->state_deadline && TICKS_PASSED(now, connection->state_deadline)) {
+		tcp_set_closed(connection, 0);
+		return;
+	}
+
+	if(connection->ack_deadline && TICKS_PASSED(now, connection->ack_deadline)) {
+		tcp_ack_now(connection);
+	}
+
+	if(connection->rtx_deadline && TICKS_PASSED(now, connection->rtx_deadline)) {
+		tcp_retransmit_timeout(connection, now);
+	}
+}
+
+/**
+ * @brief Поток таймеров TCP: повторная передача, отложенные ACK, TIME_WAIT
+ */
+__attribute__((noreturn)) static void tcp_timer_loop() {
+	while(1) {
+		__asm__ volatile("cli");
+
+		sched_wait(tcp_stats.active_connections ? TCP_TIMER_INTERVAL : SCHED_MAX_IDLE_TICKS);
+
+		size_t now = getTicks();
+
+		tcp_lock_acquire();
+
+		for(size_t i = 0; i < TCP_HASH_SIZE; i++) {
+			tcp_connection_t* next;
+
+			for(tcp_connection_t* connection = tcp_table[i]; connection; connection = next) {
+				next = connection->hash_next;
+
+				tcp_connection_timers(connection, now);
+			}
+		}
+
+		tcp_lock_release();
+	}
+}
+
+void tcp_init() {
+	tcp_timer_thread = thread_create_arg1(get_current_proc(), tcp_timer_loop, 0x4000, THREAD_KERNEL, 0);
+
+	thread_set_sched_class(tcp_timer_thread, SCHED_CLASS_INTERACTIVE, 0);
+
+	qemu_ok("TCP: %d buckets, %d KiB buffers", TCP_HASH_SIZE, TCP_SEND_BUFFER_SIZE >> 10);
+}
+
+/* User interface */
+
+// Sleeps until something happens to the connection. Called and returns with `tcp_lock` held.
+static void tcp_wait(tcp_connection_t* connection) {
+	wait_queue_entry_t entry;
+
+	wait_queue_add(&connection->waiters, &entry);
+
+	connection->sleepers++;
+
+	// Nobody can wake us between the unlock and `sched_wait`: interrupts are off.
+	__asm__ volatile("cli");
+
+	tcp_lock_release();
+
+	sched_wait(SCHED_MAX_IDLE_TICKS);
+
+	wait_queue_remove(&connection->waiters, &entry);
+
+	tcp_lock_acquire();
+
+	connection->sleepers--;
+}
+
+/**
+ * @brief Начинает принимать соединения на порту
+ *
+ * @param card - Сетевая карта (NULL - любая)
+ * @param port - Порт
+ * @param backlog - Сколько соединений может ждать `tcp_accept`
+ * @param error - Получает NET_E* при ошибке
+ * @return tcp_connection_t* - Слушающее соединение или NULL
+ */
+tcp_connection_t* tcp_listen(netcard_entry_t* card, uint16_t port, size_t backlog, int* error) {
+	tcp_lock_acquire();
+
+	if(port == 0 || tcp_find_listener(card, port)) {
+		tcp_lock_release();
+
+		*error = port ? NET_EADDRINUSE : NET_EINVAL;
+		return NULL;
+	}
+
+	tcp_connection_t* listener = kcalloc(sizeof(tcp_connection_t), 1);
+
+	if(listener == NULL) {
+		tcp_lock_release();
+
+		*error = NET_ENOMEM;
+		return NULL;
+	}
+
+	listener->card = card;
+	listener->local_port = port;
+	listener->backlog = MAX(backlog, (size_t)1);
+	listener->state = TCP_LISTEN;
+
+	listener->hash_next = tcp_listeners;
+	tcp_listeners = listener;
+
+	tcp_lock_release();
+
+	return listener;
+}
+
+/**
+ * @brief Забирает установленное соединение из очереди слушающего
+ *
+ * @param listener - Слушающее соединение
+ * @param nonblock - Не ждать, если очередь пуста
+ * @param error - Получает NET_E* при ошибке
+ * @return tcp_connection_t* - Соединение или NULL
+ */
+tcp_connection_t* tcp_accept(tcp_connection_t* listener, bool nonblock, int* error) {
+	tcp_lock_acquire();
+
+	if(listener->state != TCP_LISTEN) {
+		tcp_lock_release();
+
+		*error = NET_EINVAL;
+		return NULL;
+	}
+
+	while(listener->accept_head == NULL) {
+		if(nonblock) {
+			tcp_lock_release();
+
+			*error = NET_EAGAIN;
+			return NULL;
+		}
+
+		tcp_wait(listener);
+
+		if(listener->state != TCP_LISTEN) {
+			// Closed while we slept: the last thread to leave frees it.
+			if(listener->sleepers == 0) {
+				kfree(listener);
+			}
+
+			tcp_lock_release();
+
+			*error = NET_EINVAL;
+			return NULL;
+		}
+	}
+
+	tcp_connection_t* connection = listener->accept_head;
+
+	listener->accept_head = connection->accept_next;
+
+	if(listener->accept_head == NULL) {
+		listener->accept_tail = NULL;
+	}
+
+	listener->accept_count--;
+
+	connection->accept_next = NULL;
+	connection->parent = NULL;
+	connection->queued = false;
+
+	tcp_lock_release();
+
+	return connection;
+}
+
+/**
+ * @brief Открывает соединение
+ *
+ * @param card - Сетевая карта, через которую идти
+ * @param ip - Адрес получателя
+ * @param port - Порт получателя
+ * @param local_port - Свой порт (0 - выбрать свободный)
+ * @param nonblock - Не ждать рукопожатия (тогда `error` = NET_EINPROGRESS)
+ * @param error - Получает NET_E*
+ * @return tcp_connection_t* - Соединение или NULL
+ */
+tcp_connection_t* tcp_connect(netcard_entry_t* card, const uint8_t ip[4], uint16_t port, uint16_t local_port, bool nonblock, int* error) {
+	if(card == NULL) {
+		*error = NET_ENETUNREACH;
+		return NULL;
+	}
+
+	tcp_lock_acquire();
+
+	if(local_port == 0) {
+		for(size_t i = 0; i < 0x10000 - TCP_EPHEMERAL_PORT_MIN && local_port == 0; i++) {
+			uint16_t candidate = tcp_next_port++;
+
+			if(tcp_next_port == 0) {
+				tcp_next_port = TCP_EPHEMERAL_PORT_MIN;
+			}
+
+			if(!tcp_port_in_use(candidate)) {
+				local_port = candidate;
+			}
+		}
+	}
+
+	if(local_port == 0 || tcp_lookup(card->ipv4_addr, local_port, ip, port)) {
+		tcp_lock_release();
+
+		*error = NET_EADDRINUSE;
+		return NULL;
+	}
+
+	tcp_connection_t* connection = tcp_connection_new(card, ip, local_port, port);
+
+	if(connection == NULL) {
+		tcp_lock_release();
+
+		*error = NET_ENOMEM;
+		return NULL;
+	}
+
+	connection->state = TCP_SYN_SENT;
+
+	tcp_table_insert(connection);
+
+	tcp_send_segment(connection, connection->iss, TCP_FLAG_SYN, 0, 0);
+
+	connection->snd_nxt = connection->iss + 1;
+	connection->snd_max = connection->snd_nxt;
+	connection->rtt_pending = true;
+	connection->rtt_seq = connection->iss;
+	connection->rtt_start = getTicks();
+
+	tcp_arm_retransmit(connection);
+
+	if(nonblock) {
+		tcp_lock_release();
+
+		*error = NET_EINPROGRESS;
+		return connection;
+	}
+
+	while(connection->state == TCP_SYN_SENT || connection->state == TCP_SYN_RECEIVED) {
+		tcp_wait(connection);
+	}
+
+	if(connection->state == TCP_CLOSED) {
+		*error = connection->error ? connection->error : NET_ECONNREFUSED;
+
+		tcp_connection_free(connection);
+		tcp_lock_release();
+
+		return NULL;
+	}
+
+	tcp_lock_release();
+
+	*error = 0;
+	return connection;
+}
+
+/**
+ * @brief Ставит данные в очередь отправки
+ *
+ * @param connection - Соединение
+ * @param data - Данные
+ * @param len - Длина
+ * @param nonblock - Не ждать места в буфере
+ * @return ssize_t - Сколько байт принято или -NET_E*
+ */
+ssize_t tcp_send(tcp_connection_t* connection, const void* data, size_t len, bool nonblock) {
+	size_t done = 0;
+	ssize_t result = 0;
+
+	tcp_lock_acquire();
+
+	while(done < len) {
+		tcp_state_t state = connection->state;
+
+		if(connection->error) {
+			result = -connection->error;
+			break;
+		}
+
+		if((state == TCP_SYN_SENT || state == TCP_SYN_RECEIVED) && !nonblock) {
+			tcp_wait(connection);
+			continue;
+		}
+
+		if(state != TCP_ESTABLISHED && state != TCP_CLOSE_WAIT) {
+			result = (state == TCP_SYN_SENT || state == TCP_SYN_RECEIVED) ? -NET_EAGAIN
+				   : (state == TCP_LISTEN) ? -NET_ENOTCONN : -NET_EPIPE;
+			break;
+		}
+
+		if(connection->fin_queued) {
+			result = -NET_EPIPE;
+			break;
+		}
+
+		size_t written = tcp_buffer_write(&connection->send_buffer, (const uint8_t*)data + done, len - done);
+
+		if(written) {
+			done += written;
+
+			tcp_output(connection);
+			continue;
+		}
+
+		if(nonblock) {
+			result = -NET_EAGAIN;
+			break;
+		}
+
+		tcp_wait(connection);
+	}
+
+	tcp_lock_release();
+
+	return done ? (ssize_t)done : result;
+}
+
+/**
+ * @brief Читает принятые данные
+ *
+ * @param connection - Соединение
+ * @param data - Куда
+ * @param len - Размер буфера
+ * @param nonblock - Не ждать данных
+ * @return ssize_t - Сколько прочитано, 0 - собеседник закрыл соединение, или -NET_E*
+ */
+ssize_t tcp_recv(tcp_connection_t* connection, void* data, size_t len, bool nonblock) {
+	ssize_t result;
+
+	tcp_lock_acquire();
+
+	while(1) {
+		if(connection->recv_buffer.len) {
+			size_t count = MIN(len, connection->recv_buffer.len);
+
+			tcp_buffer_peek(&connection->recv_buffer, 0, data, count);
+			tcp_buffer_consume(&connection->recv_buffer, count);
+
+			// Tell the peer once the window has opened noticeably.
+			uint32_t window = tcp_receive_window(connection);
+			uint32_t threshold = MIN((uint32_t)TCP_RECV_BUFFER_SIZE / 2, 2 * connection->mss);
+
+			if(tcp_can_send_data(connection->state) || connection->state == TCP_FIN_WAIT_2) {
+				if((int32_t)(window - connection->rcv_wnd_advertised) >= (int32_t)threshold) {
+					tcp_ack_now(connection);
+				}
+			}
+
+			result = count;
+			break;
+		}
+
+		if(connection->fin_received) {
+			result = 0;
+			break;
+		}
+
+		if(connection->error) {
+			result = -connection->error;
+			break;
+		}
+
+		if(connection->state == TCP_CLOSED || connection->state == TCP_LISTEN) {
+			result = -NET_ENOTCONN;
+			break;
+		}
+
+		if(nonblock) {
+			result = -NET_EAGAIN;
+			break;
+		}
+
+		tcp_wait(connection);
+	}
+
+	tcp_lock_release();
+
+	return result;
+}
+
+// Queues FIN after the pending data. Called with `tcp_lock` held.
+static void tcp_close_send(tcp_connection_t* connection) {
+	if(connection->state == TCP_ESTABLISHED) {
+		connection->state = TCP_FIN_WAIT_1;
+	} else if(connection->state == TCP_CLOSE_WAIT) {
+		connection->state = TCP_LAST_ACK;
+	} else {
+		return;
+	}
+
+	connection->fin_queued = true;
+
+	tcp_output(connection);
+}
+
+/**
+ * @brief Закрывает соединение на отправку (FIN), приём продолжает работать
+ *
+ * @param connection - Соединение
+ */
+void tcp_shutdown(tcp_connection_t* connection) {
+	tcp_lock_acquire();
+
+	tcp_close_send(connection);
+
+	tcp_lock_release();
+}
+
+static void tcp_listener_close(tcp_connection_t* listener) {
+	for(tcp_connection_t** link = &tcp_listeners; *link; link = &(*link)->hash_next) {
+		if(*link == listener) {
+			*link = listener->hash_next;
+			break;
+		}
+	}
+
+	listener->state = TCP_CLOSED;
+
+	// Connections nobody has accepted are reset.
+	while(listener->accept_head) {
+		tcp_connection_t* connection = listener->accept_head;
+
+		listener->accept_head = connection->accept_next;
+
+		connection->parent = NULL;
+		connection->queued = false;
+		connection->user_closed = true;
+
+		if(connection->state == TCP_CLOSED) {
+			tcp_connection_free(connection);
+		} else {
+			tcp_abort(connection, 0);
+		}
+	}
+
+	for(size_t i = 0; i < TCP_HASH_SIZE; i++) {
+		tcp_connection_t* next;
+
+		for(tcp_connection_t* connection = tcp_table[i]; connection; connection = next) {
+			next = connection->hash_next;
+
+			if(connection->parent == listener) {
+				tcp_abort(connection, 0);
+			}
+		}
+	}
+
+	wait_queue_wake_all(&listener->waiters);
+
+	// Threads blocked in `tcp_accept` still use it, the last of them frees it.
+	if(listener->sleepers == 0) {
+		kfree(listener);
+	}
+}
+
+/**
+ * @brief Закрывает соединение. Ядро доводит закрытие до конца само и освобождает его,
+ *        после вызова к соединению обращаться нельзя.
+ *
+ * @param connection - Соединение
+ */
+void tcp_close(tcp_connection_t* connection) {
+	tcp_lock_acquire();
+
+	if(connection->state == TCP_LISTEN) {
+		tcp_listener_close(connection);
+		tcp_lock_release();
+		return;
+	}
+
+	connection->user_closed = true;
+
+	switch(connection->state) {
+		case TCP_CLOSED:
+			tcp_connection_free(connection);
+			break;
+		case TCP_SYN_SENT:
+		case TCP_SYN_RECEIVED:
+			tcp_abort(connection, 0);
+			break;
+		case TCP_ESTABLISHED:
+		case TCP_CLOSE_WAIT:
+			// Unread data is lost, so the peer is told with RST (RFC 2525, 2.17)
+			if(connection->recv_buffer.len) {
+				tcp_abort(connection, 0);
+			} else {
+				tcp_close_send(connection);
+			}
+
+			break;
+		case TCP_FIN_WAIT_2:
+			connection->state_deadline = getTicks() + TCP_FIN_WAIT2_TIMEOUT;
+			break;
+		default:
+			// FIN is already on its way, the state machine finishes the job.
+			break;
+	}
+
+	tcp_lock_release();
+}
+
+/**
+ * @brief Готовность соединения для poll
+ *
+ * @param connection - Соединение
+ * @return uint32_t - Маска TCP_POLL_*
+ */
+uint32_t tcp_poll(tcp_connection_t* connection) {
+	uint32_t mask = 0;
+
+	tcp_lock_acquire();
+
+	tcp_state_t state = connection->state;
+
+	if(state == TCP_LISTEN) {
+		if(connection->accept_head) {
+			mask |= TCP_POLL_IN;
+		}
+	} else {
+		if(connection->recv_buffer.len || connection->fin_received) {
+			mask |= TCP_POLL_IN;
+		}
+
+		if((state == TCP_ESTABLISHED || state == TCP_CLOSE_WAIT) && !connection->fin_queued
+		   && tcp_buffer_free(&connection->send_buffer) > 0) {
+			mask |= TCP_POLL_OUT;
+		}
+
+		if(connection->error) {
+			mask |= TCP_POLL_ERR | TCP_POLL_IN;
+		}
+
+		if(state == TCP_CLOSED || (connection->fin_received && connection->fin_queued)) {
+			mask |= TCP_POLL_HUP;
+		}
+	}
+
+	tcp_lock_release();
+
+	return mask;
+}
+
+wait_queue_t* tcp_wait_queue(tcp_connection_t* connection) {
+	return &connection->waiters;
+}
+
+const char* tcp_state_name(tcp_state_t state) {
+	return state < TCP_STATE_COUNT ? tcp_state_names[state] : "?";
+}
+
+void tcp_get_stats(tcp_stats_t* out) {
+	tcp_lock_acquire();
+
+	*out = tcp_stats;
+
+	tcp_lock_release();
+}
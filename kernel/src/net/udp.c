@@ -3,34 +3,154 @@
 #include "net/endianess.h"
 #include <io/logging.h>
 #include "net/ipv4.h"
+#include "net/checksum.h"
 #include "debug/hexview.h"
 #include "net/dhcp.h"
+#include "sys/sync.h"
+#include "sys/scheduler/scheduler.h"
 
-uint16_t udp_calculate_checksum(SAYORI_UNUSED udp_packet_t * packet) {
-	// UDP checksum is optional in IPv4
-	return 0;
+static struct {
+	uint16_t port;
+	udp_handler_t handler;
+	void* ctx;
+} udp_bindings[UDP_MAX_BINDINGS] = {0};
+
+// Held while a handler runs, so after `udp_unbind` returns its context is not used anymore.
+static mutex_t udp_lock = {false};
+static uint16_t udp_next_port = UDP_EPHEMERAL_PORT_MIN;
+
+static void udp_lock_acquire() {
+	while(__atomic_test_and_set(&udp_lock.lock, __ATOMIC_ACQUIRE)) {
+		yield();
+	}
 }
 
-void udp_send_packet(netcard_entry_t* card, uint8_t * dst_ip, uint16_t src_port, uint16_t dst_port, void * data, int len) {
-	size_t length = sizeof(udp_packet_t) + len;
+static bool udp_port_bound(uint16_t port) {
+	for(size_t i = 0; i < UDP_MAX_BINDINGS; i++) {
+		if(udp_bindings[i].handler && udp_bindings[i].port == port) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * @brief Направляет датаграммы на порт в обработчик
+ *
+ * @param port - Порт (0 - выбрать свободный)
+ * @param handler - Обработчик
+ * @param ctx - Его контекст
+ * @return uint16_t - Занятый порт или 0, если порт занят или нет места
+ */
+uint16_t udp_bind(uint16_t port, udp_handler_t handler, void* ctx) {
+	udp_lock_acquire();
+
+	if(port == 0) {
+		for(size_t i = 0; i < 0x10000 - UDP_EPHEMERAL_PORT_MIN && port == 0; i++) {
+			uint16_t candidate = udp_next_port++;
+
+			if(udp_next_port == 0) {
+				udp_next_port = UDP_EPHEMERAL_PORT_MIN;
+			}
+
+			if(!udp_port_bound(candidate)) {
+				port = candidate;
+			}
+		}
+	} else if(udp_port_bound(port)) {
+		port = 0;
+	}
+
+	bool bound = false;
+
+	for(size_t i = 0; i < UDP_MAX_BINDINGS && port; i++) {
+		if(udp_bindings[i].handler == NULL) {
+			udp_bindings[i].port = port;
+			udp_bindings[i].handler = handler;
+			udp_bindings[i].ctx = ctx;
+
+			bound = true;
+			break;
+		}
+	}
+
+	mutex_release(&udp_lock);
+
+	return bound ? port : 0;
+}
+
+/**
+ * @brief Освобождает порт, занятый `udp_bind`
+ *
+ * @param port - Порт
+ */
+void udp_unbind(uint16_t port) {
+	udp_lock_acquire();
+
+	for(size_t i = 0; i < UDP_MAX_BINDINGS; i++) {
+		if(udp_bindings[i].handler && udp_bindings[i].port == port) {
+			udp_bindings[i].handler = NULL;
+			udp_bindings[i].ctx = NULL;
+			break;
+		}
+	}
+
+	mutex_release(&udp_lock);
+}
+
+void udp_send_netbuf(netcard_entry_t* card, const uint8_t* dst_ip, uint16_t src_port, uint16_t dst_port, netbuf_t* buf) {
+	size_t length = sizeof(udp_packet_t) + buf->len;
 
-	udp_packet_t* packet = kcalloc(1, length);
+	udp_packet_t* packet = netbuf_push(buf, sizeof(udp_packet_t));
 
 	packet->src_port = htons(src_port);
 	packet->dst_port = htons(dst_port);
 	packet->length = htons(length);
-	packet->checksum = udp_calculate_checksum(packet);
+	packet->checksum = 0;
+
+	uint32_t sum = checksum_pseudo_header(card->ipv4_addr, dst_ip, IP_PROTOCOL_UDP, length, 0);
+
+	if(card->features & NETCARD_FEATURE_TX_CSUM) {
+		packet->checksum = ~checksum_fold(sum);
+
+		buf->csum_partial = true;
+		buf->csum_start = (uint8_t*)packet - buf->head;
+		buf->csum_offset = __builtin_offsetof(udp_packet_t, checksum);
+	} else {
+		if(buf->csum_valid) {
+			sum = checksum_block_add(sum, buf->csum, sizeof(udp_packet_t));
+			sum = checksum_partial(packet, sizeof(udp_packet_t), sum);
+		} else {
+			sum = checksum_partial(packet, length, sum);
+		}
+
+		uint16_t check = checksum_fold(sum);
 
-	memcpy((char*)packet + sizeof(udp_packet_t), data, len);
+		// Zero means "no checksum", the same sum is sent as its other form.
+		packet->checksum = check ? check : 0xFFFF;
+	}
 
 	qemu_log("UDP Packet sent");
-	ipv4_send_packet(card, dst_ip, packet, length, IP_PROTOCOL_UDP);
+	ipv4_send_netbuf(card, dst_ip, buf, IP_PROTOCOL_UDP);
 }
 
-void udp_handle_packet(netcard_entry_t *card, udp_packet_t *packet) {
-	SAYORI_UNUSED uint16_t src_port = ntohs(packet->src_port);
+void udp_send_packet(netcard_entry_t* card, uint8_t * dst_ip, uint16_t src_port, uint16_t dst_port, void * data, int len) {
+	netbuf_t* buf = netbuf_alloc(NETBUF_HEADROOM, len);
+
+	if(buf == NULL) {
+		return;
+	}
+
+	netbuf_put_copy(buf, data, len);
+
+	udp_send_netbuf(card, dst_ip, src_port, dst_port, buf);
+}
+
+void udp_handle_packet(netcard_entry_t *card, ipv4_packet_t* ip, udp_packet_t *packet) {
+	uint16_t src_port = ntohs(packet->src_port);
 	uint16_t dst_port = ntohs(packet->dst_port);
-	SAYORI_UNUSED uint16_t length = ntohs(packet->length);
+	uint16_t length = ntohs(packet->length);
 	
 	void* data_ptr = (char*)packet + sizeof(udp_packet_t);
 	
@@ -38,7 +158,34 @@ void udp_handle_packet(netcard_entry_t *card, udp_packet_t *packet) {
 
 //	hexview_advanced(data_ptr, data_len, 16, true, qemu_printf);
 
+	if(length < sizeof(udp_packet_t) || length > ip->TotalLength - sizeof(ipv4_packet_t)) {
+		return;
+	}
+
+	// The sender may leave the checksum out.
+	if(packet->checksum != 0) {
+		uint32_t sum = checksum_pseudo_header(ip->Source, ip->Destination, IP_PROTOCOL_UDP, length, 0);
+
+		if(checksum_fold(checksum_partial(packet, length, sum)) != 0) {
+			qemu_warn("UDP: Bad checksum, dropped");
+			return;
+		}
+	}
+
 	if(dst_port == 68) {
 		dhcp_handle_packet(card, data_ptr);
+		return;
 	}
+
+	udp_lock_acquire();
+
+	for(size_t i = 0; i < UDP_MAX_BINDINGS; i++) {
+		if(udp_bindings[i].handler && udp_bindings[i].port == dst_port) {
+			udp_bindings[i].handler(udp_bindings[i].ctx, card, ip->Source, src_port,
+									data_ptr, length - sizeof(udp_packet_t));
+			break;
+		}
+	}
+
+	mutex_release(&udp_lock);
 }
\ No newline at end of file
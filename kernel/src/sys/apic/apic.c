@@ -76,9 +76,10 @@ void apic_init() {
 
     __using_apic = true;
 
-    // lapic_init();
+    // NOTE: Must be called after `__using_apic` is set, because calibration relies on PIT interrupts acknowledged via LAPIC.
+    lapic_init();
 
-    // qemu_log("LAPIC INITIALIZED!");
+    qemu_log("LAPIC INITIALIZED!");
 }
 
 uint32_t apic_write(uint32_t reg, uint32_t value) {
@@ -4,9 +4,16 @@
 #include "sys/acpi.h"
 #include <io/logging.h>
 #include "sys/apic.h"
+#include "sys/lapic.h"
 
 extern size_t timer_frequency;
 
+// LAPIC timer counts per one system timer tick (1 ms). 0 means LAPIC timer is not used.
+size_t lapic_ticks_per_ms = 0;
+
+// Initial count of the last one-shot period. Used to measure time passed since arming.
+static volatile uint32_t lapic_armed_count = 0;
+
 // Measure LAPIC Timer tick count for given `milliseconds`.
 size_t recalibrate_lapic_timer(size_t divisor, size_t milliseconds) {
     apic_write(APIC_REG_TMRDIV, divisor);
@@ -20,7 +27,7 @@ size_t recalibrate_lapic_timer(size_t divisor, size_t milliseconds) {
     __asm__ volatile("cli");
 
     // Stop timer (Set masking bit).
-    apic_write(APIC_REG_LVT_TMR, 0x1000);
+    apic_write(APIC_REG_LVT_TMR, APIC_LVT_MASKED);
 
     return 0xFFFFFFFF - apic_read(APIC_REG_TMRCURRCNT);
 }
@@ -43,14 +50,57 @@ void lapic_init() {
 
     qemu_log("LAPIC ticks %d times in 1 PIT millisecond", ticks_in_1_ms);
 
+    if(ticks_in_1_ms == 0) {
+        qemu_err("LAPIC timer did not tick, staying on PIT");
+        return;
+    }
+
     // Disable PIT by setting one-shot mode and never using it again.
     outb(0x43, (0b00 << 6) | (0b11 << 4) | (1 << 1));
 
     outb(0x40, 0xff);
     outb(0x40, 0xff);
 
-    // 32 is IRQ0 - PIT timer. 17th bit is periodic mode flag for timer.
-    apic_write(APIC_REG_LVT_TMR, 32 | (1 << 17));
+    // 32 is IRQ0 - PIT timer. Bits 17-18 are zero, so timer works in one-shot mode
+    // and every period is programmed by the scheduler (see `timer_program_next`).
+    apic_write(APIC_REG_LVT_TMR, 32 | APIC_LVT_TIMER_ONESHOT);
     apic_write(APIC_REG_TMRDIV, LAPIC_TIMER_DIVISOR);
-    apic_write(APIC_REG_TMRINITCNT, ticks_in_1_ms);
-}
\ No newline at end of file
+
+    lapic_ticks_per_ms = ticks_in_1_ms;
+
+    lapic_timer_arm(1);
+}
+
+bool lapic_timer_is_active() {
+    return lapic_ticks_per_ms != 0;
+}
+
+/**
+ * @brief Arms LAPIC timer in one-shot mode to fire after `ticks` system ticks.
+ *
+ * @param ticks - Ticks (milliseconds) until next timer interrupt
+ */
+void lapic_timer_arm(size_t ticks) {
+    size_t max_ticks = 0xFFFFFFFF / lapic_ticks_per_ms;
+
+    if(ticks == 0) {
+        ticks = 1;
+    } else if(ticks > max_ticks) {
+        ticks = max_ticks;
+    }
+
+    lapic_armed_count = ticks * lapic_ticks_per_ms;
+
+    apic_write(APIC_REG_TMRINITCNT, lapic_armed_count);
+}
+
+/**
+ * @brief Returns LAPIC timer counts passed since last `lapic_timer_arm` call.
+ */
+size_t lapic_timer_elapsed() {
+    if(lapic_armed_count == 0) {
+        return 0;
+    }
+
+    return lapic_armed_count - apic_read(APIC_REG_TMRCURRCNT);
+}
@@ -74,11 +74,9 @@ int32_t spawn_prog(const char *name, int argc, const char* const* eargv) {
 
     mutex_get(&elf_loader_mutex);
 
-    extern volatile uint32_t next_pid;
-
     process_t* proc = allocate_one(process_t);
 
-    proc->pid = next_pid++;
+    // PID is assigned in `process_add_prepared`.
     proc->list_item.list = nullptr;  // No nested processes hehe :)
     proc->threads_count = 0;
 
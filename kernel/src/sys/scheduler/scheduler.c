@@ -16,13 +16,23 @@
 #include "lib/math.h"
 #include "sys/scheduler/thread.h"
 #include "sys/sync.h"
+#include "sys/timer.h"
+#include "arch/x86/cpuinfo.h"
+#include "io/surface.h"
+#include "net/socket.h"
 
 
 bool scheduler_working = true;
 bool multi_task = false;
 
 list_t process_list;
-uint32_t next_pid = 0;			
+idtable_t process_table;    /* PID -> process */
+
+// Threads which are dead and removed from the run queue, waiting for the reaper.
+list_t dead_thread_list;
+thread_t* sched_reaper_thread = NULL;
+
+__attribute__((noreturn)) static void sched_reaper();
 
 process_t* kernel_proc = 0;
 process_t* current_proc = 0;
@@ -32,9 +42,17 @@ extern uint32_t __init_esp;
 extern physical_addr_t kernel_page_directory;
 
 extern thread_t* sched_idle_thread;
+extern list_t thread_list;
 
 mutex_t proclist_scheduler_mutex = {.lock = false};
 
+// Timeslice length for every scheduling class (in ticks).
+static const size_t sched_class_timeslice[SCHED_CLASS_COUNT] = {
+    [SCHED_CLASS_REALTIME] = 2,
+    [SCHED_CLASS_INTERACTIVE] = 4,
+    [SCHED_CLASS_BATCH] = 10,
+};
+
 /**
  * @brief Initializes scheduler
  */
@@ -43,13 +61,14 @@ void init_task_manager(void){
 	__asm__ volatile("mov %%esp, %0" : "=a"(esp));
 
 	list_init(&process_list);
+	list_init(&dead_thread_list);
+	idtable_init(&process_table, PROCESS_TABLE_BITS);
 	initialize_thread_list();
 
 	/* Create kernel process */
 	kernel_proc = kmalloc_common(sizeof(process_t), 4);
     memset(kernel_proc, 0, sizeof(process_t));
 
-	kernel_proc->pid = next_pid++;
     // NOTE: Page directory address must be PHYSICAL!
 	kernel_proc->page_dir = kernel_page_directory;
 	kernel_proc->list_item.list = nullptr;
@@ -58,11 +77,11 @@ void init_task_manager(void){
 	kernel_proc->name = strdynamize("kernel");
 	kernel_proc->cwd = strdynamize("rd0:/");
 	
-	list_add(&process_list, (void*)&kernel_proc->list_item);
+	// Kernel process is the first one, so it gets PID 0.
+	process_add_prepared(kernel_proc);
 
     extern thread_t* kernel_thread;
     extern thread_t* current_thread;
-    extern size_t next_thread_id;
 
 	/* Create kernel thread */
 	kernel_thread = kmalloc_common(sizeof(thread_t), 4);
@@ -70,7 +89,6 @@ void init_task_manager(void){
 
 	kernel_thread->process = kernel_proc;
 	kernel_thread->list_item.list = nullptr;
-	kernel_thread->id = next_thread_id++;
 	kernel_thread->stack_size = DEFAULT_STACK_SIZE;
 	kernel_thread->esp = (size_t*)esp;
 	kernel_thread->stack_top = __init_esp;
@@ -82,6 +100,8 @@ void init_task_manager(void){
     __asm__ volatile("fxsave (%0)" :: "a"(kernel_thread->fxsave_region));
 
     kernel_thread->flags = THREAD_KERNEL;
+    kernel_thread->sched_class = SCHED_CLASS_INTERACTIVE;
+    kernel_thread->switched_in_tsc = rdtsc();
 
     thread_add_prepared(kernel_thread);
 
@@ -92,6 +112,8 @@ void init_task_manager(void){
 
 	initialize_idle_thread();
 
+	sched_reaper_thread = thread_create(kernel_proc, sched_reaper, 0x4000, THREAD_KERNEL, NULL, 0);
+
     qemu_ok("OK");
 }
 
@@ -102,7 +124,6 @@ void scheduler_mode(bool on) {
 size_t create_process(void* entry_point, char* name, bool is_kernel) {
     process_t* proc = allocate_one(process_t);
 
-	proc->pid = next_pid++;
 	proc->list_item.list = nullptr;  // No nested processes
 	proc->threads_count = 0;
 
@@ -113,12 +134,11 @@ size_t create_process(void* entry_point, char* name, bool is_kernel) {
     
     process_add_prepared(proc);
 
-    thread_t* thread = _thread_create_unwrapped(proc, entry_point, DEFAULT_STACK_SIZE, is_kernel ? THREAD_KERNEL : 0, NULL, 0);
+    // The thread is added to the scheduler by `_thread_create_unwrapped` itself.
+    _thread_create_unwrapped(proc, entry_point, DEFAULT_STACK_SIZE, is_kernel ? THREAD_KERNEL : 0, NULL, 0);
 
     qemu_log("PID: %d, DIR: %x; Threads: %d", proc->pid, proc->page_dir, proc->threads_count);
 
-	thread_add_prepared(thread);
-
     void* virt = clone_kernel_page_directory((size_t*)proc->page_tables_virts);
     uint32_t phys = virt2phys(get_kernel_page_directory(), (virtual_addr_t) virt);
 
@@ -139,18 +159,17 @@ process_t* get_current_proc(void) {
     return current_proc;
 }
 
-bool process_exists(size_t pid) {
-    process_t* proc = get_current_proc();
-
-    do {
-        if(proc->pid == pid) {
-            return true;
-        }
-
-        proc = (process_t*)proc->list_item.next;
-    } while(proc != NULL && proc->pid != 0);
+/**
+ * @brief Find process by PID
+ *
+ * @return process_t* - Process or NULL if it does not exist (or already freed)
+ */
+process_t* process_get(size_t pid) {
+    return idtable_get(&process_table, pid);
+}
 
-    return false;
+bool process_exists(size_t pid) {
+    return process_get(pid) != NULL;
 }
 
 void process_wait(size_t pid) {
@@ -168,10 +187,6 @@ static void remove_thread(thread_t* thread) {
     process_t* process = thread->process;
     qemu_log("REMOVING DEAD THREAD: #%u", thread->id);
 
-    thread_remove_prepared((thread_t*)thread);
-
-    qemu_log("REMOVED FROM LIST");
-
     kfree(thread->fxsave_region);
     kfree((void*)thread->kernel_stack_bottom);
     kfree(thread->stack);
@@ -183,12 +198,15 @@ static void remove_thread(thread_t* thread) {
 
     bool is_kernels_pid = current_proc->pid == 0;
     // NOTE: We should be in kernel process (PID 0) to free page tables and process itself.
-    // TODO: Switch to kernel's PD here, because process info stored there
+    // Reaper thread always runs in kernel process, so this holds.
     if(process->threads_count == 0 && is_kernels_pid) {
         qemu_warn("PROCESS #%d `%s` DOES NOT HAVE ANY THREADS", process->pid, process->name);
 
         // load_page_directory(kernel_page_directory);
 
+        surface_destroy_process(process->pid);
+        socket_close_process(process->pid);
+
         if(process->program) {
             for (int32_t i = 0; i < process->program->elf_header.e_phnum; i++) {
                 Elf32_Phdr *phdr = process->program->p_header + i;
@@ -244,59 +262,218 @@ static void remove_thread(thread_t* thread) {
     }
 }
 
-static inline thread_t* sched_select_next() {
-    // Choose next thread.
-    thread_t* next_thread = (thread_t *)get_current_thread()->list_item.next;
+static void sched_reschedule();
 
-    while(next_thread != NULL) {
+/**
+ * @brief Moves dead thread from run queue to the reaper.
+ *
+ * Freeing memory is slow, so it's not done here (we are in timer interrupt).
+ */
+static inline void sched_bury(thread_t* thread) {
+    thread_remove_prepared(thread);
+
+    list_add(&dead_thread_list, &thread->list_item);
+
+    thread_wake(sched_reaper_thread);
+}
+
+/**
+ * @brief Frees threads that exited. Runs in kernel process.
+ */
+__attribute__((noreturn)) static void sched_reaper() {
+    while(1) {
+        __asm__ volatile("cli");
+
+        thread_t* thread = (thread_t*)dead_thread_list.first;
+
+        if(thread == NULL) {
+            // Sleep until somebody dies.
+            sched_wait(SCHED_MAX_IDLE_TICKS);
+            continue;
+        }
+
+        list_remove(&thread->list_item);
+        thread->list_item.list = nullptr;
+
+        __asm__ volatile("sti");
+
+        remove_thread(thread);
+    }
+}
+
+SAYORI_INLINE bool thread_is_sleeping(const thread_t* thread, size_t now) {
+    return thread->wakeup_tick != 0 && (ssize_t)(thread->wakeup_tick - now) > 0;
+}
+
+/**
+ * @brief Rank of a runnable thread, lower runs first.
+ *
+ * Class goes first, threads which yielded by themselves go after all threads of all classes.
+ * Thread that did not run for `SCHED_STARVATION_TICKS` gets the best rank, so nobody starves.
+ */
+SAYORI_INLINE size_t sched_rank(const thread_t* thread, size_t now) {
+    if((ssize_t)(now - thread->last_run_tick) >= SCHED_STARVATION_TICKS) {
+        return 0;
+    }
+
+    return thread->sched_class + (thread->sched_yielded ? SCHED_CLASS_COUNT : 0);
+}
+
+/**
+ * @brief Chooses next runnable thread.
+ *
+ * @param now - Current tick
+ * @param wakeup_ticks - Receives ticks until the nearest sleeper wakes up
+ * @return thread_t* - Next thread or NULL if CPU should go idle
+ */
+static inline thread_t* sched_select_next(size_t now, size_t* wakeup_ticks) {
+    thread_t* current = get_current_thread();
+    thread_t* next_thread = (thread_t *)current->list_item.next;
+
+    thread_t* best = NULL;
+    size_t best_rank = 0;
+
+    size_t remaining = thread_list.count;
+
+    *wakeup_ticks = SCHED_MAX_IDLE_TICKS;
+
+    // Walk the whole ring starting after current thread, so threads with equal rank go round-robin.
+    while(remaining--) {
         // Save the next of next thread because if our `next_thread` is dead, it will be removed, leaving us with gap.
         thread_t* next_thread_soon = (thread_t *)next_thread->list_item.next;
 
-        // If the thread is PAUSED, skip it.
-        if(next_thread->state == PAUSED) {
+        // If we encountered dead thread, give it to the reaper. But not the one we are running on.
+        if(next_thread->state == DEAD && next_thread != current) {
+            sched_bury(next_thread);
+
             next_thread = next_thread_soon;
             continue;
         }
 
-        // If we encountered dead thread, remove it.
-        if(next_thread->state == DEAD) {
-        	qemu_log("QUICK NOTICE: WE ARE IN PROCESS NR. #%u", current_proc->pid);
+        // Idle thread is chosen only when there's nothing else to run.
+        // If the thread is PAUSED, skip it.
+        if(next_thread == sched_idle_thread || next_thread->state == PAUSED || next_thread->state == DEAD) {
+            next_thread = next_thread_soon;
+            continue;
+        }
 
-            remove_thread(next_thread);
+        if(thread_is_sleeping(next_thread, now)) {
+            *wakeup_ticks = MIN(*wakeup_ticks, next_thread->wakeup_tick - now);
 
             next_thread = next_thread_soon;
             continue;
         }
 
-        break;
+        size_t rank = sched_rank(next_thread, now);
+
+        if(best == NULL || rank < best_rank || (rank == best_rank && next_thread->priority > best->priority)) {
+            best = next_thread;
+            best_rank = rank;
+        }
+
+        next_thread = next_thread_soon;
     }
 
-    return next_thread;
+    return best;
+}
+
+/**
+ * @brief Charges CPU time to the thread going off CPU and starts counting for the next one.
+ */
+static inline void sched_account(thread_t* prev, thread_t* next, size_t now) {
+    uint64_t tsc = rdtsc();
+
+    prev->runtime_tsc += tsc - prev->switched_in_tsc;
+    prev->runtime_ticks += now - prev->last_run_tick;
+
+    next->switched_in_tsc = tsc;
+    next->last_run_tick = now;
+    next->sched_yielded = false;
 }
 
-void task_switch_v2_wrapper(registers_t* regs) {
+void task_switch_v2_wrapper(SAYORI_UNUSED registers_t* regs) {
     if(!multi_task) {
         // qemu_err("Scheduler is disabled!");
         return;
     }
 
+    size_t now = getTicks();
+    size_t wakeup_ticks = 0;
+    size_t slice = 0;
+
+    thread_t* current = get_current_thread();
+
     // Choose next thread.
-    thread_t* next_thread = sched_select_next();
+    thread_t* next_thread = sched_select_next(now, &wakeup_ticks);
 
-	// If no next thresd available, go idle.
+	// If no next thread available, go idle until the nearest sleeper should wake up.
     if(!next_thread) {
     	next_thread = sched_idle_thread;
+
+        slice = wakeup_ticks;
+    } else {
+        // Cut the slice if someone wakes up earlier, so woken thread won't wait for the whole slice.
+        slice = MIN(sched_class_timeslice[next_thread->sched_class], wakeup_ticks);
     }
 
+    sched_account(current, next_thread, now);
+
+    next_thread->slice_end_tick = now + slice;
+
+    timer_program_next(slice);
+
     // Actually switch the context.
-    task_switch_v2(get_current_thread(), next_thread);
+    task_switch_v2(current, next_thread);
 
     // next_thread is now current_thread.
 }
 
+/**
+ * @brief Called by timer interrupt. Switches thread only when its timeslice is over.
+ */
+void sched_tick(registers_t* regs) {
+    thread_t* current = get_current_thread();
+    size_t now = getTicks();
+
+    if(current == sched_idle_thread || (ssize_t)(now - current->slice_end_tick) >= 0) {
+        task_switch_v2_wrapper(regs);
+        return;
+    }
+
+    // Interrupt came before the end of slice (periodic PIT): wait for the rest.
+    timer_program_next(current->slice_end_tick - now);
+}
+
+/**
+ * @brief Puts current thread to sleep, so scheduler won't pick it until `ticks` pass.
+ *
+ * @param ticks - Ticks to sleep
+ */
+void sched_sleep_ticks(size_t ticks) {
+    thread_t* thread = get_current_thread();
+
+    // +1 keeps old `sleep_ticks` behaviour: at least `ticks` full ticks pass.
+    size_t wakeup = getTicks() + ticks + 1;
+
+    thread->wakeup_tick = wakeup;
+
+    // NOTE: Not a yield(): sleeping thread should keep its rank when it wakes up.
+    while((ssize_t)(getTicks() - wakeup) < 0) {
+        sched_reschedule();
+    }
+
+    thread->wakeup_tick = 0;
+}
+
 void process_add_prepared(process_t* process) {
     mutex_get(&proclist_scheduler_mutex);
 
+    process->pid = idtable_alloc(&process_table, process);
+
+    if(process->pid == IDTABLE_INVALID_ID) {
+        qemu_err("Process table is full!");
+    }
+
     list_add(&process_list, (list_item_t*)&process->list_item);
 
     mutex_release(&proclist_scheduler_mutex);
@@ -305,12 +482,14 @@ void process_add_prepared(process_t* process) {
 void process_remove_prepared(process_t* process) {
     mutex_get(&proclist_scheduler_mutex);
 
+    idtable_remove(&process_table, process->pid);
+
     list_remove(&process->list_item);
 
     mutex_release(&proclist_scheduler_mutex);
 }
 
-void yield() {
+static void sched_reschedule() {
     #ifdef NOCTURNE_X86
     __asm__ volatile("cli");
 
@@ -326,6 +505,155 @@ void yield() {
     #endif
 }
 
+/**
+ * @brief Blocks current thread until `thread_wake` is called on it or `max_ticks` pass.
+ *
+ * Check your wait condition with interrupts disabled and call this without enabling them,
+ * then a wakeup can't be lost. Interrupts are enabled on return.
+ *
+ * @param max_ticks - Timeout in ticks
+ */
+void sched_wait(size_t max_ticks) {
+    thread_t* thread = get_current_thread();
+
+    thread->wakeup_tick = getTicks() + max_ticks;
+
+    sched_reschedule();
+
+    thread->wakeup_tick = 0;
+}
+
+/**
+ * @brief Makes sleeping thread runnable again. Can be called from interrupt handlers.
+ *
+ * @param thread - Thread to wake up (NULL is ignored)
+ */
+void thread_wake(thread_t* thread) {
+    if(thread) {
+        thread->wakeup_tick = 0;
+    }
+}
+
+/**
+ * @brief Registers current thread in a wait queue.
+ *
+ * @param queue - Wait queue
+ * @param entry - Entry owned by the waiter (usually on its stack)
+ */
+void wait_queue_add(wait_queue_t* queue, wait_queue_entry_t* entry) {
+    size_t flags = irq_save();
+
+    entry->thread = get_current_thread();
+    entry->woken = false;
+    entry->prev = NULL;
+    entry->next = queue->head;
+
+    if(queue->head) {
+        queue->head->prev = entry;
+    }
+
+    queue->head = entry;
+
+    irq_restore(flags);
+}
+
+/**
+ * @brief Removes entry added by `wait_queue_add`.
+ *
+ * @param queue - Wait queue
+ * @param entry - Entry
+ */
+void wait_queue_remove(wait_queue_t* queue, wait_queue_entry_t* entry) {
+    size_t flags = irq_save();
+
+    if(entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        queue->head = entry->next;
+    }
+
+    if(entry->next) {
+        entry->next->prev = entry->prev;
+    }
+
+    entry->next = entry->prev = NULL;
+
+    irq_restore(flags);
+}
+
+/**
+ * @brief Wakes every thread waiting in the queue. Can be called from interrupt handlers.
+ *
+ * Entries stay registered, waiters remove them on their own.
+ *
+ * @param queue - Wait queue
+ */
+void wait_queue_wake_all(wait_queue_t* queue) {
+    size_t flags = irq_save();
+
+    for(wait_queue_entry_t* entry = queue->head; entry; entry = entry->next) {
+        entry->woken = true;
+        thread_wake(entry->thread);
+    }
+
+    irq_restore(flags);
+}
+
+void yield() {
+    if(!multi_task) {
+        return;
+    }
+
+    // Let everyone who wants CPU run before us.
+    get_current_thread()->sched_yielded = true;
+
+    sched_reschedule();
+}
+
+/**
+ * @brief Copies scheduler statistics of every thread.
+ *
+ * @param out - Output array
+ * @param capacity - Size of output array in elements
+ * @return size_t - Number of threads (may be bigger than `capacity`)
+ */
+size_t sched_get_thread_info(thread_info_t* out, size_t capacity) {
+    size_t flags = irq_save();
+
+    thread_t* current = get_current_thread();
+    thread_t* thread = (thread_t*)thread_list.first;
+    size_t count = thread_list.count;
+
+    for(size_t i = 0; i < count && i < capacity; i++) {
+        thread_info_t* info = out + i;
+
+        info->id = thread->id;
+        info->pid = thread->process->pid;
+        info->sched_class = thread->sched_class;
+        info->priority = thread->priority;
+        info->state = thread->state;
+        info->sleeping = thread->wakeup_tick != 0;
+        info->idle = thread == sched_idle_thread;
+        info->runtime_ticks = thread->runtime_ticks;
+        info->runtime_tsc = thread->runtime_tsc;
+
+        // Time of the running thread is not charged yet.
+        if(thread == current) {
+            info->runtime_tsc += rdtsc() - thread->switched_in_tsc;
+            info->runtime_ticks += getTicks() - thread->last_run_tick;
+        }
+
+        strncpy(info->name, thread->process->name, sizeof(info->name) - 1);
+        info->name[sizeof(info->name) - 1] = 0;
+
+        thread = (thread_t*)thread->list_item.next;
+    }
+
+    irq_restore(flags);
+
+    return count;
+}
+
 void enter_usermode(void (*ep)()) {
     __asm__ volatile("cli \n\
         push $0x23 \n\
@@ -3,7 +3,7 @@
 #include "io/logging.h"
 
 list_t thread_list;
-uint32_t next_thread_id = 0;	
+uint32_t next_thread_id = 0;
 
 thread_t* kernel_thread = 0;
 thread_t* current_thread = 0;
@@ -27,6 +27,8 @@ thread_t* get_current_thread() {
 void thread_add_prepared(thread_t* thread) {
     mutex_get(&threadlist_scheduler_mutex);
 
+    thread->id = next_thread_id++;
+
     list_add(&thread_list, (list_item_t*)&thread->list_item);
 
     mutex_release(&threadlist_scheduler_mutex);
@@ -36,6 +38,7 @@ void thread_remove_prepared(thread_t* thread) {
     mutex_get(&threadlist_scheduler_mutex);
 
     list_remove(&thread->list_item);
+    thread->list_item.list = nullptr;
 
     mutex_release(&threadlist_scheduler_mutex);
 }
@@ -69,14 +72,14 @@ void thread_remove_prepared(thread_t* thread) {
     thread_t* tmp_thread = kmalloc_common(sizeof(thread_t), 4);
     memset(tmp_thread, 0, sizeof(thread_t));
 
-    /* Initialization of thread  */
-    tmp_thread->id = next_thread_id++;
+    /* Initialization of thread (ID is assigned in `thread_add_prepared`) */
     tmp_thread->list_item.list = nullptr;
     tmp_thread->process = proc;
     tmp_thread->stack_size = stack_size;
     tmp_thread->entry_point = (uint32_t) entry_point;
 	tmp_thread->fxsave_region = kmalloc_common(512, 16);
     tmp_thread->flags = flags;
+    tmp_thread->sched_class = (flags & THREAD_KERNEL) ? SCHED_CLASS_INTERACTIVE : SCHED_CLASS_BATCH;
 
     tmp_thread->kernel_stack_bottom = (size_t)kmalloc_common(PAGE_SIZE, 16);
     tmp_thread->kernel_stack_top = tmp_thread->kernel_stack_bottom + PAGE_SIZE;
@@ -217,9 +220,29 @@ __attribute__((noreturn)) void thread_exit_entrypoint() {
         __asm__ volatile("hlt");
 }
 
+/**
+ * @brief Меняет класс планирования и приоритет потока
+ *
+ * @param thread - Поток
+ * @param sched_class - Класс (SCHED_CLASS_*)
+ * @param priority - Приоритет внутри класса (больше - раньше)
+ */
+void thread_set_sched_class(thread_t* thread, uint32_t sched_class, uint32_t priority) {
+    if(sched_class >= SCHED_CLASS_COUNT) {
+        qemu_err("Invalid scheduling class: %d", sched_class);
+        return;
+    }
+
+    thread->sched_class = sched_class;
+    thread->priority = priority;
+}
+
 __attribute__((noreturn)) void sched_idle_task() {
 	while(1) {
 		__asm__ volatile("hlt");
+
+		// Interrupt could wake somebody up (see `thread_wake`), don't wait for the timer.
+		yield();
 	}
 }
 
@@ -232,4 +255,7 @@ void initialize_idle_thread() {
 		NULL,
 		0
 	);
+
+	// Idle thread is picked by scheduler separately, class is used only for statistics.
+	thread_set_sched_class(sched_idle_thread, SCHED_CLASS_BATCH, 0);
 }
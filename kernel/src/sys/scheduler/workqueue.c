@@ -0,0 +1,216 @@
+/**
+ * @file sys/scheduler/workqueue.c
+ * @author NDRAEY (pikachu_andrey@vk.com)
+ * @brief Очереди отложенной работы с пулом потоков-исполнителей
+ * @version 0.4.3
+ * @date 2026-10-19
+ * @copyright Copyright SayoriOS Team (c) 2022-2026
+ */
+
+#include "sys/scheduler/workqueue.h"
+#include "sys/scheduler/scheduler.h"
+#include "sys/sync.h"
+#include "arch/x86/cpuinfo.h"
+#include "arch/x86/pit.h"
+#include "io/logging.h"
+#include "lib/string.h"
+
+typedef struct {
+    work_t*                 head;
+    work_t*                 tail;
+    thread_t*               worker;
+    workqueue_queue_stats_t stats;
+} workqueue_t;
+
+static workqueue_t workqueues[WORK_PRIORITY_COUNT] = {0};
+
+// Items for `workqueue_submit`, so it never calls the allocator (it may be called from IRQ).
+static work_t work_pool[WORKQUEUE_POOL_SIZE] = {0};
+static work_t* work_pool_free = NULL;
+
+static const uint32_t workqueue_worker_class[WORK_PRIORITY_COUNT] = {
+    [WORK_PRIORITY_HIGH] = SCHED_CLASS_REALTIME,
+    [WORK_PRIORITY_NORMAL] = SCHED_CLASS_INTERACTIVE,
+    [WORK_PRIORITY_LOW] = SCHED_CLASS_BATCH,
+};
+
+static bool workqueue_ready = false;
+
+/**
+ * @brief Поток-исполнитель одной очереди
+ *
+ * @param queue - Очередь, которую он обслуживает
+ */
+__attribute__((noreturn)) static void workqueue_worker(workqueue_t* queue) {
+    while(1) {
+        __asm__ volatile("cli");
+
+        work_t* work = queue->head;
+
+        if(work == NULL) {
+            sched_wait(SCHED_MAX_IDLE_TICKS);
+            continue;
+        }
+
+        queue->head = work->next;
+
+        if(queue->head == NULL) {
+            queue->tail = NULL;
+        }
+
+        queue->stats.depth--;
+
+        // Clear it before running, so work can be queued again while running.
+        work->pending = false;
+
+        work_fn_t fn = work->fn;
+        void* arg = work->arg;
+        bool pooled = work->pooled;
+
+        uint64_t start = rdtsc();
+        uint64_t latency = start - work->submit_tsc;
+
+        queue->stats.total_latency_tsc += latency;
+
+        if(latency > queue->stats.max_latency_tsc) {
+            queue->stats.max_latency_tsc = latency;
+        }
+
+        // Pooled item is copied out, give it back right away.
+        if(pooled) {
+            work->next = work_pool_free;
+            work_pool_free = work;
+        }
+
+        __asm__ volatile("sti");
+
+        fn(arg);
+
+        queue->stats.total_run_tsc += rdtsc() - start;
+        queue->stats.completed++;
+    }
+}
+
+/**
+ * @brief Запускает потоки-исполнители (по одному на приоритет)
+ */
+void workqueue_init() {
+    for(size_t i = 0; i < WORKQUEUE_POOL_SIZE; i++) {
+        work_pool[i].next = work_pool_free;
+        work_pool_free = &work_pool[i];
+    }
+
+    for(size_t i = 0; i < WORK_PRIORITY_COUNT; i++) {
+        workqueue_t* queue = &workqueues[i];
+
+        queue->worker = thread_create_arg1(get_current_proc(), workqueue_worker, 0x4000, THREAD_KERNEL, (size_t)queue);
+
+        thread_set_sched_class(queue->worker, workqueue_worker_class[i], 0);
+    }
+
+    workqueue_ready = true;
+
+    qemu_ok("Work queues are ready (%d workers)", WORK_PRIORITY_COUNT);
+}
+
+/**
+ * @brief Ставит работу в очередь. Можно вызывать из обработчиков прерываний.
+ *
+ * @param work - Работа (должна жить, пока не выполнится)
+ * @return true - если поставлена, false - если уже ждёт в очереди
+ */
+bool workqueue_queue_work(work_t* work) {
+    if(work->priority >= WORK_PRIORITY_COUNT) {
+        qemu_err("Invalid work priority: %d", work->priority);
+        return false;
+    }
+
+    size_t flags = irq_save();
+
+    if(work->pending) {
+        irq_restore(flags);
+        return false;
+    }
+
+    workqueue_t* queue = &workqueues[work->priority];
+
+    work->pending = true;
+    work->next = NULL;
+    work->submit_tsc = rdtsc();
+
+    if(queue->tail) {
+        queue->tail->next = work;
+    } else {
+        queue->head = work;
+    }
+
+    queue->tail = work;
+
+    queue->stats.submitted++;
+    queue->stats.depth++;
+
+    if(queue->stats.depth > queue->stats.max_depth) {
+        queue->stats.max_depth = queue->stats.depth;
+    }
+
+    thread_wake(queue->worker);
+
+    irq_restore(flags);
+
+    return true;
+}
+
+/**
+ * @brief Ставит в очередь вызов `fn(arg)`. Можно вызывать из обработчиков прерываний.
+ *
+ * @param fn - Функция
+ * @param arg - Аргумент
+ * @param priority - Приоритет (WORK_PRIORITY_*)
+ * @return true - если поставлена, false - если пул заданий исчерпан
+ */
+bool workqueue_submit(work_fn_t fn, void* arg, uint32_t priority) {
+    if(!workqueue_ready || priority >= WORK_PRIORITY_COUNT) {
+        return false;
+    }
+
+    size_t flags = irq_save();
+
+    work_t* work = work_pool_free;
+
+    if(work == NULL) {
+        workqueues[priority].stats.dropped++;
+
+        irq_restore(flags);
+
+        return false;
+    }
+
+    work_pool_free = work->next;
+
+    work->fn = fn;
+    work->arg = arg;
+    work->priority = priority;
+    work->pending = false;
+    work->pooled = true;
+
+    workqueue_queue_work(work);
+
+    irq_restore(flags);
+
+    return true;
+}
+
+/**
+ * @brief Копирует статистику очередей
+ */
+void workqueue_get_stats(workqueue_stats_t* out) {
+    size_t flags = irq_save();
+
+    for(size_t i = 0; i < WORK_PRIORITY_COUNT; i++) {
+        out->queues[i] = workqueues[i].stats;
+    }
+
+    irq_restore(flags);
+
+    out->tsc_per_ms = timer_tsc_per_ms();
+}
@@ -11,12 +11,14 @@
 #include "arch/x86/registers.h"
 #include	"io/ports.h"
 #include    "io/screen.h"
+#include    "io/surface.h"
 #include	"io/tty.h"
 #include	"user/env.h"
 #include    "sys/file_descriptors.h"
 #include    <kernel.h>
 #include	"io/keyboard.h"
 #include	"arch/x86/cputemp.h"
+#include    "net/socket.h"
 
 size_t syscall_env(struct env* position) {
     memcpy(position, &system_environment, sizeof(env_t));
@@ -87,6 +89,8 @@ size_t syscall_exit(SAYORI_UNUSED uint32_t status) {
 }
 
 size_t syscall_screen_update() {
+  // Programs draw straight into the back buffer, so nothing marked their changes.
+  screen_mark_all_dirty();
   screen_update();
 
   return 0;
@@ -164,10 +168,6 @@ size_t syscall_get_console_size(uint32_t* out_wh) {
 }
 
 size_t syscall_get_screen_parameters(size_t screen_id, size_t parameter, uint8_t* out_buffer, size_t length) {
-    (void)screen_id;
-    
-    // TODO: Utilize screen_id somehow.
-
     if(out_buffer == NULL) {
         return (size_t)-1;
     }
@@ -184,15 +184,31 @@ size_t syscall_get_screen_parameters(size_t screen_id, size_t parameter, uint8_t
         return (size_t)-1;
     }
 
+    blit_surface_t target;
+
+    if(screen_id == SURFACE_SCREEN) {
+        screen_back_surface(&target);
+    } else {
+        surface_t* surface = surface_get(screen_id);
+
+        if(surface == NULL) {
+            return (size_t)-1;
+        }
+
+        target = surface->pixels;
+
+        surface_put(surface);
+    }
+
     switch(parameter) {
         case SCREEN_QUERY_WIDTH: 
-            *(uint32_t*)out_buffer = getScreenWidth();
+            *(uint32_t*)out_buffer = target.width;
             break;
         case SCREEN_QUERY_HEIGHT: 
-            *(uint32_t*)out_buffer = getScreenHeight();
+            *(uint32_t*)out_buffer = target.height;
             break;
         case SCREEN_QUERY_BITS_PER_PIXEL: 
-            *(uint32_t*)out_buffer = getDisplayBpp();
+            *(uint32_t*)out_buffer = target.bpp;
             break;
     }
 
@@ -200,30 +216,83 @@ size_t syscall_get_screen_parameters(size_t screen_id, size_t parameter, uint8_t
 }
 
 size_t syscall_copy_to_screen(size_t screen_id, uint8_t* buffer) {
-    // TODO: Utilize screen_id somehow.
     if(buffer == NULL) {
         return (size_t)-1;
     }
 
+    if(screen_id != SURFACE_SCREEN) {
+        surface_t* surface = surface_get(screen_id);
+
+        if(surface == NULL) {
+            return (size_t)-1;
+        }
+
+        memcpy(surface->pixels.pixels, buffer, surface->pixels.pitch * surface->pixels.height);
+        surface_put(surface);
+
+        surface_present(screen_id, NULL, 0);
+
+        return 0;
+    }
+
     memcpy((char*)getFrameBufferAddr(), (char*)buffer, getDisplaySize());
+    screen_mark_all_dirty();
     screen_update();
 
     return 0;
 }
 
 size_t syscall_copy_from_screen(size_t screen_id, uint8_t* buffer) {
-    (void)screen_id;
-
-    // TODO: Utilize screen_id somehow.
     if(buffer == NULL) {
         return (size_t)-1;
     }
 
+    if(screen_id != SURFACE_SCREEN) {
+        surface_t* surface = surface_get(screen_id);
+
+        if(surface == NULL) {
+            return (size_t)-1;
+        }
+
+        memcpy(buffer, surface->pixels.pixels, surface->pixels.pitch * surface->pixels.height);
+        surface_put(surface);
+
+        return 0;
+    }
+
     memcpy((char*)buffer, (char*)getFrameBufferAddr(), getDisplaySize());
 
     return 0;
 }
 
+size_t syscall_surface_create(uint32_t width, uint32_t height, size_t address, size_t* out_id) {
+    if(out_id == NULL) {
+        return (size_t)-1;
+    }
+
+    ssize_t id = surface_create(width, height, address);
+
+    if(id < 0) {
+        return (size_t)-1;
+    }
+
+    *out_id = (size_t)id;
+
+    return 0;
+}
+
+size_t syscall_surface_destroy(size_t id) {
+    return surface_destroy(id) ? 0 : (size_t)-1;
+}
+
+size_t syscall_surface_move(size_t id, int32_t x, int32_t y) {
+    return surface_move(id, x, y) ? 0 : (size_t)-1;
+}
+
+size_t syscall_surface_present(size_t id, const surface_rect_t* rects, size_t count) {
+    return surface_present(id, rects, count) ? 0 : (size_t)-1;
+}
+
 size_t syscall_yield(registers_t* regs) {
     task_switch_v2_wrapper(regs);
 
@@ -254,6 +323,56 @@ size_t syscall_fd_tell(int descriptor_number, int* out) {
     return file_descriptor_tell(descriptor_number, out);
 }
 
+// Sockets return the result or a negated NET_E* code.
+
+size_t syscall_socket(uint32_t domain, uint32_t type, uint32_t protocol) {
+    return socket_create(domain, type, protocol);
+}
+
+size_t syscall_socket_bind(int32_t fd, const socket_address_t* address) {
+    return socket_bind(fd, address);
+}
+
+size_t syscall_socket_listen(int32_t fd, size_t backlog) {
+    return socket_listen(fd, backlog);
+}
+
+size_t syscall_socket_accept(int32_t fd, socket_address_t* address) {
+    return socket_accept(fd, address);
+}
+
+size_t syscall_socket_connect(int32_t fd, const socket_address_t* address) {
+    return socket_connect(fd, address);
+}
+
+size_t syscall_socket_send(int32_t fd, const void* data, size_t len, uint32_t flags) {
+    return socket_send(fd, data, len, flags);
+}
+
+size_t syscall_socket_recv(int32_t fd, void* data, size_t len, uint32_t flags) {
+    return socket_recv(fd, data, len, flags);
+}
+
+size_t syscall_socket_sendto(int32_t fd, const void* data, size_t len, uint32_t flags, const socket_address_t* address) {
+    return socket_sendto(fd, data, len, flags, address);
+}
+
+size_t syscall_socket_recvfrom(int32_t fd, void* data, size_t len, uint32_t flags, socket_address_t* address) {
+    return socket_recvfrom(fd, data, len, flags, address);
+}
+
+size_t syscall_socket_poll(socket_poll_t* fds, size_t count, int32_t timeout_ms) {
+    return socket_poll(fds, count, timeout_ms);
+}
+
+size_t syscall_socket_shutdown(int32_t fd, uint32_t how) {
+    return socket_shutdown(fd, how);
+}
+
+size_t syscall_socket_close(int32_t fd) {
+    return socket_close(fd);
+}
+
 syscall_fn_t* calls_table[] = {
     // Environment
 	[0] = (syscall_fn_t *)syscall_env,
@@ -301,6 +420,26 @@ syscall_fn_t* calls_table[] = {
     [26] = (syscall_fn_t *)syscall_get_screen_parameters,
     [27] = (syscall_fn_t *)syscall_copy_to_screen,
     [28] = (syscall_fn_t *)syscall_copy_from_screen,
+
+    // Sockets
+    [29] = (syscall_fn_t *)syscall_socket,
+    [30] = (syscall_fn_t *)syscall_socket_bind,
+    [31] = (syscall_fn_t *)syscall_socket_listen,
+    [32] = (syscall_fn_t *)syscall_socket_accept,
+    [33] = (syscall_fn_t *)syscall_socket_connect,
+    [34] = (syscall_fn_t *)syscall_socket_send,
+    [35] = (syscall_fn_t *)syscall_socket_recv,
+    [36] = (syscall_fn_t *)syscall_socket_sendto,
+    [37] = (syscall_fn_t *)syscall_socket_recvfrom,
+    [38] = (syscall_fn_t *)syscall_socket_poll,
+    [39] = (syscall_fn_t *)syscall_socket_shutdown,
+    [40] = (syscall_fn_t *)syscall_socket_close,
+
+    // Surfaces
+    [41] = (syscall_fn_t *)syscall_surface_create,
+    [42] = (syscall_fn_t *)syscall_surface_destroy,
+    [43] = (syscall_fn_t *)syscall_surface_move,
+    [44] = (syscall_fn_t *)syscall_surface_present,
 };
 
 #define SYSCALL_COUNT (sizeof(calls_table) / sizeof(syscall_fn_t*))
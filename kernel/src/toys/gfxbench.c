@@ -8,11 +8,179 @@
 #include "io/screen.h"
 #include "sys/timer.h"
 #include "lib/sprintf.h"
+#include "lib/asprintf.h"
+#include "io/keyboard.h"
+#include "lib/string.h"
+#include "lib/pixel.h"
+#include "lib/blit.h"
+#include "lib/rand.h"
+#include "drv/psf.h"
+#include "io/tty.h"
+#include "mem/vmm.h"
+#include "arch/x86/cpuinfo.h"
+#include "arch/x86/pit.h"
+
+// Passes over the whole surface per primitive and blitter variant.
+#define GFXBENCH_ROUNDS 16
+
+// Lines moved by the scroll test, one text row.
+#define GFXBENCH_SCROLL 16
+
+typedef struct {
+    blit_surface_t screen;  /* Screen format */
+    blit_surface_t image24;
+    blit_surface_t image32;
+    uint32_t*      argb;    /* One row of translucent pixels */
+} gfxbench_surfaces_t;
+
+typedef struct {
+    const char* name;
+    // Draws once, returns the number of pixels touched.
+    size_t (*run)(gfxbench_surfaces_t* s);
+} gfxbench_primitive_t;
+
+static size_t gfxbench_fill_span(gfxbench_surfaces_t* s) {
+    for(uint32_t y = 0; y < s->screen.height; y++) {
+        blit_fill_span(&s->screen, 0, y, s->screen.width, 0x336699);
+    }
+
+    return s->screen.width * s->screen.height;
+}
+
+static size_t gfxbench_fill_rect(gfxbench_surfaces_t* s) {
+    blit_fill_rect(&s->screen, 0, 0, s->screen.width, s->screen.height, 0x996633);
+
+    return s->screen.width * s->screen.height;
+}
+
+static size_t gfxbench_scroll(gfxbench_surfaces_t* s) {
+    uint32_t height = s->screen.height - GFXBENCH_SCROLL;
+
+    blit_copy_rect(&s->screen, 0, 0, &s->screen, 0, GFXBENCH_SCROLL, s->screen.width, height);
+
+    return s->screen.width * height;
+}
+
+static size_t gfxbench_blend_span(gfxbench_surfaces_t* s) {
+    for(uint32_t y = 0; y < s->screen.height; y++) {
+        blit_blend_span(&s->screen, 0, y, s->argb, s->screen.width);
+    }
+
+    return s->screen.width * s->screen.height;
+}
+
+static size_t gfxbench_24_to_32(gfxbench_surfaces_t* s) {
+    blit_copy_rect(&s->image32, 0, 0, &s->image24, 0, 0, s->image32.width, s->image32.height);
+
+    return s->image32.width * s->image32.height;
+}
+
+static size_t gfxbench_32_to_24(gfxbench_surfaces_t* s) {
+    blit_copy_rect(&s->image24, 0, 0, &s->image32, 0, 0, s->image24.width, s->image24.height);
+
+    return s->image24.width * s->image24.height;
+}
+
+static const gfxbench_primitive_t gfxbench_primitives_list[] = {
+    {"fill span", gfxbench_fill_span},
+    {"fill rect", gfxbench_fill_rect},
+    {"scroll", gfxbench_scroll},
+    {"blend span", gfxbench_blend_span},
+    {"24 -> 32", gfxbench_24_to_32},
+    {"32 -> 24", gfxbench_32_to_24},
+};
+
+static bool gfxbench_surface(blit_surface_t* out, uint32_t width, uint32_t height, uint32_t bpp) {
+    out->width = width;
+    out->height = height;
+    out->bpp = bpp;
+    out->pitch = width * (bpp >> 3);
+    out->pixels = kmalloc_common(out->pitch * height, 16);
+
+    return out->pixels != NULL;
+}
+
+/**
+ * @brief Скорость каждого примитива lib/blit для всех вариантов ядер, в мегапикселях в секунду
+ *
+ * Рисует в буферы размера экрана в памяти, сам экран не трогает.
+ */
+void gfxbench_primitives() {
+    gfxbench_surfaces_t s = {0};
+    uint32_t width = getScreenWidth();
+    uint32_t height = getScreenHeight();
+    uint64_t tsc_per_ms = timer_tsc_per_ms();
+
+    bool ok = height > GFXBENCH_SCROLL
+              && gfxbench_surface(&s.screen, width, height, getDisplayBpp())
+              && gfxbench_surface(&s.image24, width, height, 24)
+              && gfxbench_surface(&s.image32, width, height, 32)
+              && (s.argb = kcalloc(width, sizeof(uint32_t))) != NULL;
+
+    if(!ok) {
+        tty_printf("gfxbench: no memory for %dx%d buffers\n", width, height);
+        goto end;
+    }
+
+    for(uint32_t x = 0; x < width; x++) {
+        s.argb[x] = ((uint32_t)(x & 0xFF) << 24) | (rand() & 0xFFFFFF);
+    }
+
+    tty_printf("%dx%d, %d bits, MPix/s\n%-12s", width, height, getDisplayBpp(), "PRIMITIVE");
+
+    for(size_t v = 0; v < blit_variant_count(); v++) {
+        tty_printf(" %10s", blit_variant(v)->name);
+    }
+
+    tty_printf("\n");
+
+    const blit_ops_t* active = blit_ops;
+
+    for(size_t p = 0; p < sizeof(gfxbench_primitives_list) / sizeof(gfxbench_primitives_list[0]); p++) {
+        const gfxbench_primitive_t* primitive = gfxbench_primitives_list + p;
+
+        tty_printf("%-12s", primitive->name);
+
+        for(size_t v = 0; v < blit_variant_count(); v++) {
+            // Other drawing meanwhile runs on the tested variant too, every variant draws the same.
+            blit_ops = blit_variant(v);
+
+            uint64_t pixels = 0;
+            uint64_t start = rdtsc();
+
+            for(size_t round = 0; round < GFXBENCH_ROUNDS; round++) {
+                pixels += primitive->run(&s);
+            }
+
+            uint64_t cycles = rdtsc() - start;
+
+            blit_ops = active;
+
+            tty_printf(" %10d", (uint32_t)(cycles ? pixels * tsc_per_ms / cycles / 1000 : 0));
+        }
+
+        tty_printf("\n");
+    }
+
+    tty_printf("Active: %s\n", active->name);
+
+end:
+    kfree(s.screen.pixels);
+    kfree(s.image24.pixels);
+    kfree(s.image32.pixels);
+    kfree(s.argb);
+}
 
 uint32_t gfxbench(uint32_t argc, char* args[]) {
+	(void)argc;
+	(void)args;
+
 	size_t frames = 0;
 	size_t fps = 0;
 	size_t last_measurement = timestamp();
+	// Bytes screen_update copied to the screen, per frame of the last second.
+	uint64_t last_flushed = screen_flushed_bytes();
+	size_t frame_bytes = 0;
 
 	size_t scrw = getScreenWidth();
 	size_t scrh = getScreenHeight();
@@ -29,12 +197,14 @@ uint32_t gfxbench(uint32_t argc, char* args[]) {
 		if(timestamp() - last_measurement >= 1000) {
 			last_measurement = timestamp();
 			fps = frames;
+			frame_bytes = frames ? (screen_flushed_bytes() - last_flushed) / frames : 0;
+			last_flushed = screen_flushed_bytes();
 			frames = 0;
 		}
 
 		drawRect(0, 0, scrw, scrh, 0x999999);
 
-		asprintf(&string, "[%d x %d @ %d bits] %d FPS", scrw, scrh, scrbpp, fps);
+		asprintf(&string, "[%d x %d @ %d bits] %d FPS, %d KB flushed per frame", scrw, scrh, scrbpp, fps, frame_bytes / 1024);
 
 		draw_vga_str(string, strlen(string), 0, 0, 0x000000);
 
@@ -63,6 +63,7 @@ void mala_init() {
 
 void mala_flush() {
     memcpy((char*)getFrameBufferAddr() + BUFSIZE(canvas_width, STATUSBAR_HEIGHT), buffer, buffer_size);
+    screen_mark_dirty(0, STATUSBAR_HEIGHT, canvas_width, canvas_height);
 
 
     for(int i = 0; i < COLORS; i++) {
@@ -22,8 +22,9 @@ use margin::Margin;
 use noct_fs::File;
 use noct_input::kbd::{Key, SpecialKey};
 use noct_logger::{qemu_note, qemu_ok};
-use noct_sched::{spawn, task_yield};
-use noct_timer::timestamp;
+use noct_sched::{SchedClass, spawn};
+use noct_screen::window::Window;
+use noct_timer::{sleep_ms, timestamp};
 use noct_tty::println;
 use nwav::Chunk::{Format, List};
 use spin::Mutex;
@@ -32,7 +33,24 @@ use alloc::collections::LinkedList;
 
 const CACHE_SIZE: usize = 512 << 10;
 
+// How long the loops sleep when there is nothing to do, the player thread is realtime
+// and would starve everything else if it spun.
+const IDLE_SLEEP_MS: u32 = 16;
+
 mod margin;
+
+/// Gives the thread its old scheduling class back on any way out of the player.
+struct SchedClassGuard {
+    thread: *mut noct_sched::thread_t,
+    class: SchedClass,
+    priority: u32,
+}
+
+impl Drop for SchedClassGuard {
+    fn drop(&mut self) {
+        noct_sched::set_sched_class(self.thread, self.class, self.priority);
+    }
+}
 // mod border_wrapped;
 // mod text_list;
 
@@ -194,18 +212,18 @@ fn draw_ui(
     layout.draw(canvas).unwrap();
 }
 
-fn render_canvas(canvas: &mut Canvas<Rgb888>) {
-    let mut pixels = canvas
+fn render_canvas(canvas: &mut Canvas<Rgb888>, window: &mut Window) {
+    let pixels = canvas
         .pixels
         .iter()
         .map(|a| a.unwrap_or(Rgb888::BLACK))
         .map(|x| ((x.r() as u32) << 16) | ((x.g() as u32) << 8) | ((x.b()) as u32));
 
-    for y in 0..600 {
-        for x in 0..800 {
-            noct_screen::set_pixel(x, y, pixels.next().unwrap());
-        }
+    for (dst, pixel) in window.pixels_mut().iter_mut().zip(pixels) {
+        *dst = pixel;
     }
+
+    window.present();
 }
 
 #[inline(always)]
@@ -268,20 +286,20 @@ pub fn player(args: &[&str]) -> Result<(), usize> {
 
     let mut canvas: Canvas<Rgb888> = Canvas::new(Size::new(800, 600));
 
+    // Closing the window brings back whatever the player covered.
+    let Some(mut window) = Window::new(0, 0, 800, 600) else {
+        println!("Cannot create a window!");
+        return Err(3);
+    };
+
     let arced_running = is_running.clone();
     let arced_file = file.clone();
     let arced_cache = cache_line.clone();
     let arced_br = bytes_read.clone();
     spawn(move || {
         while *arced_running.lock() {
-            if *arced_br.lock() >= filesize {
-                // qemu_log!("Reached the end!");
-                task_yield();
-                continue;
-            }
-
-            if arced_cache.lock().len() > 10 {
-                task_yield();
+            if *arced_br.lock() >= filesize || arced_cache.lock().len() > 10 {
+                unsafe { sleep_ms(IDLE_SLEEP_MS) };
                 continue;
             }
 
@@ -301,6 +319,19 @@ pub fn player(args: &[&str]) -> Result<(), usize> {
         qemu_ok!("Exit!");
     });
 
+    // Audio must not wait behind CPU-heavy threads, otherwise it underruns. Only the thread
+    // feeding the device is realtime, the prefetcher keeps ten blocks of slack.
+    let player_thread = noct_sched::current_thread();
+    let (prev_class, prev_priority) = noct_sched::sched_class(player_thread);
+
+    noct_sched::set_sched_class(player_thread, SchedClass::Realtime, 0);
+
+    let _sched_class = SchedClassGuard {
+        thread: player_thread,
+        class: prev_class,
+        priority: prev_priority,
+    };
+
     let meta = metadata
         .map(|a| {
             let artist = a
@@ -327,7 +358,6 @@ pub fn player(args: &[&str]) -> Result<(), usize> {
             noct_input::kbd::parse_scancode(key as u8).unwrap_or((Key::Unknown, false));
 
         if key == Key::Special(SpecialKey::ESCAPE) {
-            noct_screen::fill(0);
             break;
         } else if key == Key::Character(' ') && is_pressed {
             let curstat = *status.lock();
@@ -367,6 +397,7 @@ pub fn player(args: &[&str]) -> Result<(), usize> {
         }
 
         let curstat = *status.lock();
+        let mut wrote = false;
 
         if curstat == PlayerStatus::Playing {
             let block = {
@@ -384,6 +415,7 @@ pub fn player(args: &[&str]) -> Result<(), usize> {
                 audio.write(&a);
 
                 bytes_played += a.len();
+                wrote = true;
             } else if *bytes_read.lock() >= filesize {
                 qemu_note!("No block!");
 
@@ -403,9 +435,14 @@ pub fn player(args: &[&str]) -> Result<(), usize> {
             &total_time_seconds,
         );
 
-        render_canvas(&mut canvas);
+        render_canvas(&mut canvas, &mut window);
 
         qemu_note!("Rendered in: {} ms", timestamp() - st);
+
+        // Paused, stopped or waiting for the prefetcher: nothing blocks in audio.write.
+        if !wrote {
+            unsafe { sleep_ms(IDLE_SLEEP_MS) };
+        }
     }
 
     audio.close();
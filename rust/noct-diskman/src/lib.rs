@@ -12,6 +12,7 @@ use alloc::{
     vec::Vec,
 };
 use noct_mbr::{PartitionRecord, PartitionType};
+use noct_sched::{WorkPriority, executor::Offload};
 use spin::RwLock;
 
 use lazy_static::lazy_static;
@@ -89,6 +90,33 @@ pub fn read(disk_id: &str, location: u64, buffer: &mut [u8]) -> i64 {
     }
 }
 
+/// Read data from disk without blocking the caller.
+///
+/// Drivers are synchronous, so the read runs on the kernel work queue and the returned
+/// future completes with the same result as [`read`] and the buffer given back.
+///
+/// # Arguments:
+///
+/// * `disk_id` - ID of the target disk.
+/// * `location` - Exact location in bytes.
+/// * `buffer` - Output buffer where data is being written.
+pub fn read_async(
+    disk_id: &str,
+    location: u64,
+    mut buffer: Vec<u8>,
+) -> Offload<(i64, Vec<u8>)> {
+    let disk_id = disk_id.to_owned();
+
+    noct_sched::executor::offload(
+        move || {
+            let result = read(&disk_id, location, &mut buffer);
+
+            (result, buffer)
+        },
+        WorkPriority::Normal,
+    )
+}
+
 /// Write data to disk.
 ///
 /// Returns -1 if disk can't be found.
@@ -1,4 +1,4 @@
-use crate::keyboard_buffer_get;
+use crate::{keyboard_buffer_get, keyboard_buffer_get_async};
 
 #[derive(Debug, Clone, Copy, PartialEq)]
 pub enum SpecialKey {
@@ -142,8 +142,15 @@ unsafe extern "C" {
 }
 
 pub fn get_key() -> CharKey {
-    let key = keyboard_buffer_get();
+    key_from_raw(keyboard_buffer_get())
+}
+
+/// Waits for a key without polling. Must be awaited inside an executor from `noct_sched::executor`.
+pub async fn get_key_async() -> CharKey {
+    key_from_raw(keyboard_buffer_get_async().await)
+}
 
+fn key_from_raw(key: u32) -> CharKey {
     let ch = unsafe { parse_char(key) };
 
     if ch == 0 {
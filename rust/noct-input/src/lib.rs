@@ -5,8 +5,11 @@ extern crate alloc;
 
 use alloc::vec::Vec;
 use core::cell::OnceCell;
+use core::future::Future;
+use core::task::Poll;
 
 use noct_logger::{qemu_err, qemu_ok};
+use noct_sched::sync::WaitQueue;
 use noct_sched::task_yield;
 
 pub mod kbd;
@@ -14,6 +17,9 @@ pub mod kbd;
 /// Global keyboard buffer (kernel-wide). Used everywhere.
 static mut KEYBOARD_BUFFER: OnceCell<KeyboardBuffer> = OnceCell::new();
 
+/// Tasks waiting for a key in [`keyboard_buffer_get_async`].
+static KEYBOARD_WAITERS: WaitQueue = WaitQueue::new();
+
 /// A definition of Keyboard buffer. It's just a pre-allocated vector, but functionality can be extended soon and new fields may be added.
 pub struct KeyboardBuffer {
     buffer: Vec<u32>,
@@ -80,6 +86,8 @@ pub unsafe extern "C" fn keyboard_buffer_init() {
 #[unsafe(no_mangle)]
 pub extern "C" fn keyboard_buffer_put(character: u32) {
     unsafe { KEYBOARD_BUFFER.get_mut().unwrap().push(character) };
+
+    KEYBOARD_WAITERS.wake_all();
 }
 
 /// External function for C API that gets a character from a buffer.
@@ -98,3 +106,22 @@ pub extern "C" fn keyboard_buffer_get_or_nothing() -> u32 {
 
     v.get_raw().unwrap_or(0)
 }
+
+/// Waits for a character from a buffer without polling.
+pub fn keyboard_buffer_get_async() -> impl Future<Output = u32> {
+    core::future::poll_fn(|cx| {
+        let v = unsafe { KEYBOARD_BUFFER.get_mut().unwrap() };
+
+        if let Some(character) = v.get_raw() {
+            return Poll::Ready(character);
+        }
+
+        KEYBOARD_WAITERS.register(cx.waker());
+
+        // A key could arrive before the waker was registered.
+        match v.get_raw() {
+            Some(character) => Poll::Ready(character),
+            None => Poll::Pending,
+        }
+    })
+}
@@ -0,0 +1,282 @@
+#![no_std]
+
+//! Rust access to the kernel network stack (`net/stack.h`).
+
+extern crate alloc;
+
+use alloc::{borrow::ToOwned, collections::VecDeque, string::String, sync::Arc, vec::Vec};
+use core::{
+    ffi::{CStr, c_char, c_void},
+    future::Future,
+    slice,
+    sync::atomic::{AtomicUsize, Ordering},
+    task::Poll,
+};
+
+use noct_sched::{
+    WorkPriority,
+    sync::{IrqMutex, WaitQueue},
+};
+
+/// Frames kept by a [`Receiver`] before new ones are dropped.
+pub const RECEIVER_QUEUE_LIMIT: usize = 256;
+
+#[repr(C)]
+pub struct netcard_entry_t {
+    pub name: [c_char; 64],
+    pub ipv4_addr: [u8; 4],
+    pub get_mac_addr: Option<unsafe extern "C" fn(*mut u8)>,
+    pub send_packet: Option<unsafe extern "C" fn(*mut c_void, usize)>,
+    pub send_netbuf: Option<unsafe extern "C" fn(*mut c_void) -> bool>,
+    pub stack: *mut c_void,
+    pub features: u32,
+    pub flush: Option<unsafe extern "C" fn()>,
+    pub poll: Option<unsafe extern "C" fn(usize) -> usize>,
+    pub rx_irq_enable: Option<unsafe extern "C" fn() -> bool>,
+}
+
+/// Per-card counters of the network stack.
+#[repr(C)]
+#[derive(Clone, Copy, Default, Debug)]
+pub struct netstack_stats_t {
+    pub rx_packets: usize,
+    /// RX ring was full or the frame did not fit into a slot.
+    pub rx_dropped: usize,
+    pub tx_packets: usize,
+    /// TX ring was full.
+    pub tx_dropped: usize,
+    /// RX interrupts that started polling.
+    pub interrupts: usize,
+    /// Calls of the card's poll function.
+    pub polls: usize,
+}
+
+type RxListener =
+    unsafe extern "C" fn(card: *mut netcard_entry_t, data: *mut c_void, length: usize, ctx: *mut c_void);
+
+unsafe extern "C" {
+    fn netstack_add_rx_listener(listener: RxListener, ctx: *mut c_void) -> bool;
+    fn netstack_remove_rx_listener(listener: RxListener, ctx: *mut c_void);
+    fn netstack_get_stats(card: *mut netcard_entry_t, out: *mut netstack_stats_t) -> bool;
+    fn netcards_get_count() -> usize;
+    fn netcard_get(index: usize) -> *mut netcard_entry_t;
+    fn checksum_benchmark(length: usize, rounds: usize, out: *mut ChecksumBench) -> bool;
+    fn netbench_udp(count: usize, payload: usize, out: *mut BenchResult) -> isize;
+    fn netbench_tcp(bytes: usize, out: *mut BenchResult) -> isize;
+}
+
+/// Counters of one network card.
+pub struct CardStats {
+    pub name: String,
+    pub stats: netstack_stats_t,
+}
+
+/// Counters of every card attached to the network stack.
+pub fn card_stats() -> Vec<CardStats> {
+    let count = unsafe { netcards_get_count() };
+    let mut result = Vec::with_capacity(count);
+
+    for index in 0..count {
+        let card = unsafe { netcard_get(index) };
+
+        if card.is_null() {
+            continue;
+        }
+
+        let mut stats = netstack_stats_t::default();
+
+        if !unsafe { netstack_get_stats(card, &mut stats) } {
+            continue;
+        }
+
+        let name = unsafe { CStr::from_ptr((*card).name.as_ptr()) }
+            .to_string_lossy()
+            .into_owned();
+
+        result.push(CardStats { name, stats });
+    }
+
+    result
+}
+
+/// TSC cycles spent by each way of checksumming a buffer (`net/checksum.h`).
+#[repr(C)]
+#[derive(Clone, Copy, Default, Debug)]
+pub struct ChecksumBench {
+    /// Plain loop over 16-bit words.
+    pub reference_tsc: u64,
+    pub partial_tsc: u64,
+    /// `memcpy`, then a separate pass to sum.
+    pub memcpy_tsc: u64,
+    /// Copy and sum in one pass.
+    pub copy_tsc: u64,
+    pub tsc_per_ms: u64,
+    /// The kernel was built with the SSE2 loop.
+    pub sse2: bool,
+}
+
+/// Runs every checksum variant `rounds` times over `length` random bytes.
+/// `None` if they disagree on the result or the buffers could not be allocated.
+pub fn benchmark_checksum(length: usize, rounds: usize) -> Option<ChecksumBench> {
+    let mut result = ChecksumBench::default();
+
+    if unsafe { checksum_benchmark(length, rounds, &mut result) } {
+        Some(result)
+    } else {
+        None
+    }
+}
+
+/// Work of the whole stack on the packet path (`netstack_counters_t`).
+#[repr(C)]
+#[derive(Clone, Copy, Default, Debug)]
+pub struct netstack_counters_t {
+    /// Packet buffers, queued datagrams and out-of-order segments.
+    pub allocations: usize,
+    /// Those of them that went to the heap.
+    pub heap_allocations: usize,
+    pub copies: usize,
+    pub copied_bytes: usize,
+}
+
+/// Result of a loopback benchmark (`net/netbench.h`).
+#[repr(C)]
+#[derive(Clone, Copy, Default, Debug)]
+pub struct BenchResult {
+    /// UDP: datagrams received.
+    pub datagrams: usize,
+    /// UDP: datagrams that never arrived.
+    pub lost: usize,
+    /// Payload received.
+    pub bytes: usize,
+    /// Frames that went through the loopback card.
+    pub frames: usize,
+    pub elapsed_us: u64,
+    pub counters: netstack_counters_t,
+}
+
+/// Sends `count` datagrams of `payload` bytes to itself over 127.0.0.1.
+/// Errors are negative `NET_E*` codes.
+pub fn benchmark_udp(count: usize, payload: usize) -> Result<BenchResult, isize> {
+    let mut result = BenchResult::default();
+
+    match unsafe { netbench_udp(count, payload, &mut result) } {
+        0 => Ok(result),
+        error => Err(error),
+    }
+}
+
+/// Streams `bytes` bytes over a TCP connection to 127.0.0.1.
+pub fn benchmark_tcp(bytes: usize) -> Result<BenchResult, isize> {
+    let mut result = BenchResult::default();
+
+    match unsafe { netbench_tcp(bytes, &mut result) } {
+        0 => Ok(result),
+        error => Err(error),
+    }
+}
+
+/// Received Ethernet frame.
+pub struct Frame {
+    /// Name of the card it came from.
+    pub card: String,
+    pub data: Vec<u8>,
+}
+
+struct Shared {
+    frames: IrqMutex<VecDeque<Frame>>,
+    waiters: WaitQueue,
+    dropped: AtomicUsize,
+}
+
+unsafe extern "C" fn receiver_listener(
+    card: *mut netcard_entry_t,
+    data: *mut c_void,
+    length: usize,
+    ctx: *mut c_void,
+) {
+    let shared = unsafe { &*(ctx as *const Shared) };
+
+    if shared.frames.with(|frames| frames.len()) >= RECEIVER_QUEUE_LIMIT {
+        shared.dropped.fetch_add(1, Ordering::Relaxed);
+        return;
+    }
+
+    let card = unsafe { CStr::from_ptr((*card).name.as_ptr()) }
+        .to_string_lossy()
+        .into_owned();
+    let data = unsafe { slice::from_raw_parts(data as *const u8, length) }.to_owned();
+
+    shared.frames.with(|frames| frames.push_back(Frame { card, data }));
+    shared.waiters.wake_all();
+}
+
+/// Gets a copy of every frame received by any card.
+pub struct Receiver {
+    shared: Arc<Shared>,
+    /// Reference owned by the network stack.
+    ctx: *const Shared,
+}
+
+unsafe impl Send for Receiver {}
+unsafe impl Sync for Receiver {}
+
+impl Receiver {
+    /// Returns `None` if all listener slots of the network stack are taken.
+    pub fn new() -> Option<Self> {
+        let shared = Arc::new(Shared {
+            frames: IrqMutex::new(VecDeque::new()),
+            waiters: WaitQueue::new(),
+            dropped: AtomicUsize::new(0),
+        });
+
+        let ctx = Arc::into_raw(shared.clone());
+
+        if unsafe { netstack_add_rx_listener(receiver_listener, ctx as *mut c_void) } {
+            Some(Self { shared, ctx })
+        } else {
+            drop(unsafe { Arc::from_raw(ctx) });
+            None
+        }
+    }
+
+    pub fn try_recv(&self) -> Option<Frame> {
+        self.shared.frames.with(|frames| frames.pop_front())
+    }
+
+    /// Waits for the next frame without polling.
+    pub fn recv(&self) -> impl Future<Output = Frame> + '_ {
+        core::future::poll_fn(|cx| {
+            if let Some(frame) = self.try_recv() {
+                return Poll::Ready(frame);
+            }
+
+            self.shared.waiters.register(cx.waker());
+
+            match self.try_recv() {
+                Some(frame) => Poll::Ready(frame),
+                None => Poll::Pending,
+            }
+        })
+    }
+
+    /// Frames lost because the queue was full.
+    pub fn dropped(&self) -> usize {
+        self.shared.dropped.load(Ordering::Relaxed)
+    }
+}
+
+impl Drop for Receiver {
+    fn drop(&mut self) {
+        unsafe { netstack_remove_rx_listener(receiver_listener, self.ctx as *mut c_void) };
+
+        // The listener may be running right now on the RX worker. Release the stack's
+        // reference from the same worker, after it returns (leaked if the pool is full).
+        let ctx = self.ctx as usize;
+
+        noct_sched::submit(
+            move || drop(unsafe { Arc::from_raw(ctx as *const Shared) }),
+            WorkPriority::Normal,
+        );
+    }
+}
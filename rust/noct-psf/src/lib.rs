@@ -2,16 +2,79 @@
 
 extern crate alloc;
 
+use alloc::vec;
 use alloc::vec::Vec;
 use noct_logger::qemu_err;
-use noct_screen::set_pixel;
+use noct_screen::{mark_dirty, write_pixel};
 
 pub mod c_api;
 
+const fn bit_lanes() -> [[u32; 8]; 256] {
+    let mut table = [[0u32; 8]; 256];
+    let mut bits = 0;
+
+    while bits < 256 {
+        let mut x = 0;
+
+        while x < 8 {
+            if bits & (0x80 >> x) != 0 {
+                table[bits][x] = u32::MAX;
+            }
+
+            x += 1;
+        }
+
+        bits += 1;
+    }
+
+    table
+}
+
+// Row mask -> 8 pixel masks, all ones where the font bit is set, so a glyph row is drawn
+// without testing single bits.
+static BIT_LANES: [[u32; 8]; 256] = bit_lanes();
+
+/// Writes 8 pixels of a glyph row to `dst`. Without a background only set bits are written.
+#[inline(always)]
+fn write_glyph_row(dst: &mut [u8], bits: u8, bytes_per_pixel: usize, fg: u32, bg: Option<u32>) {
+    let lanes = &BIT_LANES[bits as usize];
+
+    match (bytes_per_pixel, bg) {
+        (4, Some(bg)) => {
+            let diff = fg ^ bg;
+
+            for (pixel, lane) in dst[..32].chunks_exact_mut(4).zip(lanes) {
+                pixel.copy_from_slice(&(bg ^ (diff & lane)).to_le_bytes());
+            }
+        }
+        (4, None) => {
+            for (pixel, lane) in dst[..32].chunks_exact_mut(4).zip(lanes) {
+                let old = u32::from_le_bytes([pixel[0], pixel[1], pixel[2], pixel[3]]);
+
+                pixel.copy_from_slice(&((old & !lane) | (fg & lane)).to_le_bytes());
+            }
+        }
+        (_, Some(bg)) => {
+            let diff = fg ^ bg;
+
+            for (pixel, lane) in dst[..24].chunks_exact_mut(3).zip(lanes) {
+                pixel.copy_from_slice(&(bg ^ (diff & lane)).to_le_bytes()[..3]);
+            }
+        }
+        (_, None) => {
+            for (pixel, lane) in dst[..24].chunks_exact_mut(3).zip(lanes) {
+                if *lane != 0 {
+                    pixel.copy_from_slice(&fg.to_le_bytes()[..3]);
+                }
+            }
+        }
+    }
+}
+
 #[derive(Debug)]
 #[repr(C)]
 pub struct PSF {
-    font_data: Vec<u8>,
+    glyphs: Vec<u8>,
     mode: usize,
     height: usize,
 }
@@ -31,11 +94,7 @@ impl PSF {
         let mode = data[2] as usize;
         let height = data[3] as usize;
 
-        Some(Self {
-            font_data: Vec::from(data),
-            mode,
-            height,
-        })
+        Some(Self::expand(data, mode, height))
     }
 
     pub fn from_data(data: &[u8]) -> Option<Self> {
@@ -46,11 +105,7 @@ impl PSF {
             return None;
         }
 
-        Some(Self {
-            font_data: Vec::from(data),
-            mode,
-            height,
-        })
+        Some(Self::expand(data, mode, height))
     }
 
     pub fn from_data_vec(data: Vec<u8>) -> Option<Self> {
@@ -61,11 +116,24 @@ impl PSF {
             return None;
         }
 
-        Some(Self {
-            font_data: data,
+        Some(Self::expand(&data, mode, height))
+    }
+
+    /// Copies the glyph table out of the file, one 8-pixel row mask per byte, with glyphs
+    /// missing from a truncated file left blank, so drawing never has to check the file again.
+    fn expand(data: &[u8], mode: usize, height: usize) -> Self {
+        let count = if mode == 0 || mode == 2 { 256 } else { 512 };
+        let table = data.get(4..).unwrap_or(&[]);
+        let length = table.len().min(count * height);
+
+        let mut glyphs = vec![0u8; count * height];
+        glyphs[..length].copy_from_slice(&table[..length]);
+
+        Self {
+            glyphs,
             mode,
             height,
-        })
+        }
     }
 
     pub fn from_file(path: &str) -> Option<Self> {
@@ -81,6 +149,25 @@ impl PSF {
         Self::from_data_vec(data)
     }
 
+    pub fn height(&self) -> usize {
+        self.height
+    }
+
+    /// Number of glyphs in the font: 512 in modes 1 and 3, 256 otherwise.
+    pub fn glyph_count(&self) -> usize {
+        self.glyphs.len() / self.height.max(1)
+    }
+
+    /// Glyph index for a character code (two UTF-8 bytes for Cyrillic).
+    pub fn glyph_index(c: u16) -> u16 {
+        Self::psf1_rupatch(c)
+    }
+
+    /// Bitmap of a glyph, one byte per row, most significant bit on the left.
+    pub fn glyph(&self, index: u16) -> Option<&[u8]> {
+        self.get_glyph(index)
+    }
+
     fn psf1_rupatch(c: u16) -> u16 {
         let hi: u8 = (c >> 8) as u8;
         let lo: u8 = (c & 0xff) as u8;
@@ -112,13 +199,50 @@ impl PSF {
     }
 
     fn get_glyph(&self, ch: u16) -> Option<&[u8]> {
-        if (ch > 511) || (ch > 255 && (self.mode == 0 || self.mode == 2)) {
-            return None;
+        let offset = ch as usize * self.height;
+
+        self.glyphs.get(offset..offset + self.height)
+    }
+
+    /// Draws a glyph into `target`, which starts at its top left pixel and has rows of `pitch`
+    /// bytes, a whole row at a time. Rows past the end of `target` are cut off. `bpp` is 24 or
+    /// 32. Without `bg` only the glyph pixels are written. Returns false when the font has no such glyph or `bpp` is
+    /// not supported.
+    pub fn draw_glyph_into(
+        &self,
+        c: u16,
+        target: &mut [u8],
+        pitch: usize,
+        bpp: usize,
+        fg: u32,
+        bg: Option<u32>,
+    ) -> bool {
+        let Some(glyph) = self.get_glyph(Self::psf1_rupatch(c)) else {
+            return false;
+        };
+
+        if bpp != 24 && bpp != 32 {
+            return false;
         }
 
-        let offset = 4 + ch as usize * self.height;
+        let bytes_per_pixel = bpp >> 3;
+        let row_bytes = 8 * bytes_per_pixel;
+
+        for (y, &bits) in glyph.iter().enumerate() {
+            if bits == 0 && bg.is_none() {
+                continue;
+            }
+
+            let offset = y * pitch;
+
+            if offset + row_bytes > target.len() {
+                break;
+            }
+
+            write_glyph_row(&mut target[offset..offset + row_bytes], bits, bytes_per_pixel, fg, bg);
+        }
 
-        Some(&self.font_data[offset..offset + self.height])
+        true
     }
 
     pub fn draw_character_custom(
@@ -155,6 +279,23 @@ impl PSF {
     #[inline]
     pub fn draw_character(&self, c: u16, pos_x: usize, pos_y: usize, color: u32) {
         // qemu_note!("PSF draw_character: {c} at {pos_x}, {pos_y}");
-        self.draw_character_custom(c, pos_x, pos_y, color, set_pixel);
+        mark_dirty(pos_x, pos_y, 8, self.height);
+
+        let (width, height) = noct_screen::dimensions();
+        let bpp = noct_screen::bits_per_pixel();
+
+        // Clipped characters go pixel by pixel.
+        if pos_x + 8 > width || pos_y + self.height > height {
+            self.draw_character_custom(c, pos_x, pos_y, color, write_pixel);
+            return;
+        }
+
+        let pitch = noct_screen::pitch();
+        let offset = pos_y * pitch + pos_x * (bpp >> 3);
+        let target = &mut noct_screen::back_framebuffer_mut()[offset..];
+
+        if !self.draw_glyph_into(c, target, pitch, bpp, color, None) {
+            self.draw_character_custom(c, pos_x, pos_y, color, write_pixel);
+        }
     }
 }
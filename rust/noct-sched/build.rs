@@ -7,6 +7,7 @@ fn main() {
 
     let mut builder = bindgen::Builder::default()
         .header("../../kernel/include/sys/scheduler/scheduler.h")
+        .header("../../kernel/include/sys/scheduler/workqueue.h")
         .clang_arg("-I../../kernel/include/")
         .parse_callbacks(Box::new(bindgen::CargoCallbacks::new()))
         .use_core()
@@ -0,0 +1,416 @@
+//! Cooperative `async` executor running on kernel threads.
+//!
+//! Tasks are polled only after they were woken. When nothing is ready, the executor
+//! thread blocks in `sched_wait` until a waker (which may be called from an IRQ
+//! handler) or the nearest timer wakes it, so waiting tasks take no CPU time.
+
+use alloc::{boxed::Box, collections::VecDeque, sync::Arc, task::Wake, vec::Vec};
+use core::{
+    cell::UnsafeCell,
+    future::Future,
+    pin::Pin,
+    sync::atomic::{AtomicBool, AtomicPtr, AtomicUsize, Ordering},
+    task::{Context, Poll, Waker},
+};
+
+use crate::sync::{IrqMutex, WaitQueue, irq_restore, irq_save};
+use crate::{
+    BoxedFnOnce, SCHED_MAX_IDLE_TICKS, WorkPriority, current_thread, sched_wait, thread_t,
+    thread_wake,
+};
+
+unsafe extern "C" {
+    fn getTicks() -> usize;
+    fn getFrequency() -> usize;
+}
+
+type BoxedFuture = Pin<Box<dyn Future<Output = ()> + Send>>;
+
+struct Shared {
+    ready: IrqMutex<VecDeque<Arc<Task>>>,
+    /// Thread that runs the executor (null until it starts).
+    thread: AtomicPtr<thread_t>,
+    /// Spawned tasks that are not finished yet.
+    tasks: AtomicUsize,
+    /// The future passed to `block_on` has to be polled.
+    main_woken: AtomicBool,
+}
+
+impl Shared {
+    fn notify(&self) {
+        unsafe { thread_wake(self.thread.load(Ordering::Acquire)) };
+    }
+}
+
+struct Task {
+    /// Only the executor thread touches it.
+    future: UnsafeCell<Option<BoxedFuture>>,
+    queued: AtomicBool,
+    shared: Arc<Shared>,
+}
+
+unsafe impl Send for Task {}
+unsafe impl Sync for Task {}
+
+impl Wake for Task {
+    fn wake(self: Arc<Self>) {
+        self.wake_by_ref();
+    }
+
+    fn wake_by_ref(self: &Arc<Self>) {
+        if !self.queued.swap(true, Ordering::AcqRel) {
+            self.shared.ready.with(|queue| queue.push_back(self.clone()));
+            self.shared.notify();
+        }
+    }
+}
+
+struct MainWaker {
+    shared: Arc<Shared>,
+}
+
+impl Wake for MainWaker {
+    fn wake(self: Arc<Self>) {
+        self.wake_by_ref();
+    }
+
+    fn wake_by_ref(self: &Arc<Self>) {
+        self.shared.main_woken.store(true, Ordering::Release);
+        self.shared.notify();
+    }
+}
+
+/// Pending timers of all executors: `(deadline tick, waker)`.
+static TIMERS: IrqMutex<Vec<(usize, Waker)>> = IrqMutex::new(Vec::new());
+
+#[inline]
+fn now() -> usize {
+    unsafe { getTicks() }
+}
+
+/// Wakes expired timers and returns the nearest deadline left.
+fn fire_timers() -> Option<usize> {
+    let now = now();
+
+    let (expired, nearest) = TIMERS.with(|timers| {
+        let expired: Vec<Waker> = timers
+            .extract_if(.., |(deadline, _)| *deadline <= now)
+            .map(|(_, waker)| waker)
+            .collect();
+
+        (expired, timers.iter().map(|(deadline, _)| *deadline).min())
+    });
+
+    for waker in expired {
+        waker.wake();
+    }
+
+    nearest
+}
+
+/// Future that completes after the given tick.
+pub struct Sleep {
+    deadline: usize,
+}
+
+impl Future for Sleep {
+    type Output = ();
+
+    fn poll(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<()> {
+        if now() >= self.deadline {
+            return Poll::Ready(());
+        }
+
+        let deadline = self.deadline;
+
+        TIMERS.with(|timers| {
+            if !timers
+                .iter()
+                .any(|(x, waker)| *x == deadline && waker.will_wake(cx.waker()))
+            {
+                timers.push((deadline, cx.waker().clone()));
+            }
+        });
+
+        Poll::Pending
+    }
+}
+
+pub fn sleep_ticks(ticks: usize) -> Sleep {
+    Sleep {
+        deadline: now() + ticks,
+    }
+}
+
+pub fn sleep_ms(milliseconds: usize) -> Sleep {
+    let frequency = unsafe { getFrequency() };
+
+    sleep_ticks((milliseconds * frequency).div_ceil(1000))
+}
+
+/// Handle for spawning tasks onto an executor from any thread.
+#[derive(Clone)]
+pub struct Spawner {
+    shared: Arc<Shared>,
+}
+
+impl Spawner {
+    pub fn spawn(&self, future: impl Future<Output = ()> + Send + 'static) {
+        let task = Arc::new(Task {
+            future: UnsafeCell::new(Some(Box::pin(future))),
+            queued: AtomicBool::new(false),
+            shared: self.shared.clone(),
+        });
+
+        let tasks = self.shared.tasks.fetch_add(1, Ordering::AcqRel) + 1;
+
+        // Keep room for every task, so wakers called from IRQ handlers never allocate.
+        self.shared.ready.with(|queue| {
+            if tasks > queue.len() {
+                queue.reserve(tasks - queue.len());
+            }
+        });
+
+        task.wake_by_ref();
+    }
+}
+
+/// Single-threaded executor. It runs on the thread that calls [`Executor::block_on`].
+pub struct Executor {
+    shared: Arc<Shared>,
+}
+
+impl Default for Executor {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl Executor {
+    pub fn new() -> Self {
+        Self {
+            shared: Arc::new(Shared {
+                ready: IrqMutex::new(VecDeque::new()),
+                thread: AtomicPtr::new(core::ptr::null_mut()),
+                tasks: AtomicUsize::new(0),
+                main_woken: AtomicBool::new(false),
+            }),
+        }
+    }
+
+    pub fn spawner(&self) -> Spawner {
+        Spawner {
+            shared: self.shared.clone(),
+        }
+    }
+
+    pub fn spawn(&self, future: impl Future<Output = ()> + Send + 'static) {
+        self.spawner().spawn(future);
+    }
+
+    /// Runs `future` to completion, polling spawned tasks meanwhile.
+    pub fn block_on<F: Future>(&self, future: F) -> F::Output {
+        let mut future = core::pin::pin!(future);
+        let waker = Waker::from(Arc::new(MainWaker {
+            shared: self.shared.clone(),
+        }));
+
+        self.shared.thread.store(current_thread(), Ordering::Release);
+        self.shared.main_woken.store(true, Ordering::Release);
+
+        let result = loop {
+            let nearest = fire_timers();
+
+            if self.shared.main_woken.swap(false, Ordering::AcqRel) {
+                if let Poll::Ready(result) = future.as_mut().poll(&mut Context::from_waker(&waker)) {
+                    break result;
+                }
+            }
+
+            if !self.run_ready() {
+                self.idle(nearest);
+            }
+        };
+
+        self.shared.thread.store(core::ptr::null_mut(), Ordering::Release);
+
+        result
+    }
+
+    /// Runs until every spawned task is finished.
+    pub fn run(&self) {
+        let shared = self.shared.clone();
+
+        self.block_on(core::future::poll_fn(move |_| {
+            if shared.tasks.load(Ordering::Acquire) == 0 {
+                Poll::Ready(())
+            } else {
+                Poll::Pending
+            }
+        }));
+    }
+
+    /// Polls woken tasks. Returns `false` if there were none.
+    fn run_ready(&self) -> bool {
+        let mut ran = false;
+
+        while let Some(task) = self.shared.ready.with(|queue| queue.pop_front()) {
+            ran = true;
+
+            // Cleared before polling, so the task can be woken again while it runs.
+            task.queued.store(false, Ordering::Release);
+
+            let slot = unsafe { &mut *task.future.get() };
+
+            if let Some(future) = slot.as_mut() {
+                let waker = Waker::from(task.clone());
+
+                if future.as_mut().poll(&mut Context::from_waker(&waker)).is_ready() {
+                    *slot = None;
+
+                    if self.shared.tasks.fetch_sub(1, Ordering::AcqRel) == 1 {
+                        self.shared.main_woken.store(true, Ordering::Release);
+                    }
+                }
+            }
+
+            if self.shared.main_woken.load(Ordering::Acquire) {
+                break;
+            }
+        }
+
+        ran
+    }
+
+    /// Blocks the thread until something is woken or the nearest timer expires.
+    fn idle(&self, nearest: Option<usize>) {
+        let max = SCHED_MAX_IDLE_TICKS as usize;
+        let ticks = match nearest {
+            Some(deadline) => deadline.saturating_sub(now()).clamp(1, max),
+            None => max,
+        };
+
+        // Checked with interrupts disabled, so a wakeup from IRQ can't be lost.
+        let flags = irq_save();
+
+        let nothing_to_do = !self.shared.main_woken.load(Ordering::Acquire)
+            && self.shared.ready.with(|queue| queue.is_empty());
+
+        if nothing_to_do {
+            // Returns with interrupts enabled.
+            unsafe { sched_wait(ticks as _) };
+        } else {
+            irq_restore(flags);
+        }
+    }
+}
+
+pub enum Either<A, B> {
+    Left(A),
+    Right(B),
+}
+
+/// Waits for the first of two futures to complete. The other one is dropped.
+pub async fn select<A: Future, B: Future>(a: A, b: B) -> Either<A::Output, B::Output> {
+    let mut a = core::pin::pin!(a);
+    let mut b = core::pin::pin!(b);
+
+    core::future::poll_fn(|cx| {
+        if let Poll::Ready(result) = a.as_mut().poll(cx) {
+            return Poll::Ready(Either::Left(result));
+        }
+
+        if let Poll::Ready(result) = b.as_mut().poll(cx) {
+            return Poll::Ready(Either::Right(result));
+        }
+
+        Poll::Pending
+    })
+    .await
+}
+
+/// Runs `future` to completion on the current thread.
+pub fn block_on<F: Future>(future: F) -> F::Output {
+    Executor::new().block_on(future)
+}
+
+/// Starts a kernel thread that runs an executor forever and returns its spawner.
+pub fn spawn_executor_thread() -> Spawner {
+    let executor = Executor::new();
+    let spawner = executor.spawner();
+
+    crate::spawn(move || executor.block_on(core::future::pending::<()>()));
+
+    spawner
+}
+
+static GLOBAL_SPAWNER: IrqMutex<Option<Spawner>> = IrqMutex::new(None);
+
+/// Spawns a task onto the shared kernel executor thread (started on first use).
+pub fn spawn(future: impl Future<Output = ()> + Send + 'static) {
+    let spawner = match GLOBAL_SPAWNER.with(|x| x.clone()) {
+        Some(spawner) => spawner,
+        None => {
+            let spawner = spawn_executor_thread();
+
+            GLOBAL_SPAWNER.with(|x| x.get_or_insert(spawner).clone())
+        }
+    };
+
+    spawner.spawn(future);
+}
+
+struct OffloadState<T> {
+    result: IrqMutex<Option<T>>,
+    waiters: WaitQueue,
+}
+
+/// Result of a blocking call that runs on the kernel work queue.
+pub struct Offload<T> {
+    state: Arc<OffloadState<T>>,
+}
+
+/// Runs a blocking closure on the kernel work queue and returns a future of its result.
+///
+/// If the work pool is exhausted, the closure runs right away on the calling thread.
+pub fn offload<T: Send + 'static>(
+    f: impl FnOnce() -> T + Send + 'static,
+    priority: WorkPriority,
+) -> Offload<T> {
+    let state = Arc::new(OffloadState {
+        result: IrqMutex::new(None),
+        waiters: WaitQueue::new(),
+    });
+
+    let job_state = state.clone();
+    let job: BoxedFnOnce = Box::new(move || {
+        let result = f();
+
+        job_state.result.with(|x| *x = Some(result));
+        job_state.waiters.wake_all();
+    });
+
+    if let Err(job) = crate::submit_boxed(job, priority) {
+        job();
+    }
+
+    Offload { state }
+}
+
+impl<T: Send> Future for Offload<T> {
+    type Output = T;
+
+    fn poll(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<T> {
+        if let Some(result) = self.state.result.with(Option::take) {
+            return Poll::Ready(result);
+        }
+
+        self.state.waiters.register(cx.waker());
+
+        // It could have finished before the waker was registered.
+        match self.state.result.with(Option::take) {
+            Some(result) => Poll::Ready(result),
+            None => Poll::Pending,
+        }
+    }
+}
@@ -12,6 +12,9 @@ extern crate alloc;
 
 include!(concat!(env!("OUT_DIR"), "/bindings.rs"));
 
+pub mod executor;
+pub mod sync;
+
 impl process_t {
     pub fn cwd(&self) -> String {
         let c_str = unsafe { CStr::from_ptr(self.cwd as *const _) };
@@ -68,3 +71,137 @@ pub fn spawn(f: impl FnOnce() + Send + 'static) -> *mut thread_t {
         )
     }
 }
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum SchedClass {
+    Realtime,
+    Interactive,
+    Batch,
+}
+
+impl SchedClass {
+    pub fn from_raw(raw: u32) -> Option<Self> {
+        match raw {
+            SCHED_CLASS_REALTIME => Some(Self::Realtime),
+            SCHED_CLASS_INTERACTIVE => Some(Self::Interactive),
+            SCHED_CLASS_BATCH => Some(Self::Batch),
+            _ => None,
+        }
+    }
+
+    pub fn as_raw(&self) -> u32 {
+        match self {
+            Self::Realtime => SCHED_CLASS_REALTIME,
+            Self::Interactive => SCHED_CLASS_INTERACTIVE,
+            Self::Batch => SCHED_CLASS_BATCH,
+        }
+    }
+
+    pub fn name(&self) -> &'static str {
+        match self {
+            Self::Realtime => "rt",
+            Self::Interactive => "int",
+            Self::Batch => "batch",
+        }
+    }
+}
+
+#[inline]
+pub fn current_thread() -> *mut thread_t {
+    unsafe { get_current_thread() }
+}
+
+/// Changes scheduling class and priority (higher runs first) of a thread.
+pub fn set_sched_class(thread: *mut thread_t, class: SchedClass, priority: u32) {
+    unsafe { thread_set_sched_class(thread, class.as_raw(), priority) };
+}
+
+/// Returns `(class, priority)` of a thread.
+pub fn sched_class(thread: *mut thread_t) -> (SchedClass, u32) {
+    let thread = unsafe { &*thread };
+
+    (
+        SchedClass::from_raw(thread.sched_class).unwrap_or(SchedClass::Interactive),
+        thread.priority,
+    )
+}
+
+/// Takes a snapshot of scheduler statistics of all threads.
+pub fn threads_info() -> Vec<thread_info_t> {
+    let mut capacity = 16;
+
+    loop {
+        let mut infos: Vec<thread_info_t> = Vec::with_capacity(capacity);
+
+        let count = unsafe { sched_get_thread_info(infos.as_mut_ptr(), capacity as _) } as usize;
+
+        if count <= capacity {
+            unsafe { infos.set_len(count) };
+
+            return infos;
+        }
+
+        // Threads were created in the meantime, try again with bigger buffer.
+        capacity = count + 8;
+    }
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum WorkPriority {
+    High,
+    Normal,
+    Low,
+}
+
+impl WorkPriority {
+    pub const ALL: [WorkPriority; 3] = [Self::High, Self::Normal, Self::Low];
+
+    pub fn as_raw(&self) -> u32 {
+        match self {
+            Self::High => WORK_PRIORITY_HIGH,
+            Self::Normal => WORK_PRIORITY_NORMAL,
+            Self::Low => WORK_PRIORITY_LOW,
+        }
+    }
+
+    pub fn name(&self) -> &'static str {
+        match self {
+            Self::High => "high",
+            Self::Normal => "normal",
+            Self::Low => "low",
+        }
+    }
+}
+
+extern "C" fn work_trampoline(f: *mut c_void) {
+    trampoline(f as *mut ());
+}
+
+fn submit_boxed(f: BoxedFnOnce, priority: WorkPriority) -> Result<(), BoxedFnOnce> {
+    let raw = Box::into_raw(Box::new(f));
+
+    let queued =
+        unsafe { workqueue_submit(Some(work_trampoline), raw as *mut c_void, priority.as_raw()) };
+
+    if queued {
+        Ok(())
+    } else {
+        Err(*unsafe { Box::from_raw(raw) })
+    }
+}
+
+/// Runs a closure on the kernel work queue of given priority.
+///
+/// Returns `false` (and drops the closure) if the work pool is exhausted.
+pub fn submit(f: impl FnOnce() + Send + 'static, priority: WorkPriority) -> bool {
+    submit_boxed(Box::new(f), priority).is_ok()
+}
+
+/// Takes a snapshot of work queue statistics.
+pub fn workqueue_stats() -> workqueue_stats_t {
+    let mut stats: workqueue_stats_t = unsafe { core::mem::zeroed() };
+
+    unsafe { workqueue_get_stats(&mut stats) };
+
+    stats
+}
@@ -0,0 +1,140 @@
+//! Primitives for sharing state with interrupt handlers.
+
+use core::cell::UnsafeCell;
+use core::task::Waker;
+
+/// Disables interrupts and returns previous flags (`irq_save` from `sys/sync.h`).
+#[inline(always)]
+pub fn irq_save() -> usize {
+    #[cfg(any(target_arch = "x86", target_arch = "x86_64"))]
+    {
+        let flags: usize;
+
+        unsafe { core::arch::asm!("pushf", "pop {}", "cli", out(reg) flags) };
+
+        flags
+    }
+
+    #[cfg(not(any(target_arch = "x86", target_arch = "x86_64")))]
+    {
+        0
+    }
+}
+
+/// Restores flags saved by [`irq_save`].
+#[inline(always)]
+pub fn irq_restore(flags: usize) {
+    #[cfg(any(target_arch = "x86", target_arch = "x86_64"))]
+    unsafe {
+        core::arch::asm!("push {}", "popf", in(reg) flags)
+    };
+
+    #[cfg(not(any(target_arch = "x86", target_arch = "x86_64")))]
+    let _ = flags;
+}
+
+/// A value guarded by disabled interrupts.
+///
+/// The kernel runs on one CPU, so this excludes both IRQ handlers and preemption.
+/// `with` must not be nested for the same mutex.
+pub struct IrqMutex<T> {
+    inner: UnsafeCell<T>,
+}
+
+unsafe impl<T: Send> Sync for IrqMutex<T> {}
+unsafe impl<T: Send> Send for IrqMutex<T> {}
+
+impl<T> IrqMutex<T> {
+    pub const fn new(value: T) -> Self {
+        Self {
+            inner: UnsafeCell::new(value),
+        }
+    }
+
+    pub fn with<R>(&self, f: impl FnOnce(&mut T) -> R) -> R {
+        let flags = irq_save();
+        let result = f(unsafe { &mut *self.inner.get() });
+        irq_restore(flags);
+
+        result
+    }
+}
+
+/// Tasks one [`WaitQueue`] holds at once.
+pub const WAIT_QUEUE_SLOTS: usize = 16;
+
+struct WaitSlot {
+    waker: Option<Waker>,
+    /// Registered and not woken yet.
+    armed: bool,
+}
+
+/// List of tasks waiting for an event.
+///
+/// Futures register their waker before checking the condition again, and event
+/// sources (including IRQ handlers) call [`WaitQueue::wake_all`].
+///
+/// Wakers live in fixed slots, so waking neither allocates nor frees: dropping the last
+/// reference to a task would run `kfree` in the IRQ handler. A woken waker stays in its
+/// slot until `register` reuses the slot, and is dropped there, in task context.
+pub struct WaitQueue {
+    slots: IrqMutex<[WaitSlot; WAIT_QUEUE_SLOTS]>,
+}
+
+impl Default for WaitQueue {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl WaitQueue {
+    pub const fn new() -> Self {
+        Self {
+            slots: IrqMutex::new(
+                [const {
+                    WaitSlot {
+                        waker: None,
+                        armed: false,
+                    }
+                }; WAIT_QUEUE_SLOTS],
+            ),
+        }
+    }
+
+    pub fn register(&self, waker: &Waker) {
+        let registered = self.slots.with(|slots| {
+            if let Some(slot) = slots
+                .iter_mut()
+                .find(|slot| slot.waker.as_ref().is_some_and(|x| x.will_wake(waker)))
+            {
+                slot.armed = true;
+                return Some(None);
+            }
+
+            let slot = slots.iter_mut().find(|slot| !slot.armed)?;
+
+            slot.armed = true;
+
+            Some(slot.waker.replace(waker.clone()))
+        });
+
+        match registered {
+            // The waker it replaced is dropped here, outside of the IRQ lock.
+            Some(stale) => drop(stale),
+            // Every slot is taken: have the task polled again rather than lose the event.
+            None => waker.wake_by_ref(),
+        }
+    }
+
+    pub fn wake_all(&self) {
+        self.slots.with(|slots| {
+            for slot in slots.iter_mut().filter(|slot| slot.armed) {
+                slot.armed = false;
+
+                if let Some(waker) = &slot.waker {
+                    waker.wake_by_ref();
+                }
+            }
+        });
+    }
+}
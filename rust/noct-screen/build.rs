@@ -5,6 +5,7 @@ use bindgen::RustTarget;
 fn main() {
     let bindings = bindgen::Builder::default()
         .header("../../kernel/include/io/screen.h")
+        .header("../../kernel/include/gui/compositor.h")
         .clang_arg("-I../../kernel/include/")
         .parse_callbacks(Box::new(bindgen::CargoCallbacks::new()))
         .use_core()
@@ -5,16 +5,43 @@
 
 include!(concat!(env!("OUT_DIR"), "/bindings.rs"));
 
+pub mod window;
+
 pub fn fill(color: u32) {
     let (w, h) = dimensions();
 
-    for y in 0..h {
-        for x in 0..w {
-            set_pixel(x, y, color);
-        }
+    fill_rect(0, 0, w, h, color);
+}
+
+/// Fills a rectangle, clipped to the screen.
+pub fn fill_rect(x: isize, y: isize, width: usize, height: usize, color: u32) {
+    unsafe { screen_fill_rect(x as _, y as _, width as _, height as _, color) };
+}
+
+/// Moves a rectangle within the back buffer, overlapping areas included (scrolling).
+pub fn copy_rect(dst_x: isize, dst_y: isize, src_x: isize, src_y: isize, width: usize, height: usize) {
+    unsafe {
+        screen_copy_rect(dst_x as _, dst_y as _, src_x as _, src_y as _, width as _, height as _)
+    };
+}
+
+/// Blends a row of 0xAARRGGBB pixels over the screen.
+pub fn blend_span(x: isize, y: isize, argb: &[u32]) {
+    unsafe { screen_blend_span(x as _, y as _, argb.as_ptr(), argb.len() as _) };
+}
+
+/// Draws a 0x00RRGGBB image of `width` pixels per row, converted to the screen format.
+pub fn draw_image(x: isize, y: isize, width: usize, pixels: &[u32]) {
+    if width == 0 {
+        return;
     }
+
+    let height = pixels.len() / width;
+
+    unsafe { screen_draw_image(x as _, y as _, width as _, height as _, pixels.as_ptr()) };
 }
 
+/// Draws a pixel and marks it for the next `flush`.
 pub fn set_pixel(x: usize, y: usize, color: u32) {
     let (w, h) = dimensions();
 
@@ -22,6 +49,19 @@ pub fn set_pixel(x: usize, y: usize, color: u32) {
         return;
     }
 
+    write_pixel(x, y, color);
+
+    unsafe { screen_mark_dirty(x as _, y as _, 1, 1) };
+}
+
+/// Draws a pixel without marking it, the caller marks the whole area with `mark_dirty`.
+pub fn write_pixel(x: usize, y: usize, color: u32) {
+    let (w, h) = dimensions();
+
+    if x >= w || y >= h {
+        return;
+    }
+
     let offset = (x * (bits_per_pixel() >> 3)) + y * pitch();
     let pixels = &mut back_framebuffer_mut()[offset..];
 
@@ -82,9 +122,43 @@ pub fn buf_size() -> usize {
 }
 
 #[inline]
-pub fn flush() {
-    let backfb = back_framebuffer();
-    let real_screen = framebuffer_mut();
+pub fn mark_dirty(x: usize, y: usize, width: usize, height: usize) {
+    unsafe { screen_mark_dirty(x as _, y as _, width as _, height as _) };
+}
+
+/// Whether flushes fill a hidden video memory page and show it by flipping.
+#[inline]
+pub fn page_flipping() -> bool {
+    unsafe { screen_page_flipping() }
+}
 
-    real_screen.copy_from_slice(backfb);
+/// Switches between page flipping and copying to video memory, returns false when the
+/// requested mode is not available.
+pub fn set_page_flipping(enable: bool) -> bool {
+    unsafe { screen_set_page_flipping(enable) }
+}
+
+/// Modes the screen can be switched to, empty without a modesetting driver.
+pub fn modes() -> impl Iterator<Item = screen_mode_t> {
+    (0..unsafe { screen_mode_count() }).filter_map(|index| {
+        let mut mode = screen_mode_t {
+            width: 0,
+            height: 0,
+            bpp: 0,
+        };
+
+        unsafe { screen_mode_get(index, &mut mode) }.then_some(mode)
+    })
+}
+
+/// Switches the screen mode. The back buffer comes back cleared, so everything has to be
+/// redrawn; returns false when the mode is not available.
+pub fn set_mode(width: usize, height: usize, bpp: usize) -> bool {
+    unsafe { screen_set_mode(width as _, height as _, bpp as _) }
+}
+
+/// Copies everything drawn since the last flush to the screen.
+#[inline]
+pub fn flush() {
+    unsafe { screen_update() };
 }
@@ -0,0 +1,86 @@
+use crate::{
+    compositor_show_cursor, window_create, window_damage, window_destroy, window_move,
+    window_present, window_raise, window_t,
+};
+
+/// A window of the kernel compositor: an off-screen 0x00RRGGBB buffer shown above the
+/// desktop and the windows created before it.
+pub struct Window {
+    raw: *mut window_t,
+}
+
+impl Window {
+    /// Creates a window above the others. It shows up on the first `damage` or `present`,
+    /// so its contents can be drawn first.
+    pub fn new(x: isize, y: isize, width: usize, height: usize) -> Option<Self> {
+        let raw = unsafe { window_create(x as _, y as _, width as _, height as _) };
+
+        (!raw.is_null()).then_some(Self { raw })
+    }
+
+    #[inline]
+    pub fn width(&self) -> usize {
+        unsafe { (*self.raw).surface.width as usize }
+    }
+
+    #[inline]
+    pub fn height(&self) -> usize {
+        unsafe { (*self.raw).surface.height as usize }
+    }
+
+    #[inline]
+    pub fn position(&self) -> (isize, isize) {
+        unsafe { ((*self.raw).x as isize, (*self.raw).y as isize) }
+    }
+
+    /// Pixels row by row, `width()` per row.
+    #[inline]
+    pub fn pixels(&self) -> &[u32] {
+        unsafe {
+            core::slice::from_raw_parts(
+                (*self.raw).surface.pixels as *const u32,
+                self.width() * self.height(),
+            )
+        }
+    }
+
+    #[inline]
+    pub fn pixels_mut(&mut self) -> &mut [u32] {
+        unsafe {
+            core::slice::from_raw_parts_mut(
+                (*self.raw).surface.pixels as *mut u32,
+                self.width() * self.height(),
+            )
+        }
+    }
+
+    /// Marks a part of the window for the next compositor frame.
+    pub fn damage(&self, x: usize, y: usize, width: usize, height: usize) {
+        unsafe { window_damage(self.raw, x as _, y as _, width as _, height as _) };
+    }
+
+    /// Puts the whole window on the screen right away.
+    pub fn present(&self) {
+        unsafe { window_present(self.raw) };
+    }
+
+    /// Moves the window, only the uncovered screen and the window itself are redrawn.
+    pub fn move_to(&self, x: isize, y: isize) {
+        unsafe { window_move(self.raw, x as _, y as _) };
+    }
+
+    pub fn raise(&self) {
+        unsafe { window_raise(self.raw) };
+    }
+}
+
+impl Drop for Window {
+    fn drop(&mut self) {
+        unsafe { window_destroy(self.raw) };
+    }
+}
+
+/// Shows or hides the mouse cursor drawn by the compositor.
+pub fn show_cursor(show: bool) {
+    unsafe { compositor_show_cursor(show) };
+}
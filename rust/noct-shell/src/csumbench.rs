@@ -0,0 +1,67 @@
+use noct_tty::println;
+
+use super::ShellContext;
+
+pub static CSUMBENCH_COMMAND_ENTRY: crate::ShellCommandEntry =
+    ("csumbench", csumbench, Some("Measures Internet checksum speed"));
+
+// Small packet, minimal IPv4 MTU, Ethernet MTU, a page and a large socket write.
+const SIZES: [usize; 5] = [64, 576, 1500, 4096, 65536];
+
+const DEFAULT_BYTES: usize = 16 * 1024 * 1024;
+
+pub fn csumbench(_context: &mut ShellContext, args: &[&str]) -> Result<(), usize> {
+    if args.contains(&"-h") {
+        println!("csumbench - Measures Internet checksum speed.\n");
+        println!("Usage: csumbench [megabytes per run]");
+        println!("\nWORDS is the old 16-bit loop, WIDE the current one, MEMCPY+SUM copies and");
+        println!("sums in two passes, COPY does both in one pass. Numbers are MB/s.");
+
+        return Ok(());
+    }
+
+    let total = match args.first() {
+        Some(arg) => arg.parse::<usize>().map_err(|_| 1usize)? * 1024 * 1024,
+        None => DEFAULT_BYTES,
+    };
+
+    println!(
+        "{:>8} {:>10} {:>10} {:>12} {:>10}",
+        "BYTES", "WORDS", "WIDE", "MEMCPY+SUM", "COPY"
+    );
+
+    let mut sse2 = false;
+
+    for length in SIZES {
+        let rounds = (total / length).max(1);
+
+        let Some(bench) = noct_net::benchmark_checksum(length, rounds) else {
+            println!("csumbench: results differ on {} bytes", length);
+            return Err(2);
+        };
+
+        sse2 = bench.sse2;
+
+        // Bytes per millisecond are kilobytes per second, divided once more for megabytes.
+        let speed = |cycles: u64| {
+            if cycles == 0 {
+                0
+            } else {
+                (length * rounds) as u64 * bench.tsc_per_ms / cycles / 1000
+            }
+        };
+
+        println!(
+            "{:>8} {:>10} {:>10} {:>12} {:>10}",
+            length,
+            speed(bench.reference_tsc),
+            speed(bench.partial_tsc),
+            speed(bench.memcpy_tsc),
+            speed(bench.copy_tsc)
+        );
+    }
+
+    println!("\nSSE2: {}", if sse2 { "yes" } else { "no" });
+
+    Ok(())
+}
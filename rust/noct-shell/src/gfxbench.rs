@@ -0,0 +1,36 @@
+use core::ptr;
+
+use noct_tty::println;
+
+use super::ShellContext;
+
+pub static GFXBENCH_COMMAND_ENTRY: crate::ShellCommandEntry =
+    ("gfxbench", gfxbench, Some("Benchmarks screen drawing"));
+
+unsafe extern "C" {
+    #[link_name = "gfxbench"]
+    fn gfxbench_run(argc: u32, argv: *const *const u8) -> u32;
+    fn gfxbench_primitives();
+}
+
+pub fn gfxbench(_context: &mut ShellContext, args: &[&str]) -> Result<(), usize> {
+    match args.first() {
+        None => {
+            // Runs until ESC is pressed.
+            unsafe { gfxbench_run(0, ptr::null()) };
+            Ok(())
+        }
+        Some(&"prims") => {
+            unsafe { gfxbench_primitives() };
+            Ok(())
+        }
+        Some(&"-h") => {
+            println!("gfxbench - Benchmarks screen drawing.\n");
+            println!("Usage: gfxbench         Redraws the screen, shows FPS and bytes flushed per frame (ESC to quit)");
+            println!("       gfxbench prims   Speed of each drawing primitive with every blitter variant");
+
+            Ok(())
+        }
+        Some(_) => Err(1),
+    }
+}
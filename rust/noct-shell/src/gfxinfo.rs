@@ -4,7 +4,108 @@ use super::{ShellCommandEntry, ShellContext};
 
 pub static GFXINFO_COMMAND_ENTRY: ShellCommandEntry = ("gfxinfo", gfxinfo, None);
 
-pub fn gfxinfo(_ctx: &mut ShellContext, _args: &[&str]) -> Result<(), usize> {
+fn flip(args: &[&str]) -> Result<(), usize> {
+    let enable = match args.first() {
+        Some(&"on") => true,
+        Some(&"off") => false,
+        _ => {
+            println!("Usage: gfxinfo flip on|off");
+            return Err(1);
+        }
+    };
+
+    if !noct_screen::set_page_flipping(enable) {
+        println!("gfxinfo: page flipping needs a Bochs/QEMU VBE mode with room for two pages");
+        return Err(2);
+    }
+
+    Ok(())
+}
+
+fn modes() -> Result<(), usize> {
+    let (width, height) = noct_screen::dimensions();
+    let bpp = noct_screen::bits_per_pixel();
+    let mut count = 0;
+
+    for mode in noct_screen::modes() {
+        let current = mode.width as usize == width
+            && mode.height as usize == height
+            && mode.bpp as usize == bpp;
+
+        println!(
+            "{} {}x{}x{}",
+            if current { "*" } else { " " },
+            mode.width,
+            mode.height,
+            mode.bpp
+        );
+
+        count += 1;
+    }
+
+    if count == 0 {
+        println!("gfxinfo: the display adapter has no modesetting driver");
+        return Err(2);
+    }
+
+    Ok(())
+}
+
+fn parse_mode(text: &str) -> Option<(usize, usize, usize)> {
+    let mut parts = text.split('x');
+
+    let width = parts.next()?.parse().ok()?;
+    let height = parts.next()?.parse().ok()?;
+    let bpp = match parts.next() {
+        Some(bpp) => bpp.parse().ok()?,
+        None => 32,
+    };
+
+    parts.next().is_none().then_some((width, height, bpp))
+}
+
+fn mode(args: &[&str]) -> Result<(), usize> {
+    let Some((width, height, bpp)) = args.first().and_then(|text| parse_mode(text)) else {
+        println!("Usage: gfxinfo mode WIDTHxHEIGHT[xBPP]");
+        return Err(1);
+    };
+
+    if !noct_screen::set_mode(width, height, bpp) {
+        println!("gfxinfo: {width}x{height}x{bpp} is not available");
+        return Err(2);
+    }
+
+    noct_tty::c_api::tty_fit_screen();
+
+    println!("Screen mode: {width}x{height}x{bpp}");
+
+    Ok(())
+}
+
+pub fn gfxinfo(_ctx: &mut ShellContext, args: &[&str]) -> Result<(), usize> {
+    if args.contains(&"-h") {
+        println!("gfxinfo - Shows the screen mode.\n");
+        println!("Usage: gfxinfo");
+        println!("       gfxinfo flip on|off");
+        println!("       gfxinfo modes");
+        println!("       gfxinfo mode WIDTHxHEIGHT[xBPP]");
+        println!("\nflip on keeps the back buffer in a hidden video memory page and shows it");
+        println!("at vertical retrace. Programs that keep the back buffer address from env");
+        println!("draw into the wrong page then.");
+        println!("\nmodes lists the modes of the display adapter, the current one marked with *.");
+        println!("mode switches to one of them (32 bits per pixel by default). Programs that draw");
+        println!("to the screen without a window have to be restarted.");
+
+        return Ok(());
+    }
+
+    match args.first() {
+        Some(&"flip") => return flip(&args[1..]),
+        Some(&"modes") => return modes(),
+        Some(&"mode") => return mode(&args[1..]),
+        _ => {}
+    }
+
     let (width, height) = noct_screen::dimensions();
     let pitch = noct_screen::pitch();
     let buffer_size = noct_screen::buf_size();
@@ -19,6 +120,14 @@ pub fn gfxinfo(_ctx: &mut ShellContext, _args: &[&str]) -> Result<(), usize> {
     println!("Framebuffer at: 0x{framebuffer:x}");
     println!("Back framebuffer at: 0x{back_framebuffer:x}");
     println!("Buffer size: {buffer_size} bytes");
+    println!(
+        "Presentation: {}",
+        if noct_screen::page_flipping() {
+            "page flipping at vertical retrace"
+        } else {
+            "copy to video memory"
+        }
+    );
 
     Ok(())
 }
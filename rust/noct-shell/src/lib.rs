@@ -27,22 +27,29 @@ use noct_path::Path;
 pub mod cat;
 pub mod cd;
 pub mod cls;
+pub mod csumbench;
 pub mod datetime;
 pub mod dir;
 pub mod disk_ctl;
 pub mod disks;
 pub mod file;
 pub mod file_ops;
+pub mod gfxbench;
 pub mod gfxinfo;
 pub mod log;
 pub mod mala;
 pub mod meminfo;
 pub mod mtrr;
+pub mod netbench;
+pub mod netdump;
+pub mod netstat;
 pub mod pavi;
 #[cfg(target_arch = "x86")]
 pub mod pci;
 pub mod reboot;
 pub mod sysinfo;
+pub mod top;
+pub mod workq;
 
 pub type ShellCommand<E = usize> = fn(&mut ShellContext, &[&str]) -> Result<(), E>;
 pub type ShellCommandEntry<'a, 'b> = (&'a str, ShellCommand, Option<&'b str>);
@@ -67,6 +74,7 @@ static COMMANDS: &[ShellCommandEntry] = &[
     pavi::PAVI_COMMAND_ENTRY,
     reboot::REBOOT_COMMAND_ENTRY,
     gfxinfo::GFXINFO_COMMAND_ENTRY,
+    gfxbench::GFXBENCH_COMMAND_ENTRY,
     log::LOG_COMMAND_ENTRY,
     file::FILE_COMMAND_ENTRY,
     datetime::DATETIME_COMMAND_ENTRY,
@@ -76,6 +84,12 @@ static COMMANDS: &[ShellCommandEntry] = &[
         Some("New player"),
     ),
     sysinfo::SYSINFO_COMMAND_ENTRY,
+    top::TOP_COMMAND_ENTRY,
+    netdump::NETDUMP_COMMAND_ENTRY,
+    netstat::NETSTAT_COMMAND_ENTRY,
+    netbench::NETBENCH_COMMAND_ENTRY,
+    csumbench::CSUMBENCH_COMMAND_ENTRY,
+    workq::WORKQ_COMMAND_ENTRY,
     ("help", help, Some("Prints help message")),
 ];
 
@@ -0,0 +1,121 @@
+use alloc::format;
+use alloc::string::String;
+use noct_net::BenchResult;
+use noct_tty::println;
+
+use super::ShellContext;
+
+pub static NETBENCH_COMMAND_ENTRY: crate::ShellCommandEntry =
+    ("netbench", netbench, Some("Benchmarks the network stack over loopback"));
+
+const DEFAULT_DATAGRAMS: usize = 20000;
+// Packet rate with the smallest useful datagrams, then with full Ethernet frames.
+const DEFAULT_UDP_SIZES: [usize; 2] = [64, 1472];
+const DEFAULT_TCP_MEGABYTES: usize = 16;
+
+// `value / per` with two decimals.
+fn ratio(value: u64, per: u64) -> String {
+    if per == 0 {
+        return String::from("-");
+    }
+
+    let hundredths = value * 100 / per;
+
+    format!("{}.{:02}", hundredths / 100, hundredths % 100)
+}
+
+fn report(name: &str, packets: usize, result: &BenchResult) {
+    let packets = packets as u64;
+    let counters = result.counters;
+
+    println!(
+        "{:12} {:>10} {:>10} {:>10} {:>10} {:>10} {:>6}",
+        name,
+        if result.elapsed_us == 0 { 0 } else { packets * 1_000_000 / result.elapsed_us },
+        // Bytes per microsecond are megabytes per second.
+        ratio(result.bytes as u64, result.elapsed_us),
+        ratio(counters.allocations as u64, packets),
+        ratio(counters.heap_allocations as u64, packets),
+        ratio(counters.copies as u64, packets),
+        result.lost
+    );
+}
+
+fn header() {
+    println!(
+        "{:12} {:>10} {:>10} {:>10} {:>10} {:>10} {:>6}",
+        "TEST", "PKT/S", "MB/S", "ALLOC/PKT", "HEAP/PKT", "COPY/PKT", "LOST"
+    );
+}
+
+fn run_udp(count: usize, size: usize) -> Result<(), usize> {
+    match noct_net::benchmark_udp(count, size) {
+        Ok(result) => {
+            report(&format!("udp {}", size), result.datagrams, &result);
+            Ok(())
+        }
+        Err(error) => {
+            println!("netbench: UDP test failed with error {}", -error);
+            Err(2)
+        }
+    }
+}
+
+fn run_tcp(megabytes: usize) -> Result<(), usize> {
+    match noct_net::benchmark_tcp(megabytes * 1024 * 1024) {
+        // Every segment counts, ACKs included.
+        Ok(result) => {
+            report(&format!("tcp {}M", megabytes), result.frames, &result);
+            Ok(())
+        }
+        Err(error) => {
+            println!("netbench: TCP test failed with error {}", -error);
+            Err(2)
+        }
+    }
+}
+
+pub fn netbench(_context: &mut ShellContext, args: &[&str]) -> Result<(), usize> {
+    if args.contains(&"-h") {
+        println!("netbench - Benchmarks the network stack over the loopback card.\n");
+        println!("Usage: netbench");
+        println!("       netbench udp [datagrams] [size]");
+        println!("       netbench tcp [megabytes]");
+        println!("\nUDP packets are datagrams, TCP packets are all segments, ACKs included.");
+        println!("ALLOC/PKT counts buffer and queue allocations, HEAP/PKT those that hit the heap.");
+        println!("Other network traffic during the test is counted too.");
+
+        return Ok(());
+    }
+
+    let number = |index: usize, default: usize| match args.get(index) {
+        Some(arg) => arg.parse::<usize>().map_err(|_| 1usize),
+        None => Ok(default),
+    };
+
+    match args.first() {
+        Some(&"udp") => {
+            let count = number(1, DEFAULT_DATAGRAMS)?;
+            let size = number(2, DEFAULT_UDP_SIZES[0])?;
+
+            header();
+            run_udp(count, size)
+        }
+        Some(&"tcp") => {
+            let megabytes = number(1, DEFAULT_TCP_MEGABYTES)?;
+
+            header();
+            run_tcp(megabytes)
+        }
+        Some(_) => Err(1),
+        None => {
+            header();
+
+            for size in DEFAULT_UDP_SIZES {
+                run_udp(DEFAULT_DATAGRAMS, size)?;
+            }
+
+            run_tcp(DEFAULT_TCP_MEGABYTES)
+        }
+    }
+}
@@ -0,0 +1,85 @@
+use noct_input::kbd::{CharKey, get_key_async};
+use noct_sched::executor::{Either, block_on, select};
+use noct_tty::println;
+
+use super::ShellContext;
+
+pub static NETDUMP_COMMAND_ENTRY: crate::ShellCommandEntry =
+    ("netdump", netdump, Some("Prints received network frames"));
+
+fn format_mac(mac: &[u8]) -> [u8; 6] {
+    let mut result = [0u8; 6];
+
+    result.copy_from_slice(&mac[..6]);
+
+    result
+}
+
+async fn wait_key_press() {
+    loop {
+        // Skip releases (e.g. of the Enter that started the command)
+        if let CharKey::Key(_, false) = get_key_async().await {
+            continue;
+        }
+
+        return;
+    }
+}
+
+pub fn netdump(_context: &mut ShellContext, args: &[&str]) -> Result<(), usize> {
+    if args.contains(&"-h") {
+        println!("netdump - Prints received network frames until a key is pressed.\n");
+        println!("Usage: netdump [frame count]");
+
+        return Ok(());
+    }
+
+    let limit = match args.first() {
+        Some(arg) => Some(arg.parse::<usize>().map_err(|_| 1usize)?),
+        None => None,
+    };
+
+    let Some(receiver) = noct_net::Receiver::new() else {
+        println!("netdump: no free listener slots in the network stack");
+        return Err(2);
+    };
+
+    println!("Listening, press any key to stop...");
+
+    let received = block_on(async {
+        let mut received = 0;
+
+        while limit != Some(received) {
+            let frame = match select(receiver.recv(), wait_key_press()).await {
+                Either::Left(frame) => frame,
+                Either::Right(()) => break,
+            };
+
+            received += 1;
+
+            if frame.data.len() < 14 {
+                println!("{}: runt frame ({} bytes)", frame.card, frame.data.len());
+                continue;
+            }
+
+            let dst = format_mac(&frame.data[0..6]);
+            let src = format_mac(&frame.data[6..12]);
+            let ethertype = u16::from_be_bytes([frame.data[12], frame.data[13]]);
+
+            println!(
+                "{}: {:02x?} -> {:02x?} type {:04x}, {} bytes",
+                frame.card,
+                src,
+                dst,
+                ethertype,
+                frame.data.len()
+            );
+        }
+
+        received
+    });
+
+    println!("{} frames, {} dropped", received, receiver.dropped());
+
+    Ok(())
+}
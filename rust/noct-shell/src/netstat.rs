@@ -0,0 +1,45 @@
+use noct_tty::println;
+
+use super::ShellContext;
+
+pub static NETSTAT_COMMAND_ENTRY: crate::ShellCommandEntry =
+    ("netstat", netstat, Some("Shows network card statistics"));
+
+pub fn netstat(_context: &mut ShellContext, args: &[&str]) -> Result<(), usize> {
+    if args.contains(&"-h") {
+        println!("netstat - Shows network card statistics.\n");
+        println!("Usage: netstat");
+        println!("\nIRQS are RX interrupts, POLLS are passes of the RX worker over the card.");
+        println!("FR/IRQ above 1 means interrupts are being coalesced by polling.");
+
+        return Ok(());
+    }
+
+    println!(
+        "{:12} {:>10} {:>8} {:>10} {:>8} {:>10} {:>10} {:>8}",
+        "CARD", "RX", "RX DROP", "TX", "TX DROP", "IRQS", "POLLS", "FR/IRQ"
+    );
+
+    for card in noct_net::card_stats() {
+        let stats = card.stats;
+        let per_irq = if stats.interrupts == 0 {
+            0
+        } else {
+            stats.rx_packets / stats.interrupts
+        };
+
+        println!(
+            "{:12} {:>10} {:>8} {:>10} {:>8} {:>10} {:>10} {:>8}",
+            card.name,
+            stats.rx_packets,
+            stats.rx_dropped,
+            stats.tx_packets,
+            stats.tx_dropped,
+            stats.interrupts,
+            stats.polls,
+            per_irq
+        );
+    }
+
+    Ok(())
+}
@@ -0,0 +1,91 @@
+use alloc::vec::Vec;
+use core::ffi::CStr;
+
+use noct_sched::{SchedClass, thread_info_t, thread_state_t_DEAD, thread_state_t_PAUSED};
+use noct_tty::println;
+
+use super::ShellContext;
+
+pub static TOP_COMMAND_ENTRY: crate::ShellCommandEntry =
+    ("top", top, Some("Shows CPU usage of every thread"));
+
+const DEFAULT_INTERVAL_MS: u32 = 1000;
+
+fn state_name(info: &thread_info_t) -> &'static str {
+    if info.idle {
+        "idle"
+    } else if info.state == thread_state_t_DEAD {
+        "dead"
+    } else if info.state == thread_state_t_PAUSED {
+        "paused"
+    } else if info.sleeping {
+        "sleep"
+    } else {
+        "run"
+    }
+}
+
+pub fn top(_context: &mut ShellContext, args: &[&str]) -> Result<(), usize> {
+    if args.contains(&"-h") {
+        println!("top - Shows CPU usage of every thread.\n");
+        println!("Usage: top [interval in ms (default: {})]", DEFAULT_INTERVAL_MS);
+
+        return Ok(());
+    }
+
+    let interval = match args.first() {
+        Some(arg) => arg.parse::<u32>().map_err(|_| 1usize)?,
+        None => DEFAULT_INTERVAL_MS,
+    };
+
+    let before = noct_sched::threads_info();
+
+    unsafe { noct_timer::sleep_ms(interval) };
+
+    let after = noct_sched::threads_info();
+
+    // CPU time of every thread spent during the interval.
+    let deltas: Vec<(&thread_info_t, u64)> = after
+        .iter()
+        .map(|info| {
+            let prev = before
+                .iter()
+                .find(|x| x.id == info.id)
+                .map(|x| x.runtime_tsc)
+                .unwrap_or(0);
+
+            (info, info.runtime_tsc.saturating_sub(prev))
+        })
+        .collect();
+
+    let total: u64 = deltas.iter().map(|x| x.1).sum::<u64>().max(1);
+
+    println!(
+        "{:>5} {:>5} {:16} {:6} {:>4} {:7} {:>6} {:>10}",
+        "TID", "PID", "NAME", "CLASS", "PRI", "STATE", "CPU%", "TIME(ms)"
+    );
+
+    for (info, delta) in deltas {
+        let name = unsafe { CStr::from_ptr(info.name.as_ptr()) }.to_string_lossy();
+        let class = SchedClass::from_raw(info.sched_class)
+            .map(|x| x.name())
+            .unwrap_or("?");
+
+        let permille = delta * 1000 / total;
+
+        println!(
+            "{:>5} {:>5} {:16} {:6} {:>4} {:7} {:>4}.{} {:>10}",
+            info.id,
+            info.pid,
+            name,
+            class,
+            info.priority,
+            state_name(info),
+            permille / 10,
+            permille % 10,
+            info.runtime_ticks
+        );
+    }
+
+    Ok(())
+}
@@ -0,0 +1,56 @@
+use noct_sched::WorkPriority;
+use noct_tty::println;
+
+use super::ShellContext;
+
+pub static WORKQ_COMMAND_ENTRY: crate::ShellCommandEntry =
+    ("workq", workq, Some("Shows kernel work queue statistics"));
+
+pub fn workq(_context: &mut ShellContext, args: &[&str]) -> Result<(), usize> {
+    if args.contains(&"-h") {
+        println!("workq - Shows kernel work queue statistics.\n");
+        println!("Usage: workq");
+
+        return Ok(());
+    }
+
+    let stats = noct_sched::workqueue_stats();
+
+    // Cycles to microseconds. Zero means the TSC is not calibrated yet.
+    let to_us = |cycles: u64| {
+        if stats.tsc_per_ms == 0 {
+            0
+        } else {
+            cycles * 1000 / stats.tsc_per_ms
+        }
+    };
+
+    println!(
+        "{:8} {:>6} {:>6} {:>10} {:>10} {:>8} {:>10} {:>10} {:>10}",
+        "QUEUE", "DEPTH", "MAX", "SUBMITTED", "COMPLETED", "DROPPED", "AVG(us)", "MAX(us)", "RUN(us)"
+    );
+
+    for (priority, queue) in WorkPriority::ALL.iter().zip(stats.queues.iter()) {
+        let completed = queue.completed as u64;
+        let avg_latency = if completed == 0 {
+            0
+        } else {
+            queue.total_latency_tsc / completed
+        };
+
+        println!(
+            "{:8} {:>6} {:>6} {:>10} {:>10} {:>8} {:>10} {:>10} {:>10}",
+            priority.name(),
+            queue.depth,
+            queue.max_depth,
+            queue.submitted,
+            queue.completed,
+            queue.dropped,
+            to_us(avg_latency),
+            to_us(queue.max_latency_tsc),
+            to_us(queue.total_run_tsc)
+        );
+    }
+
+    Ok(())
+}
@@ -59,8 +59,7 @@ pub extern "C" fn tty_putchar(c: c_char) {
     let mut binding = CONSOLE.lock();
     let console = binding.as_mut().unwrap();
 
-    console.console_mut().print_char(char::from(c as u8));
-    console.render(None);
+    console.print_char(char::from(c as u8));
 }
 
 #[unsafe(no_mangle)]
@@ -73,7 +72,16 @@ pub extern "C" fn tty_clear() {
     unsafe {
         noct_screen::clean_screen();
     }
-    console.render(None);
+    console.render();
+}
+
+/// Resizes the console after the screen mode changed.
+#[unsafe(no_mangle)]
+pub extern "C" fn tty_fit_screen() {
+    let mut binding = CONSOLE.lock();
+    let console = binding.as_mut().unwrap();
+
+    console.fit_screen();
 }
 
 #[unsafe(no_mangle)]
@@ -97,11 +105,7 @@ pub extern "C" fn tty_update() {
     let mut binding = CONSOLE.lock();
     let console = binding.as_mut().unwrap();
 
-    unsafe {
-        noct_screen::clean_screen();
-    }
-
-    console.render(None);
+    console.render();
 }
 
 #[unsafe(no_mangle)]
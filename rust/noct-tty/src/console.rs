@@ -1,3 +1,6 @@
+use core::mem;
+use core::ops::Range;
+
 use alloc::string::String;
 use alloc::vec;
 use alloc::vec::Vec;
@@ -20,22 +23,20 @@ pub struct Dimensions {
     pub columns: usize,
 }
 
-pub enum AttributeValue {
-    Color(u32),
-}
-
-pub struct Attribute {
-    pub row: usize,
-    pub column: usize,
-    pub attribute_value: AttributeValue,
-}
+const DEFAULT_COLOR: u32 = 0x00_ffffff;
 
 pub struct Console {
     dimensions: Dimensions,
     row: usize,
     column: usize,
     data: Vec<char>,
-    attributes: Vec<Attribute>,
+    // Foreground color of every cell, set from the current color when the cell is printed.
+    colors: Vec<u32>,
+    color: u32,
+    // Changed columns of every row since the last `take_dirty_row`, empty ranges are clean.
+    dirty: Vec<Range<usize>>,
+    // Lines scrolled since the last `take_scrolled`.
+    scrolled: usize,
 }
 
 impl Console {
@@ -45,12 +46,16 @@ impl Console {
             row: 0,
             column: 0,
             data: vec![char::default(); rows * columns],
-            attributes: vec![],
+            colors: vec![DEFAULT_COLOR; rows * columns],
+            color: DEFAULT_COLOR,
+            dirty: vec![0..columns; rows],
+            scrolled: 0,
         }
     }
 
     pub fn resize(&mut self, rows: usize, columns: usize) {
         let mut data = vec![char::default(); rows * columns];
+        let mut colors = vec![DEFAULT_COLOR; rows * columns];
 
         let target_rows = rows.min(self.dimensions.rows);
         let target_columns = columns.min(self.dimensions.columns);
@@ -58,16 +63,58 @@ impl Console {
         for i in 0..target_rows {
             for j in 0..target_columns {
                 data[i * columns + j] = self.data[i * self.dimensions.columns + j];
+                colors[i * columns + j] = self.colors[i * self.dimensions.columns + j];
             }
         }
 
         self.data = data;
+        self.colors = colors;
         self.dimensions = Dimensions { rows, columns };
+        self.dirty = vec![0..columns; rows];
+        self.scrolled = 0;
     }
 
     pub fn clear(&mut self) {
         self.data.fill(char::default());
-        self.attributes.clear();
+        self.colors.fill(DEFAULT_COLOR);
+        self.color = DEFAULT_COLOR;
+        self.mark_all_dirty();
+        self.scrolled = 0;
+    }
+
+    /// Marks a cell as changed.
+    pub fn mark_dirty(&mut self, row: usize, column: usize) {
+        let Some(span) = self.dirty.get_mut(row) else {
+            return;
+        };
+
+        if column >= self.dimensions.columns {
+            return;
+        }
+
+        if span.start == span.end {
+            *span = column..column + 1;
+        } else {
+            span.start = span.start.min(column);
+            span.end = span.end.max(column + 1);
+        }
+    }
+
+    pub fn mark_all_dirty(&mut self) {
+        let columns = self.dimensions.columns;
+
+        self.dirty.fill(0..columns);
+    }
+
+    /// Returns the columns of `row` changed since the last call and marks them clean.
+    pub fn take_dirty_row(&mut self, row: usize) -> Range<usize> {
+        self.dirty.get_mut(row).map(|span| mem::replace(span, 0..0)).unwrap_or(0..0)
+    }
+
+    /// Returns the number of lines scrolled since the last call.
+    /// Rows that are still on the screen keep their dirty state, shifted up with their contents.
+    pub fn take_scrolled(&mut self) -> usize {
+        mem::replace(&mut self.scrolled, 0)
     }
 
     pub fn dimensions(&self) -> &Dimensions {
@@ -97,6 +144,8 @@ impl Console {
         let begin = self.row * self.dimensions.columns;
         let end = begin + self.dimensions.columns;
 
+        self.dirty[self.row] = 0..self.dimensions.columns;
+
         &mut self.data[begin..end]
     }
 
@@ -162,14 +211,14 @@ impl Console {
         }
 
         self.data[pos] = character;
+        self.colors[pos] = self.color;
+        self.mark_dirty(self.row, self.column);
 
         self.move_right();
     }
 
-    pub fn get_attribute(&self, row: usize, column: usize) -> Option<&Attribute> {
-        self.attributes
-            .iter()
-            .find(|a| a.row == row && a.column == column)
+    pub fn get_color(&self, row: usize, column: usize) -> Option<u32> {
+        self.colors.get((row * self.dimensions.columns) + column).copied()
     }
 
     pub fn print_str(&mut self, input: &str) {
@@ -216,17 +265,11 @@ impl Console {
                     if last_char == 'm' {
                         let code = *values.last().unwrap_or(&0);
 
-                        let color = AttributeValue::Color(if code == 0 {
-                            0x00_ffffff
+                        self.color = if code == 0 {
+                            DEFAULT_COLOR
                         } else {
                             ANSI_COLORS[(code - 30) as usize]
-                        });
-
-                        self.attributes.push(Attribute {
-                            row: self.row,
-                            column: self.column,
-                            attribute_value: color,
-                        });
+                        };
 
                         continue;
                     } else if last_char == 'H' {
@@ -251,7 +294,7 @@ impl Console {
                     } else if last_char == 'K' {
                         let code = *values.last().unwrap_or(&0);
 
-                        if code == 0 {
+                        if code == 0 && self.row < self.dimensions.rows {
                             let start_position = self.column;
                             let end_position = self.dimensions.columns - 1;
                             let line = self.current_line_mut();
@@ -272,9 +315,22 @@ impl Console {
 
     pub fn scroll(&mut self) {
         self.data.copy_within(self.dimensions.columns.., 0);
+        self.colors.copy_within(self.dimensions.columns.., 0);
 
         let last_line = self.data.len() - self.dimensions.columns;
         self.data[last_line..].fill(char::default());
+        self.colors[last_line..].fill(DEFAULT_COLOR);
+
+        // The renderer moves the screen up and clears the new line, so it starts clean.
+        self.dirty.rotate_left(1);
+        *self.dirty.last_mut().unwrap() = 0..0;
+
+        self.scrolled += 1;
+
+        if self.scrolled >= self.dimensions.rows {
+            // Nothing on the screen survives, repaint everything instead.
+            self.mark_all_dirty();
+        }
     }
 
     pub fn set_position(&mut self, x: usize, y: usize) {
@@ -1,25 +1,79 @@
 use core::cell::OnceCell;
+use core::ops::Range;
 
+use alloc::vec;
+use alloc::vec::Vec;
 use noct_psf::PSF;
-use noct_screen::screen_update;
 
-use crate::console::{AttributeValue, Console};
+use crate::console::Console;
 
 unsafe extern "C" {
     #[allow(improper_ctypes)]
     pub static PSF_FONT: OnceCell<PSF>;
 }
 
+const CELL_WIDTH: usize = 8;
+const CELL_HEIGHT: usize = 16;
+const BACKGROUND: u32 = 0;
+
+// Colors with a rasterized glyph set at the same time, the oldest one is dropped beyond that.
+const MAX_ATLASES: usize = 16;
+
+/// Glyphs of the font drawn in one color on the background, in the screen pixel format,
+/// so a cell is drawn with one copy per pixel row.
+struct GlyphAtlas {
+    color: u32,
+    ready: Vec<bool>,
+    pixels: Vec<u8>,
+}
+
+impl GlyphAtlas {
+    fn new(color: u32, glyphs: usize, cell_bytes: usize) -> Self {
+        Self {
+            color,
+            ready: vec![false; glyphs],
+            pixels: vec![0; glyphs * cell_bytes],
+        }
+    }
+
+    /// Returns the cell pixels of a glyph, rasterizing it on first use.
+    fn glyph(&mut self, font: &PSF, index: u16, bytes_per_pixel: usize) -> &[u8] {
+        let row_bytes = CELL_WIDTH * bytes_per_pixel;
+        let cell_bytes = row_bytes * CELL_HEIGHT;
+        let index = index as usize;
+        let cell = &mut self.pixels[index * cell_bytes..(index + 1) * cell_bytes];
+
+        if !self.ready[index] {
+            // Glyph indices are below 0x200, where the code page conversion changes nothing.
+            font.draw_glyph_into(
+                index as u16,
+                cell,
+                row_bytes,
+                bytes_per_pixel * 8,
+                self.color,
+                Some(BACKGROUND),
+            );
+
+            self.ready[index] = true;
+        }
+
+        cell
+    }
+}
+
 pub struct RenderedConsole {
     console: Console,
-    current_color: u32,
+    atlases: Vec<GlyphAtlas>,
+    // Cell with the text cursor at the last render, it needs a repaint once the cursor leaves.
+    cursor: Option<(usize, usize)>,
 }
 
 impl RenderedConsole {
     pub fn new(console: Console) -> Self {
         Self {
             console,
-            current_color: 0x00_ffffff,
+            atlases: vec![],
+            cursor: None,
         }
     }
 
@@ -33,69 +87,172 @@ impl RenderedConsole {
 
     pub fn print_char(&mut self, c: char) {
         self.console.print_char(c);
+        self.render();
+    }
+
+    pub fn print_str(&mut self, input: &str) {
+        self.console.print_str(input);
+        self.render();
+    }
+
+    fn glyph_index(c: char) -> u16 {
+        let code = if c.is_ascii() {
+            c as u16
+        } else {
+            let mut dst = [0u8; 4];
+            c.encode_utf8(&mut dst);
 
-        if c == '\n' {
-            unsafe {
-                noct_screen::clean_screen();
+            (u32::from_be_bytes(dst) >> 16) as u16
+        };
+
+        PSF::glyph_index(code)
+    }
+
+    fn atlas(&mut self, color: u32, glyphs: usize, cell_bytes: usize) -> &mut GlyphAtlas {
+        let position = match self.atlases.iter().position(|atlas| atlas.color == color) {
+            Some(position) => position,
+            None => {
+                if self.atlases.len() >= MAX_ATLASES {
+                    self.atlases.remove(0);
+                }
+
+                self.atlases.push(GlyphAtlas::new(color, glyphs, cell_bytes));
+                self.atlases.len() - 1
             }
+        };
+
+        &mut self.atlases[position]
+    }
+
+    /// Moves the screen up by the lines the console scrolled, with one block copy.
+    fn render_scroll(&mut self) -> bool {
+        let lines = self.console.take_scrolled();
+
+        if lines == 0 {
+            return false;
+        }
+
+        let dimensions = self.console.dimensions();
+        let (rows, width) = (dimensions.rows, dimensions.columns * CELL_WIDTH);
+        let kept = rows.saturating_sub(lines);
 
-            self.render(None);
+        if kept > 0 {
+            noct_screen::copy_rect(
+                0,
+                0,
+                0,
+                (lines * CELL_HEIGHT) as isize,
+                width,
+                kept * CELL_HEIGHT,
+            );
         }
+
+        noct_screen::fill_rect(
+            0,
+            (kept * CELL_HEIGHT) as isize,
+            width,
+            (rows - kept) * CELL_HEIGHT,
+            BACKGROUND,
+        );
+
+        self.cursor = self
+            .cursor
+            .and_then(|(row, column)| row.checked_sub(lines).map(|row| (row, column)));
+
+        true
     }
 
-    pub fn print_str(&mut self, input: &str) {
-        self.console.print_str(input);
+    fn render_row(&mut self, font: &PSF, row: usize, columns: Range<usize>) {
+        let bytes_per_pixel = noct_screen::bits_per_pixel() >> 3;
+        let pitch = noct_screen::pitch();
+        let row_bytes = CELL_WIDTH * bytes_per_pixel;
+        let cell_bytes = row_bytes * CELL_HEIGHT;
+        let glyphs = font.glyph_count();
+        let screen = noct_screen::back_framebuffer_mut();
 
-        if input.contains('\n') {
-            unsafe {
-                noct_screen::clean_screen();
+        for column in columns.clone() {
+            let character = *self.console.get_character(row, column).unwrap();
+            let color = self.console.get_color(row, column).unwrap();
+            let origin = row * CELL_HEIGHT * pitch + column * row_bytes;
+
+            let index = Self::glyph_index(character);
+
+            if character == char::default() || index as usize >= glyphs {
+                for y in 0..CELL_HEIGHT {
+                    let line = origin + y * pitch;
+
+                    screen[line..line + row_bytes].fill(0);
+                }
+
+                continue;
             }
 
-            self.render(None);
+            let cell = self.atlas(color, glyphs, cell_bytes).glyph(font, index, bytes_per_pixel);
+
+            for (y, pixels) in cell.chunks_exact(row_bytes).enumerate() {
+                let line = origin + y * pitch;
+
+                screen[line..line + row_bytes].copy_from_slice(pixels);
+            }
         }
+
+        noct_screen::mark_dirty(
+            columns.start * CELL_WIDTH,
+            row * CELL_HEIGHT,
+            columns.len() * CELL_WIDTH,
+            CELL_HEIGHT,
+        );
     }
 
-    pub fn render(&mut self, start_position: Option<(usize, usize)>) {
-        let dimensions = self.console.dimensions();
+    /// Follows a screen mode change: resizes the console to the screen and redraws all of it.
+    pub fn fit_screen(&mut self) {
+        let (width, height) = noct_screen::dimensions();
+        let (rows, columns) = (height / CELL_HEIGHT, width / CELL_WIDTH);
+
+        self.console.resize(rows, columns);
 
-        let start_row = start_position.map(|(row, _)| row).unwrap_or(0);
-        let start_column = start_position.map(|(_, column)| column).unwrap_or(0);
+        let (row, column) = self.console.position();
+
+        self.console.set_position(
+            column.min(columns.saturating_sub(1)),
+            row.min(rows.saturating_sub(1)),
+        );
+
+        // The glyphs were rasterized in the old pixel format.
+        self.atlases.clear();
+        self.cursor = None;
+
+        noct_screen::fill(BACKGROUND);
+        self.render();
+    }
 
+    /// Draws the cells changed since the last render and flushes them to the screen.
+    pub fn render(&mut self) {
         let font = unsafe { PSF_FONT.get().unwrap() };
 
-        for row in start_row..dimensions.rows {
-            for column in start_column..dimensions.columns {
-                let char = self.console.get_character(row, column).unwrap();
+        let mut drawn = self.render_scroll();
 
-                if *char == char::default() {
-                    continue;
-                }
+        let position = self.console.position();
 
-                if let Some(attribute) = self.console.get_attribute(row, column) {
-                    match attribute.attribute_value {
-                        AttributeValue::Color(color) => {
-                            self.current_color = color;
-                        }
-                    }
-                }
+        if let Some((row, column)) = self.cursor.filter(|&cursor| cursor != position) {
+            self.console.mark_dirty(row, column);
+        }
+
+        self.cursor = Some(position);
 
-                font.draw_character(
-                    if char.is_ascii() {
-                        *char as u16
-                    } else {
-                        let mut dst = [0u8; 4];
-                        char.encode_utf8(&mut dst);
-
-                        let value = u32::from_be_bytes(dst) >> 16;
-                        value as u16
-                    },
-                    column * 8,
-                    row * 16,
-                    self.current_color,
-                );
+        for row in 0..self.console.dimensions().rows {
+            let columns = self.console.take_dirty_row(row);
+
+            if columns.is_empty() {
+                continue;
             }
+
+            self.render_row(font, row, columns);
+            drawn = true;
         }
 
-        unsafe { screen_update() };
+        if drawn {
+            noct_screen::flush();
+        }
     }
 }
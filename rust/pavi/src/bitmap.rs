@@ -0,0 +1,154 @@
+use alloc::vec;
+use alloc::vec::Vec;
+
+use nimage::Image;
+
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum Filter {
+    Nearest,
+    Bilinear,
+}
+
+/// An image as rows of 0x00RRGGBB pixels, ready to be copied to the window.
+pub struct Bitmap {
+    pub width: usize,
+    pub height: usize,
+    pub pixels: Vec<u32>,
+}
+
+// 16.16 fixed point source position of the center of destination pixel `index`,
+// shifted back by half a pixel so it lands between the source pixels to blend.
+fn source_position(index: usize, source: usize, destination: usize) -> i64 {
+    ((2 * index + 1) as i64 * source as i64 * 0x10000) / (2 * destination as i64) - 0x8000
+}
+
+/// Source pixel and the weight (0..=255) of the next one for each destination pixel.
+fn bilinear_taps(source: usize, destination: usize) -> Vec<(usize, usize, u32)> {
+    (0..destination)
+        .map(|index| {
+            let position = source_position(index, source, destination).max(0);
+            let first = (position >> 16) as usize;
+
+            if first + 1 >= source {
+                (source - 1, source - 1, 0)
+            } else {
+                (first, first + 1, ((position >> 8) & 0xff) as u32)
+            }
+        })
+        .collect()
+}
+
+/// Blends two 0x00RRGGBB pixels, `weight` of 256 is all `b`. Red and blue go in one multiply.
+#[inline(always)]
+fn lerp(a: u32, b: u32, weight: u32) -> u32 {
+    let keep = 256 - weight;
+    let rb = (((a & 0xff00ff) * keep + (b & 0xff00ff) * weight) >> 8) & 0xff00ff;
+    let g = (((a & 0x00ff00) * keep + (b & 0x00ff00) * weight) >> 8) & 0x00ff00;
+
+    rb | g
+}
+
+impl Bitmap {
+    /// Converts the decoded image once, so redraws do not go through `get_pixel`.
+    pub fn from_image(image: &Image) -> Self {
+        let (width, height) = (image.width(), image.height());
+        let mut pixels = Vec::with_capacity(width * height);
+
+        for y in 0..height {
+            for x in 0..width {
+                let pixel = image.get_pixel(x, y).unwrap_or(0);
+
+                pixels.push(((pixel & 0xff0000) >> 16) | (pixel & 0x00ff00) | ((pixel & 0x0000ff) << 16));
+            }
+        }
+
+        Self {
+            width,
+            height,
+            pixels,
+        }
+    }
+
+    pub fn scale(&self, width: usize, height: usize, filter: Filter) -> Self {
+        match filter {
+            Filter::Nearest => self.scale_nearest(width, height),
+            Filter::Bilinear => self.scale_bilinear(width, height),
+        }
+    }
+
+    pub fn scale_nearest(&self, width: usize, height: usize) -> Self {
+        let mut pixels = vec![0; width * height];
+
+        if self.width == 0 || self.height == 0 || width == 0 || height == 0 {
+            return Self { width, height, pixels };
+        }
+
+        let step = |source: usize, destination: usize| ((source as u64) << 16) / destination as u64;
+        let (step_x, step_y) = (step(self.width, width), step(self.height, height));
+
+        let columns: Vec<usize> = (0..width)
+            .map(|x| (((x as u64 * step_x + step_x / 2) >> 16) as usize).min(self.width - 1))
+            .collect();
+
+        for (y, row) in pixels.chunks_exact_mut(width).enumerate() {
+            let source_y = (((y as u64 * step_y + step_y / 2) >> 16) as usize).min(self.height - 1);
+            let source = &self.pixels[source_y * self.width..][..self.width];
+
+            for (pixel, &column) in row.iter_mut().zip(&columns) {
+                *pixel = source[column];
+            }
+        }
+
+        Self { width, height, pixels }
+    }
+
+    pub fn scale_bilinear(&self, width: usize, height: usize) -> Self {
+        let mut pixels = vec![0; width * height];
+
+        if self.width == 0 || self.height == 0 || width == 0 || height == 0 {
+            return Self { width, height, pixels };
+        }
+
+        let columns = bilinear_taps(self.width, width);
+        let rows = bilinear_taps(self.height, height);
+
+        for (row, &(top, bottom, weight_y)) in pixels.chunks_exact_mut(width).zip(&rows) {
+            let top = &self.pixels[top * self.width..][..self.width];
+            let bottom = &self.pixels[bottom * self.width..][..self.width];
+
+            for (pixel, &(left, right, weight_x)) in row.iter_mut().zip(&columns) {
+                let upper = lerp(top[left], top[right], weight_x);
+                let lower = lerp(bottom[left], bottom[right], weight_x);
+
+                *pixel = lerp(upper, lower, weight_y);
+            }
+        }
+
+        Self { width, height, pixels }
+    }
+
+    /// Copies the bitmap into a `target_width` wide buffer at (x, y) row by row, clipped.
+    pub fn draw_into(&self, target: &mut [u32], target_width: usize, x: isize, y: isize) {
+        let target_height = target.len() / target_width;
+
+        let x0 = x.max(0) as usize;
+        let y0 = y.max(0) as usize;
+        let x1 = (x + self.width as isize).min(target_width as isize);
+        let y1 = (y + self.height as isize).min(target_height as isize);
+
+        if x1 <= x0 as isize || y1 <= y0 as isize {
+            return;
+        }
+
+        let (x1, y1) = (x1 as usize, y1 as usize);
+        let length = x1 - x0;
+        let source_x = (x0 as isize - x) as usize;
+
+        for row in y0..y1 {
+            let source_y = (row as isize - y) as usize;
+            let source = &self.pixels[source_y * self.width + source_x..][..length];
+
+            target[row * target_width + x0..][..length].copy_from_slice(source);
+        }
+    }
+}
@@ -7,6 +7,7 @@ use core::cell::RefCell;
 use alloc::{
     format,
     string::{String, ToString},
+    vec::Vec,
 };
 use embedded_canvas::Canvas;
 use embedded_graphics::{
@@ -16,15 +17,19 @@ use embedded_graphics::{
     prelude::{Dimensions, Point, RgbColor, Size},
     text::{Baseline, Text},
 };
-use nimage::Image;
 use noct_input::{
     kbd::{Key, SpecialKey, parse_scancode},
     keyboard_buffer_get,
 };
 use noct_logger::{qemu_err, qemu_note};
+use noct_screen::window::Window;
 use noct_tty::println;
 
-#[derive(Debug)]
+mod bitmap;
+
+use bitmap::{Bitmap, Filter};
+
+#[derive(Debug, Clone, Copy, PartialEq)]
 enum ShowMode {
     Centered,
     BoundsX,
@@ -34,11 +39,17 @@ enum ShowMode {
 
 struct Pavi<'a> {
     filepath: String,
-    image: Image,
+    image: Bitmap,
+    pixel_format: String,
     render_mode: RefCell<ShowMode>,
+    filter: Filter,
+    // Scaled copies of the image for the modes shown so far, made with `filter`.
+    scaled: Vec<(ShowMode, Bitmap)>,
 
     text_ch_style: MonoTextStyle<'a, Rgb888>,
     show_status: bool,
+
+    window: Window,
 }
 
 impl Pavi<'_> {
@@ -52,94 +63,86 @@ impl Pavi<'_> {
             return Err("Invalid file format.".to_string());
         };
 
+        let (scr_w, scr_h) = noct_screen::dimensions();
+
+        let Some(window) = Window::new(0, 0, scr_w, scr_h) else {
+            return Err("Cannot create a window.".to_string());
+        };
+
         Ok(Self {
             filepath: fpath.to_string(),
-            image,
+            image: Bitmap::from_image(&image),
+            pixel_format: format!("{:?}", image.pixel_format()),
             render_mode: RefCell::new(ShowMode::Centered),
+            filter: Filter::Bilinear,
+            scaled: Vec::new(),
             text_ch_style: MonoTextStyle::new(&FONT_8X13_BOLD, Rgb888::new(0, 0xcc, 0)),
             show_status: true,
+            window,
         })
     }
 
-    fn render_image(&self) {
-        let width: usize;
-        let height: usize;
-        let (mut start_x, mut start_y) = (0isize, 0isize);
-
-        let (scr_w, scr_h) = noct_screen::dimensions();
-
-        let im_w = self.image.width();
-        let im_h = self.image.height();
+    /// Position and size of the image on a `scr_w` x `scr_h` screen.
+    fn layout(&self, scr_w: usize, scr_h: usize) -> (isize, isize, usize, usize) {
+        let (im_w, im_h) = (self.image.width.max(1), self.image.height.max(1));
 
         match *self.render_mode.borrow() {
             ShowMode::BoundsX => {
-                let diff = im_w as f64 / scr_w as f64;
-
-                width = scr_w;
-                height = (im_h as f64 / diff) as usize;
+                let height = (im_h * scr_w / im_w).max(1);
 
-                start_y = (scr_h as isize - height as isize) / 2;
+                (0, (scr_h as isize - height as isize) / 2, scr_w, height)
             }
             ShowMode::BoundsY => {
-                let diff = im_h as f64 / scr_h as f64;
-
-                width = (im_w as f64 / diff) as usize;
-                height = scr_h;
+                let width = (im_w * scr_h / im_h).max(1);
 
-                start_x = (scr_w as isize - width as isize) / 2;
-            }
-            ShowMode::Stretch => {
-                (width, height) = (scr_w, scr_h);
-            }
-            ShowMode::Centered => {
-                start_x = (scr_w as isize - im_w as isize) / 2;
-                start_y = (scr_h as isize - im_h as isize) / 2;
-
-                (width, height) = (im_w, im_h);
+                ((scr_w as isize - width as isize) / 2, 0, width, scr_h)
             }
+            ShowMode::Stretch => (0, 0, scr_w, scr_h),
+            ShowMode::Centered => (
+                (scr_w as isize - im_w as isize) / 2,
+                (scr_h as isize - im_h as isize) / 2,
+                im_w,
+                im_h,
+            ),
         }
+    }
 
-        qemu_note!("Screen: ({scr_w}, {scr_h}); Image: ({im_w}, {im_h})");
+    fn render_image(&mut self) {
+        let (scr_w, scr_h) = (self.window.width(), self.window.height());
+        let mode = *self.render_mode.borrow();
+        let (start_x, start_y, width, height) = self.layout(scr_w, scr_h);
+
+        qemu_note!("Screen: ({scr_w}, {scr_h}); Image: ({}, {})", self.image.width, self.image.height);
         qemu_note!("{start_x} {start_y} {width} {height}");
 
-        let new_image = if width == im_w && height == im_h {
+        let image = if width == self.image.width && height == self.image.height {
             &self.image
         } else {
-            &self.image.scale_to_new(width, height)
-        };
-
-        noct_screen::fill(0);
-
-        for x in 0..width {
-            for y in 0..height {
-                let pixel = new_image.get_pixel(x, y);
-
-                let Some(mut pixel) = pixel else {
-                    continue;
-                };
-
-                pixel =
-                    ((pixel & 0xff0000) >> 16) | (pixel & 0x00ff00) | ((pixel & 0x0000ff) << 16);
+            let index = match self.scaled.iter().position(|(cached, _)| *cached == mode) {
+                Some(index) => index,
+                None => {
+                    self.scaled.push((mode, self.image.scale(width, height, self.filter)));
+                    self.scaled.len() - 1
+                }
+            };
 
-                let rx = start_x + x as isize;
-                let ry = start_y + y as isize;
+            &self.scaled[index].1
+        };
 
-                if rx < 0 || ry < 0 {
-                    continue;
-                }
+        let pixels = self.window.pixels_mut();
 
-                noct_screen::set_pixel(rx as usize, ry as usize, pixel);
-            }
-        }
+        pixels.fill(0);
+        image.draw_into(pixels, scr_w, start_x, start_y);
 
         if self.show_status {
             let fmted = format!(
-                "{} - [{}x{}] ({:?} | {:?}) ({scr_w}x{scr_h})",
+                "{} - [{}x{}] ({:?} | {:?} | {}) ({scr_w}x{scr_h})",
                 self.filepath,
-                self.image.width(),
-                self.image.height(),
-                self.render_mode.borrow(),
-                self.image.pixel_format()
+                self.image.width,
+                self.image.height,
+                mode,
+                self.filter,
+                self.pixel_format
             );
 
             let text =
@@ -150,19 +153,23 @@ impl Pavi<'_> {
 
             text.draw(&mut canvas).unwrap();
 
-            for x in 0..sz.width {
-                for y in 0..sz.height {
-                    let coord = (y * sz.width) + x;
-                    let pixel = canvas.pixels[coord as usize]
-                        .map(|x| ((x.r() as u32) << 16) | ((x.g() as u32) << 8) | (x.b() as u32))
-                        .unwrap_or(0);
-
-                    noct_screen::set_pixel(x as _, y as _, pixel);
-                }
-            }
+            let status = Bitmap {
+                width: sz.width as usize,
+                height: sz.height as usize,
+                pixels: canvas
+                    .pixels
+                    .iter()
+                    .map(|x| {
+                        x.map(|x| ((x.r() as u32) << 16) | ((x.g() as u32) << 8) | (x.b() as u32))
+                            .unwrap_or(0)
+                    })
+                    .collect(),
+            };
+
+            status.draw_into(pixels, scr_w, 0, 0);
         }
 
-        noct_screen::flush();
+        self.window.present();
     }
 
     pub fn run(&mut self) {
@@ -204,6 +211,16 @@ impl Pavi<'_> {
 
                     self.render_image();
                 }
+                Key::Character('f') => {
+                    self.filter = match self.filter {
+                        Filter::Nearest => Filter::Bilinear,
+                        Filter::Bilinear => Filter::Nearest,
+                    };
+
+                    self.scaled.clear();
+
+                    self.render_image();
+                }
                 _ => {
                     qemu_note!("Key {:?} is not supported yet", key);
                 }